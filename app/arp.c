@@ -0,0 +1,321 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       ARP table management with persisted static entries
+ * @}
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arp.h"
+#include "common.h"
+#include "lwip/etharp.h"
+#include "lwip/netif.h"
+#include "lwip/tcpip.h"
+#include "net/ipv4/addr.h"
+#include "netdev_hook.h"
+#include "nvconf.h"
+#include "xtimer.h"
+
+/* lwIP gives up on a request after ARP_MAXPENDING seconds */
+#define PENDING_TIMEOUT_US  (5 * US_PER_SEC)
+
+typedef struct {
+    ip4_addr_t addr;
+    uint32_t since;
+} _pending_t;
+
+typedef struct {
+    ip4_addr_t addr;
+    struct eth_addr mac;
+} _entry_t;
+
+static netif_output_fn _orig_output;
+static _pending_t _pending[ARP_PENDING_NUMOF];
+static unsigned _pending_next;
+static arp_stats_t _stats;
+
+static _pending_t *_pending_find(const ip4_addr_t *addr, uint32_t now)
+{
+    for (unsigned i = 0; i < ARP_PENDING_NUMOF; i++) {
+        if (ip4_addr_cmp(&_pending[i].addr, addr) &&
+            ((now - _pending[i].since) < PENDING_TIMEOUT_US)) {
+            return &_pending[i];
+        }
+    }
+    return NULL;
+}
+
+/* with ARP_QUEUEING disabled lwIP keeps a single packet per unresolved
+ * entry, so a second packet to a pending next hop drops the first one */
+static void _account(struct netif *netif, const ip4_addr_t *hop)
+{
+    struct eth_addr *mac;
+    const ip4_addr_t *addr;
+    uint32_t now = xtimer_now_usec();
+    _pending_t *pending = _pending_find(hop, now);
+
+    if (etharp_find_addr(netif, hop, &mac, &addr) >= 0) {
+        _stats.hits++;
+        if (pending) {
+            ip4_addr_set_zero(&pending->addr);
+        }
+        return;
+    }
+    _stats.misses++;
+    if (pending) {
+        _stats.queue_drops++;
+        return;
+    }
+    pending = &_pending[_pending_next++ % ARP_PENDING_NUMOF];
+    ip4_addr_copy(pending->addr, *hop);
+    pending->since = now;
+}
+
+static err_t _output(struct netif *netif, struct pbuf *q,
+                     const ip4_addr_t *ipaddr)
+{
+    if (!ip4_addr_isbroadcast(ipaddr, netif) && !ip4_addr_ismulticast(ipaddr)) {
+        const ip4_addr_t *hop = ipaddr;
+
+        if (!ip4_addr_netcmp(ipaddr, netif_ip4_addr(netif),
+                             netif_ip4_netmask(netif)) &&
+            !ip4_addr_isany_val(*netif_ip4_gw(netif))) {
+            hop = netif_ip4_gw(netif);
+        }
+        _account(netif, hop);
+    }
+    return _orig_output(netif, q, ipaddr);
+}
+
+/* must be called with the lwIP core locked */
+static void _restore(void)
+{
+    nvconf_t *conf = nvconf_get();
+
+    for (unsigned i = 0; i < NVCONF_ARP_NUMOF; i++) {
+        ip4_addr_t addr;
+        struct eth_addr mac;
+
+        if (!conf->arp[i].used) {
+            continue;
+        }
+        memcpy(&addr.addr, conf->arp[i].ip, sizeof(conf->arp[i].ip));
+        memcpy(mac.addr, conf->arp[i].mac, sizeof(mac.addr));
+        etharp_add_static_entry(&addr, &mac);
+    }
+}
+
+/* must be called with the lwIP core locked */
+static void _announce(struct netif *netif)
+{
+    if (netif_is_up(netif) && netif_is_link_up(netif) &&
+        !ip4_addr_isany_val(*netif_ip4_addr(netif)) &&
+        (etharp_gratuitous(netif) == ERR_OK)) {
+        _stats.gratuitous++;
+    }
+}
+
+/* called by lwIP with the core locked */
+static void _link_cb(struct netif *netif)
+{
+    if (netif_is_link_up(netif)) {
+        /* taking the netif down flushed the static entries as well */
+        _restore();
+        _announce(netif);
+    }
+}
+
+void arp_init(void)
+{
+    struct netif *netif = netdev_hook_netif();
+
+    if (netif == NULL) {
+        return;
+    }
+    LOCK_TCPIP_CORE();
+    _orig_output = netif->output;
+    netif->output = _output;
+    netif_set_link_callback(netif, _link_cb);
+    _restore();
+    _announce(netif);
+    UNLOCK_TCPIP_CORE();
+}
+
+const arp_stats_t *arp_stats(void)
+{
+    return &_stats;
+}
+
+static nvconf_arp_t *_conf_find(const ip4_addr_t *addr)
+{
+    nvconf_t *conf = nvconf_get();
+
+    for (unsigned i = 0; i < NVCONF_ARP_NUMOF; i++) {
+        if (conf->arp[i].used &&
+            (memcmp(conf->arp[i].ip, &addr->addr, sizeof(conf->arp[i].ip)) == 0)) {
+            return &conf->arp[i];
+        }
+    }
+    return NULL;
+}
+
+static void _save(void)
+{
+    int res = nvconf_save();
+
+    if (res < 0) {
+        printf("warning: static entries not persisted (error code %d)\n", -res);
+    }
+}
+
+static int _parse_addr(ip4_addr_t *addr, const char *str)
+{
+    if (ipv4_addr_from_str((ipv4_addr_t *)&addr->addr, str) == NULL) {
+        puts("error: unable to parse IPv4 address");
+        return 1;
+    }
+    return 0;
+}
+
+static int arp_list(void)
+{
+    _entry_t entries[ARP_TABLE_SIZE];
+    unsigned num = 0;
+
+    LOCK_TCPIP_CORE();
+    for (size_t i = 0; i < ARP_TABLE_SIZE; i++) {
+        ip4_addr_t *addr;
+        struct netif *netif;
+        struct eth_addr *mac;
+
+        if (etharp_get_entry(i, &addr, &netif, &mac)) {
+            ip4_addr_copy(entries[num].addr, *addr);
+            entries[num].mac = *mac;
+            num++;
+        }
+    }
+    UNLOCK_TCPIP_CORE();
+
+    for (unsigned i = 0; i < num; i++) {
+        char addr_str[IPV4_ADDR_MAX_STR_LEN];
+        const uint8_t *mac = entries[i].mac.addr;
+
+        printf("%-15s %02x:%02x:%02x:%02x:%02x:%02x %s\n",
+               ipv4_addr_to_str(addr_str, (ipv4_addr_t *)&entries[i].addr.addr,
+                                sizeof(addr_str)),
+               mac[0], mac[1], mac[2], mac[3], mac[4], mac[5],
+               _conf_find(&entries[i].addr) ? "static" : "dynamic");
+    }
+    return 0;
+}
+
+static int arp_add(const char *addr_str, const char *mac_str)
+{
+    ip4_addr_t addr;
+    struct eth_addr mac;
+    nvconf_arp_t *entry;
+    err_t err;
+
+    if (_parse_addr(&addr, addr_str)) {
+        return 1;
+    }
+    if ((strlen(mac_str) > (3 * sizeof(mac.addr))) ||
+        (hex2ints(mac.addr, mac_str) != sizeof(mac.addr))) {
+        puts("error: unable to parse MAC address");
+        return 1;
+    }
+    if ((entry = _conf_find(&addr)) == NULL) {
+        nvconf_t *conf = nvconf_get();
+
+        for (unsigned i = 0; i < NVCONF_ARP_NUMOF; i++) {
+            if (!conf->arp[i].used) {
+                entry = &conf->arp[i];
+                break;
+            }
+        }
+    }
+    if (entry == NULL) {
+        printf("error: at most %u static entries\n", NVCONF_ARP_NUMOF);
+        return 1;
+    }
+    LOCK_TCPIP_CORE();
+    err = etharp_add_static_entry(&addr, &mac);
+    UNLOCK_TCPIP_CORE();
+    if (err != ERR_OK) {
+        printf("error: unable to add entry (lwIP error %d)\n", err);
+        return 1;
+    }
+    memcpy(entry->ip, &addr.addr, sizeof(entry->ip));
+    memcpy(entry->mac, mac.addr, sizeof(entry->mac));
+    entry->used = 1;
+    _save();
+    return 0;
+}
+
+static int arp_del(const char *addr_str)
+{
+    ip4_addr_t addr;
+    nvconf_arp_t *entry;
+
+    if (_parse_addr(&addr, addr_str)) {
+        return 1;
+    }
+    if ((entry = _conf_find(&addr)) == NULL) {
+        puts("error: no such static entry");
+        return 1;
+    }
+    LOCK_TCPIP_CORE();
+    etharp_remove_static_entry(&addr);
+    UNLOCK_TCPIP_CORE();
+    memset(entry, 0, sizeof(*entry));
+    _save();
+    return 0;
+}
+
+int arp_cmd(int argc, char **argv)
+{
+    if ((argc < 2) || (strcmp(argv[1], "list") == 0)) {
+        return arp_list();
+    }
+    else if (strcmp(argv[1], "add") == 0) {
+        if (argc < 4) {
+            printf("usage: %s add <addr> <mac>\n", argv[0]);
+            return 1;
+        }
+        return arp_add(argv[2], argv[3]);
+    }
+    else if (strcmp(argv[1], "del") == 0) {
+        if (argc < 3) {
+            printf("usage: %s del <addr>\n", argv[0]);
+            return 1;
+        }
+        return arp_del(argv[2]);
+    }
+    else if (strcmp(argv[1], "stats") == 0) {
+        printf("%" PRIu32 " hits, %" PRIu32 " misses, %" PRIu32 " queue drops, "
+               "%" PRIu32 " gratuitous\n", _stats.hits, _stats.misses,
+               _stats.queue_drops, _stats.gratuitous);
+        return 0;
+    }
+    else if (strcmp(argv[1], "reset") == 0) {
+        memset(&_stats, 0, sizeof(_stats));
+        return 0;
+    }
+    else {
+        printf("usage: %s [list|add|del|stats|reset]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
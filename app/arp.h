@@ -0,0 +1,74 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       ARP table management with persisted static entries
+ *
+ * Static entries are kept in @ref nvconf_t and installed into the lwIP ARP
+ * table at boot and again whenever the link comes up, so the first packet to
+ * a known peer never waits for resolution. A gratuitous ARP is sent at the
+ * same points so peers learn our address without asking.
+ * @}
+ */
+#ifndef ARP_H
+#define ARP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Pending resolutions tracked for queue drop accounting
+ */
+#ifndef ARP_PENDING_NUMOF
+#define ARP_PENDING_NUMOF   (4U)
+#endif
+
+/**
+ * @brief   ARP statistics, counted on IPv4 unicast output
+ */
+typedef struct {
+    uint32_t hits;          /**< next hop was resolved */
+    uint32_t misses;        /**< next hop needed a request */
+    uint32_t queue_drops;   /**< packet replaced an unsent queued one */
+    uint32_t gratuitous;    /**< gratuitous ARPs sent */
+} arp_stats_t;
+
+/**
+ * @brief   Restore the static entries and announce ourselves
+ *
+ * @pre     @ref netdev_hook_init and @ref nvconf_load were called
+ */
+void arp_init(void);
+
+/**
+ * @brief   Get the ARP statistics
+ */
+const arp_stats_t *arp_stats(void);
+
+/**
+ * @brief   ARP shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int arp_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARP_H */
+/** @} */
@@ -0,0 +1,255 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Boot-to-first-packet timeline and fast start configuration
+ * @}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "boottime.h"
+#include "lwip/netif.h"
+#include "lwip/tcpip.h"
+#ifdef MODULE_LWIP_DHCP_AUTO
+#include "lwip/dhcp.h"
+#endif
+#include "net/ipv4/addr.h"
+#include "netdev_hook.h"
+#include "nvconf.h"
+#include "xtimer.h"
+
+#define ETH_TYPE_OFFSET     (12U)
+
+static const char *_names[BOOTTIME_NUMOF] = {
+    [BOOTTIME_MAIN] = "main()",
+    [BOOTTIME_MAC] = "MAC address",
+    [BOOTTIME_LINK_UP] = "link up",
+    [BOOTTIME_NETIF_UP] = "netif up",
+    [BOOTTIME_FIRST_ARP] = "first ARP",
+    [BOOTTIME_TCP_CONNECT] = "TCP connected",
+};
+
+static uint32_t _stamps[BOOTTIME_NUMOF];
+static netdev_hook_t _hook;
+static int _fast;
+
+NETIF_DECLARE_EXT_CALLBACK(_netif_cb)
+
+void boottime_mark(boottime_event_t event)
+{
+    if ((event < BOOTTIME_NUMOF) && (_stamps[event] == 0)) {
+        uint32_t now = xtimer_now_usec();
+
+        /* 0 means "not reached" */
+        _stamps[event] = now ? now : 1;
+    }
+}
+
+uint32_t boottime_get(boottime_event_t event)
+{
+    return (event < BOOTTIME_NUMOF) ? _stamps[event] : 0;
+}
+
+static int _tx(netdev_hook_t *hook, netdev_t *dev, const iolist_t *iolist)
+{
+    (void)hook;
+    (void)dev;
+    if (_stamps[BOOTTIME_FIRST_ARP] == 0) {
+        const uint8_t *frame = iolist->iol_base;
+
+        /* lwIP puts the complete Ethernet header in the first buffer */
+        if ((iolist->iol_len >= (ETH_TYPE_OFFSET + 2)) &&
+            (frame[ETH_TYPE_OFFSET] == 0x08) &&
+            (frame[ETH_TYPE_OFFSET + 1] == 0x06)) {
+            boottime_mark(BOOTTIME_FIRST_ARP);
+        }
+    }
+    return 0;
+}
+
+/* called by lwIP with the core locked */
+static void _netif_changed(struct netif *netif, netif_nsc_reason_t reason,
+                           const netif_ext_callback_args_t *args)
+{
+    (void)args;
+    if (netif != netdev_hook_netif()) {
+        return;
+    }
+    if ((reason & LWIP_NSC_LINK_CHANGED) && netif_is_link_up(netif)) {
+        boottime_mark(BOOTTIME_LINK_UP);
+    }
+    /* static, DHCP or shell, whatever set the address last */
+    if ((reason & (LWIP_NSC_IPV4_ADDRESS_CHANGED | LWIP_NSC_STATUS_CHANGED)) &&
+        netif_is_up(netif) && !ip4_addr_isany_val(*netif_ip4_addr(netif))) {
+        boottime_mark(BOOTTIME_NETIF_UP);
+    }
+}
+
+/* must be called with the lwIP core locked */
+static int _apply(struct netif *netif)
+{
+    const nvconf_net_t *net = &nvconf_get()->net;
+    ip4_addr_t addr, netmask, gw;
+
+    if (!(net->flags & NVCONF_NET_STATIC)) {
+        return 0;
+    }
+    memcpy(&addr.addr, net->addr, sizeof(net->addr));
+    memcpy(&netmask.addr, net->netmask, sizeof(net->netmask));
+    memcpy(&gw.addr, net->gw, sizeof(net->gw));
+#ifdef MODULE_LWIP_DHCP_AUTO
+    dhcp_stop(netif);
+#endif
+    netif_set_addr(netif, &addr, &netmask, &gw);
+    return 1;
+}
+
+int boottime_init(void)
+{
+    struct netif *netif = netdev_hook_netif();
+
+    _hook.tx = _tx;
+    netdev_hook_add(&_hook);
+    if (netif == NULL) {
+        return 0;
+    }
+    LOCK_TCPIP_CORE();
+    /* later changes, e.g. a DHCP lease, are stamped as they happen */
+    netif_add_ext_callback(&_netif_cb, _netif_changed);
+    _fast = _apply(netif);
+    /* a link that came up before the callback was added */
+    if (netif_is_link_up(netif)) {
+        boottime_mark(BOOTTIME_LINK_UP);
+    }
+    if (netif_is_up(netif) && !ip4_addr_isany_val(*netif_ip4_addr(netif))) {
+        boottime_mark(BOOTTIME_NETIF_UP);
+    }
+    UNLOCK_TCPIP_CORE();
+    return _fast;
+}
+
+static void _print_addr(const char *name, const uint8_t *addr)
+{
+    char addr_str[IPV4_ADDR_MAX_STR_LEN];
+
+    printf("%s %s", name, ipv4_addr_to_str(addr_str, (const ipv4_addr_t *)addr,
+                                           sizeof(addr_str)));
+}
+
+static int boot_print(void)
+{
+    const nvconf_net_t *net = &nvconf_get()->net;
+    uint32_t prev = 0;
+
+    for (unsigned i = 0; i < BOOTTIME_NUMOF; i++) {
+        if (_stamps[i] == 0) {
+            printf("%-14s        -\n", _names[i]);
+            continue;
+        }
+        printf("%-14s %8" PRIu32 " us (+%" PRIu32 " us)\n", _names[i],
+               _stamps[i], _stamps[i] - prev);
+        prev = _stamps[i];
+    }
+    printf("fast start: %s", _fast ? "on" : "off");
+    if (net->flags & NVCONF_NET_STATIC) {
+        _print_addr(",", net->addr);
+        _print_addr("/", net->netmask);
+        _print_addr(" gw", net->gw);
+    }
+    if (net->flags & NVCONF_NET_PEER) {
+        _print_addr(", peer", net->peer);
+        printf(":%u", net->peer_port);
+    }
+    if (net->flags & NVCONF_NET_STANDBY) {
+        _print_addr(", standby", net->standby);
+        printf(":%u", net->standby_port);
+    }
+    puts("");
+    return 0;
+}
+
+static int _parse_addr(uint8_t *addr, const char *str)
+{
+    if (ipv4_addr_from_str((ipv4_addr_t *)addr, str) == NULL) {
+        printf("error: unable to parse IPv4 address %s\n", str);
+        return 1;
+    }
+    return 0;
+}
+
+static int _save(void)
+{
+    int res = nvconf_save();
+
+    if (res < 0) {
+        printf("error: unable to store configuration (error code %d)\n", -res);
+        return 1;
+    }
+    return 0;
+}
+
+int boot_cmd(int argc, char **argv)
+{
+    nvconf_net_t *net = &nvconf_get()->net;
+
+    if (argc < 2) {
+        return boot_print();
+    }
+    else if (strcmp(argv[1], "net") == 0) {
+        if (argc < 5) {
+            printf("usage: %s net <addr> <netmask> <gw>\n", argv[0]);
+            return 1;
+        }
+        if (_parse_addr(net->addr, argv[2]) ||
+            _parse_addr(net->netmask, argv[3]) ||
+            _parse_addr(net->gw, argv[4])) {
+            return 1;
+        }
+        net->flags |= NVCONF_NET_STATIC;
+        return _save();
+    }
+    else if (strcmp(argv[1], "peer") == 0) {
+        if (argc < 4) {
+            printf("usage: %s peer <addr> <port>\n", argv[0]);
+            return 1;
+        }
+        if (_parse_addr(net->peer, argv[2])) {
+            return 1;
+        }
+        net->peer_port = atoi(argv[3]);
+        net->flags |= NVCONF_NET_PEER;
+        return _save();
+    }
+    else if (strcmp(argv[1], "standby") == 0) {
+        if (argc < 4) {
+            printf("usage: %s standby <addr> <port>\n", argv[0]);
+            return 1;
+        }
+        if (_parse_addr(net->standby, argv[2])) {
+            return 1;
+        }
+        net->standby_port = atoi(argv[3]);
+        net->flags |= NVCONF_NET_STANDBY;
+        return _save();
+    }
+    else if (strcmp(argv[1], "clear") == 0) {
+        memset(net, 0, sizeof(*net));
+        return _save();
+    }
+    else {
+        printf("usage: %s [net|peer|standby|clear]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
@@ -0,0 +1,84 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Boot-to-first-packet timeline and fast start configuration
+ *
+ * Milestones are stamped with xtimer_now_usec(), i.e. relative to the timer
+ * initialization early in board start-up. Only the first occurrence of each
+ * milestone is kept. Milestones already reached when main() runs (e.g. a
+ * link that came up during auto init) are stamped when main() notices them.
+ *
+ * The fast start configuration stored in @ref nvconf_net_t provides the IP
+ * configuration and the collector address, so neither DHCP nor the shell is
+ * needed before the first connection.
+ * @}
+ */
+#ifndef BOOTTIME_H
+#define BOOTTIME_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Boot milestones, in expected order
+ */
+typedef enum {
+    BOOTTIME_MAIN,              /**< main() entered */
+    BOOTTIME_MAC,               /**< MAC address read from the driver */
+    BOOTTIME_LINK_UP,           /**< PHY reported link up */
+    BOOTTIME_NETIF_UP,          /**< netif up with an IPv4 address */
+    BOOTTIME_FIRST_ARP,         /**< first ARP frame sent */
+    BOOTTIME_TCP_CONNECT,       /**< first TCP connection established */
+    BOOTTIME_NUMOF,             /**< number of milestones */
+} boottime_event_t;
+
+/**
+ * @brief   Stamp @p event unless it was stamped before
+ */
+void boottime_mark(boottime_event_t event);
+
+/**
+ * @brief   Get the time stamp of @p event
+ *
+ * @return  time stamp in us, 0 if the milestone was not reached yet
+ */
+uint32_t boottime_get(boottime_event_t event);
+
+/**
+ * @brief   Apply the fast start configuration and start the timeline hooks
+ *
+ * @pre     @ref netdev_hook_init and @ref nvconf_load were called
+ *
+ * @return  1 if a static IP configuration from flash was applied
+ * @return  0 if the interface keeps its default configuration
+ */
+int boottime_init(void);
+
+/**
+ * @brief   Boot timeline shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int boot_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOTTIME_H */
+/** @} */
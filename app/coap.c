@@ -0,0 +1,682 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       CoAP server with Observe and block-wise transfer
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coap.h"
+#include "lwip/api.h"
+#include "net/sock/udp.h"
+#include "prio.h"
+#include "random.h"
+#include "thread.h"
+#include "xtimer.h"
+
+#ifdef MODULE_LWIP_IPV6
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#define TYPE_CON            (0U)
+#define TYPE_NON            (1U)
+#define TYPE_ACK            (2U)
+#define TYPE_RST            (3U)
+
+#define CODE_EMPTY          (0x00U)
+#define CODE_GET            (0x01U)
+#define CODE_CONTENT        (0x45U)     /* 2.05 */
+#define CODE_BAD_OPTION     (0x82U)     /* 4.02 */
+#define CODE_NOT_FOUND      (0x84U)     /* 4.04 */
+#define CODE_NOT_ALLOWED    (0x85U)     /* 4.05 */
+
+#define OPT_ETAG            (4U)
+#define OPT_OBSERVE         (6U)
+#define OPT_URI_PATH        (11U)
+#define OPT_CONTENT_FORMAT  (12U)
+#define OPT_BLOCK2          (23U)
+#define OPT_SIZE2           (28U)
+
+#define CF_TEXT             (0U)
+#define CF_LINK_FORMAT      (40U)
+#define CF_OCTET_STREAM     (42U)
+
+#define TX_SIZE             (128U)
+#define PATH_MAX_LEN        (32U)
+#define IDLE_US             (100U * US_PER_MS)
+
+typedef struct {
+    uint8_t type;
+    uint8_t code;
+    uint16_t mid;
+    uint8_t tkl;
+    const uint8_t *token;
+    char path[PATH_MAX_LEN];
+    bool has_observe;
+    uint32_t observe;
+    bool has_block2;
+    uint32_t block2;
+} _req_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    unsigned last_opt;
+} _msg_t;
+
+typedef struct {
+    bool used;
+    sock_udp_ep_t ep;
+    uint8_t tkl;
+    uint8_t token[8];
+    uint16_t mid;               /* of the last notification */
+} _observer_t;
+
+#ifdef MODULE_SOCK_UDP
+static const char _links[] = "</value>;obs;ct=0,</waveform>;ct=42;sz=";
+static sock_udp_t _sock;
+static bool _running;
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+static uint8_t _rx[COAP_RX_BUF_SIZE];
+static uint8_t _tx[TX_SIZE];
+static coap_stats_t _stats;
+static uint32_t _stats_since;
+static uint16_t _mid;
+
+static _observer_t _observers[COAP_OBSERVERS];
+static uint32_t _observe_seq;
+static volatile uint32_t _value;
+static volatile uint32_t _rate;
+static volatile uint32_t _interval_us = COAP_INTERVAL_MS * US_PER_MS;
+static uint32_t _next_change;
+static uint32_t _last_notify;
+static uint32_t _pending;       /* changes since the last notification */
+
+static int16_t _waveform[COAP_WAVEFORM_SIZE / sizeof(int16_t)];
+static uint32_t _etag;
+static sock_udp_ep_t _xfer_ep;
+static uint32_t _xfer_start;
+
+static bool _ep_equal(const sock_udp_ep_t *a, const sock_udp_ep_t *b)
+{
+    return (a->family == b->family) && (a->port == b->port) &&
+           (memcmp(&a->addr, &b->addr, (a->family == AF_INET6)
+                   ? sizeof(a->addr.ipv6) : sizeof(a->addr.ipv4)) == 0);
+}
+
+/* synthetic capture: a triangle wave whose period changes per capture */
+static void _capture(void)
+{
+    unsigned period = 64 + 16 * (_etag % 8);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(_waveform); i++) {
+        unsigned phase = i % period;
+        int32_t v = (phase < period / 2) ? phase : (period - phase);
+
+        _waveform[i] = (v * 65535) / (int32_t)period - 16384;
+    }
+    _etag++;
+}
+
+static unsigned _ext(unsigned v)
+{
+    return (v < 13) ? v : ((v < 269) ? 13 : 14);
+}
+
+static void _opt(_msg_t *m, unsigned num, const void *val, size_t len)
+{
+    unsigned delta = num - m->last_opt;
+    uint8_t *p = m->buf + m->len;
+
+    *p++ = (_ext(delta) << 4) | _ext(len);
+    for (unsigned i = 0, v = delta; i < 2; i++, v = len) {
+        if (v >= 269) {
+            *p++ = (v - 269) >> 8;
+            *p++ = (v - 269) & 0xff;
+        }
+        else if (v >= 13) {
+            *p++ = v - 13;
+        }
+    }
+    memcpy(p, val, len);
+    m->len = (p + len) - m->buf;
+    m->last_opt = num;
+}
+
+static void _opt_uint(_msg_t *m, unsigned num, uint32_t value)
+{
+    uint8_t buf[4];
+    size_t len = 0;
+
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        if (len || (value >> shift) & 0xff) {
+            buf[len++] = value >> shift;
+        }
+    }
+    _opt(m, num, buf, len);
+}
+
+static void _hdr(_msg_t *m, uint8_t type, uint8_t code, uint16_t mid,
+                 const uint8_t *token, uint8_t tkl)
+{
+    m->buf = _tx;
+    m->buf[0] = (1 << 6) | (type << 4) | tkl;
+    m->buf[1] = code;
+    m->buf[2] = mid >> 8;
+    m->buf[3] = mid & 0xff;
+    if (tkl) {
+        memcpy(m->buf + 4, token, tkl);
+    }
+    m->len = 4 + tkl;
+    m->last_opt = 0;
+}
+
+/* response header matching the request type */
+static void _reply_hdr(_msg_t *m, const _req_t *req, uint8_t code)
+{
+    if (req->type == TYPE_CON) {
+        _hdr(m, TYPE_ACK, code, req->mid, req->token, req->tkl);
+    }
+    else {
+        _hdr(m, TYPE_NON, code, _mid++, req->token, req->tkl);
+    }
+}
+
+static void _payload(_msg_t *m, const void *data, size_t len)
+{
+    if (len) {
+        m->buf[m->len++] = 0xff;
+        memcpy(m->buf + m->len, data, len);
+        m->len += len;
+    }
+}
+
+static void _send(const sock_udp_ep_t *remote, const _msg_t *m)
+{
+    sock_udp_send(&_sock, m->buf, m->len, remote);
+}
+
+/* sends the header from m and data without copying it */
+static int _send_ref(const sock_udp_ep_t *remote, _msg_t *m,
+                     const void *data, size_t len)
+{
+    struct netbuf *buf = netbuf_new();
+    struct pbuf *ref = pbuf_alloc(PBUF_RAW, len, PBUF_REF);
+    ip_addr_t addr;
+    err_t err = ERR_MEM;
+
+    m->buf[m->len++] = 0xff;
+    if (buf && ref && netbuf_alloc(buf, m->len)) {
+        memcpy(buf->p->payload, m->buf, m->len);
+        ref->payload = (void *)data;
+        pbuf_cat(buf->p, ref);
+        ref = NULL;
+        /* the application runs lwIP with IPv4 */
+        memcpy(ip_2_ip4(&addr), &remote->addr.ipv4, sizeof(ip4_addr_t));
+        err = netconn_sendto(_sock.base.conn, buf, &addr, remote->port);
+    }
+    if (ref) {
+        pbuf_free(ref);
+    }
+    if (buf) {
+        netbuf_delete(buf);
+    }
+    return (err == ERR_OK) ? 0 : -EIO;
+}
+
+static uint32_t _uint(const uint8_t *val, size_t len)
+{
+    uint32_t v = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        v = (v << 8) | val[i];
+    }
+    return v;
+}
+
+/* returns 0, -EINVAL for malformed messages, -ENOTSUP for unknown critical
+ * options */
+static int _parse(_req_t *req, const uint8_t *buf, size_t len)
+{
+    unsigned num = 0;
+    size_t pos, path_len = 0;
+
+    memset(req, 0, sizeof(*req));
+    if ((len < 4) || ((buf[0] >> 6) != 1) || ((buf[0] & 0xf) > 8)) {
+        return -EINVAL;
+    }
+    req->type = (buf[0] >> 4) & 0x3;
+    req->tkl = buf[0] & 0xf;
+    req->code = buf[1];
+    req->mid = (buf[2] << 8) | buf[3];
+    req->token = buf + 4;
+    pos = 4 + req->tkl;
+    if (pos > len) {
+        return -EINVAL;
+    }
+    while ((pos < len) && (buf[pos] != 0xff)) {
+        unsigned v[2] = { buf[pos] >> 4, buf[pos] & 0xf };
+
+        pos++;
+        for (unsigned i = 0; i < 2; i++) {
+            if (v[i] == 15) {
+                return -EINVAL;
+            }
+            if (v[i] == 13) {
+                v[i] = (pos < len) ? (13 + buf[pos]) : 0;
+                pos++;
+            }
+            else if (v[i] == 14) {
+                v[i] = (pos + 1 < len) ? (269 + ((buf[pos] << 8) |
+                                                 buf[pos + 1])) : 0;
+                pos += 2;
+            }
+        }
+        if (pos + v[1] > len) {
+            return -EINVAL;
+        }
+        num += v[0];
+        switch (num) {
+        case OPT_OBSERVE:
+            req->has_observe = true;
+            req->observe = _uint(buf + pos, v[1]);
+            break;
+        case OPT_URI_PATH:
+            if (path_len + 1 + v[1] >= sizeof(req->path)) {
+                return -EINVAL;
+            }
+            req->path[path_len++] = '/';
+            memcpy(req->path + path_len, buf + pos, v[1]);
+            path_len += v[1];
+            break;
+        case OPT_BLOCK2:
+            req->has_block2 = true;
+            req->block2 = _uint(buf + pos, v[1]);
+            break;
+        case 3:     /* Uri-Host */
+        case 7:     /* Uri-Port */
+        case 15:    /* Uri-Query */
+        case 17:    /* Accept */
+            break;
+        default:
+            /* odd option numbers are critical */
+            if (num & 1) {
+                return -ENOTSUP;
+            }
+        }
+        pos += v[1];
+    }
+    return 0;
+}
+
+static _observer_t *_find_observer(const sock_udp_ep_t *ep,
+                                   const uint8_t *token, uint8_t tkl)
+{
+    for (unsigned i = 0; i < COAP_OBSERVERS; i++) {
+        _observer_t *o = &_observers[i];
+
+        if (o->used && (o->tkl == tkl) && _ep_equal(&o->ep, ep) &&
+            (memcmp(o->token, token, tkl) == 0)) {
+            return o;
+        }
+    }
+    return NULL;
+}
+
+static _observer_t *_observe(const sock_udp_ep_t *ep, const _req_t *req)
+{
+    _observer_t *o = _find_observer(ep, req->token, req->tkl);
+
+    for (unsigned i = 0; (o == NULL) && (i < COAP_OBSERVERS); i++) {
+        if (!_observers[i].used) {
+            o = &_observers[i];
+            o->used = true;
+            o->ep = *ep;
+            o->tkl = req->tkl;
+            memcpy(o->token, req->token, req->tkl);
+        }
+    }
+    return o;
+}
+
+static void _value_msg(_msg_t *m, bool observe)
+{
+    char buf[12];
+    int len = snprintf(buf, sizeof(buf), "%" PRIu32, _value);
+
+    if (observe) {
+        _opt_uint(m, OPT_OBSERVE, _observe_seq & 0xffffff);
+    }
+    _opt_uint(m, OPT_CONTENT_FORMAT, CF_TEXT);
+    _payload(m, buf, len);
+}
+
+static void _get_value(const sock_udp_ep_t *remote, const _req_t *req)
+{
+    _observer_t *o = NULL;
+    _msg_t m;
+
+    if (req->has_observe && (req->observe == 0)) {
+        /* without a free entry the client gets a plain response */
+        o = _observe(remote, req);
+    }
+    else if (req->has_observe && (req->observe == 1)) {
+        o = _find_observer(remote, req->token, req->tkl);
+        if (o) {
+            o->used = false;
+            o = NULL;
+        }
+    }
+    _reply_hdr(&m, req, CODE_CONTENT);
+    _value_msg(&m, o != NULL);
+    _send(remote, &m);
+}
+
+static void _get_waveform(const sock_udp_ep_t *remote, const _req_t *req)
+{
+    unsigned szx = COAP_BLOCK_SZX;
+    uint32_t num = 0;
+    size_t size, offset, len;
+    bool more;
+    _msg_t m;
+
+    if (req->has_block2) {
+        num = req->block2 >> 4;
+        szx = MIN(szx, req->block2 & 0x7);
+    }
+    size = 1U << (szx + 4);
+    offset = num * size;
+    if (offset >= sizeof(_waveform)) {
+        _stats.errors++;
+        _reply_hdr(&m, req, CODE_BAD_OPTION);
+        _send(remote, &m);
+        return;
+    }
+    len = MIN(size, sizeof(_waveform) - offset);
+    more = (offset + len) < sizeof(_waveform);
+
+    _reply_hdr(&m, req, CODE_CONTENT);
+    _opt(&m, OPT_ETAG, &_etag, sizeof(_etag));
+    _opt_uint(&m, OPT_CONTENT_FORMAT, CF_OCTET_STREAM);
+    _opt_uint(&m, OPT_BLOCK2, (num << 4) | (more << 3) | szx);
+    if (num == 0) {
+        _opt_uint(&m, OPT_SIZE2, sizeof(_waveform));
+        _xfer_ep = *remote;
+        _xfer_start = xtimer_now_usec();
+    }
+    if (_send_ref(remote, &m, (uint8_t *)_waveform + offset, len) < 0) {
+        _stats.errors++;
+        return;
+    }
+    _stats.blocks++;
+    _stats.block_bytes += len;
+    if (!more && _ep_equal(remote, &_xfer_ep)) {
+        _stats.transfers++;
+        _stats.block_us += xtimer_now_usec() - _xfer_start;
+    }
+}
+
+static void _get_core(const sock_udp_ep_t *remote, const _req_t *req)
+{
+    char buf[sizeof(_links) + 8];
+    int len = snprintf(buf, sizeof(buf), "%s%u", _links,
+                       (unsigned)sizeof(_waveform));
+    _msg_t m;
+
+    _reply_hdr(&m, req, CODE_CONTENT);
+    _opt_uint(&m, OPT_CONTENT_FORMAT, CF_LINK_FORMAT);
+    _payload(&m, buf, len);
+    _send(remote, &m);
+}
+
+static void _handle(const sock_udp_ep_t *remote, size_t len)
+{
+    _req_t req;
+    _msg_t m;
+    int res = _parse(&req, _rx, len);
+
+    if (res == -EINVAL) {
+        _stats.errors++;
+        return;
+    }
+    if (req.code == CODE_EMPTY) {
+        if (req.type == TYPE_CON) {
+            /* CoAP ping */
+            _hdr(&m, TYPE_RST, CODE_EMPTY, req.mid, NULL, 0);
+            _send(remote, &m);
+        }
+        else if (req.type == TYPE_RST) {
+            for (unsigned i = 0; i < COAP_OBSERVERS; i++) {
+                if (_observers[i].used && (_observers[i].mid == req.mid) &&
+                    _ep_equal(&_observers[i].ep, remote)) {
+                    _observers[i].used = false;
+                }
+            }
+        }
+        return;
+    }
+    if ((req.type != TYPE_CON) && (req.type != TYPE_NON)) {
+        return;
+    }
+    _stats.requests++;
+    if (res == -ENOTSUP) {
+        _stats.errors++;
+        _reply_hdr(&m, &req, CODE_BAD_OPTION);
+        _send(remote, &m);
+    }
+    else if (req.code != CODE_GET) {
+        _stats.errors++;
+        _reply_hdr(&m, &req, CODE_NOT_ALLOWED);
+        _send(remote, &m);
+    }
+    else if (strcmp(req.path, "/value") == 0) {
+        _get_value(remote, &req);
+    }
+    else if (strcmp(req.path, "/waveform") == 0) {
+        _get_waveform(remote, &req);
+    }
+    else if (strcmp(req.path, "/.well-known/core") == 0) {
+        _get_core(remote, &req);
+    }
+    else {
+        _reply_hdr(&m, &req, CODE_NOT_FOUND);
+        _send(remote, &m);
+    }
+}
+
+static void _notify(uint32_t now)
+{
+    bool sent = false;
+
+    _observe_seq++;
+    for (unsigned i = 0; i < COAP_OBSERVERS; i++) {
+        _observer_t *o = &_observers[i];
+        _msg_t m;
+
+        if (!o->used) {
+            continue;
+        }
+        o->mid = _mid++;
+        _hdr(&m, TYPE_NON, CODE_CONTENT, o->mid, o->token, o->tkl);
+        _value_msg(&m, true);
+        _send(&o->ep, &m);
+        _stats.notifications++;
+        sent = true;
+    }
+    if (sent) {
+        _stats.coalesced += _pending - 1;
+    }
+    _pending = 0;
+    _last_notify = now;
+}
+
+/* advances the producer and notifies when due, returns the time until
+ * the next event */
+static uint32_t _tick(void)
+{
+    uint32_t now = xtimer_now_usec();
+    uint32_t rate = _rate;
+    uint32_t timeout = IDLE_US;
+
+    if (rate) {
+        uint32_t period = MAX(US_PER_SEC / rate, 1);
+        int32_t behind = now - _next_change;
+
+        /* don't catch up on more than a second of changes, and restart
+         * after the producer was stopped */
+        if ((behind > (int32_t)US_PER_SEC) || (behind < -(int32_t)US_PER_SEC)) {
+            _next_change = now;
+        }
+        while ((int32_t)(now - _next_change) >= 0) {
+            _value++;
+            _stats.changes++;
+            _pending++;
+            _next_change += period;
+        }
+        timeout = MIN(timeout, _next_change - now);
+    }
+    if (_pending) {
+        uint32_t since = now - _last_notify;
+
+        if (since >= _interval_us) {
+            _notify(now);
+        }
+        else {
+            timeout = MIN(timeout, _interval_us - since);
+        }
+    }
+    return timeout;
+}
+
+static void *_server_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        sock_udp_ep_t remote;
+        ssize_t res = sock_udp_recv(&_sock, _rx, sizeof(_rx), _tick(),
+                                    &remote);
+
+        if (res > 0) {
+            _handle(&remote, res);
+        }
+    }
+    return NULL;
+}
+
+int coap_start(uint16_t port)
+{
+    sock_udp_ep_t local = SOCK_IP_EP_ANY;
+    int res;
+
+    if (_running) {
+        return -EALREADY;
+    }
+    local.port = port;
+    if ((res = sock_udp_create(&_sock, &local, NULL, 0)) < 0) {
+        return res;
+    }
+    _capture();
+    _mid = random_uint32();
+    _stats_since = xtimer_now_usec();
+    _running = true;
+    if (thread_create(_stack, sizeof(_stack), PRIO_COAP,
+                      THREAD_CREATE_STACKTEST, _server_thread, NULL,
+                      "coap") <= KERNEL_PID_UNDEF) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+const coap_stats_t *coap_stats(void)
+{
+    return &_stats;
+}
+
+static uint32_t _per_sec(uint32_t count, uint32_t us)
+{
+    return us ? (uint32_t)(((uint64_t)count * US_PER_SEC) / us) : 0;
+}
+
+static void _print(void)
+{
+    uint32_t elapsed = xtimer_now_usec() - _stats_since;
+    unsigned observers = 0;
+
+    for (unsigned i = 0; i < COAP_OBSERVERS; i++) {
+        observers += _observers[i].used;
+    }
+    printf("requests %" PRIu32 ", errors %" PRIu32 ", %u observers\n",
+           _stats.requests, _stats.errors, observers);
+    printf("changes %" PRIu32 " (%" PRIu32 "/s), notifications %" PRIu32
+           " (%" PRIu32 "/s), coalesced %" PRIu32 "\n", _stats.changes,
+           _per_sec(_stats.changes, elapsed), _stats.notifications,
+           _per_sec(_stats.notifications, elapsed), _stats.coalesced);
+    printf("blocks %" PRIu32 ", %" PRIu32 " KiB, %" PRIu32 " transfers",
+           _stats.blocks, (uint32_t)(_stats.block_bytes / 1024),
+           _stats.transfers);
+    if (_stats.block_us) {
+        printf(", %" PRIu32 " kbit/s",
+               (uint32_t)((uint64_t)_stats.transfers * sizeof(_waveform) *
+                          8000 / _stats.block_us));
+    }
+    puts("");
+}
+
+int coap_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        _print();
+        return 0;
+    }
+    else if (strcmp(argv[1], "start") == 0) {
+        int res = coap_start((argc > 2) ? strtoul(argv[2], NULL, 0)
+                                        : COAP_PORT);
+
+        if (res < 0) {
+            printf("error: unable to start CoAP server (error code %d)\n",
+                   -res);
+            return 1;
+        }
+        return 0;
+    }
+    else if ((strcmp(argv[1], "rate") == 0) && (argc > 2)) {
+        _rate = strtoul(argv[2], NULL, 0);
+        return 0;
+    }
+    else if ((strcmp(argv[1], "interval") == 0) && (argc > 2)) {
+        _interval_us = strtoul(argv[2], NULL, 0) * US_PER_MS;
+        return 0;
+    }
+    else if (strcmp(argv[1], "capture") == 0) {
+        _capture();
+        return 0;
+    }
+    else if (strcmp(argv[1], "reset") == 0) {
+        memset(&_stats, 0, sizeof(_stats));
+        _stats_since = xtimer_now_usec();
+        return 0;
+    }
+    printf("usage: %s [start [<port>]|rate <changes/s>|interval <ms>|"
+           "capture|reset]\n", argv[0]);
+    return 1;
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
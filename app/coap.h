@@ -0,0 +1,117 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       CoAP server with Observe and block-wise transfer
+ *
+ * One thread serves CoAP (RFC 7252) GET requests on a sock_udp socket.
+ * Confirmable requests are answered piggybacked, non-confirmable ones
+ * with a non-confirmable response.
+ *
+ * Resources:
+ * - `/.well-known/core`    link format listing
+ * - `/value`               counter that a producer changes `coap rate`
+ *                          times per second, observable (RFC 7641)
+ * - `/waveform`            capture of @ref COAP_WAVEFORM_SIZE bytes of
+ *                          16 bit samples, block-wise (RFC 7959)
+ *
+ * Notifications go out at most once per `coap interval`. Changes that
+ * happen faster are coalesced: the next notification carries the latest
+ * value, and the skipped changes are counted. An observer is removed when
+ * it answers a notification with a reset or deregisters with Observe 1.
+ *
+ * Blocks of the waveform are handed to lwIP as PBUF_REF references into
+ * the capture, behind a small header pbuf, so they are not copied before
+ * the driver takes them. `coap capture` takes a new capture and changes
+ * the ETag, so a transfer running across it is detected by the client.
+ * tools/coap_bench.py measures both against the libcoap client.
+ * @}
+ */
+#ifndef COAP_H
+#define COAP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef COAP_PORT
+#define COAP_PORT               (5683U)     /**< default listen port */
+#endif
+#ifndef COAP_OBSERVERS
+#define COAP_OBSERVERS          (4U)        /**< concurrent observers */
+#endif
+#ifndef COAP_WAVEFORM_SIZE
+#define COAP_WAVEFORM_SIZE      (16U * 1024U) /**< capture size in bytes */
+#endif
+#ifndef COAP_BLOCK_SZX
+#define COAP_BLOCK_SZX          (6U)        /**< largest block, 2^(4+szx) */
+#endif
+#ifndef COAP_INTERVAL_MS
+#define COAP_INTERVAL_MS        (100U)      /**< default notification gap */
+#endif
+#ifndef COAP_RX_BUF_SIZE
+#define COAP_RX_BUF_SIZE        (256U)      /**< request buffer */
+#endif
+/** @} */
+
+/**
+ * @brief   Server statistics
+ */
+typedef struct {
+    uint32_t requests;          /**< requests answered */
+    uint32_t errors;            /**< malformed or unsupported requests */
+    uint32_t changes;           /**< changes of `/value` */
+    uint32_t notifications;     /**< notifications sent */
+    uint32_t coalesced;         /**< changes not notified on their own */
+    uint32_t blocks;            /**< waveform blocks sent */
+    uint32_t transfers;         /**< complete waveform transfers */
+    uint64_t block_bytes;       /**< waveform bytes sent */
+    uint64_t block_us;          /**< duration of the complete transfers */
+} coap_stats_t;
+
+/**
+ * @brief   Start the server thread
+ *
+ * @param[in] port      port to listen on
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the server is already running
+ * @return  -ENOMEM if the thread could not be created
+ */
+int coap_start(uint16_t port);
+
+/**
+ * @brief   Get the server statistics
+ */
+const coap_stats_t *coap_stats(void);
+
+/**
+ * @brief   CoAP shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int coap_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COAP_H */
+/** @} */
@@ -54,4 +54,32 @@ size_t hex2ints(uint8_t *out, const char *in)
     return out_size;
 }
 
+int tokenize(char *line, char **argv, int max)
+{
+    int argc = 0;
+
+    while (*line && (argc < max)) {
+        char end = ' ';
+
+        while ((*line == ' ') || (*line == '\t')) {
+            line++;
+        }
+        if (*line == '\0') {
+            break;
+        }
+        if (*line == '"') {
+            end = '"';
+            line++;
+        }
+        argv[argc++] = line;
+        while (*line && (*line != end) && ((end == '"') || (*line != '\t'))) {
+            line++;
+        }
+        if (*line) {
+            *line++ = '\0';
+        }
+    }
+    return argc;
+}
+
 /** @} */
@@ -47,6 +47,20 @@ extern "C" {
  */
 size_t hex2ints(uint8_t *out, const char *in);
 
+/**
+ * @brief   Splits a command line into arguments in place
+ *
+ * Arguments are separated by blanks, double quotes group blanks into one
+ * argument.
+ *
+ * @param[in,out] line  `\0` terminated command line
+ * @param[out] argv     argument pointers into @p line
+ * @param[in] max       size of @p argv
+ *
+ * @return  number of arguments
+ */
+int tokenize(char *line, char **argv, int max);
+
 #ifdef MODULE_SOCK_IP
 /**
  * @brief   Raw IP shell command
@@ -84,6 +98,17 @@ int tcp_cmd(int argc, char **argv);
  * @return  other on error
  */
 int udp_cmd(int argc, char **argv);
+
+/**
+ * @brief   Reliable UDP bulk transfer shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int rudp_cmd(int argc, char **argv);
 #endif
 
 #ifdef __cplusplus
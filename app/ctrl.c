@@ -0,0 +1,398 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Binary UDP control channel for benchmark orchestration
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "coap.h"
+#include "common.h"
+#include "ctrl.h"
+#include "fwup.h"
+#include "http.h"
+#include "metrics.h"
+#include "msg.h"
+#include "net/sock/udp.h"
+#include "prio.h"
+#include "ptp_slave.h"
+#include "rsh.h"
+#include "stream.h"
+#include "thread.h"
+#include "tls.h"
+#include "xtimer.h"
+
+#ifdef MODULE_LWIP_IPV6
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#ifdef MODULE_SOCK_UDP
+#define JOB_ARGS_MAX        (16U)
+#define MSG_JOB             (0x4301)
+
+static uint8_t _buf[CTRL_BUF_SIZE];
+static sock_udp_t _sock;
+static const shell_command_t *_commands;
+static bool _running;
+static char _ctrl_stack[THREAD_STACKSIZE_DEFAULT];
+
+static char _job_line[SHELL_DEFAULT_BUFSIZE];
+static volatile uint8_t _job_state = CTRL_JOB_IDLE;
+static uint16_t _job_seq;
+static int _job_ret;
+static uint32_t _job_start, _job_end;
+static kernel_pid_t _job_pid;
+static char _job_stack[THREAD_STACKSIZE_MAIN];
+
+static const shell_command_t *_find(const char *line)
+{
+    size_t len = strcspn(line, " \t");
+
+    for (const shell_command_t *cmd = _commands; cmd->name; cmd++) {
+        if ((strlen(cmd->name) == len) &&
+            (strncmp(cmd->name, line, len) == 0)) {
+            return cmd;
+        }
+    }
+    return NULL;
+}
+
+static void *_job_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        char *argv[JOB_ARGS_MAX];
+        msg_t msg;
+        int argc;
+
+        msg_receive(&msg);
+        argc = tokenize(_job_line, argv, JOB_ARGS_MAX);
+        _job_ret = _find(argv[0])->handler(argc, argv);
+        _job_end = xtimer_now_usec();
+        _job_state = CTRL_JOB_DONE;
+    }
+    return NULL;
+}
+
+static int _exec(const uint8_t *payload, size_t len, uint16_t seq)
+{
+    msg_t msg = { .type = MSG_JOB };
+
+    /* a retransmitted request must not start the job again */
+    if ((_job_state != CTRL_JOB_IDLE) && (seq == _job_seq)) {
+        return 0;
+    }
+    if (_job_state == CTRL_JOB_RUNNING) {
+        return -EBUSY;
+    }
+    if (len >= sizeof(_job_line)) {
+        return -E2BIG;
+    }
+    memcpy(_job_line, payload, len);
+    _job_line[len] = '\0';
+    if (_find(_job_line) == NULL) {
+        return -ENOENT;
+    }
+    _job_seq = seq;
+    _job_start = xtimer_now_usec();
+    _job_state = CTRL_JOB_RUNNING;
+    /* the job thread is waiting unless a job is running */
+    if (msg_try_send(&msg, _job_pid) != 1) {
+        _job_state = CTRL_JOB_DONE;
+        return -EBUSY;
+    }
+    return 0;
+}
+
+static size_t _status(uint8_t *out)
+{
+    ctrl_status_t status = {
+        .state = _job_state,
+        .seq = byteorder_htons(_job_seq),
+        .ret = byteorder_htonl(_job_ret),
+    };
+    uint32_t end = (_job_state == CTRL_JOB_DONE) ? _job_end
+                                                 : xtimer_now_usec();
+
+    if (_job_state != CTRL_JOB_IDLE) {
+        status.elapsed_ms = byteorder_htonl((end - _job_start) / US_PER_MS);
+    }
+    memcpy(out, &status, sizeof(status));
+    return sizeof(status);
+}
+
+static size_t _put_u32(uint8_t *out, size_t offset, uint32_t value)
+{
+    network_uint32_t n = byteorder_htonl(value);
+
+    memcpy(out + offset, &n, sizeof(n));
+    return offset + sizeof(n);
+}
+
+static size_t _metrics(uint16_t index, uint8_t *out, size_t space)
+{
+    const metrics_metric_t *m = metrics_next(NULL);
+    network_uint16_t next = byteorder_htons(0);
+    size_t offset = sizeof(next);
+
+    for (unsigned i = 0; m && (i < index); i++) {
+        m = metrics_next(m);
+    }
+    for (; m; m = metrics_next(m), index++) {
+        size_t name_len = MIN(strlen(m->name), UINT8_MAX);
+        bool hist = m->type == METRICS_TYPE_HISTOGRAM;
+
+        if ((offset + 2 + name_len + (hist ? 8 : 4)) > space) {
+            next = byteorder_htons(index);
+            break;
+        }
+        out[offset++] = m->type;
+        out[offset++] = name_len;
+        memcpy(out + offset, m->name, name_len);
+        offset += name_len;
+        if (hist) {
+            offset = _put_u32(out, offset, m->count);
+            offset = _put_u32(out, offset, (uint32_t)m->sum);
+        }
+        else {
+            offset = _put_u32(out, offset, m->ref ? *m->ref : m->value);
+        }
+    }
+    memcpy(out, &next, sizeof(next));
+    return offset;
+}
+
+static int _stats(uint8_t id, uint8_t *out, size_t *len)
+{
+    uint32_t values[24];
+    unsigned numof = 0;
+
+    switch (id) {
+#ifdef MODULE_SOCK_TCP
+    case CTRL_STATS_STREAM: {
+        const stream_stats_t *s = stream_stats();
+        const uint32_t v[] = {
+            s->connects, s->failures, s->failovers, s->last_latency_us,
+            s->max_latency_us, s->last_gap_us, s->max_gap_us, s->records,
+            s->acked, s->lost_records, (uint32_t)s->lost_bytes,
+            s->replayed_records, (uint32_t)s->replayed_bytes,
+        };
+
+        numof = ARRAY_SIZE(v);
+        memcpy(values, v, sizeof(v));
+        break;
+    }
+    case CTRL_STATS_HTTP: {
+        const http_stats_t *s = http_stats();
+        const uint32_t v[] = {
+            s->connections, s->requests, s->pipelined, s->errors,
+            (uint32_t)s->rom_bytes, (uint32_t)s->copied_bytes,
+        };
+
+        numof = ARRAY_SIZE(v);
+        memcpy(values, v, sizeof(v));
+        break;
+    }
+#endif
+    case CTRL_STATS_COAP: {
+        const coap_stats_t *s = coap_stats();
+        const uint32_t v[] = {
+            s->requests, s->errors, s->changes, s->notifications,
+            s->coalesced, s->blocks, s->transfers, (uint32_t)s->block_bytes,
+            (uint32_t)s->block_us,
+        };
+
+        numof = ARRAY_SIZE(v);
+        memcpy(values, v, sizeof(v));
+        break;
+    }
+    case CTRL_STATS_PTP: {
+        const ptp_slave_stats_t *s = ptp_slave_stats();
+        const uint32_t v[] = {
+            s->state, s->announces, s->syncs, s->delay_reqs, s->delay_resps,
+            s->timeouts, s->steps, s->rx_hw, s->rx_sw, s->tx_hw, s->tx_sw,
+            s->rx_dropped, (uint32_t)s->offset_ns, (uint32_t)s->path_delay_ns,
+            (uint32_t)s->freq_ppb, s->samples, s->offset_max_ns,
+            (uint32_t)s->offset_total_ns,
+        };
+
+        numof = ARRAY_SIZE(v);
+        memcpy(values, v, sizeof(v));
+        break;
+    }
+    case CTRL_STATS_FWUP: {
+        const fwup_result_t *s = fwup_result();
+        const uint32_t v[] = {
+            s->status, s->size, s->duration_us, s->wait_us, s->flash_us,
+        };
+
+        numof = ARRAY_SIZE(v);
+        memcpy(values, v, sizeof(v));
+        break;
+    }
+    case CTRL_STATS_RSH: {
+        const rsh_stats_t *s = rsh_stats();
+        const uint32_t v[] = {
+            s->sessions, s->commands, s->bytes, s->writes,
+        };
+
+        numof = ARRAY_SIZE(v);
+        memcpy(values, v, sizeof(v));
+        break;
+    }
+#ifdef MODULE_WOLFSSL
+    case CTRL_STATS_TLS:
+    case CTRL_STATS_DTLS: {
+        const tls_stats_t *s = tls_stats((id == CTRL_STATS_TLS)
+                                         ? TLS_PROTO_TLS : TLS_PROTO_DTLS);
+        const uint32_t v[] = {
+            s->full, s->resumed, s->failures, s->full_us, s->full_max_us,
+            s->resumed_us, s->resumed_max_us, (uint32_t)s->full_total_us,
+            (uint32_t)s->resumed_total_us, (uint32_t)s->bytes,
+            (uint32_t)s->bulk_us,
+        };
+
+        numof = ARRAY_SIZE(v);
+        memcpy(values, v, sizeof(v));
+        break;
+    }
+#endif
+    default:
+        return -ENOENT;
+    }
+    *len = 0;
+    for (unsigned i = 0; i < numof; i++) {
+        *len = _put_u32(out, *len, values[i]);
+    }
+    return 0;
+}
+
+/* handles the request payload in place, returns the reply payload length
+ * in @p len */
+static int _handle(uint8_t op, uint16_t seq, uint8_t *payload, size_t *len)
+{
+    size_t space = sizeof(_buf) - sizeof(ctrl_hdr_t);
+    int res = 0;
+
+    switch (op) {
+    case CTRL_OP_PING: {
+        ctrl_ping_t ping = {
+            .uptime_ms = byteorder_htonl(xtimer_now_usec64() / US_PER_MS),
+        };
+        uint16_t numof = 0;
+
+        while (_commands[numof].name) {
+            numof++;
+        }
+        ping.commands = byteorder_htons(numof);
+        memcpy(payload, &ping, sizeof(ping));
+        *len = sizeof(ping);
+        break;
+    }
+    case CTRL_OP_EXEC:
+        res = _exec(payload, *len, seq);
+        *len = 0;
+        break;
+    case CTRL_OP_STATUS:
+        *len = _status(payload);
+        break;
+    case CTRL_OP_METRICS: {
+        uint16_t index = (*len >= 2) ? ((payload[0] << 8) | payload[1]) : 0;
+
+        *len = _metrics(index, payload, space);
+        break;
+    }
+    case CTRL_OP_STATS:
+        res = (*len >= 1) ? _stats(payload[0], payload, len) : -EINVAL;
+        if (res < 0) {
+            *len = 0;
+        }
+        break;
+    default:
+        res = -EOPNOTSUPP;
+        *len = 0;
+    }
+    return res;
+}
+
+static void *_ctrl_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        ctrl_hdr_t *hdr = (ctrl_hdr_t *)_buf;
+        sock_udp_ep_t remote;
+        ssize_t res;
+        size_t len;
+
+        res = sock_udp_recv(&_sock, _buf, sizeof(_buf), SOCK_NO_TIMEOUT,
+                            &remote);
+        if ((res < (ssize_t)sizeof(*hdr)) ||
+            (byteorder_ntohs(hdr->magic) != CTRL_MAGIC) ||
+            (hdr->op & CTRL_OP_REPLY)) {
+            continue;
+        }
+        len = res - sizeof(*hdr);
+        if (hdr->version != CTRL_VERSION) {
+            res = -EPROTONOSUPPORT;
+            len = 0;
+        }
+        else {
+            res = _handle(hdr->op, byteorder_ntohs(hdr->seq),
+                          _buf + sizeof(*hdr), &len);
+        }
+        hdr->op |= CTRL_OP_REPLY;
+        hdr->status = byteorder_htons(-res);
+        sock_udp_send(&_sock, _buf, sizeof(*hdr) + len, &remote);
+    }
+    return NULL;
+}
+
+int ctrl_start(uint16_t port, const shell_command_t *commands)
+{
+    sock_udp_ep_t local = SOCK_IP_EP_ANY;
+    int res;
+
+    if (_running) {
+        return -EALREADY;
+    }
+    local.port = port;
+    if ((res = sock_udp_create(&_sock, &local, NULL, 0)) < 0) {
+        return res;
+    }
+    _commands = commands;
+    _running = true;
+    _job_pid = thread_create(_job_stack, sizeof(_job_stack),
+                             PRIO_CTRL_JOB, THREAD_CREATE_STACKTEST,
+                             _job_thread, NULL, "ctrl_job");
+    /* requests are answered while a job runs */
+    if ((_job_pid <= KERNEL_PID_UNDEF) ||
+        (thread_create(_ctrl_stack, sizeof(_ctrl_stack),
+                       PRIO_CTRL, THREAD_CREATE_STACKTEST,
+                       _ctrl_thread, NULL, "ctrl") <= KERNEL_PID_UNDEF)) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+#else
+int ctrl_start(uint16_t port, const shell_command_t *commands)
+{
+    (void)port;
+    (void)commands;
+    return -ENOTSUP;
+}
+#endif
+
+/** @} */
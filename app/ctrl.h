@@ -0,0 +1,146 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Binary UDP control channel for benchmark orchestration
+ *
+ * Every request is one datagram starting with a @ref ctrl_hdr_t, and is
+ * answered by one datagram with the same header, the request op or'ed
+ * with @ref CTRL_OP_REPLY, and the status set. All fields are in network
+ * byte order.
+ *
+ * - @ref CTRL_OP_PING: reply is a @ref ctrl_ping_t
+ * - @ref CTRL_OP_EXEC: payload is a shell command line, which is started
+ *   in the background as the job; one job runs at a time (EBUSY). A
+ *   repeated request with the same sequence number is answered without
+ *   starting the job again, so requests can be retried safely.
+ * - @ref CTRL_OP_STATUS: reply is the @ref ctrl_status_t of the job
+ * - @ref CTRL_OP_METRICS: payload is the network_uint16_t index of the first
+ *   metric. Reply is the index to continue with (0 at the end), followed by
+ *   records of a type byte, a name length byte, the name and one
+ *   network_uint32_t value, or count and sum for histograms.
+ * - @ref CTRL_OP_STATS: payload is one of the CTRL_STATS_* ids, reply is the
+ *   fields of that statistics struct as network_uint32_t in declaration
+ *   order, 64 bit counters truncated.
+ *
+ * Starting and stopping servers and benchmarks and setting parameters is
+ * done with the shell commands; tools/ctrl.py is the host side.
+ *
+ * The channel has no authentication and runs any shell command for anybody
+ * who can reach the port, so it is only started at boot in builds with
+ * `make CTRL=1` (@ref CTRL_AUTOSTART), meant for isolated test networks.
+ * @}
+ */
+#ifndef CTRL_H
+#define CTRL_H
+
+#include <stdint.h>
+
+#include "byteorder.h"
+#include "shell.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef CTRL_PORT
+#define CTRL_PORT               (12380U)    /**< listen port */
+#endif
+#ifndef CTRL_BUF_SIZE
+#define CTRL_BUF_SIZE           (512U)      /**< largest datagram */
+#endif
+#ifndef CTRL_AUTOSTART
+#define CTRL_AUTOSTART          (0)         /**< start from main() */
+#endif
+/** @} */
+
+/**
+ * @brief   Protocol constants
+ * @{
+ */
+#define CTRL_MAGIC              (0x5243U)   /**< "RC" */
+#define CTRL_VERSION            (1U)        /**< protocol version */
+#define CTRL_OP_PING            (0x01U)     /**< liveness and version */
+#define CTRL_OP_EXEC            (0x02U)     /**< start a shell command */
+#define CTRL_OP_STATUS          (0x03U)     /**< state of the job */
+#define CTRL_OP_METRICS         (0x04U)     /**< registered metrics */
+#define CTRL_OP_STATS           (0x05U)     /**< statistics struct */
+#define CTRL_OP_REPLY           (0x80U)     /**< set in replies */
+#define CTRL_STATS_STREAM       (1U)        /**< @ref stream_stats_t */
+#define CTRL_STATS_HTTP         (2U)        /**< @ref http_stats_t */
+#define CTRL_STATS_FWUP         (3U)        /**< @ref fwup_result_t */
+#define CTRL_STATS_RSH          (4U)        /**< @ref rsh_stats_t */
+#define CTRL_STATS_TLS          (5U)        /**< TLS @ref tls_stats_t */
+#define CTRL_STATS_DTLS         (6U)        /**< DTLS @ref tls_stats_t */
+#define CTRL_STATS_COAP         (7U)        /**< @ref coap_stats_t */
+#define CTRL_STATS_PTP          (8U)        /**< @ref ptp_slave_stats_t */
+/** @} */
+
+/**
+ * @brief   Job states
+ */
+enum {
+    CTRL_JOB_IDLE,              /**< no job was started */
+    CTRL_JOB_RUNNING,           /**< the job is running */
+    CTRL_JOB_DONE,              /**< the job returned */
+};
+
+/**
+ * @brief   Request and reply header
+ */
+typedef struct __attribute__((packed)) {
+    network_uint16_t magic;     /**< @ref CTRL_MAGIC */
+    uint8_t version;            /**< @ref CTRL_VERSION */
+    uint8_t op;                 /**< CTRL_OP_* */
+    network_uint16_t seq;       /**< chosen by the client, echoed */
+    network_uint16_t status;    /**< replies: 0 or a positive errno value */
+} ctrl_hdr_t;
+
+/**
+ * @brief   Reply payload of @ref CTRL_OP_PING
+ */
+typedef struct __attribute__((packed)) {
+    network_uint32_t uptime_ms; /**< time since boot */
+    network_uint16_t commands;  /**< number of shell commands */
+} ctrl_ping_t;
+
+/**
+ * @brief   Reply payload of @ref CTRL_OP_STATUS
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t state;              /**< CTRL_JOB_* */
+    uint8_t reserved;           /**< zero */
+    network_uint16_t seq;       /**< sequence number of the exec request */
+    network_uint32_t ret;       /**< return value of the command */
+    network_uint32_t elapsed_ms; /**< run time so far or in total */
+} ctrl_status_t;
+
+/**
+ * @brief   Start the control and job threads
+ *
+ * @param[in] port      port to listen on
+ * @param[in] commands  command table, terminated by an all NULL entry
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the control channel is already running
+ * @return  -ENOMEM if a thread could not be created
+ */
+int ctrl_start(uint16_t port, const shell_command_t *commands);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CTRL_H */
+/** @} */
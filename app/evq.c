@@ -0,0 +1,456 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Instrumented event queues for async sock events
+ * @}
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "clist.h"
+#include "evq.h"
+#include "irq.h"
+#include "thread_flags.h"
+#include "xtimer.h"
+
+#if EVQ_INSTRUMENT
+
+enum {
+    METRIC_LATENCY,
+    METRIC_POSTS,
+    METRIC_COALESCED,
+    METRIC_DEPTH,
+};
+
+static const uint32_t _bounds[] = EVQ_BOUNDS_US;
+static evq_t *_queues[EVQ_NUMOF];
+static unsigned _numof;
+
+/* the application links with --wrap=event_post --wrap=event_cancel */
+extern void __real_event_post(event_queue_t *queue, event_t *event);
+extern void __real_event_cancel(event_queue_t *queue, event_t *event);
+
+static evq_t *_find(event_queue_t *queue)
+{
+    for (unsigned i = 0; i < _numof; i++) {
+        if (&_queues[i]->queue == queue) {
+            return _queues[i];
+        }
+    }
+    return NULL;
+}
+
+void __wrap_event_post(event_queue_t *queue, event_t *event)
+{
+    evq_t *evq = _find(queue);
+    unsigned state;
+
+    if (evq == NULL) {
+        __real_event_post(queue, event);
+        return;
+    }
+    state = irq_disable();
+    evq->posts++;
+    /* a queued event stays queued once, the sock collects the flags */
+    if (event->list_node.next) {
+        evq->coalesced++;
+    }
+    else {
+        unsigned i, free = EVQ_PENDING_MAX;
+
+        /* a slot still holding the event is stale, its post was dropped
+         * without going through event_cancel() */
+        for (i = 0; i < EVQ_PENDING_MAX; i++) {
+            if (evq->pending[i].event == event) {
+                break;
+            }
+            if (!evq->pending[i].event && (free == EVQ_PENDING_MAX)) {
+                free = i;
+            }
+        }
+        if (i == EVQ_PENDING_MAX) {
+            i = free;
+        }
+        if (i < EVQ_PENDING_MAX) {
+            evq->pending[i].event = event;
+            evq->pending[i].posted = xtimer_now_usec();
+        }
+        else {
+            evq->untracked++;
+        }
+    }
+    irq_restore(state);
+    __real_event_post(queue, event);
+    state = irq_disable();
+    evq->depth_max = MAX(evq->depth_max,
+                         (uint32_t)clist_count(&queue->event_list));
+    irq_restore(state);
+}
+
+/* closing a sock cancels its event, which frees its time stamp */
+void __wrap_event_cancel(event_queue_t *queue, event_t *event)
+{
+    evq_t *evq = _find(queue);
+
+    if (evq != NULL) {
+        unsigned state = irq_disable();
+
+        for (unsigned i = 0; i < EVQ_PENDING_MAX; i++) {
+            if (evq->pending[i].event == event) {
+                evq->pending[i].event = NULL;
+            }
+        }
+        irq_restore(state);
+    }
+    __real_event_cancel(queue, event);
+}
+
+int evq_init(evq_t *evq, const char *name)
+{
+    static const char *const suffixes[] = {
+        "latency_us", "posts_total", "coalesced_total", "depth_max",
+    };
+    static const char *const help[] = {
+        "Time events waited in the queue",
+        "Posts to the queue",
+        "Posts of an event already queued",
+        "Most events queued at once",
+    };
+    unsigned state;
+
+    memset(evq, 0, sizeof(*evq));
+    evq->name = name;
+    for (unsigned i = 0; i < ARRAY_SIZE(evq->metrics); i++) {
+        snprintf(evq->names[i], sizeof(evq->names[i]), "evq_%s_%s", name,
+                 suffixes[i]);
+        evq->metrics[i].name = evq->names[i];
+        evq->metrics[i].help = help[i];
+    }
+    evq->metrics[METRIC_LATENCY].type = METRICS_TYPE_HISTOGRAM;
+    evq->metrics[METRIC_LATENCY].bounds = _bounds;
+    evq->metrics[METRIC_LATENCY].buckets = evq->buckets;
+    evq->metrics[METRIC_LATENCY].numof = ARRAY_SIZE(_bounds);
+    evq->metrics[METRIC_POSTS].type = METRICS_TYPE_COUNTER;
+    evq->metrics[METRIC_POSTS].ref = &evq->posts;
+    evq->metrics[METRIC_COALESCED].type = METRICS_TYPE_COUNTER;
+    evq->metrics[METRIC_COALESCED].ref = &evq->coalesced;
+    evq->metrics[METRIC_DEPTH].type = METRICS_TYPE_GAUGE;
+    evq->metrics[METRIC_DEPTH].ref = &evq->depth_max;
+    event_queue_init(&evq->queue);
+
+    state = irq_disable();
+    if (_numof >= EVQ_NUMOF) {
+        irq_restore(state);
+        return -ENOMEM;
+    }
+    _queues[_numof++] = evq;
+    irq_restore(state);
+    for (unsigned i = 0; i < ARRAY_SIZE(evq->metrics); i++) {
+        metrics_register(&evq->metrics[i]);
+    }
+    return 0;
+}
+
+/* event_get() and taking the event's time stamp are one step, so a post
+ * right after the event left the queue gets a new time stamp */
+static event_t *_wait(evq_t *evq, uint32_t *latency)
+{
+    while (1) {
+        unsigned state = irq_disable();
+        event_t *event = event_get(&evq->queue);
+
+        if (event) {
+            *latency = UINT32_MAX;
+            for (unsigned i = 0; i < EVQ_PENDING_MAX; i++) {
+                if (evq->pending[i].event == event) {
+                    *latency = xtimer_now_usec() - evq->pending[i].posted;
+                    evq->pending[i].event = NULL;
+                    break;
+                }
+            }
+            irq_restore(state);
+            return event;
+        }
+        irq_restore(state);
+        thread_flags_wait_any(THREAD_FLAG_EVENT);
+    }
+}
+
+void evq_loop(evq_t *evq)
+{
+    while (1) {
+        uint32_t latency;
+        event_t *event = _wait(evq, &latency);
+
+        /* untracked events have no time stamp */
+        if (latency != UINT32_MAX) {
+            metrics_observe(&evq->metrics[METRIC_LATENCY], latency);
+            evq->latency_max_us = MAX(evq->latency_max_us, latency);
+        }
+        evq->dispatched++;
+        event->handler(event);
+    }
+}
+
+/* socks attached under one name share its handler, so they must share the
+ * callback and its argument, too */
+static int _handler(evq_t *evq, void *arg, const char *name,
+                    evq_handler_t **out)
+{
+    evq_handler_t *h;
+
+    for (unsigned i = 0; i < evq->handlers_numof; i++) {
+        if (strcmp(evq->handlers[i].name, name) == 0) {
+            *out = &evq->handlers[i];
+            return (evq->handlers[i].arg == arg) ? 0 : -EINVAL;
+        }
+    }
+    if (evq->handlers_numof >= EVQ_HANDLERS_MAX) {
+        return -ENOMEM;
+    }
+    h = &evq->handlers[evq->handlers_numof++];
+    h->evq = evq;
+    h->name = name;
+    h->arg = arg;
+    snprintf(h->metric, sizeof(h->metric), "evq_%s_%s_us", evq->name, name);
+    h->run_us.name = h->metric;
+    h->run_us.help = "Time spent in the handler";
+    h->run_us.type = METRICS_TYPE_HISTOGRAM;
+    h->run_us.bounds = _bounds;
+    h->run_us.buckets = h->buckets;
+    h->run_us.numof = ARRAY_SIZE(_bounds);
+    metrics_register(&h->run_us);
+    *out = h;
+    return 0;
+}
+
+static void _ran(evq_handler_t *h, uint32_t start)
+{
+    uint32_t duration = xtimer_now_usec() - start;
+
+    h->calls++;
+    h->max_us = MAX(h->max_us, duration);
+    metrics_observe(&h->run_us, duration);
+}
+
+#ifdef MODULE_SOCK_UDP
+static void _udp_cb(sock_udp_t *sock, sock_async_flags_t flags, void *arg)
+{
+    evq_handler_t *h = arg;
+    uint32_t start = xtimer_now_usec();
+
+    h->cb.udp(sock, flags, h->arg);
+    _ran(h, start);
+}
+
+int evq_udp_event_init(evq_t *evq, sock_udp_t *sock, sock_udp_cb_t cb,
+                       void *arg, const char *name)
+{
+    evq_handler_t *h;
+    int res = _handler(evq, arg, name, &h);
+
+    if ((res == 0) && h->cb.udp && (h->cb.udp != cb)) {
+        res = -EINVAL;
+    }
+    if (res < 0) {
+        sock_udp_event_init(sock, &evq->queue, cb, arg);
+        return res;
+    }
+    h->cb.udp = cb;
+    sock_udp_event_init(sock, &evq->queue, _udp_cb, h);
+    return 0;
+}
+#endif
+
+#ifdef MODULE_SOCK_TCP
+static void _tcp_cb(sock_tcp_t *sock, sock_async_flags_t flags, void *arg)
+{
+    evq_handler_t *h = arg;
+    uint32_t start = xtimer_now_usec();
+
+    h->cb.tcp(sock, flags, h->arg);
+    _ran(h, start);
+}
+
+static void _tcp_queue_cb(sock_tcp_queue_t *queue, sock_async_flags_t flags,
+                          void *arg)
+{
+    evq_handler_t *h = arg;
+    uint32_t start = xtimer_now_usec();
+
+    h->cb.tcp_queue(queue, flags, h->arg);
+    _ran(h, start);
+}
+
+int evq_tcp_event_init(evq_t *evq, sock_tcp_t *sock, sock_tcp_cb_t cb,
+                       void *arg, const char *name)
+{
+    evq_handler_t *h;
+    int res = _handler(evq, arg, name, &h);
+
+    if ((res == 0) && h->cb.tcp && (h->cb.tcp != cb)) {
+        res = -EINVAL;
+    }
+    if (res < 0) {
+        sock_tcp_event_init(sock, &evq->queue, cb, arg);
+        return res;
+    }
+    h->cb.tcp = cb;
+    sock_tcp_event_init(sock, &evq->queue, _tcp_cb, h);
+    return 0;
+}
+
+int evq_tcp_queue_event_init(evq_t *evq, sock_tcp_queue_t *queue,
+                             sock_tcp_queue_cb_t cb, void *arg,
+                             const char *name)
+{
+    evq_handler_t *h;
+    int res = _handler(evq, arg, name, &h);
+
+    if ((res == 0) && h->cb.tcp_queue && (h->cb.tcp_queue != cb)) {
+        res = -EINVAL;
+    }
+    if (res < 0) {
+        sock_tcp_queue_event_init(queue, &evq->queue, cb, arg);
+        return res;
+    }
+    h->cb.tcp_queue = cb;
+    sock_tcp_queue_event_init(queue, &evq->queue, _tcp_queue_cb, h);
+    return 0;
+}
+#endif
+
+#ifdef MODULE_SOCK_IP
+static void _ip_cb(sock_ip_t *sock, sock_async_flags_t flags, void *arg)
+{
+    evq_handler_t *h = arg;
+    uint32_t start = xtimer_now_usec();
+
+    h->cb.ip(sock, flags, h->arg);
+    _ran(h, start);
+}
+
+int evq_ip_event_init(evq_t *evq, sock_ip_t *sock, sock_ip_cb_t cb,
+                      void *arg, const char *name)
+{
+    evq_handler_t *h;
+    int res = _handler(evq, arg, name, &h);
+
+    if ((res == 0) && h->cb.ip && (h->cb.ip != cb)) {
+        res = -EINVAL;
+    }
+    if (res < 0) {
+        sock_ip_event_init(sock, &evq->queue, cb, arg);
+        return res;
+    }
+    h->cb.ip = cb;
+    sock_ip_event_init(sock, &evq->queue, _ip_cb, h);
+    return 0;
+}
+#endif
+
+/* prints the non-empty buckets as "<=bound:count" */
+static void _print_histogram(const metrics_metric_t *m)
+{
+    if (m->count == 0) {
+        return;
+    }
+    printf(" ");
+    for (unsigned i = 0; i <= m->numof; i++) {
+        if (m->buckets[i] == 0) {
+            continue;
+        }
+        if (i < m->numof) {
+            printf(" <=%" PRIu32 ":%" PRIu32, m->bounds[i], m->buckets[i]);
+        }
+        else {
+            printf(" >%" PRIu32 ":%" PRIu32, m->bounds[i - 1], m->buckets[i]);
+        }
+    }
+    puts("");
+}
+
+static void evq_print(const evq_t *evq)
+{
+    const metrics_metric_t *latency = &evq->metrics[METRIC_LATENCY];
+
+    printf("%s: %" PRIu32 " posts, %" PRIu32 " coalesced, %" PRIu32
+           " dispatched, depth max %" PRIu32 "\n", evq->name, evq->posts,
+           evq->coalesced, evq->dispatched, evq->depth_max);
+    printf("  latency avg %" PRIu32 " us, max %" PRIu32 " us, %" PRIu32
+           " untracked\n",
+           latency->count ? (uint32_t)(latency->sum / latency->count) : 0,
+           evq->latency_max_us, evq->untracked);
+    _print_histogram(latency);
+    for (unsigned i = 0; i < evq->handlers_numof; i++) {
+        const evq_handler_t *h = &evq->handlers[i];
+
+        printf("  %s: %" PRIu32 " calls, avg %" PRIu32 " us, max %" PRIu32
+               " us\n", h->name, h->calls,
+               h->calls ? (uint32_t)(h->run_us.sum / h->calls) : 0,
+               h->max_us);
+        _print_histogram(&h->run_us);
+    }
+}
+
+static void _reset(metrics_metric_t *m)
+{
+    memset(m->buckets, 0, (m->numof + 1) * sizeof(m->buckets[0]));
+    m->count = 0;
+    m->sum = 0;
+}
+
+static void evq_reset(evq_t *evq)
+{
+    unsigned state = irq_disable();
+
+    evq->posts = evq->coalesced = evq->dispatched = evq->untracked = 0;
+    evq->depth_max = evq->latency_max_us = 0;
+    irq_restore(state);
+    _reset(&evq->metrics[METRIC_LATENCY]);
+    for (unsigned i = 0; i < evq->handlers_numof; i++) {
+        evq->handlers[i].calls = evq->handlers[i].max_us = 0;
+        _reset(&evq->handlers[i].run_us);
+    }
+}
+
+int evq_cmd(int argc, char **argv)
+{
+    if ((argc > 1) && (strcmp(argv[1], "reset") != 0)) {
+        printf("usage: %s [reset]\n", argv[0]);
+        return 1;
+    }
+    if (_numof == 0) {
+        puts("no instrumented event queue");
+    }
+    for (unsigned i = 0; i < _numof; i++) {
+        if (argc > 1) {
+            evq_reset(_queues[i]);
+        }
+        else {
+            evq_print(_queues[i]);
+        }
+    }
+    return 0;
+}
+#else
+int evq_cmd(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    puts("event queue statistics need a build with EVQ=1");
+    return 1;
+}
+#endif
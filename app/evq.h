@@ -0,0 +1,296 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Instrumented event queues for async sock events
+ *
+ * An @ref evq_t is an event_queue_t with statistics. The servers that
+ * handle their sock events in an event loop opt in by initializing their
+ * queue with @ref evq_init, attaching their socks through the
+ * evq_*_event_init() functions and running @ref evq_loop instead of
+ * event_loop().
+ *
+ * The application links with --wrap=event_post, so every post to an
+ * instrumented queue is counted and time stamped, and with
+ * --wrap=event_cancel, so closing a sock drops the time stamp of its
+ * queued event. lwIP's sock layer
+ * posts the same event of a sock again while it is still queued, e.g.
+ * for every segment of a burst. event_post() leaves such an event queued
+ * once and the sock collects the flags, so these posts are coalesced.
+ * They are counted, and the event keeps the time of its first post. Per
+ * queue there are:
+ * - posts, coalesced posts and dispatched events
+ * - the post-to-dispatch latency: max, mean and a histogram
+ * - the largest number of events queued at once
+ *
+ * The sock callbacks are called through a wrapper that times them, so
+ * every handler gets a run time histogram. All histograms are metrics
+ * (metrics.h) named evq_<queue>_latency_us and evq_<queue>_<handler>_us.
+ * `evq` prints everything.
+ *
+ * The instrumentation is built with `make EVQ=1` only (@ref
+ * EVQ_INSTRUMENT). Otherwise an @ref evq_t is a plain event queue and the
+ * functions below map to event_queue_init(), event_loop() and the
+ * sock_*_event_init() functions.
+ * @}
+ */
+#ifndef EVQ_H
+#define EVQ_H
+
+#include <stdint.h>
+
+#include "event.h"
+#include "metrics.h"
+#include "net/sock/async/event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef EVQ_INSTRUMENT
+#define EVQ_INSTRUMENT          (0)         /**< collect statistics */
+#endif
+#ifndef EVQ_NUMOF
+#define EVQ_NUMOF               (4U)        /**< instrumented queues */
+#endif
+#ifndef EVQ_PENDING_MAX
+#define EVQ_PENDING_MAX         (8U)        /**< queued events time stamped */
+#endif
+#ifndef EVQ_HANDLERS_MAX
+#define EVQ_HANDLERS_MAX        (4U)        /**< timed handlers per queue */
+#endif
+#ifndef EVQ_NAME_MAX
+#define EVQ_NAME_MAX            (40U)       /**< metric name length */
+#endif
+/** @} */
+
+/**
+ * @brief   Histogram bounds in us, shared by all histograms
+ */
+#define EVQ_BOUNDS_US   { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, \
+                          10000, 20000, 50000 }
+
+/**
+ * @brief   Number of histogram bounds
+ */
+#define EVQ_BOUNDS_NUMOF        (12U)
+
+typedef struct evq evq_t;
+
+#if EVQ_INSTRUMENT || defined(DOXYGEN)
+/**
+ * @brief   Timed sock callback, allocated by the evq_*_event_init()
+ *          functions
+ */
+typedef struct {
+    evq_t *evq;                 /**< queue it runs from */
+    const char *name;           /**< handler name */
+    union {
+#ifdef MODULE_SOCK_UDP
+        sock_udp_cb_t udp;      /**< UDP sock callback */
+#endif
+#ifdef MODULE_SOCK_TCP
+        sock_tcp_cb_t tcp;      /**< TCP sock callback */
+        sock_tcp_queue_cb_t tcp_queue;  /**< TCP listen queue callback */
+#endif
+#ifdef MODULE_SOCK_IP
+        sock_ip_cb_t ip;        /**< raw IP sock callback */
+#endif
+    } cb;
+    void *arg;                  /**< callback argument */
+    uint32_t calls;             /**< times called */
+    uint32_t max_us;            /**< longest run */
+    metrics_metric_t run_us;    /**< run time histogram */
+    uint32_t buckets[EVQ_BOUNDS_NUMOF + 1]; /**< its counts */
+    char metric[EVQ_NAME_MAX];  /**< its name */
+} evq_handler_t;
+
+/**
+ * @brief   Instrumented event queue
+ */
+struct evq {
+    event_queue_t queue;        /**< the queue, post to it as usual */
+    const char *name;           /**< queue name */
+    uint32_t posts;             /**< event_post() calls */
+    uint32_t coalesced;         /**< posts of an event already queued */
+    uint32_t dispatched;        /**< events handled */
+    uint32_t untracked;         /**< posts beyond @ref EVQ_PENDING_MAX */
+    uint32_t depth_max;         /**< most events queued at once */
+    uint32_t latency_max_us;    /**< longest post-to-dispatch latency */
+    struct {
+        event_t *event;         /**< queued event, NULL if free */
+        uint32_t posted;        /**< time of its first post */
+    } pending[EVQ_PENDING_MAX]; /**< queued events */
+    metrics_metric_t metrics[4];            /**< queue metrics */
+    char names[4][EVQ_NAME_MAX];            /**< their names */
+    uint32_t buckets[EVQ_BOUNDS_NUMOF + 1]; /**< latency histogram */
+    evq_handler_t handlers[EVQ_HANDLERS_MAX];   /**< timed handlers */
+    unsigned handlers_numof;    /**< handlers in use */
+};
+
+/**
+ * @brief   Initialize and register an instrumented queue
+ *
+ * Claims the queue for the calling thread, like event_queue_init().
+ *
+ * @param[out] evq      queue
+ * @param[in] name      queue name for `evq` and the metric names
+ *
+ * @return  0 on success
+ * @return  -ENOMEM if @ref EVQ_NUMOF queues are registered, the queue
+ *          works without statistics then
+ */
+int evq_init(evq_t *evq, const char *name);
+
+/**
+ * @brief   Handle the events of @p evq forever, like event_loop()
+ */
+void evq_loop(evq_t *evq);
+
+#ifdef MODULE_SOCK_UDP
+/**
+ * @brief   Like sock_udp_event_init(), with @p cb timed as @p name
+ *
+ * @return  0 on success
+ * @return  -ENOMEM if @ref EVQ_HANDLERS_MAX handlers are in use, @p cb
+ *          is attached without timing then
+ * @return  -EINVAL if @p name is in use with another @p cb or @p arg,
+ *          @p cb is attached without timing then
+ */
+int evq_udp_event_init(evq_t *evq, sock_udp_t *sock, sock_udp_cb_t cb,
+                       void *arg, const char *name);
+#endif
+
+#ifdef MODULE_SOCK_TCP
+/**
+ * @brief   Like sock_tcp_event_init(), with @p cb timed as @p name
+ *
+ * Socks attached under the same name share the handler, they must have
+ * the same @p cb and @p arg.
+ *
+ * @return  0 on success
+ * @return  -ENOMEM if @ref EVQ_HANDLERS_MAX handlers are in use, @p cb
+ *          is attached without timing then
+ * @return  -EINVAL if @p name is in use with another @p cb or @p arg,
+ *          @p cb is attached without timing then
+ */
+int evq_tcp_event_init(evq_t *evq, sock_tcp_t *sock, sock_tcp_cb_t cb,
+                       void *arg, const char *name);
+
+/**
+ * @brief   Like sock_tcp_queue_event_init(), with @p cb timed as @p name
+ *
+ * @return  0 on success
+ * @return  -ENOMEM if @ref EVQ_HANDLERS_MAX handlers are in use, @p cb
+ *          is attached without timing then
+ * @return  -EINVAL if @p name is in use with another @p cb or @p arg,
+ *          @p cb is attached without timing then
+ */
+int evq_tcp_queue_event_init(evq_t *evq, sock_tcp_queue_t *queue,
+                             sock_tcp_queue_cb_t cb, void *arg,
+                             const char *name);
+#endif
+
+#ifdef MODULE_SOCK_IP
+/**
+ * @brief   Like sock_ip_event_init(), with @p cb timed as @p name
+ *
+ * @return  0 on success
+ * @return  -ENOMEM if @ref EVQ_HANDLERS_MAX handlers are in use, @p cb
+ *          is attached without timing then
+ * @return  -EINVAL if @p name is in use with another @p cb or @p arg,
+ *          @p cb is attached without timing then
+ */
+int evq_ip_event_init(evq_t *evq, sock_ip_t *sock, sock_ip_cb_t cb,
+                      void *arg, const char *name);
+#endif
+
+#else /* EVQ_INSTRUMENT */
+struct evq {
+    event_queue_t queue;
+};
+
+static inline int evq_init(evq_t *evq, const char *name)
+{
+    (void)name;
+    event_queue_init(&evq->queue);
+    return 0;
+}
+
+static inline void evq_loop(evq_t *evq)
+{
+    event_loop(&evq->queue);
+}
+
+#ifdef MODULE_SOCK_UDP
+static inline int evq_udp_event_init(evq_t *evq, sock_udp_t *sock,
+                                     sock_udp_cb_t cb, void *arg,
+                                     const char *name)
+{
+    (void)name;
+    sock_udp_event_init(sock, &evq->queue, cb, arg);
+    return 0;
+}
+#endif
+
+#ifdef MODULE_SOCK_TCP
+static inline int evq_tcp_event_init(evq_t *evq, sock_tcp_t *sock,
+                                     sock_tcp_cb_t cb, void *arg,
+                                     const char *name)
+{
+    (void)name;
+    sock_tcp_event_init(sock, &evq->queue, cb, arg);
+    return 0;
+}
+
+static inline int evq_tcp_queue_event_init(evq_t *evq,
+                                           sock_tcp_queue_t *queue,
+                                           sock_tcp_queue_cb_t cb, void *arg,
+                                           const char *name)
+{
+    (void)name;
+    sock_tcp_queue_event_init(queue, &evq->queue, cb, arg);
+    return 0;
+}
+#endif
+
+#ifdef MODULE_SOCK_IP
+static inline int evq_ip_event_init(evq_t *evq, sock_ip_t *sock,
+                                    sock_ip_cb_t cb, void *arg,
+                                    const char *name)
+{
+    (void)name;
+    sock_ip_event_init(sock, &evq->queue, cb, arg);
+    return 0;
+}
+#endif
+#endif /* EVQ_INSTRUMENT */
+
+/**
+ * @brief   Event queue statistics shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int evq_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVQ_H */
+/** @} */
@@ -0,0 +1,424 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Forward error correction for UDP datagrams
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fec.h"
+#include "xtimer.h"
+
+#define GF_POLY         (0x11d)     /* x^8 + x^4 + x^3 + x^2 + 1 */
+
+static uint8_t _gf_exp[512];
+static uint8_t _gf_log[256];
+static bool _gf_ready;
+static uint8_t _pkt[sizeof(fec_hdr_t) + FEC_SYMBOL_MAX];
+
+static void _gf_init(void)
+{
+    unsigned x = 1;
+
+    if (_gf_ready) {
+        return;
+    }
+    for (unsigned i = 0; i < 255; i++) {
+        _gf_exp[i] = x;
+        _gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= GF_POLY;
+        }
+    }
+    /* doubled so the sum of two logs never needs a modulo */
+    for (unsigned i = 255; i < sizeof(_gf_exp); i++) {
+        _gf_exp[i] = _gf_exp[i - 255];
+    }
+    _gf_ready = true;
+}
+
+static inline uint8_t _gf_mul(uint8_t a, uint8_t b)
+{
+    if ((a == 0) || (b == 0)) {
+        return 0;
+    }
+    return _gf_exp[_gf_log[a] + _gf_log[b]];
+}
+
+static inline uint8_t _gf_inv(uint8_t a)
+{
+    return _gf_exp[255 - _gf_log[a]];
+}
+
+/* dst += c * src */
+static void _gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+    if (c == 0) {
+        return;
+    }
+    if (c == 1) {
+        for (size_t i = 0; i < len; i++) {
+            dst[i] ^= src[i];
+        }
+        return;
+    }
+    const uint8_t *exp = &_gf_exp[_gf_log[c]];
+    for (size_t i = 0; i < len; i++) {
+        if (src[i]) {
+            dst[i] ^= exp[_gf_log[src[i]]];
+        }
+    }
+}
+
+/* generator coefficient of repair row j for data packet i: parity for a
+ * single repair packet, a Cauchy matrix otherwise, so every square
+ * submatrix is invertible */
+static inline uint8_t _coef(unsigned m, unsigned j, unsigned i)
+{
+    if (m == 1) {
+        return 1;
+    }
+    return _gf_inv(j ^ (FEC_M_MAX + i));
+}
+
+int fec_enc_init(fec_enc_t *enc, unsigned k, unsigned m)
+{
+    if ((k == 0) || (k > FEC_K_MAX) || (m == 0) || (m > FEC_M_MAX)) {
+        return -EINVAL;
+    }
+    _gf_init();
+    memset(enc, 0, sizeof(*enc));
+    enc->k = k;
+    enc->m = m;
+    return 0;
+}
+
+static void _hdr_init(fec_hdr_t *hdr, unsigned k, unsigned m, unsigned idx,
+                      unsigned n, uint16_t block)
+{
+    hdr->k = k;
+    hdr->m = m;
+    hdr->idx = idx;
+    hdr->n = n;
+    hdr->block = byteorder_htons(block);
+}
+
+int fec_enc_flush(fec_enc_t *enc, fec_send_cb_t send_cb, void *arg,
+                  fec_stats_t *stats)
+{
+    fec_hdr_t *hdr = (fec_hdr_t *)_pkt;
+    int res = 0;
+
+    if (enc->idx == 0) {
+        return 0;
+    }
+    for (unsigned j = 0; j < enc->m; j++) {
+        _hdr_init(hdr, enc->k, enc->m, enc->k + j, enc->idx, enc->block);
+        memcpy(_pkt + sizeof(*hdr), enc->repair[j], enc->sym_len);
+        if ((res = send_cb(arg, _pkt, sizeof(*hdr) + enc->sym_len)) < 0) {
+            break;
+        }
+        stats->repair_tx++;
+    }
+    memset(enc->repair, 0, sizeof(enc->repair));
+    enc->idx = 0;
+    enc->sym_len = 0;
+    enc->block++;
+    return (res < 0) ? res : 0;
+}
+
+int fec_enc_send(fec_enc_t *enc, const void *data, size_t len,
+                 fec_send_cb_t send_cb, void *arg, fec_stats_t *stats)
+{
+    fec_hdr_t *hdr = (fec_hdr_t *)_pkt;
+    uint8_t sym_hdr[2] = { len >> 8, len & 0xff };
+    uint32_t start;
+    int res;
+
+    if (len > FEC_PAYLOAD_MAX) {
+        return -EMSGSIZE;
+    }
+    _hdr_init(hdr, enc->k, enc->m, enc->idx, 0, enc->block);
+    memcpy(_pkt + sizeof(*hdr), data, len);
+    if ((res = send_cb(arg, _pkt, sizeof(*hdr) + len)) < 0) {
+        return res;
+    }
+    stats->data_tx++;
+    /* fold the symbol into every repair row right away, so the block never
+     * has to be buffered */
+    start = xtimer_now_usec();
+    for (unsigned j = 0; j < enc->m; j++) {
+        uint8_t c = _coef(enc->m, j, enc->idx);
+
+        _gf_mul_add(enc->repair[j], sym_hdr, c, sizeof(sym_hdr));
+        _gf_mul_add(enc->repair[j] + sizeof(sym_hdr), data, c, len);
+    }
+    stats->enc_us += xtimer_now_usec() - start;
+    if ((len + sizeof(sym_hdr)) > enc->sym_len) {
+        enc->sym_len = len + sizeof(sym_hdr);
+    }
+    if (++enc->idx == enc->k) {
+        return fec_enc_flush(enc, send_cb, arg, stats);
+    }
+    return 0;
+}
+
+void fec_dec_init(fec_dec_t *dec)
+{
+    _gf_init();
+    memset(dec, 0, sizeof(*dec));
+}
+
+static unsigned _popcount(uint16_t v)
+{
+    unsigned n = 0;
+
+    for (; v; v &= v - 1) {
+        n++;
+    }
+    return n;
+}
+
+static void _slot_release(fec_slot_t *slot, fec_stats_t *stats)
+{
+    if ((slot->k != 0) && !slot->done) {
+        uint16_t data_mask = (1U << slot->n) - 1;
+
+        stats->residual += slot->n - _popcount(slot->have & data_mask);
+    }
+    slot->k = 0;
+}
+
+static fec_slot_t *_slot_get(fec_dec_t *dec, const fec_hdr_t *hdr,
+                             fec_stats_t *stats)
+{
+    uint16_t block = byteorder_ntohs(hdr->block);
+    fec_slot_t *oldest = &dec->slots[0];
+
+    for (unsigned i = 0; i < FEC_SLOTS; i++) {
+        fec_slot_t *slot = &dec->slots[i];
+
+        if ((slot->k != 0) && (slot->block == block)) {
+            return slot;
+        }
+        if ((slot->k == 0) ||
+            ((oldest->k != 0) && ((int16_t)(slot->block - oldest->block) < 0))) {
+            oldest = slot;
+        }
+    }
+    if (dec->started) {
+        int16_t gap = block - dec->next_block;
+
+        if (gap < 0) {
+            /* late packet of a block that was already given up on */
+            return NULL;
+        }
+        /* whole blocks went missing in between */
+        stats->residual += gap * dec->last_k;
+    }
+    dec->started = 1;
+    dec->next_block = block + 1;
+    dec->last_k = hdr->k;
+    _slot_release(oldest, stats);
+    oldest->block = block;
+    oldest->k = hdr->k;
+    oldest->m = hdr->m;
+    /* all k until a repair packet says the block was flushed early */
+    oldest->n = hdr->k;
+    oldest->done = 0;
+    oldest->have = 0;
+    return oldest;
+}
+
+/* Gauss-Jordan inversion of the n x n matrix a into inv, n <= FEC_M_MAX */
+static int _gf_invert(uint8_t a[FEC_M_MAX][FEC_M_MAX],
+                      uint8_t inv[FEC_M_MAX][FEC_M_MAX], unsigned n)
+{
+    for (unsigned r = 0; r < n; r++) {
+        for (unsigned c = 0; c < n; c++) {
+            inv[r][c] = (r == c);
+        }
+    }
+    for (unsigned c = 0; c < n; c++) {
+        unsigned p = c;
+
+        while ((p < n) && (a[p][c] == 0)) {
+            p++;
+        }
+        if (p == n) {
+            return -1;
+        }
+        if (p != c) {
+            for (unsigned i = 0; i < n; i++) {
+                uint8_t t = a[p][i];
+                a[p][i] = a[c][i];
+                a[c][i] = t;
+                t = inv[p][i];
+                inv[p][i] = inv[c][i];
+                inv[c][i] = t;
+            }
+        }
+        uint8_t f = _gf_inv(a[c][c]);
+        for (unsigned i = 0; i < n; i++) {
+            a[c][i] = _gf_mul(a[c][i], f);
+            inv[c][i] = _gf_mul(inv[c][i], f);
+        }
+        for (unsigned r = 0; r < n; r++) {
+            uint8_t g = a[r][c];
+
+            if ((r == c) || (g == 0)) {
+                continue;
+            }
+            for (unsigned i = 0; i < n; i++) {
+                a[r][i] ^= _gf_mul(g, a[c][i]);
+                inv[r][i] ^= _gf_mul(g, inv[c][i]);
+            }
+        }
+    }
+    return 0;
+}
+
+static void _recover(fec_slot_t *slot, fec_deliver_cb_t deliver_cb, void *arg,
+                     fec_stats_t *stats)
+{
+    uint8_t a[FEC_M_MAX][FEC_M_MAX], inv[FEC_M_MAX][FEC_M_MAX];
+    uint8_t missing[FEC_M_MAX], rows[FEC_M_MAX];
+    uint16_t len = 0;
+    unsigned n = 0, r = 0;
+
+    for (unsigned i = 0; i < slot->n; i++) {
+        if (!(slot->have & (1U << i))) {
+            missing[n++] = i;
+        }
+    }
+    for (unsigned j = 0; (j < slot->m) && (r < n); j++) {
+        unsigned idx = slot->k + j;
+
+        if (slot->have & (1U << idx)) {
+            rows[r++] = j;
+            if (slot->sym_len[idx] > len) {
+                len = slot->sym_len[idx];
+            }
+        }
+    }
+    /* strip the received data out of the repair symbols, leaving a linear
+     * system in the missing ones only */
+    for (unsigned x = 0; x < n; x++) {
+        uint8_t *s = slot->sym[slot->k + rows[x]];
+
+        memset(s + slot->sym_len[slot->k + rows[x]], 0,
+               len - slot->sym_len[slot->k + rows[x]]);
+        for (unsigned i = 0; i < slot->n; i++) {
+            if (slot->have & (1U << i)) {
+                _gf_mul_add(s, slot->sym[i], _coef(slot->m, rows[x], i),
+                            slot->sym_len[i]);
+            }
+        }
+        for (unsigned y = 0; y < n; y++) {
+            a[x][y] = _coef(slot->m, rows[x], missing[y]);
+        }
+    }
+    if (_gf_invert(a, inv, n) < 0) {
+        stats->residual += n;
+        return;
+    }
+    for (unsigned y = 0; y < n; y++) {
+        uint8_t *out = slot->sym[missing[y]];
+        uint16_t plen;
+
+        memset(out, 0, len);
+        for (unsigned x = 0; x < n; x++) {
+            _gf_mul_add(out, slot->sym[slot->k + rows[x]], inv[y][x], len);
+        }
+        plen = (out[0] << 8) | out[1];
+        if (plen > (len - 2)) {
+            /* can't happen for consistent input, drop rather than overrun */
+            stats->residual++;
+            continue;
+        }
+        slot->sym_len[missing[y]] = plen + 2;
+        slot->have |= 1U << missing[y];
+        stats->recovered++;
+        deliver_cb(arg, out + 2, plen, true);
+    }
+}
+
+int fec_dec_recv(fec_dec_t *dec, const void *pkt, size_t len,
+                 fec_deliver_cb_t deliver_cb, void *arg, fec_stats_t *stats)
+{
+    const fec_hdr_t *hdr = pkt;
+    const uint8_t *payload = (const uint8_t *)pkt + sizeof(*hdr);
+    fec_slot_t *slot;
+    uint16_t data_mask, repair_mask;
+    uint32_t start;
+
+    if ((len < sizeof(*hdr)) || (hdr->k == 0) || (hdr->k > FEC_K_MAX) ||
+        (hdr->m == 0) || (hdr->m > FEC_M_MAX) ||
+        (hdr->idx >= (hdr->k + hdr->m))) {
+        return -EBADMSG;
+    }
+    len -= sizeof(*hdr);
+    /* data symbols get the length prepended, repair symbols have it */
+    if ((hdr->idx < hdr->k) ? (len > FEC_PAYLOAD_MAX)
+                            : ((len > FEC_SYMBOL_MAX) || (hdr->n == 0) ||
+                               (hdr->n > hdr->k))) {
+        return -EBADMSG;
+    }
+    if (hdr->idx < hdr->k) {
+        stats->data_rx++;
+        deliver_cb(arg, payload, len, false);
+    }
+    else {
+        stats->repair_rx++;
+    }
+    if ((slot = _slot_get(dec, hdr, stats)) == NULL) {
+        return 0;
+    }
+    if (slot->done || (slot->have & (1U << hdr->idx)) ||
+        (slot->k != hdr->k) || (slot->m != hdr->m) ||
+        ((hdr->idx < hdr->k) && (hdr->idx >= slot->n))) {
+        return 0;
+    }
+    if (hdr->idx >= hdr->k) {
+        slot->n = hdr->n;
+    }
+    start = xtimer_now_usec();
+    slot->have |= 1U << hdr->idx;
+    if (hdr->idx < hdr->k) {
+        /* store as symbol so it can take part in decoding */
+        slot->sym[hdr->idx][0] = len >> 8;
+        slot->sym[hdr->idx][1] = len & 0xff;
+        memcpy(&slot->sym[hdr->idx][2], payload, len);
+        slot->sym_len[hdr->idx] = len + 2;
+    }
+    else {
+        memcpy(slot->sym[hdr->idx], payload, len);
+        slot->sym_len[hdr->idx] = len;
+    }
+    data_mask = (1U << slot->n) - 1;
+    repair_mask = ((1U << slot->m) - 1) << slot->k;
+    if ((slot->have & data_mask) == data_mask) {
+        slot->done = 1;
+    }
+    else if (_popcount(slot->have & (data_mask | repair_mask)) >= slot->n) {
+        _recover(slot, deliver_cb, arg, stats);
+        slot->done = 1;
+    }
+    stats->dec_us += xtimer_now_usec() - start;
+    return 0;
+}
+
+/** @} */
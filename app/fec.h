@@ -0,0 +1,194 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Forward error correction for UDP datagrams
+ *
+ * Datagrams are grouped into blocks of K data packets followed by M repair
+ * packets. With M = 1 the repair packet is the XOR parity of the block,
+ * otherwise the repair packets are rows of a systematic Cauchy Reed-Solomon
+ * code over GF(256), so any K of the K + M packets restore the block. Data
+ * packets are delivered as soon as they arrive; repair packets only cost
+ * latency for the packets they recover.
+ * @}
+ */
+#ifndef FEC_H
+#define FEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "byteorder.h"
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef FEC_K_MAX
+#define FEC_K_MAX           (8U)    /**< maximum data packets per block */
+#endif
+#ifndef FEC_M_MAX
+#define FEC_M_MAX           (4U)    /**< maximum repair packets per block */
+#endif
+#ifndef FEC_SLOTS
+#define FEC_SLOTS           (2U)    /**< blocks the decoder keeps in flight */
+#endif
+/** @} */
+
+#if (FEC_K_MAX + FEC_M_MAX) > 16
+#error "FEC_K_MAX + FEC_M_MAX must fit the 16 bit receive bitmap"
+#endif
+
+/**
+ * @brief   FEC header preceding every datagram
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t k;                  /**< data packets per block */
+    uint8_t m;                  /**< repair packets in this block */
+    uint8_t idx;                /**< 0..k-1 for data, k.. for repair */
+    uint8_t n;                  /**< repair: data packets sent in this
+                                     block, k or fewer for a flushed
+                                     block; data: 0 */
+    network_uint16_t block;     /**< block number */
+} fec_hdr_t;
+
+/**
+ * @brief   Largest payload protected by FEC
+ */
+#define FEC_PAYLOAD_MAX     (SOCK_INBUF_SIZE - sizeof(fec_hdr_t) - 2)
+
+/**
+ * @brief   Size of a coded symbol: payload length plus payload
+ */
+#define FEC_SYMBOL_MAX      (FEC_PAYLOAD_MAX + 2)
+
+/**
+ * @brief   Callback to put an encoded datagram on the wire
+ */
+typedef int (*fec_send_cb_t)(void *arg, const void *pkt, size_t len);
+
+/**
+ * @brief   Callback receiving decoded payloads
+ *
+ * @param[in] arg           user argument
+ * @param[in] data          payload
+ * @param[in] len           length of @p data
+ * @param[in] recovered     payload was rebuilt from repair packets
+ */
+typedef void (*fec_deliver_cb_t)(void *arg, const void *data, size_t len,
+                                 bool recovered);
+
+/**
+ * @brief   FEC statistics
+ */
+typedef struct {
+    uint32_t data_tx;           /**< data packets sent */
+    uint32_t repair_tx;         /**< repair packets sent */
+    uint32_t enc_us;            /**< time spent encoding */
+    uint32_t data_rx;           /**< data packets received */
+    uint32_t repair_rx;         /**< repair packets received */
+    uint32_t recovered;         /**< data packets rebuilt from repair */
+    uint32_t residual;          /**< data packets lost for good */
+    uint32_t dec_us;            /**< time spent decoding */
+} fec_stats_t;
+
+/**
+ * @brief   Encoder state
+ */
+typedef struct {
+    uint8_t k;                  /**< configured data packets per block */
+    uint8_t m;                  /**< configured repair packets per block */
+    uint8_t idx;                /**< data packets in the current block */
+    uint16_t block;             /**< current block number */
+    uint16_t sym_len;           /**< longest symbol in the current block */
+    uint8_t repair[FEC_M_MAX][FEC_SYMBOL_MAX]; /**< repair accumulators */
+} fec_enc_t;
+
+/**
+ * @brief   Decoder block slot
+ */
+typedef struct {
+    uint16_t block;             /**< block number */
+    uint8_t k;                  /**< data packets per block, 0 for unused */
+    uint8_t m;                  /**< repair packets in block */
+    uint8_t n;                  /**< data packets sent in block */
+    uint8_t done;               /**< all data packets delivered */
+    uint16_t have;              /**< bitmap of received packets */
+    uint16_t sym_len[FEC_K_MAX + FEC_M_MAX]; /**< symbol lengths */
+    uint8_t sym[FEC_K_MAX + FEC_M_MAX][FEC_SYMBOL_MAX]; /**< symbols */
+} fec_slot_t;
+
+/**
+ * @brief   Decoder state
+ */
+typedef struct {
+    fec_slot_t slots[FEC_SLOTS];    /**< blocks in flight */
+    uint16_t next_block;            /**< block expected next */
+    uint8_t last_k;                 /**< k of the latest block */
+    uint8_t started;                /**< first packet was seen */
+} fec_dec_t;
+
+/**
+ * @brief   Initialize an encoder
+ *
+ * @return  0 on success
+ * @return  -EINVAL if @p k or @p m are out of range
+ */
+int fec_enc_init(fec_enc_t *enc, unsigned k, unsigned m);
+
+/**
+ * @brief   Send @p data as the next data packet and, once the block is full,
+ *          its repair packets
+ *
+ * @return  0 on success
+ * @return  -EMSGSIZE if @p len exceeds @ref FEC_PAYLOAD_MAX
+ * @return  negative value returned by @p send_cb
+ */
+int fec_enc_send(fec_enc_t *enc, const void *data, size_t len,
+                 fec_send_cb_t send_cb, void *arg, fec_stats_t *stats);
+
+/**
+ * @brief   Close a partial block by sending its repair packets
+ *
+ * The repair packets keep the block's k and tell the decoder how many data
+ * packets were sent, so they never take the index of a data packet.
+ */
+int fec_enc_flush(fec_enc_t *enc, fec_send_cb_t send_cb, void *arg,
+                  fec_stats_t *stats);
+
+/**
+ * @brief   Initialize a decoder
+ */
+void fec_dec_init(fec_dec_t *dec);
+
+/**
+ * @brief   Feed a received datagram into the decoder
+ *
+ * Payloads are handed to @p deliver_cb, data packets immediately and
+ * recovered packets as soon as enough repair packets arrived.
+ *
+ * @return  0 on success
+ * @return  -EBADMSG on malformed datagrams
+ */
+int fec_dec_recv(fec_dec_t *dec, const void *pkt, size_t len,
+                 fec_deliver_cb_t deliver_cb, void *arg, fec_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FEC_H */
+/** @} */
@@ -0,0 +1,340 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Firmware update over TCP into a flash staging area
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fwup.h"
+#include "msg.h"
+#include "net/sock/tcp.h"
+#include "prio.h"
+#include "thread.h"
+#include "xtimer.h"
+
+#if defined(MODULE_PERIPH_FLASHPAGE) && \
+    defined(MODULE_PERIPH_FLASHPAGE_RAW) && defined(MODULE_SOCK_TCP)
+#include "periph/flashpage.h"
+
+#ifdef MODULE_LWIP_IPV6
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+/* upper half of the flash, without the nvconf page at the very end */
+#ifndef FWUP_FIRST_PAGE
+#define FWUP_FIRST_PAGE     (FLASHPAGE_NUMOF / 2)
+#endif
+#ifndef FWUP_PAGES
+#define FWUP_PAGES          ((FLASHPAGE_NUMOF / 2) - 1)
+#endif
+
+#define MSG_PROGRAM         (0x4601)
+#define MSG_DONE            (0x4602)
+#define QUEUE_SIZE          (4U)
+
+typedef struct {
+    uint8_t data[FLASHPAGE_SIZE]
+        __attribute__((aligned(FLASHPAGE_RAW_ALIGNMENT)));
+    size_t len;
+    unsigned page;
+} _buf_t;
+
+static _buf_t _bufs[FWUP_BUFS];
+static sha256_context_t _sha;
+static volatile int _flash_res;
+static unsigned _last_page;
+static bool _pipelined = true;
+static bool _running;
+static volatile bool _busy;
+static uint16_t _port;
+static fwup_result_t _result;
+
+static kernel_pid_t _writer_pid;
+static char _writer_stack[THREAD_STACKSIZE_DEFAULT];
+static msg_t _writer_queue[QUEUE_SIZE];
+static char _server_stack[THREAD_STACKSIZE_DEFAULT];
+static msg_t _server_queue[QUEUE_SIZE];
+static sock_tcp_t _socks[1];
+static sock_tcp_queue_t _queue;
+
+static int _program(const _buf_t *buf)
+{
+    void *addr = flashpage_addr(buf->page);
+    size_t len = (buf->len + FLASHPAGE_RAW_BLOCKSIZE - 1) &
+                 ~(FLASHPAGE_RAW_BLOCKSIZE - 1);
+
+    /* pipelined, all but the first page were erased ahead of time */
+    if (!_pipelined || (buf->page == FWUP_FIRST_PAGE)) {
+        flashpage_write(buf->page, NULL);
+    }
+    flashpage_write_raw(addr, buf->data, len);
+    if (_pipelined && (buf->page < _last_page)) {
+        flashpage_write(buf->page + 1, NULL);
+    }
+    if (memcmp(addr, buf->data, buf->len) != 0) {
+        return -EIO;
+    }
+    sha256_update(&_sha, addr, buf->len);
+    return 0;
+}
+
+static void *_writer_thread(void *arg)
+{
+    (void)arg;
+    msg_init_queue(_writer_queue, QUEUE_SIZE);
+    while (1) {
+        msg_t msg;
+        kernel_pid_t sender;
+        uint32_t start;
+
+        msg_receive(&msg);
+        if (msg.type != MSG_PROGRAM) {
+            continue;
+        }
+        sender = msg.sender_pid;
+        start = xtimer_now_usec();
+        if (_flash_res == 0) {
+            _flash_res = _program(msg.content.ptr);
+        }
+        _result.flash_us += xtimer_now_usec() - start;
+        msg.type = MSG_DONE;
+        msg_send(&msg, sender);
+    }
+    return NULL;
+}
+
+static int _read_full(sock_tcp_t *sock, void *data, size_t len)
+{
+    uint8_t *pos = data;
+
+    while (len) {
+        ssize_t res = sock_tcp_read(sock, pos, len, FWUP_TIMEOUT_US);
+
+        if (res <= 0) {
+            return (res < 0) ? res : -ECONNRESET;
+        }
+        pos += res;
+        len -= res;
+    }
+    return 0;
+}
+
+/* waits until the writer handed back a buffer */
+static void _wait_done(void)
+{
+    uint32_t start = xtimer_now_usec();
+    msg_t msg;
+
+    do {
+        msg_receive(&msg);
+    } while (msg.type != MSG_DONE);
+    _result.wait_us += xtimer_now_usec() - start;
+}
+
+static int _update(sock_tcp_t *sock)
+{
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    fwup_hdr_t hdr;
+    unsigned pending = 0, next = 0;
+    uint32_t start, offset = 0;
+    int res;
+
+    memset(&_result, 0, sizeof(_result));
+    if ((res = _read_full(sock, &hdr, sizeof(hdr))) < 0) {
+        return res;
+    }
+    start = xtimer_now_usec();
+    _result.size = byteorder_ntohl(hdr.size);
+    if (byteorder_ntohl(hdr.magic) != FWUP_MAGIC) {
+        return -EINVAL;
+    }
+    if ((_result.size == 0) ||
+        (_result.size > ((uint32_t)FWUP_PAGES * FLASHPAGE_SIZE))) {
+        return -EFBIG;
+    }
+    _last_page = FWUP_FIRST_PAGE + ((_result.size - 1) / FLASHPAGE_SIZE);
+    _flash_res = 0;
+    sha256_init(&_sha);
+    for (unsigned page = FWUP_FIRST_PAGE; offset < _result.size; page++) {
+        _buf_t *buf = &_bufs[next];
+        msg_t msg = { .type = MSG_PROGRAM, .content.ptr = buf };
+
+        /* buffers come back in order, so the next one is the oldest */
+        if (pending == (_pipelined ? FWUP_BUFS : 1)) {
+            _wait_done();
+            pending--;
+        }
+        if (_flash_res < 0) {
+            break;
+        }
+        buf->len = MIN(FLASHPAGE_SIZE, _result.size - offset);
+        buf->page = page;
+        if ((res = _read_full(sock, buf->data, buf->len)) < 0) {
+            break;
+        }
+        memset(buf->data + buf->len, 0xff, sizeof(buf->data) - buf->len);
+        msg_send(&msg, _writer_pid);
+        pending++;
+        next = (next + 1) % FWUP_BUFS;
+        offset += buf->len;
+    }
+    while (pending--) {
+        _wait_done();
+    }
+    if ((res == 0) && ((res = _flash_res) == 0)) {
+        sha256_final(&_sha, digest);
+        if (memcmp(digest, hdr.sha256, sizeof(digest)) != 0) {
+            res = -EBADMSG;
+        }
+    }
+    _result.duration_us = xtimer_now_usec() - start;
+    return res;
+}
+
+static void *_server_thread(void *arg)
+{
+    sock_tcp_ep_t local = SOCK_IP_EP_ANY;
+    int res;
+
+    (void)arg;
+    msg_init_queue(_server_queue, QUEUE_SIZE);
+    local.port = _port;
+    if ((res = sock_tcp_listen(&_queue, &local, _socks, ARRAY_SIZE(_socks),
+                               0)) < 0) {
+        printf("Unable to open update receiver on port %" PRIu16
+               " (error code %d)\n", local.port, -res);
+        _running = false;
+        return NULL;
+    }
+    printf("Success: started update receiver on port %" PRIu16 "\n",
+           local.port);
+    while (1) {
+        sock_tcp_t *sock;
+        fwup_reply_t reply;
+
+        if (sock_tcp_accept(&_queue, &sock, SOCK_NO_TIMEOUT) < 0) {
+            continue;
+        }
+        _busy = true;
+        _result.status = _update(sock);
+        _busy = false;
+        reply.status = byteorder_htonl(-_result.status);
+        reply.duration_ms = byteorder_htonl(_result.duration_us / US_PER_MS);
+        sock_tcp_write(sock, &reply, sizeof(reply));
+        sock_tcp_disconnect(sock);
+        printf("fwup: %" PRIu32 " byte image %s (error code %d) in %" PRIu32
+               " ms\n", _result.size, _result.status ? "failed" : "verified",
+               -_result.status, _result.duration_us / US_PER_MS);
+    }
+    return NULL;
+}
+
+int fwup_start(uint16_t port)
+{
+    if (_running) {
+        return -EALREADY;
+    }
+    _port = port;
+    _running = true;
+    /* the writer runs below the receiver, which mostly waits for data */
+    _writer_pid = thread_create(_writer_stack, sizeof(_writer_stack),
+                                PRIO_FWUP_FLASH,
+                                THREAD_CREATE_STACKTEST, _writer_thread, NULL,
+                                "fwup_flash");
+    if ((_writer_pid <= KERNEL_PID_UNDEF) ||
+        (thread_create(_server_stack, sizeof(_server_stack),
+                       PRIO_FWUP, THREAD_CREATE_STACKTEST,
+                       _server_thread, NULL, "fwup") <= KERNEL_PID_UNDEF)) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+static int _set_pipeline(const char *arg)
+{
+    if (_busy) {
+        puts("error: update in progress");
+        return 1;
+    }
+    _pipelined = strcmp(arg, "off") != 0;
+    return 0;
+}
+#else
+int fwup_start(uint16_t port)
+{
+    (void)port;
+    return -ENOTSUP;
+}
+
+static int _set_pipeline(const char *arg)
+{
+    (void)arg;
+    puts("error: no flash page support");
+    return 1;
+}
+
+static fwup_result_t _result;
+#endif
+
+const fwup_result_t *fwup_result(void)
+{
+    return &_result;
+}
+
+int fwup_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        if (_result.size == 0) {
+            puts("no update received");
+            return 0;
+        }
+        printf("last update: %" PRIu32 " bytes, %s (error code %d)\n",
+               _result.size, _result.status ? "failed" : "verified",
+               -_result.status);
+        if (_result.duration_us) {
+            printf("%" PRIu32 " ms, %" PRIu32 " KiB/s, receiver waited %"
+                   PRIu32 " ms, flash busy %" PRIu32 " ms\n",
+                   _result.duration_us / US_PER_MS,
+                   (uint32_t)(((uint64_t)_result.size * US_PER_SEC / 1024) /
+                              _result.duration_us),
+                   _result.wait_us / US_PER_MS, _result.flash_us / US_PER_MS);
+        }
+        return 0;
+    }
+    else if (strcmp(argv[1], "start") == 0) {
+        int res = fwup_start((argc > 2) ? strtoul(argv[2], NULL, 0)
+                                        : FWUP_PORT);
+
+        if (res < 0) {
+            printf("error: unable to start update receiver (error code %d)\n",
+                   -res);
+            return 1;
+        }
+        return 0;
+    }
+    else if ((strcmp(argv[1], "pipeline") == 0) && (argc > 2)) {
+        return _set_pipeline(argv[2]);
+    }
+    else {
+        printf("usage: %s [start [<port>]|pipeline on|off]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
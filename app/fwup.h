@@ -0,0 +1,124 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Firmware update over TCP into a flash staging area
+ *
+ * A client connects, sends a @ref fwup_hdr_t and then the image. The image
+ * is written to the staging pages starting at `FWUP_FIRST_PAGE`, and the
+ * device answers with a @ref fwup_reply_t before it closes the connection.
+ *
+ * Reception and flash programming run in two threads. The receiver fills
+ * one of @ref FWUP_BUFS page buffers from the socket while the writer
+ * programs the previous one and then erases the page after it, so the
+ * erase is done by the time the next buffer arrives. Programmed pages are
+ * read back, compared and fed to a SHA-256 that is checked against the
+ * header at the end, so what is verified is the flash content. With
+ * `fwup pipeline off` every page is erased and programmed while the
+ * receiver waits, for comparison.
+ *
+ * Booting the staged image is left to a bootloader; this module only
+ * stages and verifies it.
+ * @}
+ */
+#ifndef FWUP_H
+#define FWUP_H
+
+#include <stdint.h>
+
+#include "byteorder.h"
+#include "hashes/sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef FWUP_PORT
+#define FWUP_PORT               (12370U)    /**< default listen port */
+#endif
+#ifndef FWUP_BUFS
+#define FWUP_BUFS               (2U)        /**< page buffers in flight */
+#endif
+#ifndef FWUP_TIMEOUT_US
+#define FWUP_TIMEOUT_US         (5000000UL) /**< idle timeout while receiving */
+#endif
+/** @} */
+
+/**
+ * @brief   Header magic, "FWUP"
+ */
+#define FWUP_MAGIC              (0x46575550UL)
+
+/**
+ * @brief   Update header sent by the client, in network byte order
+ */
+typedef struct __attribute__((packed)) {
+    network_uint32_t magic;     /**< @ref FWUP_MAGIC */
+    network_uint32_t size;      /**< image size in bytes */
+    uint8_t sha256[SHA256_DIGEST_LENGTH]; /**< SHA-256 of the image */
+} fwup_hdr_t;
+
+/**
+ * @brief   Reply sent by the device, in network byte order
+ */
+typedef struct __attribute__((packed)) {
+    network_uint32_t status;    /**< 0 or a positive errno value */
+    network_uint32_t duration_ms; /**< time from header to verified image */
+} fwup_reply_t;
+
+/**
+ * @brief   Result of the last update
+ */
+typedef struct {
+    int status;                 /**< 0 or negative errno */
+    uint32_t size;              /**< image size */
+    uint32_t duration_us;       /**< time from header to verified image */
+    uint32_t wait_us;           /**< receiver waiting for a free buffer */
+    uint32_t flash_us;          /**< writer erasing, programming, hashing */
+} fwup_result_t;
+
+/**
+ * @brief   Start the update receiver and flash writer threads
+ *
+ * @param[in] port      port to listen on
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the receiver is already running
+ * @return  -ENOMEM if a thread could not be created
+ * @return  -ENOTSUP without flash page or TCP support
+ */
+int fwup_start(uint16_t port);
+
+/**
+ * @brief   Get the result of the last update
+ */
+const fwup_result_t *fwup_result(void);
+
+/**
+ * @brief   Firmware update shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int fwup_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FWUP_H */
+/** @} */
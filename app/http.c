@@ -0,0 +1,532 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Minimal HTTP/1.1 server
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "evq.h"
+#include "http.h"
+#include "lwip/api.h"
+#include "metrics.h"
+#include "net/sock/async/event.h"
+#include "net/sock/tcp.h"
+#include "prio.h"
+#include "thread.h"
+#include "xtimer.h"
+
+#ifdef MODULE_LWIP_IPV6
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#ifdef MODULE_SOCK_TCP
+#define DATA_CHUNK          (1024U)
+#define HDR_SIZE            (160U)
+#define PAGE_SIZE           (384U)
+
+/* 64 characters, 16 of them make a data chunk */
+#define DATA_LINE   \
+    "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ-\n"
+#define DATA_LINE4  DATA_LINE DATA_LINE DATA_LINE DATA_LINE
+
+typedef enum {
+    _GET,
+    _HEAD,
+    _OTHER,
+} _method_t;
+
+typedef struct {
+    _method_t method;
+    const char *path;
+    size_t path_len;
+    bool http10;
+    bool keep_alive;
+} _req_t;
+
+typedef struct {
+    uint32_t left;              /* /data bytes still to send */
+    uint32_t sent;              /* /data bytes sent */
+    bool more;                  /* more responses follow the data */
+    bool close;                 /* close once the data went out */
+    size_t fill;
+    char buf[HTTP_RX_BUF_SIZE];
+} _conn_t;
+
+static const char _index_html[] =
+    "<!DOCTYPE html>\n"
+    "<html><head><title>RIOT lwIP</title></head><body>\n"
+    "<h1>RIOT lwIP test application</h1>\n"
+    "<ul>\n"
+    "<li><a href=\"/status\">status</a></li>\n"
+    "<li><a href=\"/data/1024\">1 MiB of test data</a></li>\n"
+    "</ul>\n"
+    "</body></html>\n";
+
+/* every chunk of a /data download references this block */
+static const char _data_chunk[DATA_CHUNK + 1] =
+    DATA_LINE4 DATA_LINE4 DATA_LINE4 DATA_LINE4;
+
+static sock_tcp_t _socks[HTTP_CONN_NUMOF];
+static _conn_t _conns[HTTP_CONN_NUMOF];
+static sock_tcp_queue_t _queue;
+static evq_t _evq;
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+static char _hdr[HDR_SIZE];
+static char _page[PAGE_SIZE];
+static uint16_t _port;
+static bool _running;
+static http_stats_t _stats;
+static metrics_metric_t _metrics[] = {
+    METRICS_COUNTER_REF("http_connections_total", "Accepted connections",
+                        &_stats.connections),
+    METRICS_COUNTER_REF("http_requests_total", "Answered requests",
+                        &_stats.requests),
+    METRICS_COUNTER_REF("http_errors_total", "Rejected requests",
+                        &_stats.errors),
+};
+
+/* without NETCONN_COPY lwIP queues PBUF_ROM references to data, which
+ * must stay valid until it is acknowledged */
+static int _write(sock_tcp_t *sock, const void *data, size_t len,
+                  uint8_t flags)
+{
+    struct netconn *conn = sock->base.conn;
+
+    if (len == 0) {
+        return 0;
+    }
+    if ((conn == NULL) || (netconn_write(conn, data, len, flags) != ERR_OK)) {
+        return -EIO;
+    }
+    if (flags & NETCONN_COPY) {
+        _stats.copied_bytes += len;
+    }
+    else {
+        _stats.rom_bytes += len;
+    }
+    return 0;
+}
+
+static int _header(sock_tcp_t *sock, const _req_t *req, const char *status,
+                   const char *type, uint32_t len, bool more)
+{
+    const char *conn = "";
+    int hlen;
+
+    if (!req->keep_alive) {
+        conn = "Connection: close\r\n";
+    }
+    else if (req->http10) {
+        conn = "Connection: keep-alive\r\n";
+    }
+    hlen = snprintf(_hdr, sizeof(_hdr),
+                    "HTTP/1.1 %s\r\nContent-Type: %s\r\n"
+                    "Content-Length: %" PRIu32 "\r\n%s\r\n",
+                    status, type, len, conn);
+    return _write(sock, _hdr, hlen, NETCONN_COPY | (more ? NETCONN_MORE : 0));
+}
+
+static size_t _status_page(void)
+{
+    return snprintf(_page, sizeof(_page),
+                    "uptime_s %" PRIu32 "\n"
+                    "http_connections %" PRIu32 "\n"
+                    "http_requests %" PRIu32 "\n"
+                    "http_pipelined %" PRIu32 "\n"
+                    "http_errors %" PRIu32 "\n"
+                    "http_rom_kib %" PRIu32 "\n"
+                    "http_copied_kib %" PRIu32 "\n",
+                    (uint32_t)(xtimer_now_usec64() / US_PER_SEC),
+                    _stats.connections, _stats.requests, _stats.pipelined,
+                    _stats.errors, (uint32_t)(_stats.rom_bytes / 1024),
+                    (uint32_t)(_stats.copied_bytes / 1024));
+}
+
+/* sends as much of a /data body as the send buffer takes, returns -EAGAIN
+ * if the rest has to wait for SOCK_ASYNC_MSG_SENT */
+static int _pump(sock_tcp_t *sock, _conn_t *c)
+{
+    struct netconn *conn = sock->base.conn;
+
+    while (c->left) {
+        size_t off = c->sent % DATA_CHUNK;
+        size_t len = MIN(c->left, DATA_CHUNK - off);
+        size_t written = 0;
+        err_t err;
+
+        if (conn == NULL) {
+            return -EIO;
+        }
+        err = netconn_write_partly(conn, _data_chunk + off, len,
+                                   NETCONN_DONTBLOCK |
+                                   (((len < c->left) || c->more)
+                                    ? NETCONN_MORE : 0), &written);
+        if ((err != ERR_OK) && (err != ERR_WOULDBLOCK)) {
+            return -EIO;
+        }
+        c->sent += written;
+        c->left -= written;
+        _stats.rom_bytes += written;
+        if (written < len) {
+            return -EAGAIN;
+        }
+    }
+    return 0;
+}
+
+static int _data(sock_tcp_t *sock, _conn_t *c, const _req_t *req, bool more)
+{
+    uint32_t kib = 0;
+
+    /* /data/<kib> */
+    for (size_t i = sizeof("/data/") - 1; i < req->path_len; i++) {
+        if ((req->path[i] < '0') || (req->path[i] > '9')) {
+            kib = UINT32_MAX;
+            break;
+        }
+        kib = (kib * 10) + (req->path[i] - '0');
+        if (kib > HTTP_DATA_MAX_KIB) {
+            break;
+        }
+    }
+    if (kib > HTTP_DATA_MAX_KIB) {
+        _stats.errors++;
+        return _header(sock, req, "404 Not Found", "text/plain", 0, more);
+    }
+    if (_header(sock, req, "200 OK", "application/octet-stream",
+                kib * DATA_CHUNK, more || (kib && (req->method == _GET))) < 0) {
+        return -EIO;
+    }
+    c->left = (req->method == _GET) ? kib * DATA_CHUNK : 0;
+    c->sent = 0;
+    c->more = more;
+    return _pump(sock, c);
+}
+
+static int _respond(sock_tcp_t *sock, _conn_t *c, const _req_t *req,
+                    bool more)
+{
+    const char *body = NULL;
+    size_t len = 0;
+    uint8_t flags = more ? NETCONN_MORE : 0;
+
+    if (req->method == _OTHER) {
+        _stats.errors++;
+        return _header(sock, req, "501 Not Implemented", "text/plain", 0,
+                       more);
+    }
+    _stats.requests++;
+    if ((req->path_len == 1) && (req->path[0] == '/')) {
+        body = _index_html;
+        len = sizeof(_index_html) - 1;
+    }
+    else if ((req->path_len == 7) && (memcmp(req->path, "/status", 7) == 0)) {
+        len = _status_page();
+        if (_header(sock, req, "200 OK", "text/plain", len,
+                    more || (req->method == _GET)) < 0) {
+            return -EIO;
+        }
+        return (req->method == _GET)
+               ? _write(sock, _page, len, NETCONN_COPY | flags) : 0;
+    }
+    else if ((req->path_len > 6) && (memcmp(req->path, "/data/", 6) == 0)) {
+        return _data(sock, c, req, more);
+    }
+    else {
+        return _header(sock, req, "404 Not Found", "text/plain", 0, more);
+    }
+    if (_header(sock, req, "200 OK", "text/html", len,
+                more || (req->method == _GET)) < 0) {
+        return -EIO;
+    }
+    return (req->method == _GET) ? _write(sock, body, len, flags) : 0;
+}
+
+/* returns the position behind the empty line ending the headers */
+static const char *_headers_end(const char *buf, size_t len)
+{
+    const char *p = buf, *end = buf + len;
+
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        p++;
+        if ((p < end) && (*p == '\n')) {
+            return p + 1;
+        }
+        if (((p + 1) < end) && (p[0] == '\r') && (p[1] == '\n')) {
+            return p + 2;
+        }
+    }
+    return NULL;
+}
+
+/* returns the length of the request, 0 if it is incomplete and -1 if it is
+ * malformed. The request line is checked in place and the only header looked
+ * at is Connection, anything else is skipped without tokenizing. */
+static int _parse(const char *buf, size_t len, _req_t *req)
+{
+    const char *end = _headers_end(buf, len);
+    const char *line, *eol, *version;
+
+    if (end == NULL) {
+        return 0;
+    }
+    if ((size_t)(end - buf) < sizeof("GET / HTTP/1.0\n\n") - 1) {
+        return -1;
+    }
+    eol = memchr(buf, '\n', end - buf);
+    if (memcmp(buf, "GET ", 4) == 0) {
+        req->method = _GET;
+        req->path = buf + 4;
+    }
+    else if (memcmp(buf, "HEAD ", 5) == 0) {
+        req->method = _HEAD;
+        req->path = buf + 5;
+    }
+    else {
+        req->method = _OTHER;
+        req->path = memchr(buf, ' ', eol - buf);
+        if (req->path == NULL) {
+            return -1;
+        }
+        req->path++;
+    }
+    version = memchr(req->path, ' ', eol - req->path);
+    if ((version == NULL) || ((eol - version) < 9) ||
+        (memcmp(version + 1, "HTTP/1.", 7) != 0)) {
+        return -1;
+    }
+    req->path_len = version - req->path;
+    req->http10 = version[8] == '0';
+    req->keep_alive = !req->http10;
+    for (line = eol + 1; line < end; line = eol + 1) {
+        eol = memchr(line, '\n', end - line);
+        if (((line[0] | 0x20) == 'c') && ((eol - line) > 11) &&
+            (strncasecmp(line, "connection:", 11) == 0)) {
+            const char *value = line + 11;
+
+            while ((value < eol) && (*value == ' ')) {
+                value++;
+            }
+            if (((eol - value) >= 5) && (strncasecmp(value, "close", 5) == 0)) {
+                req->keep_alive = false;
+            }
+            else if (((eol - value) >= 10) &&
+                     (strncasecmp(value, "keep-alive", 10) == 0)) {
+                req->keep_alive = true;
+            }
+        }
+    }
+    return end - buf;
+}
+
+/* answers the complete requests in the buffer, returns true to close */
+static bool _process(sock_tcp_t *sock, _conn_t *c)
+{
+    size_t off = 0;
+    bool close = false;
+
+    /* requests behind a /data body wait until it went out */
+    while (!close && !c->left) {
+        _req_t req;
+        int len = _parse(c->buf + off, c->fill - off, &req);
+        bool more;
+        int res;
+
+        if (len == 0) {
+            break;
+        }
+        if (len < 0) {
+            _stats.errors++;
+            req.keep_alive = false;
+            req.http10 = false;
+            _header(sock, &req, "400 Bad Request", "text/plain", 0, false);
+            return true;
+        }
+        if (off) {
+            _stats.pipelined++;
+        }
+        off += len;
+        /* hold back the push while further requests are waiting */
+        more = req.keep_alive &&
+               (_headers_end(c->buf + off, c->fill - off) != NULL);
+        res = _respond(sock, c, &req, more);
+        if (res == -EAGAIN) {
+            c->close = !req.keep_alive;
+            break;
+        }
+        close = (res < 0) || !req.keep_alive;
+    }
+    c->fill -= off;
+    memmove(c->buf, c->buf + off, c->fill);
+    if (!close && !c->left && (c->fill == sizeof(c->buf))) {
+        _req_t req = { .keep_alive = false };
+
+        _stats.errors++;
+        _header(sock, &req, "431 Request Header Fields Too Large",
+                "text/plain", 0, false);
+        close = true;
+    }
+    return close;
+}
+
+static void _recv(sock_tcp_t *sock, sock_async_flags_t flags, void *arg)
+{
+    _conn_t *c = &_conns[sock - _socks];
+    bool close = false;
+
+    (void)arg;
+    if (c->left) {
+        int res = _pump(sock, c);
+
+        if (res == 0) {
+            /* answer what was pipelined behind the data */
+            close = c->close || _process(sock, c);
+        }
+        else {
+            close = (res != -EAGAIN);
+        }
+    }
+    /* while data is due, requests stay in lwIP's receive queue */
+    while (!close && !c->left) {
+        ssize_t res = sock_tcp_read(sock, c->buf + c->fill,
+                                    sizeof(c->buf) - c->fill, 0);
+
+        if (res <= 0) {
+            break;
+        }
+        c->fill += res;
+        close = _process(sock, c);
+    }
+    if (flags & SOCK_ASYNC_CONN_FIN) {
+        /* the client is done sending, finish the data still due */
+        close = close || !c->left;
+        c->close = true;
+    }
+    if (close) {
+        c->fill = 0;
+        c->left = 0;
+        sock_tcp_disconnect(sock);
+    }
+}
+
+static void _accept(sock_tcp_queue_t *queue, sock_async_flags_t flags,
+                    void *arg)
+{
+    (void)arg;
+    if (flags & SOCK_ASYNC_CONN_RECV) {
+        sock_tcp_t *sock = NULL;
+
+        if (sock_tcp_accept(queue, &sock, 0) == 0) {
+            _conn_t *c = &_conns[sock - _socks];
+
+            c->fill = 0;
+            c->left = 0;
+            c->close = false;
+#if LWIP_SO_SNDTIMEO
+            /* headers and pages are written blocking */
+            netconn_set_sendtimeout(sock->base.conn, HTTP_SEND_TIMEOUT_MS);
+#endif
+            _stats.connections++;
+            evq_tcp_event_init(&_evq, sock, _recv, NULL, "recv");
+        }
+    }
+}
+
+static void *_server_thread(void *arg)
+{
+    sock_tcp_ep_t local = SOCK_IP_EP_ANY;
+    int res;
+
+    (void)arg;
+    local.port = _port;
+    if ((res = sock_tcp_listen(&_queue, &local, _socks, HTTP_CONN_NUMOF,
+                               0)) < 0) {
+        printf("Unable to open HTTP server on port %" PRIu16
+               " (error code %d)\n", local.port, -res);
+        _running = false;
+        return NULL;
+    }
+    printf("Success: started HTTP server on port %" PRIu16 "\n", local.port);
+    evq_init(&_evq, "http");
+    evq_tcp_queue_event_init(&_evq, &_queue, _accept, NULL, "accept");
+    evq_loop(&_evq);
+    return NULL;
+}
+
+int http_start(uint16_t port)
+{
+    if (_running) {
+        return -EALREADY;
+    }
+    _port = port;
+    _running = true;
+    for (unsigned i = 0; i < ARRAY_SIZE(_metrics); i++) {
+        metrics_register(&_metrics[i]);
+    }
+    if (thread_create(_stack, sizeof(_stack), PRIO_HTTP,
+                      THREAD_CREATE_STACKTEST, _server_thread, NULL,
+                      "http") <= KERNEL_PID_UNDEF) {
+        _running = false;
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+const http_stats_t *http_stats(void)
+{
+    return &_stats;
+}
+
+int http_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("connections %" PRIu32 ", requests %" PRIu32 " (%" PRIu32
+               " pipelined), errors %" PRIu32 "\n", _stats.connections,
+               _stats.requests, _stats.pipelined, _stats.errors);
+        printf("sent %" PRIu32 " KiB from flash, %" PRIu32 " KiB copied\n",
+               (uint32_t)(_stats.rom_bytes / 1024),
+               (uint32_t)(_stats.copied_bytes / 1024));
+        return 0;
+    }
+    else if (strcmp(argv[1], "start") == 0) {
+        int res = http_start((argc > 2) ? strtoul(argv[2], NULL, 0)
+                                        : HTTP_PORT);
+
+        if (res < 0) {
+            printf("error: unable to start HTTP server (error code %d)\n",
+                   -res);
+            return 1;
+        }
+        return 0;
+    }
+    else if (strcmp(argv[1], "reset") == 0) {
+        memset(&_stats, 0, sizeof(_stats));
+        return 0;
+    }
+    else {
+        printf("usage: %s [start [<port>]|reset]\n", argv[0]);
+        return 1;
+    }
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
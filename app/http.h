@@ -0,0 +1,110 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Minimal HTTP/1.1 server
+ *
+ * One thread serves up to @ref HTTP_CONN_NUMOF connections from an event
+ * queue. Connections are kept alive unless the client asks otherwise, and
+ * pipelined requests are answered in order from the receive buffer, with
+ * only the last response of a batch pushed out.
+ *
+ * Static content lives in `const` arrays, i.e. in flash, and is handed to
+ * lwIP without @ref NETCONN_COPY, so TCP sends it from PBUF_ROM references
+ * to the flash. Only the response headers and the generated status page
+ * are copied into RAM.
+ *
+ * `/data` bodies are sent without blocking, as much as fits the send
+ * buffer, and continued when lwIP reports sent data, so a slow client
+ * never holds up the others. Pipelined requests behind such a body wait
+ * for it. Headers and pages are small and written blocking, bounded by
+ * @ref HTTP_SEND_TIMEOUT_MS, after which the connection is closed.
+ *
+ * Resources:
+ * - `/`            index page
+ * - `/status`      current statistics, generated
+ * - `/data/<kib>`  @p kib KiB of test data, for downloads and benchmarks
+ * @}
+ */
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef HTTP_PORT
+#define HTTP_PORT               (80U)       /**< default listen port */
+#endif
+#ifndef HTTP_CONN_NUMOF
+#define HTTP_CONN_NUMOF         (4U)        /**< concurrent connections */
+#endif
+#ifndef HTTP_RX_BUF_SIZE
+#define HTTP_RX_BUF_SIZE        (512U)      /**< request buffer per socket */
+#endif
+#ifndef HTTP_DATA_MAX_KIB
+#define HTTP_DATA_MAX_KIB       (16384U)    /**< largest `/data` size */
+#endif
+#ifndef HTTP_SEND_TIMEOUT_MS
+#define HTTP_SEND_TIMEOUT_MS    (1000)      /**< blocking write timeout */
+#endif
+/** @} */
+
+/**
+ * @brief   Server statistics
+ */
+typedef struct {
+    uint32_t connections;       /**< accepted connections */
+    uint32_t requests;          /**< answered requests */
+    uint32_t pipelined;         /**< requests that arrived behind another */
+    uint32_t errors;            /**< malformed or unsupported requests */
+    uint64_t rom_bytes;         /**< body bytes sent from flash */
+    uint64_t copied_bytes;      /**< header and generated bytes */
+} http_stats_t;
+
+/**
+ * @brief   Start the server thread
+ *
+ * @param[in] port      port to listen on
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the server is already running
+ * @return  -ENOMEM if the thread could not be created
+ */
+int http_start(uint16_t port);
+
+/**
+ * @brief   Get the server statistics
+ */
+const http_stats_t *http_stats(void);
+
+/**
+ * @brief   HTTP server shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int http_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTTP_H */
+/** @} */
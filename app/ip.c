@@ -21,10 +21,13 @@
 #include <stdio.h>
 
 #include "common.h"
+#include "evq.h"
+#include "metrics.h"
 #include "od.h"
 #include "net/af.h"
 #include "net/sock/async/event.h"
 #include "net/sock/ip.h"
+#include "prio.h"
 #include "shell.h"
 #include "thread.h"
 #include "test_utils/expect.h"
@@ -44,6 +47,11 @@ static bool server_running;
 static sock_ip_t server_sock;
 static char server_stack[THREAD_STACKSIZE_DEFAULT];
 static msg_t server_msg_queue[SERVER_MSG_QUEUE_SIZE];
+static evq_t _evq;
+static metrics_metric_t rx_packets = METRICS_COUNTER(
+    "ip_server_rx_packets_total", "Packets received by the IP server");
+static metrics_metric_t rx_bytes = METRICS_COUNTER(
+    "ip_server_rx_bytes_total", "Payload bytes received by the IP server");
 
 static void _ip_recv(sock_ip_t *sock, sock_async_flags_t flags, void *arg)
 {
@@ -62,6 +70,8 @@ static void _ip_recv(sock_ip_t *sock, sock_async_flags_t flags, void *arg)
         else {
             char addrstr[IPV6_ADDR_MAX_STR_LEN];
 
+            metrics_inc(&rx_packets);
+            metrics_add(&rx_bytes, res);
 #ifdef MODULE_LWIP_IPV6
             printf("Received IP data from [%s]:\n",
                    ipv6_addr_to_str(addrstr, (ipv6_addr_t *)&src.addr.ipv6,
@@ -78,7 +88,6 @@ static void _ip_recv(sock_ip_t *sock, sock_async_flags_t flags, void *arg)
 
 static void *_server_thread(void *args)
 {
-    event_queue_t queue;
     sock_ip_ep_t server_addr = SOCK_IP_EP_ANY;
     uint8_t protocol;
 
@@ -89,10 +98,12 @@ static void *_server_thread(void *args)
         return NULL;
     }
     server_running = true;
+    metrics_register(&rx_packets);
+    metrics_register(&rx_bytes);
     printf("Success: started IP server on protocol %u\n", protocol);
-    event_queue_init(&queue);
-    sock_ip_event_init(&server_sock, &queue, _ip_recv, "test");
-    event_loop(&queue);
+    evq_init(&_evq, "ip_server");
+    evq_ip_event_init(&_evq, &server_sock, _ip_recv, "test", "recv");
+    evq_loop(&_evq);
     return NULL;
 }
 
@@ -141,7 +152,7 @@ static int ip_send(char *addr_str, char *port_str, char *data, unsigned int num,
 
 static int ip_start_server(char *port_str)
 {
-    if (thread_create(server_stack, sizeof(server_stack), THREAD_PRIORITY_MAIN - 1,
+    if (thread_create(server_stack, sizeof(server_stack), PRIO_IP,
                       THREAD_CREATE_STACKTEST, _server_thread, port_str,
                       "IP server") <= KERNEL_PID_UNDEF) {
         return 1;
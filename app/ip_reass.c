@@ -0,0 +1,416 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Memory-bounded IPv4 reassembly in front of lwIP
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ip_reass.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "net/sock/udp.h"
+#include "netdev_hook.h"
+#include "xtimer.h"
+
+#ifdef MODULE_LWIP_IPV6
+#include "net/ipv6.h"
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#include "net/ipv4.h"
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#define ETH_HDR_LEN         (14U)
+#define ETH_TYPE_IPV4       (0x0800U)
+#define ETH_TYPE_VLAN       (0x8100U)
+#define VLAN_TAG_LEN        (4U)
+#define IP_HDR_MAX          (60U)
+#define IP_MF               (0x2000U)
+#define IP_OFFMASK          (0x1fffU)
+
+typedef struct {
+    uint16_t start;
+    uint16_t end;
+} _range_t;
+
+typedef struct {
+    uint8_t src[4];
+    uint8_t dst[4];
+    uint16_t id;
+    uint8_t proto;
+    uint8_t used;
+    uint8_t nranges;
+    uint8_t hdr_len;            /* 0 until the first fragment arrived */
+    uint8_t link_len;           /* Ethernet header with the tag, if any */
+    uint16_t total;             /* 0 until the last fragment arrived */
+    uint32_t started;
+    _range_t ranges[IP_REASS_RANGES];
+    uint8_t hdr[ETH_HDR_LEN + VLAN_TAG_LEN + IP_HDR_MAX];
+    uint8_t data[IP_REASS_MAX_PAYLOAD];
+} _slot_t;
+
+static _slot_t _slots[IP_REASS_SLOTS];
+static ip_reass_stats_t _stats;
+static netdev_hook_t _hook;
+
+static inline uint16_t _get16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static inline void _set16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+/* merge [start, end) into the sorted, disjoint range list */
+static int _add_range(_slot_t *slot, uint16_t start, uint16_t end)
+{
+    unsigned i = 0, j = 0;
+
+    for (; i < slot->nranges; i++) {
+        _range_t *r = &slot->ranges[i];
+
+        if ((r->end < start) || (end < r->start)) {
+            /* disjoint, keep */
+            slot->ranges[j++] = *r;
+            continue;
+        }
+        if (r->start < start) {
+            start = r->start;
+        }
+        if (r->end > end) {
+            end = r->end;
+        }
+    }
+    if (j == IP_REASS_RANGES) {
+        return -1;
+    }
+    /* insert sorted */
+    for (i = j; (i > 0) && (slot->ranges[i - 1].start > start); i--) {
+        slot->ranges[i] = slot->ranges[i - 1];
+    }
+    slot->ranges[i].start = start;
+    slot->ranges[i].end = end;
+    slot->nranges = j + 1;
+    return 0;
+}
+
+static _slot_t *_slot_get(const uint8_t *ip, uint32_t now)
+{
+    uint16_t id = _get16(ip + 4);
+    _slot_t *free_slot = NULL, *oldest = NULL;
+
+    for (unsigned i = 0; i < IP_REASS_SLOTS; i++) {
+        _slot_t *slot = &_slots[i];
+
+        if (slot->used && ((now - slot->started) > IP_REASS_TIMEOUT_US)) {
+            slot->used = 0;
+            _stats.timeouts++;
+        }
+        if (!slot->used) {
+            free_slot = slot;
+            continue;
+        }
+        if ((slot->id == id) && (slot->proto == ip[9]) &&
+            (memcmp(slot->src, ip + 12, 4) == 0) &&
+            (memcmp(slot->dst, ip + 16, 4) == 0)) {
+            return slot;
+        }
+        if (!oldest || ((int32_t)(slot->started - oldest->started) < 0)) {
+            oldest = slot;
+        }
+    }
+    if (!free_slot) {
+        free_slot = oldest;
+        _stats.evicted++;
+    }
+    memcpy(free_slot->src, ip + 12, 4);
+    memcpy(free_slot->dst, ip + 16, 4);
+    free_slot->id = id;
+    free_slot->proto = ip[9];
+    free_slot->used = 1;
+    free_slot->nranges = 0;
+    free_slot->hdr_len = 0;
+    free_slot->total = 0;
+    free_slot->started = now;
+    return free_slot;
+}
+
+static void _deliver(_slot_t *slot, uint32_t now)
+{
+    uint8_t *ip = slot->hdr + slot->link_len;
+    unsigned ihl = slot->hdr_len - slot->link_len;
+    struct netif *netif = netdev_hook_netif();
+    struct pbuf *p;
+    uint16_t sum;
+
+    slot->used = 0;
+    /* rewrite the first fragment's header into that of the whole datagram */
+    _set16(ip + 2, ihl + slot->total);
+    _set16(ip + 6, 0);
+    _set16(ip + 10, 0);
+    sum = inet_chksum(ip, ihl);
+    memcpy(ip + 10, &sum, sizeof(sum));
+
+    p = pbuf_alloc(PBUF_RAW, slot->hdr_len + slot->total, PBUF_POOL);
+    if (p == NULL) {
+        _stats.dropped++;
+        return;
+    }
+    pbuf_take_at(p, slot->hdr, slot->hdr_len, 0);
+    pbuf_take_at(p, slot->data, slot->total, slot->hdr_len);
+    if (netif->input(p, netif) != ERR_OK) {
+        pbuf_free(p);
+        _stats.dropped++;
+        return;
+    }
+    _stats.datagrams++;
+    if ((now - slot->started) > _stats.max_time_us) {
+        _stats.max_time_us = now - slot->started;
+    }
+}
+
+static int _rx(netdev_hook_t *hook, netdev_t *dev, uint8_t *frame, size_t len)
+{
+    unsigned link_len = ETH_HDR_LEN;
+    unsigned ihl, tot_len, frag, start, end;
+    uint32_t now;
+    uint8_t *ip;
+    _slot_t *slot;
+
+    (void)hook;
+    (void)dev;
+
+    /* fragments on a VLAN sub-interface carry one 802.1Q tag, it stays in
+     * the stored header so the reassembled frame takes the same path */
+    if ((len >= ETH_HDR_LEN + VLAN_TAG_LEN) &&
+        (_get16(frame + 12) == ETH_TYPE_VLAN)) {
+        link_len += VLAN_TAG_LEN;
+    }
+    if ((len < link_len + 20) ||
+        (_get16(frame + link_len - 2) != ETH_TYPE_IPV4)) {
+        return len;
+    }
+    ip = frame + link_len;
+    frag = _get16(ip + 6);
+    if (!(frag & (IP_MF | IP_OFFMASK))) {
+        return len;
+    }
+    ihl = (ip[0] & 0x0f) * 4;
+    tot_len = _get16(ip + 2);
+    if ((ihl < 20) || (tot_len < ihl) || ((link_len + tot_len) > len)) {
+        /* malformed, let lwIP count it */
+        return len;
+    }
+    _stats.fragments++;
+    now = xtimer_now_usec();
+    start = (frag & IP_OFFMASK) * 8;
+    end = start + (tot_len - ihl);
+    slot = _slot_get(ip, now);
+    if ((end > IP_REASS_MAX_PAYLOAD) ||
+        (slot->total && (end > slot->total)) ||
+        (_add_range(slot, start, end) < 0)) {
+        slot->used = 0;
+        _stats.dropped++;
+        return 0;
+    }
+    memcpy(slot->data + start, ip + ihl, end - start);
+    if (start == 0) {
+        slot->link_len = link_len;
+        slot->hdr_len = link_len + ihl;
+        memcpy(slot->hdr, frame, slot->hdr_len);
+    }
+    if (!(frag & IP_MF)) {
+        slot->total = end;
+    }
+    if (slot->hdr_len && slot->total && (slot->nranges == 1) &&
+        (slot->ranges[0].start == 0) && (slot->ranges[0].end == slot->total)) {
+        _deliver(slot, now);
+    }
+    return 0;
+}
+
+void ip_reass_init(void)
+{
+    _hook.rx = _rx;
+    netdev_hook_add(&_hook);
+}
+
+const ip_reass_stats_t *ip_reass_stats(void)
+{
+    return &_stats;
+}
+
+#ifdef MODULE_SOCK_UDP
+/* kept apart from the slots so the benchmark can't disturb reassembly */
+static uint8_t _bench_buf[IP_REASS_MAX_PAYLOAD];
+
+static int _parse_ep(sock_udp_ep_t *ep, char *addr_str, char *port_str)
+{
+    *ep = (sock_udp_ep_t)SOCK_IP_EP_ANY;
+    if (addr_str != NULL) {
+#ifdef MODULE_LWIP_IPV6
+        if (ipv6_addr_from_str((ipv6_addr_t *)&ep->addr.ipv6, addr_str) == NULL) {
+#else
+        if (ipv4_addr_from_str((ipv4_addr_t *)&ep->addr.ipv4, addr_str) == NULL) {
+#endif
+            puts("Error: unable to parse destination address");
+            return 1;
+        }
+    }
+    ep->port = atoi(port_str);
+    return 0;
+}
+
+static void _print_rate(const char *what, uint32_t num, uint64_t bytes,
+                        uint32_t duration)
+{
+    if (duration == 0) {
+        duration = 1;
+    }
+    printf("%s %" PRIu32 " datagrams, %" PRIu32 " byte in %" PRIu32 " ms: "
+           "%" PRIu32 " datagrams/s, %.4f Mbps\n", what, num, (uint32_t)bytes,
+           duration / US_PER_MS,
+           (uint32_t)(((uint64_t)num * US_PER_SEC) / duration),
+           (float)bytes * 8 / duration);
+}
+
+static int reass_send(char *addr_str, char *port_str, size_t size,
+                      unsigned num, unsigned delay)
+{
+    sock_udp_ep_t dst;
+    uint32_t start, errors = 0;
+    uint64_t bytes = 0;
+
+    if (_parse_ep(&dst, addr_str, port_str)) {
+        return 1;
+    }
+    if (size > (IP_REASS_MAX_PAYLOAD - 8)) {
+        printf("error: size must not exceed %u\n", IP_REASS_MAX_PAYLOAD - 8);
+        return 1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        _bench_buf[i] = i;
+    }
+    start = xtimer_now_usec();
+    for (unsigned i = 0; i < num; i++) {
+        if (sock_udp_send(NULL, _bench_buf, size, &dst) < 0) {
+            errors++;
+        }
+        else {
+            bytes += size;
+        }
+        if (delay) {
+            xtimer_usleep(delay);
+        }
+    }
+    _print_rate("sent", num - errors, bytes, xtimer_now_usec() - start);
+    if (errors) {
+        printf("%" PRIu32 " datagrams could not be sent\n", errors);
+    }
+    return 0;
+}
+
+static int reass_recv(char *port_str, unsigned seconds)
+{
+    sock_udp_ep_t local;
+    sock_udp_t sock;
+    ip_reass_stats_t before = _stats;
+    uint32_t start, last = 0, num = 0;
+    uint64_t bytes = 0;
+    int res;
+
+    if (_parse_ep(&local, NULL, port_str)) {
+        return 1;
+    }
+    if ((res = sock_udp_create(&sock, &local, NULL, 0)) < 0) {
+        printf("Unable to open UDP sock (error code %d)\n", -res);
+        return 1;
+    }
+    printf("Receiving on UDP port %u for %u s\n", local.port, seconds);
+    start = xtimer_now_usec();
+    while ((xtimer_now_usec() - start) < (seconds * US_PER_SEC)) {
+        ssize_t n = sock_udp_recv(&sock, _bench_buf, sizeof(_bench_buf),
+                                  100 * US_PER_MS, NULL);
+        if (n >= 0) {
+            if (num == 0) {
+                start = xtimer_now_usec();
+            }
+            num++;
+            bytes += n;
+            last = xtimer_now_usec();
+        }
+    }
+    sock_udp_close(&sock);
+    _print_rate("received", num, bytes, last - start);
+    printf("reassembly: %" PRIu32 " fragments, %" PRIu32 " datagrams, "
+           "%" PRIu32 " timeouts, %" PRIu32 " evicted, %" PRIu32 " dropped\n",
+           _stats.fragments - before.fragments,
+           _stats.datagrams - before.datagrams,
+           _stats.timeouts - before.timeouts,
+           _stats.evicted - before.evicted,
+           _stats.dropped - before.dropped);
+    return 0;
+}
+#endif
+
+int reass_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("Reassembly: %u slots of %u byte, timeout %" PRIu32 " ms\n",
+               IP_REASS_SLOTS, IP_REASS_MAX_PAYLOAD,
+               (uint32_t)(IP_REASS_TIMEOUT_US / US_PER_MS));
+        printf("%" PRIu32 " fragments, %" PRIu32 " datagrams, %" PRIu32
+               " timeouts, %" PRIu32 " evicted, %" PRIu32 " dropped, "
+               "max %" PRIu32 " us\n", _stats.fragments, _stats.datagrams,
+               _stats.timeouts, _stats.evicted, _stats.dropped,
+               _stats.max_time_us);
+        return 0;
+    }
+    if (strcmp(argv[1], "reset") == 0) {
+        memset(&_stats, 0, sizeof(_stats));
+        return 0;
+    }
+#ifdef MODULE_SOCK_UDP
+    else if (strcmp(argv[1], "send") == 0) {
+        if (argc < 6) {
+            printf("usage: %s send <addr> <port> <size> <num> [<delay in us>]\n",
+                   argv[0]);
+            return 1;
+        }
+        return reass_send(argv[2], argv[3], atoi(argv[4]), atoi(argv[5]),
+                          (argc > 6) ? atoi(argv[6]) : 0);
+    }
+    else if (strcmp(argv[1], "recv") == 0) {
+        if (argc < 4) {
+            printf("usage: %s recv <port> <seconds>\n", argv[0]);
+            return 1;
+        }
+        return reass_recv(argv[2], atoi(argv[3]));
+    }
+#endif
+    else {
+        printf("usage: %s [reset|send|recv]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
@@ -0,0 +1,88 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Memory-bounded IPv4 reassembly in front of lwIP
+ *
+ * Fragments are taken out of the RX path before lwIP sees them and copied
+ * into one of @ref IP_REASS_SLOTS preallocated datagram buffers. Per slot
+ * only the received byte ranges are tracked, so the memory use is fixed at
+ * compile time no matter how fragments arrive. A completed datagram is
+ * handed to lwIP as a single unfragmented packet.
+ * @}
+ */
+#ifndef IP_REASS_H
+#define IP_REASS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef IP_REASS_SLOTS
+#define IP_REASS_SLOTS          (2U)        /**< datagrams in reassembly */
+#endif
+#ifndef IP_REASS_MAX_PAYLOAD
+#define IP_REASS_MAX_PAYLOAD    (8192U)     /**< largest IP payload accepted */
+#endif
+#ifndef IP_REASS_RANGES
+#define IP_REASS_RANGES         (8U)        /**< disjoint ranges per slot */
+#endif
+#ifndef IP_REASS_TIMEOUT_US
+#define IP_REASS_TIMEOUT_US     (2000000UL) /**< give up on a datagram */
+#endif
+/** @} */
+
+/**
+ * @brief   Reassembly statistics
+ */
+typedef struct {
+    uint32_t fragments;         /**< fragments received */
+    uint32_t datagrams;         /**< datagrams reassembled */
+    uint32_t timeouts;          /**< datagrams dropped on timeout */
+    uint32_t evicted;           /**< datagrams dropped for a newer one */
+    uint32_t dropped;           /**< fragments dropped (size, ranges, pbuf) */
+    uint32_t max_time_us;       /**< longest first-to-last fragment time */
+} ip_reass_stats_t;
+
+/**
+ * @brief   Register the reassembly hook
+ *
+ * @pre     @ref netdev_hook_init was called
+ */
+void ip_reass_init(void);
+
+/**
+ * @brief   Get the reassembly statistics
+ */
+const ip_reass_stats_t *ip_reass_stats(void);
+
+/**
+ * @brief   Reassembly shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int reass_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IP_REASS_H */
+/** @} */
@@ -1,7 +1,16 @@
 #include "net/sock/tcp.h"
 #include <lwip/sockets.h>
+#include "byteorder.h"
 #include "xtimer.h"
+#include "metrics.h"
+#include "nvconf.h"
+#include "prio.h"
+#include "stream.h"
+#include "thread.h"
+#include "wallclock.h"
 #define SOCK_QUEUE_LEN (1U)
+/* producer poll period while the stream has no collector, in us */
+#define IPREF_IDLE_US (10U * US_PER_MS)
 
 sock_tcp_t sock_queue[SOCK_QUEUE_LEN];
 uint8_t buf[2 * 1024];
@@ -72,66 +81,98 @@ int test_tcp_server(void) //speed:23.0 Mbits/sec
     return 0;
 }
 
+static char producer_stack[THREAD_STACKSIZE_DEFAULT + THREAD_EXTRA_STACKSIZE_PRINTF];
+
+/* stream_write() blocks while the collector lags, in us */
+static const uint32_t write_bounds[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+static uint32_t write_buckets[ARRAY_SIZE(write_bounds) + 1];
+static metrics_metric_t ipref_metrics[] = {
+    METRICS_COUNTER("ipref_sent_bytes_total", "Record bytes queued by the producer"),
+    METRICS_HISTOGRAM("ipref_write_duration_us", "Time spent in stream_write",
+                      write_bounds, write_buckets),
+};
+
+static void *_producer(void *arg)
+{
+    (void)arg;
+    uint64_t sentlen = 0;
+    uint32_t tick1 = xtimer_now_usec(), tick2 = 0;
+
+    while (1)
+    {
+        /* without a collector records would only overwrite each other,
+         * and spinning here starves every thread below PRIO_BULK */
+        if (!stream_connected())
+        {
+            xtimer_usleep(IPREF_IDLE_US);
+            tick1 = xtimer_now_usec();
+            sentlen = 0;
+            continue;
+        }
+        tick2 = xtimer_now_usec();
+        if (tick2 - tick1 >= 2000 * 1000)
+        {
+            float f = (float)sentlen * 8 * 1000 * 1000 / 1024 / 1024 / (tick2 - tick1);
+            printf("send speed = %.4f Mbps!\r\n", f);
+            tick1 = tick2;
+            sentlen = 0;
+        }
+        /* blocks while the collector lags behind */
+        uint32_t start = xtimer_now_usec();
+        /* wall clock stamp for one-way delays, 0 until synchronized */
+        network_uint64_t stamp = byteorder_htonll(wallclock_now(NULL));
+        memcpy(buf, &stamp, sizeof(stamp));
+        if (stream_write(buf, STREAM_RECORD_MAX) > 0)
+        {
+            sentlen += STREAM_RECORD_MAX;
+            metrics_add(&ipref_metrics[0], STREAM_RECORD_MAX);
+        }
+        metrics_observe(&ipref_metrics[1], xtimer_now_usec() - start);
+    }
+    return NULL;
+}
+
 int test_tcp_client(void)//16.2855 Mbps
 {
     int res;
     sock_tcp_ep_t remote = SOCK_IPV4_EP_ANY;
     remote.port = 12344;
 
-    uint64_t sentlen = 0;
-    uint32_t tick1 = 0, tick2 = 0;
     // for (int i = 0; i < 4 * 1024; i++)
     // {
     //     buf[i] = i & 0xff;
     // }
     memset(buf, 97, sizeof(buf));
 
-    ipv4_addr_from_str((ipv4_addr_t *)&remote.addr,
-                       "192.168.1.102");
-    if (sock_tcp_connect(&sock, &remote, 0, 0) < 0)
+    const nvconf_net_t *net = &nvconf_get()->net;
+    if (net->flags & NVCONF_NET_PEER)
     {
-        puts("Error connecting sock");
-        return 1;
+        /* fast start: collector stored in flash */
+        memcpy(&remote.addr.ipv4, net->peer, sizeof(net->peer));
+        remote.port = net->peer_port;
     }
-    puts("Sending \"Hello!\"");
-    if ((res = sock_tcp_write(&sock, "Hello!", sizeof("Hello!"))) < 0)
+    else
     {
-        puts("Errored on write");
+        ipv4_addr_from_str((ipv4_addr_t *)&remote.addr,
+                           "192.168.1.102");
     }
-    else
+    sock_tcp_ep_t standby = SOCK_IPV4_EP_ANY;
+    if (net->flags & NVCONF_NET_STANDBY)
     {
-        tick1 = xtimer_now_usec();
-        while (1)
-        {
-            tick2 = xtimer_now_usec();
-            if (tick2 - tick1 >= 2000 * 1000)
-            {
-                float f = (float)sentlen * 8 * 1000 * 1000 / 1024 / 1024 / (tick2 - tick1);
-                printf("send speed = %.4f Mbps!\r\n", f);
-                tick1 = tick2;
-                sentlen = 0;
-            }
-            if ((res = sock_tcp_write(&sock, buf, sizeof(buf))) < 0)
-            {
-                puts("Errored on write");
-                break;
-            }
-            else{
-                sentlen += sizeof(buf);
-            }
-        }
-        // if ((res = sock_tcp_read(&sock, &buf, sizeof(buf),
-        //                          SOCK_NO_TIMEOUT)) < 0)
-        // {
-        //     puts("Disconnected");
-        // }
-        // printf("Read: \"");
-        // for (int i = 0; i < res; i++)
-        // {
-        //     printf("%c", buf[i]);
-        // }
-        // puts("\"");
+        memcpy(&standby.addr.ipv4, net->standby, sizeof(net->standby));
+        standby.port = net->standby_port;
+    }
+    /* the stream reconnects and replays on its own, see stream.h */
+    if ((res = stream_start(&remote, (net->flags & NVCONF_NET_STANDBY) ? &standby : NULL)) < 0)
+    {
+        puts("Error starting stream");
+        return 1;
     }
-    sock_tcp_disconnect(&sock);
-    return res;
-}
\ No newline at end of file
+    for (unsigned i = 0; i < ARRAY_SIZE(ipref_metrics); i++)
+    {
+        metrics_register(&ipref_metrics[i]);
+    }
+    thread_create(producer_stack, sizeof(producer_stack), PRIO_BULK,
+                  THREAD_CREATE_STACKTEST, _producer, NULL, "producer");
+    return 0;
+}
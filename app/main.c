@@ -22,15 +22,39 @@
 #include <errno.h>
 #include <stdio.h>
 
+#include "arp.h"
+#include "boottime.h"
+#include "coap.h"
 #include "common.h"
+#include "ctrl.h"
+#include "evq.h"
+#include "fwup.h"
+#include "http.h"
+#include "ip_reass.h"
 #include "lwip.h"
 #include "lwip/netif.h"
+#include "mcast.h"
+#include "metrics.h"
 #if LWIP_IPV4
 #include "net/ipv6/addr.h"
 #else
 #include "net/ipv4/addr.h"
 #endif
+#include "netdev_hook.h"
+#include "nvconf.h"
+#include "owd.h"
+#include "phy.h"
+#include "prio.h"
+#include "ptp_slave.h"
+#include "qos.h"
+#include "rsh.h"
+#include "rxfilter.h"
 #include "shell.h"
+#include "storm.h"
+#include "stream.h"
+#include "tls.h"
+#include "vlan.h"
+#include "wallclock.h"
 
 static int ifconfig(int argc, char **argv)
 {
@@ -52,6 +76,9 @@ static int ifconfig(int argc, char **argv)
         printf(" inet %s\n", ipv4_addr_to_str(addrstr, (ipv4_addr_t *)&iface->ip_addr,
                                               sizeof(addrstr)));
 #endif
+        if (iface == netdev_hook_netif()) {
+            phy_print_status();
+        }
         puts("");
     }
     return 0;
@@ -63,30 +90,90 @@ static const shell_command_t shell_commands[] = {
 #endif
 #ifdef MODULE_SOCK_TCP
     { "tcp", "Send TCP messages and listen for messages on TCP port", tcp_cmd },
+    { "stream", "Resilient record stream to the collector", stream_cmd },
+    { "http", "Start the HTTP server and show its statistics", http_cmd },
 #endif
 #ifdef MODULE_SOCK_UDP
     { "udp", "Send UDP messages and listen for messages on UDP port", udp_cmd },
+    { "rudp", "Reliable bulk transfer over UDP, compared against TCP", rudp_cmd },
+    { "mcast", "Multicast groups and multicast versus unicast benchmark", mcast_cmd },
+    { "coap", "CoAP server with Observe and block-wise transfer", coap_cmd },
+    { "owd", "One-way delay probes and receiver", owd_cmd },
+#endif
+#ifdef MODULE_WOLFSSL
+    { "tls", "TLS and DTLS servers and handshake benchmark", tls_cmd },
 #endif
     { "ifconfig", "Shows assigned IPv6 addresses", ifconfig },
+    { "nethook", "Frame hook statistics and loss emulation", nethook_cmd },
+    { "boot", "Show the boot timeline and set the fast start configuration", boot_cmd },
+    { "phy", "Show the PHY link status and access PHY registers", phy_cmd },
+    { "arp", "Manage static ARP entries and show ARP statistics", arp_cmd },
+    { "reass", "IPv4 reassembly statistics and large datagram benchmark", reass_cmd },
+    { "qos", "Transmit queue statistics and latency under load benchmark", qos_cmd },
+    { "vlan", "Manage 802.1Q VLAN sub-interfaces", vlan_cmd },
+    { "filter", "MAC address filter and RX early-drop rules", filter_cmd },
+    { "storm", "Storm protection budgets and CPU starvation benchmark", storm_cmd },
+    { "metrics", "Show metrics and start the Prometheus exporter", metrics_cmd },
+    { "fwup", "Firmware update receiver into the flash staging area", fwup_cmd },
+    { "rsh", "Remote shell statistics", rsh_cmd },
+    { "wallclock", "SNTP client and disciplined wall clock", wallclock_cmd },
+    { "ptp", "IEEE 1588 slave clock and offset statistics", ptp_cmd },
+    { "prio", "Thread priority plan and scheduling latency benchmark", prio_cmd },
+    { "evq", "Event queue latency, depth and handler statistics", evq_cmd },
     { NULL, NULL, NULL }
 };
 
 static char line_buf[SHELL_DEFAULT_BUFSIZE];
+#ifdef MODULE_STM32_ETH
 extern void stm32_eth_get_mac(char *out);
+#endif
 extern int test_tcp_client(void);
 int main(void)
 {
+    boottime_mark(BOOTTIME_MAIN);
     puts("RIOT lwip test application");
+    prio_init();
+
+    if (netdev_hook_init() < 0) {
+        puts("Error: no Ethernet interface to hook");
+    }
+    rxfilter_init();
+    storm_init();
+    ip_reass_init();
+    if (nvconf_load() < 0) {
+        puts("No stored configuration, using defaults");
+    }
+    if (boottime_init()) {
+        puts("Fast start: using stored IP configuration");
+    }
+    arp_init();
+    phy_init();
+    qos_init();
+    vlan_init();
+    mcast_init();
 
+#ifdef MODULE_STM32_ETH
     uint8_t mac_addr[6] = {0};
     stm32_eth_get_mac((char *)mac_addr);
+    boottime_mark(BOOTTIME_MAC);
     printf("get mac addr is :\r\n");
     for(int i = 0; i < 6; i++)
     {
         printf("%02x ", mac_addr[i]);
     }
     printf("\r\n");
+#endif
     test_tcp_client();
+#if RSH_AUTOSTART
+    if (rsh_start(RSH_PORT, shell_commands) == 0) {
+        printf("Remote shell on port %u\n", RSH_PORT);
+    }
+#endif
+#if CTRL_AUTOSTART
+    if (ctrl_start(CTRL_PORT, shell_commands) == 0) {
+        printf("Control channel on port %u\n", CTRL_PORT);
+    }
+#endif
 
     shell_run(shell_commands, line_buf, SHELL_DEFAULT_BUFSIZE);
 
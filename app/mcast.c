@@ -0,0 +1,335 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       IPv4 multicast for UDP socks
+ * @}
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/api.h"
+#include "lwip/igmp.h"
+#include "lwip/netif.h"
+#include "lwip/tcpip.h"
+#include "lwip/udp.h"
+#include "mcast.h"
+#include "net/ipv4.h"
+#include "netdev_hook.h"
+#include "xtimer.h"
+
+#if LWIP_IGMP
+#define BENCH_INTERVAL_US   (1000U)
+#define BENCH_SIZE_MAX      (512U)
+
+typedef struct {
+    ipv4_addr_t group;
+    unsigned refs;          /* 0 marks a free entry */
+} _group_t;
+
+typedef struct {
+    sock_udp_t *sock;
+    unsigned groups;        /* 0 marks a free entry */
+} _member_t;
+
+static _group_t _groups[MCAST_GROUPS];
+static _member_t _members[MCAST_GROUPS];
+
+void mcast_init(void)
+{
+    struct netif *netif = netdev_hook_netif();
+
+    if (netif == NULL) {
+        return;
+    }
+    LOCK_TCPIP_CORE();
+    if (!(netif->flags & NETIF_FLAG_IGMP)) {
+        /* the netdev glue doesn't set the flag, start IGMP by hand */
+        netif->flags |= NETIF_FLAG_IGMP;
+        igmp_start(netif);
+    }
+    UNLOCK_TCPIP_CORE();
+}
+
+static void _set_netif(sock_udp_t *sock, struct netif *netif)
+{
+#if LWIP_MULTICAST_TX_OPTIONS
+    struct netconn *conn = sock ? sock->base.conn : NULL;
+
+    if (conn && conn->pcb.udp) {
+        udp_set_multicast_netif_index(conn->pcb.udp,
+                                      netif ? netif_get_index(netif) : 0);
+        udp_set_multicast_ttl(conn->pcb.udp, MCAST_TTL);
+    }
+#else
+    (void)sock;
+    (void)netif;
+#endif
+}
+
+/* adds @p delta to the groups @p sock is in, returns the new number */
+static unsigned _member(sock_udp_t *sock, int delta)
+{
+    _member_t *free_entry = NULL;
+
+    for (unsigned i = 0; i < MCAST_GROUPS; i++) {
+        if (_members[i].groups && (_members[i].sock == sock)) {
+            _members[i].groups += delta;
+            return _members[i].groups;
+        }
+        if (!_members[i].groups && !free_entry) {
+            free_entry = &_members[i];
+        }
+    }
+    if ((delta > 0) && free_entry) {
+        free_entry->sock = sock;
+        free_entry->groups = delta;
+        return delta;
+    }
+    return 0;
+}
+
+static _group_t *_find(const ipv4_addr_t *group)
+{
+    for (unsigned i = 0; i < MCAST_GROUPS; i++) {
+        if (_groups[i].refs && ipv4_addr_equal(&_groups[i].group, group)) {
+            return &_groups[i];
+        }
+    }
+    return NULL;
+}
+
+int mcast_join(sock_udp_t *sock, const ipv4_addr_t *group)
+{
+    struct netif *netif = netdev_hook_netif();
+    ip4_addr_t addr;
+    _group_t *entry;
+    err_t err;
+
+    memcpy(&addr.addr, group, sizeof(addr.addr));
+    if (!ip4_addr_ismulticast(&addr)) {
+        return -EINVAL;
+    }
+    if (netif == NULL) {
+        return -ENODEV;
+    }
+    LOCK_TCPIP_CORE();
+    if ((err = igmp_joingroup_netif(netif, &addr)) == ERR_OK) {
+        if (sock) {
+            _set_netif(sock, netif);
+            _member(sock, 1);
+        }
+        if ((entry = _find(group)) == NULL) {
+            for (unsigned i = 0; !entry && (i < MCAST_GROUPS); i++) {
+                if (_groups[i].refs == 0) {
+                    entry = &_groups[i];
+                    entry->group = *group;
+                }
+            }
+        }
+        /* the table only feeds the shell, lwIP counts memberships itself */
+        if (entry) {
+            entry->refs++;
+        }
+    }
+    UNLOCK_TCPIP_CORE();
+    return (err == ERR_OK) ? 0 : -ENOMEM;
+}
+
+int mcast_leave(sock_udp_t *sock, const ipv4_addr_t *group)
+{
+    struct netif *netif = netdev_hook_netif();
+    ip4_addr_t addr;
+    _group_t *entry;
+    err_t err;
+
+    if (netif == NULL) {
+        return -ENODEV;
+    }
+    memcpy(&addr.addr, group, sizeof(addr.addr));
+    LOCK_TCPIP_CORE();
+    if ((err = igmp_leavegroup_netif(netif, &addr)) == ERR_OK) {
+        /* the sock may still send to its other groups */
+        if (sock && (_member(sock, -1) == 0)) {
+            _set_netif(sock, NULL);
+        }
+        if ((entry = _find(group)) != NULL) {
+            entry->refs--;
+        }
+    }
+    UNLOCK_TCPIP_CORE();
+    return (err == ERR_OK) ? 0 : -ENOENT;
+}
+
+static uint8_t _bench_buf[BENCH_SIZE_MAX];
+
+static int _parse_addr(ipv4_addr_t *addr, const char *str)
+{
+    if (ipv4_addr_from_str(addr, str) == NULL) {
+        printf("error: unable to parse IPv4 address %s\n", str);
+        return 1;
+    }
+    return 0;
+}
+
+/* sends num messages to n_dst endpoints each, returns the time spent in
+ * sock_udp_send() */
+static uint32_t _bench_run(sock_udp_t *sock, sock_udp_ep_t *dst,
+                           unsigned n_dst, unsigned num, size_t size,
+                           uint32_t *errors)
+{
+    uint16_t port = dst->port;
+    uint32_t busy = 0;
+
+    for (unsigned i = 0; i < num; i++) {
+        uint32_t start = xtimer_now_usec();
+
+        for (unsigned j = 0; j < n_dst; j++) {
+            dst->port = port + j;
+            if (sock_udp_send(sock, _bench_buf, size, dst) < 0) {
+                (*errors)++;
+            }
+        }
+        busy += xtimer_now_usec() - start;
+        xtimer_usleep(BENCH_INTERVAL_US);
+    }
+    dst->port = port;
+    return busy;
+}
+
+static int mcast_bench(int argc, char **argv)
+{
+    sock_udp_ep_t local = SOCK_IPV4_EP_ANY;
+    sock_udp_ep_t group = SOCK_IPV4_EP_ANY;
+    sock_udp_ep_t unicast = SOCK_IPV4_EP_ANY;
+    uint32_t uc_us, mc_us, uc_err = 0, mc_err = 0;
+    unsigned n, num;
+    size_t size = 64;
+    sock_udp_t sock;
+    int res;
+
+    if (argc < 7) {
+        printf("usage: %s bench <group> <host addr> <port> <collectors> <num> "
+               "[<size>]\n", argv[0]);
+        return 1;
+    }
+    if (_parse_addr((ipv4_addr_t *)&group.addr.ipv4, argv[2]) ||
+        _parse_addr((ipv4_addr_t *)&unicast.addr.ipv4, argv[3])) {
+        return 1;
+    }
+    group.port = atoi(argv[4]);
+    /* the collectors listen on the ports following the group port */
+    unicast.port = group.port + 1;
+    n = atoi(argv[5]);
+    num = atoi(argv[6]);
+    if (argc > 7) {
+        size = MIN((size_t)atoi(argv[7]), sizeof(_bench_buf));
+    }
+    if ((n == 0) || (num == 0)) {
+        puts("error: need at least one collector and one message");
+        return 1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        _bench_buf[i] = i;
+    }
+    if ((res = sock_udp_create(&sock, &local, NULL, 0)) < 0) {
+        printf("Unable to open UDP sock (error code %d)\n", -res);
+        return 1;
+    }
+    _set_netif(&sock, netdev_hook_netif());
+    uc_us = _bench_run(&sock, &unicast, n, num, size, &uc_err);
+    mc_us = _bench_run(&sock, &group, 1, num, size, &mc_err);
+    sock_udp_close(&sock);
+    printf("unicast x%u: %" PRIu32 " us/message, %u datagrams, %" PRIu32
+           " errors\n", n, uc_us / num, n * num, uc_err);
+    printf("multicast:  %" PRIu32 " us/message, %u datagrams, %" PRIu32
+           " errors\n", mc_us / num, num, mc_err);
+    if (uc_us) {
+        printf("multicast saves %" PRIu32 " %% of the send CPU time\n",
+               (uint32_t)((uc_us > mc_us) ?
+                          ((uint64_t)(uc_us - mc_us) * 100) / uc_us : 0));
+    }
+    return 0;
+}
+
+int mcast_cmd(int argc, char **argv)
+{
+    ipv4_addr_t group;
+    int res;
+
+    if (argc < 2) {
+        char addr_str[IPV4_ADDR_MAX_STR_LEN];
+
+        for (unsigned i = 0; i < MCAST_GROUPS; i++) {
+            if (_groups[i].refs) {
+                printf("%s: %u members\n",
+                       ipv4_addr_to_str(addr_str, &_groups[i].group,
+                                        sizeof(addr_str)), _groups[i].refs);
+            }
+        }
+        return 0;
+    }
+    else if (strcmp(argv[1], "bench") == 0) {
+        return mcast_bench(argc, argv);
+    }
+    else if ((strcmp(argv[1], "join") == 0) ||
+             (strcmp(argv[1], "leave") == 0)) {
+        if (argc < 3) {
+            printf("usage: %s %s <group>\n", argv[0], argv[1]);
+            return 1;
+        }
+        if (_parse_addr(&group, argv[2])) {
+            return 1;
+        }
+        res = (argv[1][0] == 'j') ? mcast_join(NULL, &group)
+                                  : mcast_leave(NULL, &group);
+        if (res < 0) {
+            printf("error: unable to %s %s (error code %d)\n", argv[1],
+                   argv[2], -res);
+            return 1;
+        }
+        return 0;
+    }
+    else {
+        printf("usage: %s [join|leave|bench]\n", argv[0]);
+        return 1;
+    }
+}
+#else
+void mcast_init(void)
+{
+}
+
+int mcast_join(sock_udp_t *sock, const ipv4_addr_t *group)
+{
+    (void)sock;
+    (void)group;
+    return -ENOTSUP;
+}
+
+int mcast_leave(sock_udp_t *sock, const ipv4_addr_t *group)
+{
+    (void)sock;
+    (void)group;
+    return -ENOTSUP;
+}
+
+int mcast_cmd(int argc, char **argv)
+{
+    (void)argc;
+    printf("%s: lwIP was built without IGMP\n", argv[0]);
+    return 1;
+}
+#endif
+
+/** @} */
@@ -0,0 +1,90 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       IPv4 multicast for UDP socks
+ *
+ * Group membership is kept by lwIP's IGMP per interface. Joining through a
+ * sock also makes the Ethernet interface the multicast output interface of
+ * that sock, so a sock can subscribe to and publish on the same group.
+ * Datagrams to a group are received by every sock bound to the group port
+ * with an unspecified local address.
+ * @}
+ */
+#ifndef MCAST_H
+#define MCAST_H
+
+#include <stdint.h>
+
+#include "net/ipv4/addr.h"
+#include "net/sock/udp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef MCAST_GROUPS
+#define MCAST_GROUPS            (8U)        /**< groups tracked for the shell */
+#endif
+#ifndef MCAST_TTL
+#define MCAST_TTL               (1U)        /**< TTL of published datagrams */
+#endif
+/** @} */
+
+/**
+ * @brief   Enable IGMP on the Ethernet interface
+ */
+void mcast_init(void);
+
+/**
+ * @brief   Join multicast group @p group
+ *
+ * @param[in] sock      sock to publish on the group with, may be NULL
+ * @param[in] group     group address
+ *
+ * @return  0 on success
+ * @return  -EINVAL if @p group is no multicast address
+ * @return  -ENODEV if there is no Ethernet interface
+ * @return  -ENOMEM if lwIP has no memory for another group
+ */
+int mcast_join(sock_udp_t *sock, const ipv4_addr_t *group);
+
+/**
+ * @brief   Leave multicast group @p group
+ *
+ * @param[in] sock      sock given to @ref mcast_join, may be NULL
+ * @param[in] group     group address
+ *
+ * @return  0 on success
+ * @return  -ENOENT if the group was not joined
+ */
+int mcast_leave(sock_udp_t *sock, const ipv4_addr_t *group);
+
+/**
+ * @brief   Multicast shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int mcast_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MCAST_H */
+/** @} */
@@ -0,0 +1,329 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Metrics registry and Prometheus exporter
+ * @}
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/api.h"
+#include "metrics.h"
+#include "mutex.h"
+#include "net/sock/tcp.h"
+#include "prio.h"
+#include "thread.h"
+#include "xtimer.h"
+
+#ifdef MODULE_LWIP_IPV6
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#define REQ_SIZE            (128U)
+
+typedef struct {
+    sock_tcp_t *sock;           /* NULL writes to stdout */
+    size_t fill;
+    int res;
+    char buf[METRICS_CHUNK_SIZE];
+} _out_t;
+
+static metrics_metric_t *_head;
+static metrics_metric_t **_tail = &_head;
+static unsigned _numof;
+static mutex_t _lock = MUTEX_INIT;
+
+static const uint32_t _scrape_bounds[] = { 1000, 2000, 5000, 10000, 20000,
+                                           50000, 100000 };
+static uint32_t _scrape_buckets[ARRAY_SIZE(_scrape_bounds) + 1];
+static metrics_metric_t _scrapes = METRICS_COUNTER(
+    "metrics_scrapes_total", "Scrapes answered");
+static metrics_metric_t _scrape_us = METRICS_HISTOGRAM(
+    "metrics_scrape_duration_us", "Time to format and send a scrape",
+    _scrape_bounds, _scrape_buckets);
+
+int metrics_register(metrics_metric_t *m)
+{
+    int res = 0;
+
+    mutex_lock(&_lock);
+    if ((m->next != NULL) || (_tail == &m->next)) {
+        res = -EALREADY;
+    }
+    else if ((m->type == METRICS_TYPE_HISTOGRAM) &&
+             (m->numof > METRICS_BUCKETS_MAX)) {
+        res = -EINVAL;
+    }
+    else if (_numof >= METRICS_NUMOF) {
+        res = -ENOMEM;
+    }
+    else {
+        *_tail = m;
+        _tail = &m->next;
+        _numof++;
+    }
+    mutex_unlock(&_lock);
+    return res;
+}
+
+/* metrics are only ever appended, so walking the list needs no lock */
+const metrics_metric_t *metrics_next(const metrics_metric_t *m)
+{
+    return m ? m->next : _head;
+}
+
+void metrics_observe(metrics_metric_t *m, uint32_t value)
+{
+    unsigned i = 0;
+
+    while ((i < m->numof) && (value > m->bounds[i])) {
+        i++;
+    }
+    m->buckets[i]++;
+    m->sum += value;
+    m->count++;
+}
+
+static void _flush(_out_t *out, uint8_t flags)
+{
+    if ((out->fill == 0) || (out->res < 0)) {
+        return;
+    }
+    if (out->sock == NULL) {
+        fwrite(out->buf, 1, out->fill, stdout);
+    }
+    else if ((out->sock->base.conn == NULL) ||
+             (netconn_write(out->sock->base.conn, out->buf, out->fill,
+                            NETCONN_COPY | flags) != ERR_OK)) {
+        out->res = -EIO;
+    }
+    out->fill = 0;
+}
+
+/* formats one line into the buffer, sending the buffer first if the line
+ * doesn't fit anymore */
+static void _printf(_out_t *out, const char *fmt, ...)
+{
+    for (unsigned tries = 0; tries < 2; tries++) {
+        size_t space = sizeof(out->buf) - out->fill;
+        va_list args;
+        int len;
+
+        va_start(args, fmt);
+        len = vsnprintf(out->buf + out->fill, space, fmt, args);
+        va_end(args);
+        if ((len >= 0) && ((size_t)len < space)) {
+            out->fill += len;
+            return;
+        }
+        _flush(out, NETCONN_MORE);
+    }
+}
+
+static void _format(_out_t *out, const metrics_metric_t *m)
+{
+    static const char *const types[] = {
+        [METRICS_TYPE_COUNTER] = "counter",
+        [METRICS_TYPE_GAUGE] = "gauge",
+        [METRICS_TYPE_HISTOGRAM] = "histogram",
+    };
+
+    _printf(out, "# HELP %s %s\n# TYPE %s %s\n", m->name, m->help, m->name,
+            types[m->type]);
+    if (m->type == METRICS_TYPE_HISTOGRAM) {
+        uint32_t count = m->count;
+        uint32_t cumulative = 0;
+
+        for (unsigned i = 0; i < m->numof; i++) {
+            cumulative += m->buckets[i];
+            _printf(out, "%s_bucket{le=\"%" PRIu32 "\"} %" PRIu32 "\n",
+                    m->name, m->bounds[i], cumulative);
+        }
+        /* the +Inf bucket must match the count */
+        _printf(out, "%s_bucket{le=\"+Inf\"} %" PRIu32 "\n"
+                "%s_sum %" PRIu32 "\n%s_count %" PRIu32 "\n",
+                m->name, count, m->name, (uint32_t)m->sum, m->name, count);
+    }
+    else {
+        _printf(out, "%s %" PRIu32 "\n", m->name,
+                m->ref ? *m->ref : m->value);
+    }
+}
+
+/* no lock: netconn_write() may block on the scraper, and metrics are only
+ * ever appended, see metrics_next() */
+static void _expose(_out_t *out)
+{
+    for (const metrics_metric_t *m = metrics_next(NULL); m && (out->res == 0);
+         m = metrics_next(m)) {
+        _format(out, m);
+    }
+    _flush(out, 0);
+}
+
+#ifdef MODULE_SOCK_TCP
+static sock_tcp_t _socks[1];
+static sock_tcp_queue_t _queue;
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+static _out_t _out;
+static char _req[REQ_SIZE];
+static uint16_t _port;
+static bool _running;
+
+/* reads up to the end of the request headers */
+static int _read_request(sock_tcp_t *sock)
+{
+    uint32_t deadline = xtimer_now_usec() + METRICS_TIMEOUT_US;
+    size_t fill = 0;
+
+    while (fill < (sizeof(_req) - 1)) {
+        int32_t left = deadline - xtimer_now_usec();
+        ssize_t res;
+
+        if (left <= 0) {
+            return -ETIMEDOUT;
+        }
+        res = sock_tcp_read(sock, _req + fill, sizeof(_req) - 1 - fill, left);
+        if (res <= 0) {
+            return (res < 0) ? res : -ECONNRESET;
+        }
+        fill += res;
+        _req[fill] = '\0';
+        if (strstr(_req, "\r\n\r\n") || strstr(_req, "\n\n")) {
+            return 0;
+        }
+    }
+    /* the request line is all we look at, ignore overlong headers */
+    return 0;
+}
+
+static void _scrape(sock_tcp_t *sock)
+{
+    static const char ok[] = "HTTP/1.0 200 OK\r\n"
+                             "Content-Type: text/plain; version=0.0.4\r\n"
+                             "Connection: close\r\n\r\n";
+    static const char not_found[] = "HTTP/1.0 404 Not Found\r\n"
+                                    "Connection: close\r\n\r\n";
+    uint32_t start = xtimer_now_usec();
+
+    if (_read_request(sock) < 0) {
+        return;
+    }
+#if LWIP_SO_SNDTIMEO
+    /* a scraper that stops reading fails the scrape instead of blocking */
+    netconn_set_sendtimeout(sock->base.conn, METRICS_SEND_TIMEOUT_MS);
+#endif
+    _out.sock = sock;
+    _out.fill = 0;
+    _out.res = 0;
+    if ((strncmp(_req, "GET /metrics ", 13) != 0) &&
+        (strncmp(_req, "GET / ", 6) != 0)) {
+        _printf(&_out, "%s", not_found);
+        _flush(&_out, 0);
+        return;
+    }
+    _printf(&_out, "%s", ok);
+    _expose(&_out);
+    if (_out.res == 0) {
+        metrics_inc(&_scrapes);
+        metrics_observe(&_scrape_us, xtimer_now_usec() - start);
+    }
+}
+
+static void *_exporter_thread(void *arg)
+{
+    sock_tcp_ep_t local = SOCK_IP_EP_ANY;
+    int res;
+
+    (void)arg;
+    local.port = _port;
+    if ((res = sock_tcp_listen(&_queue, &local, _socks, ARRAY_SIZE(_socks),
+                               0)) < 0) {
+        printf("Unable to open metrics exporter on port %" PRIu16
+               " (error code %d)\n", local.port, -res);
+        _running = false;
+        return NULL;
+    }
+    printf("Success: started metrics exporter on port %" PRIu16 "\n",
+           local.port);
+    while (1) {
+        sock_tcp_t *sock;
+
+        if (sock_tcp_accept(&_queue, &sock, SOCK_NO_TIMEOUT) == 0) {
+            _scrape(sock);
+            sock_tcp_disconnect(sock);
+        }
+    }
+    return NULL;
+}
+
+int metrics_start(uint16_t port)
+{
+    if (_running) {
+        return -EALREADY;
+    }
+    metrics_register(&_scrapes);
+    metrics_register(&_scrape_us);
+    _port = port;
+    _running = true;
+    /* scrapes run below the network and application threads */
+    if (thread_create(_stack, sizeof(_stack), PRIO_METRICS,
+                      THREAD_CREATE_STACKTEST, _exporter_thread, NULL,
+                      "metrics") <= KERNEL_PID_UNDEF) {
+        _running = false;
+        return -ENOMEM;
+    }
+    return 0;
+}
+#else
+int metrics_start(uint16_t port)
+{
+    (void)port;
+    return -ENOTSUP;
+}
+#endif
+
+int metrics_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        static _out_t out;
+
+        out.sock = NULL;
+        out.fill = 0;
+        out.res = 0;
+        _expose(&out);
+        return 0;
+    }
+    else if (strcmp(argv[1], "start") == 0) {
+        int res = metrics_start((argc > 2) ? strtoul(argv[2], NULL, 0)
+                                           : METRICS_PORT);
+
+        if (res < 0) {
+            printf("error: unable to start metrics exporter (error code %d)\n",
+                   -res);
+            return 1;
+        }
+        return 0;
+    }
+    else {
+        printf("usage: %s [start [<port>]]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
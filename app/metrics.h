@@ -0,0 +1,193 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Metrics registry and Prometheus exporter
+ *
+ * Modules define their metrics statically and add them with
+ * @ref metrics_register. A metric either holds its own value or refers to a
+ * counter the module keeps anyway (`ref`). Each metric is expected to be
+ * updated from a single thread; a scrape reads the values without locking.
+ *
+ * `metrics start` listens for scrapes and answers them in the Prometheus
+ * text format. The response is formatted line by line into a buffer of one
+ * TCP segment that is handed to lwIP whenever it is full, so no full-size
+ * response is ever built. With at most @ref METRICS_NUMOF metrics of at most
+ * @ref METRICS_BUCKETS_MAX buckets a scrape costs a bounded number of lines,
+ * a client has @ref METRICS_TIMEOUT_US to send its request and each segment
+ * of the response @ref METRICS_SEND_TIMEOUT_MS to go out. Scrapes take no
+ * lock, so a stalled scraper never holds up @ref metrics_register.
+ * @}
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "kernel_defines.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef METRICS_PORT
+#define METRICS_PORT            (9100U)     /**< default listen port */
+#endif
+#ifndef METRICS_NUMOF
+#define METRICS_NUMOF           (48U)       /**< registered metrics limit */
+#endif
+#ifndef METRICS_BUCKETS_MAX
+#define METRICS_BUCKETS_MAX     (16U)       /**< histogram bucket limit */
+#endif
+#ifndef METRICS_CHUNK_SIZE
+#define METRICS_CHUNK_SIZE      (536U)      /**< formatting buffer */
+#endif
+#ifndef METRICS_TIMEOUT_US
+#define METRICS_TIMEOUT_US      (1000000UL) /**< request read timeout */
+#endif
+#ifndef METRICS_SEND_TIMEOUT_MS
+#define METRICS_SEND_TIMEOUT_MS (1000)      /**< response write timeout */
+#endif
+/** @} */
+
+/**
+ * @brief   Metric types
+ */
+typedef enum {
+    METRICS_TYPE_COUNTER,       /**< monotonic counter */
+    METRICS_TYPE_GAUGE,         /**< current value */
+    METRICS_TYPE_HISTOGRAM,     /**< distribution over fixed buckets */
+} metrics_type_t;
+
+typedef struct metrics_metric metrics_metric_t;
+
+/**
+ * @brief   Metric descriptor, define with the initializers below
+ */
+struct metrics_metric {
+    metrics_metric_t *next;     /**< set by @ref metrics_register */
+    const char *name;           /**< metric name */
+    const char *help;           /**< help text */
+    metrics_type_t type;        /**< metric type */
+    const volatile uint32_t *ref; /**< value kept by the module, or NULL */
+    uint32_t value;             /**< counter or gauge value without ref */
+    const uint32_t *bounds;     /**< histogram upper bounds, ascending */
+    uint32_t *buckets;          /**< histogram counts, numof + 1 entries */
+    uint8_t numof;              /**< number of histogram bounds */
+    uint32_t count;             /**< histogram observations */
+    uint64_t sum;               /**< sum of the histogram observations */
+};
+
+/**
+ * @brief   Counter holding its own value
+ */
+#define METRICS_COUNTER(n, h) \
+    { .name = (n), .help = (h), .type = METRICS_TYPE_COUNTER }
+
+/**
+ * @brief   Counter exposing the variable at @p r
+ */
+#define METRICS_COUNTER_REF(n, h, r) \
+    { .name = (n), .help = (h), .type = METRICS_TYPE_COUNTER, .ref = (r) }
+
+/**
+ * @brief   Gauge holding its own value
+ */
+#define METRICS_GAUGE(n, h) \
+    { .name = (n), .help = (h), .type = METRICS_TYPE_GAUGE }
+
+/**
+ * @brief   Histogram over the bound array @p b, @p c must have one more
+ *          entry than @p b
+ */
+#define METRICS_HISTOGRAM(n, h, b, c) \
+    { .name = (n), .help = (h), .type = METRICS_TYPE_HISTOGRAM, \
+      .bounds = (b), .buckets = (c), .numof = ARRAY_SIZE(b) }
+
+/**
+ * @brief   Add @p m to the registry
+ *
+ * @return  0 on success
+ * @return  -EALREADY if @p m is already registered
+ * @return  -EINVAL if @p m has more than @ref METRICS_BUCKETS_MAX buckets
+ * @return  -ENOMEM if @ref METRICS_NUMOF metrics are registered
+ */
+int metrics_register(metrics_metric_t *m);
+
+/**
+ * @brief   Iterate over the registry
+ *
+ * @param[in] m     current metric, NULL to get the first one
+ *
+ * @return  the metric registered after @p m, NULL at the end
+ */
+const metrics_metric_t *metrics_next(const metrics_metric_t *m);
+
+/**
+ * @brief   Add @p n to a counter
+ */
+static inline void metrics_add(metrics_metric_t *m, uint32_t n)
+{
+    m->value += n;
+}
+
+/**
+ * @brief   Increment a counter
+ */
+static inline void metrics_inc(metrics_metric_t *m)
+{
+    m->value++;
+}
+
+/**
+ * @brief   Set a gauge
+ */
+static inline void metrics_set(metrics_metric_t *m, uint32_t value)
+{
+    m->value = value;
+}
+
+/**
+ * @brief   Add @p value to a histogram
+ */
+void metrics_observe(metrics_metric_t *m, uint32_t value);
+
+/**
+ * @brief   Start the exporter thread
+ *
+ * @param[in] port      port to listen on
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the exporter is already running
+ * @return  -ENOMEM if the thread could not be created
+ */
+int metrics_start(uint16_t port);
+
+/**
+ * @brief   Metrics shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int metrics_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METRICS_H */
+/** @} */
@@ -0,0 +1,171 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Frame hooks between lwIP and the Ethernet netdev
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/netif.h"
+#include "metrics.h"
+#include "mutex.h"
+#include "netdev_hook.h"
+#include "random.h"
+
+static const netdev_driver_t *_orig_driver;
+static netdev_driver_t _hook_driver;
+static netdev_hook_t *_hooks;
+static struct netif *_netif;
+/* frames come from the tcpip thread, qos_tx and ptp, drivers aren't
+ * reentrant */
+static mutex_t _send_lock = MUTEX_INIT;
+
+/* emulated loss in 1/1000, applied before any other hook */
+static uint16_t _rx_loss, _tx_loss;
+static uint32_t _rx_frames, _rx_dropped, _tx_frames, _tx_dropped;
+static metrics_metric_t _metrics[] = {
+    METRICS_COUNTER_REF("netdev_rx_frames_total", "Frames received",
+                        &_rx_frames),
+    METRICS_COUNTER_REF("netdev_rx_dropped_total", "Frames lost by emulation",
+                        &_rx_dropped),
+    METRICS_COUNTER_REF("netdev_tx_frames_total", "Frames sent", &_tx_frames),
+    METRICS_COUNTER_REF("netdev_tx_dropped_total", "Frames lost by emulation",
+                        &_tx_dropped),
+};
+
+static inline bool _lose(uint16_t permille)
+{
+    return permille && (random_uint32_range(0, 1000) < permille);
+}
+
+static int _recv(netdev_t *dev, void *buf, size_t len, void *info)
+{
+    int res = _orig_driver->recv(dev, buf, len, info);
+
+    /* size queries and drop requests pass straight through */
+    if ((buf == NULL) || (res <= 0)) {
+        return res;
+    }
+    _rx_frames++;
+    if (_lose(_rx_loss)) {
+        _rx_dropped++;
+        return -1;
+    }
+    for (netdev_hook_t *hook = _hooks; hook; hook = hook->next) {
+        if (hook->rx && ((res = hook->rx(hook, dev, buf, res)) <= 0)) {
+            /* lwIP skips the pbuf allocation on errors */
+            return -1;
+        }
+    }
+    return res;
+}
+
+static int _send(netdev_t *dev, const iolist_t *iolist)
+{
+    _tx_frames++;
+    if (_lose(_tx_loss)) {
+        _tx_dropped++;
+        /* the frame went "on the wire" as far as lwIP is concerned */
+        return iolist_size(iolist);
+    }
+    for (netdev_hook_t *hook = _hooks; hook; hook = hook->next) {
+        int res;
+
+        if (hook->tx && ((res = hook->tx(hook, dev, iolist)) != 0)) {
+            return (res > 0) ? (int)iolist_size(iolist) : res;
+        }
+    }
+    return netdev_hook_send(dev, iolist);
+}
+
+int netdev_hook_init(void)
+{
+    for (struct netif *netif = netif_list; netif; netif = netif->next) {
+        netdev_t *dev = netif->state;
+
+        if (!(netif->flags & NETIF_FLAG_ETHARP) || (dev == NULL)) {
+            continue;
+        }
+        if (dev->driver == &_hook_driver) {
+            return 0;
+        }
+        _orig_driver = dev->driver;
+        _hook_driver = *_orig_driver;
+        _hook_driver.recv = _recv;
+        _hook_driver.send = _send;
+        _netif = netif;
+        dev->driver = &_hook_driver;
+        for (unsigned i = 0; i < ARRAY_SIZE(_metrics); i++) {
+            metrics_register(&_metrics[i]);
+        }
+        return 0;
+    }
+    return -ENODEV;
+}
+
+void netdev_hook_add(netdev_hook_t *hook)
+{
+    netdev_hook_t **tail = &_hooks;
+
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    hook->next = NULL;
+    *tail = hook;
+}
+
+int netdev_hook_send(netdev_t *dev, const iolist_t *iolist)
+{
+    int res;
+
+    mutex_lock(&_send_lock);
+    res = _orig_driver->send(dev, iolist);
+    mutex_unlock(&_send_lock);
+    return res;
+}
+
+struct netif *netdev_hook_netif(void)
+{
+    return _netif;
+}
+
+int nethook_cmd(int argc, char **argv)
+{
+    if ((argc > 1) && (strcmp(argv[1], "loss") == 0)) {
+        if (argc < 3) {
+            printf("usage: %s loss <rx permille> [<tx permille>]\n", argv[0]);
+            return 1;
+        }
+        _rx_loss = atoi(argv[2]);
+        _tx_loss = (argc > 3) ? atoi(argv[3]) : 0;
+        return 0;
+    }
+    if ((argc > 1) && (strcmp(argv[1], "reset") == 0)) {
+        _rx_frames = _rx_dropped = _tx_frames = _tx_dropped = 0;
+        return 0;
+    }
+    if (argc > 1) {
+        printf("usage: %s [loss|reset]\n", argv[0]);
+        return 1;
+    }
+    printf("rx: %" PRIu32 " frames, %" PRIu32 " dropped (loss %u/1000)\n",
+           _rx_frames, _rx_dropped, _rx_loss);
+    printf("tx: %" PRIu32 " frames, %" PRIu32 " dropped (loss %u/1000)\n",
+           _tx_frames, _tx_dropped, _tx_loss);
+    return 0;
+}
+
+/** @} */
@@ -0,0 +1,113 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Frame hooks between lwIP and the Ethernet netdev
+ *
+ * The driver of the Ethernet interface is wrapped so that every received
+ * frame passes the registered RX hooks right after the driver copied it out
+ * of the DMA ring, before lwIP allocates a pbuf for it. Every frame lwIP
+ * sends passes the TX hooks before it is handed to the driver.
+ *
+ * RX hooks run in the lwIP netdev thread, TX hooks in the tcpip thread.
+ * @}
+ */
+#ifndef NETDEV_HOOK_H
+#define NETDEV_HOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "iolist.h"
+#include "net/netdev.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Forward declaration of the lwIP interface
+ */
+struct netif;
+
+/**
+ * @brief   Hook descriptor
+ */
+typedef struct netdev_hook netdev_hook_t;
+
+/**
+ * @brief   Hook descriptor
+ */
+struct netdev_hook {
+    netdev_hook_t *next;        /**< next hook, set by @ref netdev_hook_add */
+    /**
+     * @brief   Called for every received frame, may be NULL
+     *
+     * The frame may be modified in place.
+     *
+     * @return  length of the (modified) frame to pass on
+     * @return  0 if the frame was dropped or consumed by the hook
+     */
+    int (*rx)(netdev_hook_t *hook, netdev_t *dev, uint8_t *frame, size_t len);
+    /**
+     * @brief   Called for every frame to be sent, may be NULL
+     *
+     * @return  0 to pass the frame on
+     * @return  > 0 if the frame was consumed by the hook
+     * @return  < 0 to fail the send with this error
+     */
+    int (*tx)(netdev_hook_t *hook, netdev_t *dev, const iolist_t *iolist);
+};
+
+/**
+ * @brief   Wrap the driver of the Ethernet interface
+ *
+ * @return  0 on success
+ * @return  -ENODEV if lwIP has no Ethernet interface
+ */
+int netdev_hook_init(void);
+
+/**
+ * @brief   Append @p hook to the hook chains
+ */
+void netdev_hook_add(netdev_hook_t *hook);
+
+/**
+ * @brief   Send a frame with the wrapped driver, skipping the TX hooks
+ *
+ * All sends, those of lwIP included, are serialized, so this can be called
+ * from any thread.
+ */
+int netdev_hook_send(netdev_t *dev, const iolist_t *iolist);
+
+/**
+ * @brief   Get the hooked lwIP interface
+ *
+ * @return  the interface or NULL before @ref netdev_hook_init
+ */
+struct netif *netdev_hook_netif(void);
+
+/**
+ * @brief   Hook statistics shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int nethook_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NETDEV_HOOK_H */
+/** @} */
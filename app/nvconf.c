@@ -0,0 +1,90 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Application configuration persisted in flash
+ * @}
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "checksum/crc16_ccitt.h"
+#include "nvconf.h"
+
+#if defined(MODULE_PERIPH_FLASHPAGE) && defined(MODULE_PERIPH_FLASHPAGE_RAW)
+#include "periph/flashpage.h"
+
+#ifndef NVCONF_PAGE
+#define NVCONF_PAGE         (FLASHPAGE_NUMOF - 1)
+#endif
+
+#define NVCONF_FLASH_SIZE   (((sizeof(nvconf_t) + FLASHPAGE_RAW_BLOCKSIZE - 1) / \
+                              FLASHPAGE_RAW_BLOCKSIZE) * FLASHPAGE_RAW_BLOCKSIZE)
+#endif
+
+#define CRC_OFFSET          (offsetof(nvconf_t, crc) + sizeof(uint16_t))
+
+static nvconf_t _conf;
+
+static uint16_t _crc(const nvconf_t *conf, size_t len)
+{
+    return crc16_ccitt_calc((const uint8_t *)conf + CRC_OFFSET,
+                            len - CRC_OFFSET);
+}
+
+nvconf_t *nvconf_get(void)
+{
+    return &_conf;
+}
+
+int nvconf_load(void)
+{
+    memset(&_conf, 0, sizeof(_conf));
+#ifdef NVCONF_FLASH_SIZE
+    const nvconf_t *stored = flashpage_addr(NVCONF_PAGE);
+
+    if ((stored->magic == NVCONF_MAGIC) && (stored->len > CRC_OFFSET) &&
+        (stored->len <= FLASHPAGE_SIZE) &&
+        (stored->crc == _crc(stored, stored->len))) {
+        /* an older, shorter image leaves the new fields at zero */
+        memcpy(&_conf, stored,
+               (stored->len < sizeof(_conf)) ? stored->len : sizeof(_conf));
+        return 0;
+    }
+#endif
+    return -ENOENT;
+}
+
+int nvconf_save(void)
+{
+#ifdef NVCONF_FLASH_SIZE
+    static union {
+        nvconf_t conf;
+        uint8_t raw[NVCONF_FLASH_SIZE];
+    } buf __attribute__((aligned(FLASHPAGE_RAW_ALIGNMENT)));
+    void *addr = flashpage_addr(NVCONF_PAGE);
+
+    _conf.magic = NVCONF_MAGIC;
+    _conf.len = sizeof(_conf);
+    _conf.crc = _crc(&_conf, sizeof(_conf));
+    memset(&buf, 0xff, sizeof(buf));
+    memcpy(&buf.conf, &_conf, sizeof(_conf));
+    /* erase, then program the image in one go */
+    flashpage_write(NVCONF_PAGE, NULL);
+    flashpage_write_raw(addr, &buf, sizeof(buf));
+    return (memcmp(addr, &_conf, sizeof(_conf)) == 0) ? 0 : -EIO;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+/** @} */
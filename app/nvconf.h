@@ -0,0 +1,115 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Application configuration persisted in flash
+ *
+ * The configuration is a single structure kept in RAM and written as a whole
+ * to the last flash page. The stored length makes it forward compatible:
+ * fields appended later read as zero from an older image.
+ * @}
+ */
+#ifndef NVCONF_H
+#define NVCONF_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef NVCONF_ARP_NUMOF
+#define NVCONF_ARP_NUMOF    (8U)        /**< persisted static ARP entries */
+#endif
+/** @} */
+
+/**
+ * @brief   Static ARP entry
+ */
+typedef struct {
+    uint8_t ip[4];                  /**< IPv4 address */
+    uint8_t mac[6];                 /**< Ethernet address */
+    uint8_t used;                   /**< entry is valid */
+    uint8_t reserved;               /**< 0 */
+} nvconf_arp_t;
+
+/**
+ * @brief   Network configuration used for a fast start
+ */
+typedef struct {
+    uint8_t addr[4];                /**< own IPv4 address */
+    uint8_t netmask[4];             /**< netmask */
+    uint8_t gw[4];                  /**< default gateway */
+    uint8_t peer[4];                /**< collector address */
+    uint16_t peer_port;             /**< collector TCP port */
+    uint8_t flags;                  /**< NVCONF_NET_* */
+    uint8_t reserved;               /**< 0 */
+    uint8_t standby[4];             /**< hot standby collector address */
+    uint16_t standby_port;          /**< hot standby collector TCP port */
+    uint16_t reserved2;             /**< 0 */
+} nvconf_net_t;
+
+/**
+ * @brief   Network configuration flags
+ * @{
+ */
+#define NVCONF_NET_STATIC   (0x01)  /**< apply addr, netmask and gw at boot */
+#define NVCONF_NET_PEER     (0x02)  /**< peer and peer_port are valid */
+#define NVCONF_NET_STANDBY  (0x04)  /**< standby and standby_port are valid */
+/** @} */
+
+/**
+ * @brief   Persisted configuration
+ */
+typedef struct {
+    uint32_t magic;                 /**< @ref NVCONF_MAGIC */
+    uint16_t len;                   /**< bytes covered by @p crc */
+    uint16_t crc;                   /**< CRC16-CCITT of everything after it */
+    nvconf_arp_t arp[NVCONF_ARP_NUMOF]; /**< static ARP entries */
+    nvconf_net_t net;               /**< fast start configuration */
+} nvconf_t;
+
+/**
+ * @brief   Marks a programmed configuration
+ */
+#define NVCONF_MAGIC        (0x4e56434fUL)
+
+/**
+ * @brief   Load the configuration from flash
+ *
+ * @return  0 on success
+ * @return  -ENOENT if flash holds no valid configuration, defaults apply
+ */
+int nvconf_load(void);
+
+/**
+ * @brief   Write the configuration to flash
+ *
+ * @return  0 on success
+ * @return  -ENOTSUP if the board has no usable flashpage driver
+ * @return  -EIO if verification failed
+ */
+int nvconf_save(void);
+
+/**
+ * @brief   Get the RAM copy of the configuration
+ */
+nvconf_t *nvconf_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NVCONF_H */
+/** @} */
@@ -0,0 +1,514 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       One-way delay measurement with time stamped UDP probes
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mutex.h"
+#include "net/sock/udp.h"
+#include "owd.h"
+#include "prio.h"
+#include "ptp_slave.h"
+#include "qos.h"
+#include "random.h"
+#include "thread.h"
+#include "wallclock.h"
+#include "xtimer.h"
+
+#ifdef MODULE_LWIP_IPV6
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#ifdef MODULE_SOCK_UDP
+#define REPLY_TIMEOUT_US    (200U * US_PER_MS)
+#define REPORT_TRIES        (3U)
+#define DRAIN_US            (100U * US_PER_MS)  /* for the last probes */
+#define REPORT_FIELDS       (sizeof(owd_report_t) / sizeof(uint32_t))
+
+static sock_udp_t _sock;
+static bool _running;
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+static uint8_t _rx_buf[OWD_PROBE_SIZE_MAX];
+static uint8_t _tx_buf[OWD_PROBE_SIZE_MAX];
+static uint8_t _reply_buf[sizeof(owd_msg_t) + sizeof(owd_report_t)];
+
+/* receive session, shared with the shell under _lock */
+static mutex_t _lock = MUTEX_INIT;
+static uint16_t _session;
+static bool _wall;
+static bool _invalid;               /* the time source dropped out */
+static int32_t _delays[OWD_SAMPLES];
+static unsigned _numof;
+static uint32_t _received, _reordered, _highest, _last_seq;
+static int32_t _min, _max, _last;
+static int64_t _total;
+static uint64_t _ipdv_total;
+static uint32_t _ipdv_numof;
+
+typedef enum {
+    _SRC_LOCAL,
+    _SRC_PTP,
+    _SRC_SNTP,
+} _src_t;
+
+static _src_t _src;
+
+/* wall clock time is UTC from the PTP slave, else from the SNTP client */
+static _src_t _source(void)
+{
+    uint64_t ns;
+
+    if (ptp_slave_now(&ns) == 0) {
+        return _SRC_PTP;
+    }
+    return wallclock_state()->synced ? _SRC_SNTP : _SRC_LOCAL;
+}
+
+/* the time source stays fixed for a session. Once it lost its
+ * synchronization there is no time: stamps of another source would be off
+ * by the difference of the clocks. */
+static int _now(_src_t src, uint64_t *us)
+{
+    uint64_t ns;
+
+    switch (src) {
+    case _SRC_PTP:
+        if (ptp_slave_now(&ns) < 0) {
+            return -EAGAIN;
+        }
+        *us = ns / NS_PER_US;
+        return 0;
+    case _SRC_SNTP:
+        if (!wallclock_state()->synced) {
+            return -EAGAIN;
+        }
+        *us = wallclock_now(NULL);
+        return 0;
+    default:
+        *us = xtimer_now_usec64();
+        return 0;
+    }
+}
+
+static void _reset(uint16_t session)
+{
+    _session = session;
+    _src = _source();
+    _wall = (_src != _SRC_LOCAL);
+    _invalid = false;
+    _numof = 0;
+    _received = _reordered = _highest = 0;
+    _min = INT32_MAX;
+    _max = INT32_MIN;
+    _total = 0;
+    _ipdv_total = 0;
+    _ipdv_numof = 0;
+}
+
+static void _record(uint32_t seq, int64_t delay64)
+{
+    int32_t delay = MAX(MIN(delay64, INT32_MAX), INT32_MIN);
+
+    if ((_received == 0) || (seq > _highest)) {
+        _highest = seq;
+    }
+    else {
+        _reordered++;
+    }
+    /* RFC 3393 pairs consecutive probes only */
+    if (_received && (seq == _last_seq + 1)) {
+        _ipdv_total += (delay > _last) ? (uint32_t)(delay - _last)
+                                       : (uint32_t)(_last - delay);
+        _ipdv_numof++;
+    }
+    _last_seq = seq;
+    _last = delay;
+    _received++;
+    _total += delay;
+    _min = MIN(_min, delay);
+    _max = MAX(_max, delay);
+    if (_numof < OWD_SAMPLES) {
+        _delays[_numof++] = delay;
+    }
+}
+
+static int _cmp_i32(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+void owd_report(owd_report_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    mutex_lock(&_lock);
+    r->flags = (_wall ? OWD_FLAG_WALL : 0) | (_invalid ? OWD_FLAG_INVALID : 0);
+    if (_received) {
+        /* the order is not needed any more, IPDV is kept as it goes */
+        qsort(_delays, _numof, sizeof(_delays[0]), _cmp_i32);
+        r->received = _received;
+        r->lost = MAX((int64_t)_highest + 1 - _received, 0);
+        r->reordered = _reordered;
+        r->min_us = _min;
+        r->avg_us = _total / _received;
+        r->p50_us = _delays[_numof / 2];
+        r->p99_us = _delays[(_numof * 99) / 100];
+        r->max_us = _max;
+        r->ipdv_us = _ipdv_numof ? _ipdv_total / _ipdv_numof : 0;
+        r->pdv_us = r->p99_us - r->min_us;
+    }
+    mutex_unlock(&_lock);
+}
+
+static void _print_report(const owd_report_t *r)
+{
+    printf("%" PRIu32 " received, %" PRIu32 " lost, %" PRIu32
+           " reordered, %s time\n", r->received, r->lost, r->reordered,
+           (r->flags & OWD_FLAG_WALL) ? "wall clock" : "estimated");
+    if (r->flags & OWD_FLAG_INVALID) {
+        puts("warning: the receiver's clock lost its synchronization, "
+             "later probes not counted");
+    }
+    if (r->received) {
+        printf("delay min %" PRId32 " us, avg %" PRId32 " us, p50 %" PRId32
+               " us, p99 %" PRId32 " us, max %" PRId32 " us\n", r->min_us,
+               r->avg_us, r->p50_us, r->p99_us, r->max_us);
+        printf("ipdv %" PRIu32 " us, pdv %" PRIu32 " us\n", r->ipdv_us,
+               r->pdv_us);
+    }
+}
+
+static ssize_t _put_report(uint8_t *buf)
+{
+    owd_report_t r;
+    uint32_t values[REPORT_FIELDS];
+
+    owd_report(&r);
+    memcpy(values, &r, sizeof(values));
+    for (unsigned i = 0; i < REPORT_FIELDS; i++) {
+        network_uint32_t v = byteorder_htonl(values[i]);
+
+        memcpy(buf + sizeof(owd_msg_t) + i * sizeof(v), &v, sizeof(v));
+    }
+    return sizeof(owd_msg_t) + REPORT_FIELDS * sizeof(uint32_t);
+}
+
+static void _get_report(owd_report_t *r, const uint8_t *buf)
+{
+    uint32_t values[REPORT_FIELDS];
+
+    for (unsigned i = 0; i < REPORT_FIELDS; i++) {
+        network_uint32_t v;
+
+        memcpy(&v, buf + sizeof(owd_msg_t) + i * sizeof(v), sizeof(v));
+        values[i] = byteorder_ntohl(v);
+    }
+    memcpy(r, values, sizeof(*r));
+}
+
+static void *_receiver_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        owd_msg_t *msg = (owd_msg_t *)_rx_buf;
+        sock_udp_ep_t remote;
+        ssize_t res = sock_udp_recv(&_sock, _rx_buf, sizeof(_rx_buf),
+                                    SOCK_NO_TIMEOUT, &remote);
+        uint64_t arrival, departure;
+        uint16_t session;
+        int stamped;
+
+        /* stamp right after the receive, a report being sorted in the
+         * shell must not delay it */
+        stamped = _now(_src, &arrival);
+        if (res < (ssize_t)sizeof(owd_msg_t)) {
+            continue;
+        }
+        session = byteorder_ntohs(msg->session);
+        mutex_lock(&_lock);
+        if (session != _session) {
+            _reset(session);
+            stamped = _now(_src, &arrival);
+        }
+        if ((stamped < 0) && (msg->type != OWD_TYPE_REPORT)) {
+            _invalid = true;
+            mutex_unlock(&_lock);
+            continue;
+        }
+        switch (msg->type) {
+        case OWD_TYPE_PROBE:
+            if (!_invalid) {
+                _record(byteorder_ntohl(msg->seq),
+                        (int64_t)(arrival - byteorder_ntohll(msg->t1)));
+            }
+            mutex_unlock(&_lock);
+            break;
+        case OWD_TYPE_SYNC:
+            if (_now(_src, &departure) < 0) {
+                _invalid = true;
+                mutex_unlock(&_lock);
+                break;
+            }
+            msg->type = OWD_TYPE_SYNC_REPLY;
+            msg->flags = _wall ? OWD_FLAG_WALL : 0;
+            msg->t2 = byteorder_htonll(arrival);
+            msg->t3 = byteorder_htonll(departure);
+            mutex_unlock(&_lock);
+            sock_udp_send(&_sock, msg, sizeof(*msg), &remote);
+            break;
+        case OWD_TYPE_REPORT:
+            mutex_unlock(&_lock);
+            msg->type = OWD_TYPE_REPORT_REPLY;
+            res = _put_report(_rx_buf);
+            sock_udp_send(&_sock, _rx_buf, res, &remote);
+            break;
+        default:
+            mutex_unlock(&_lock);
+            break;
+        }
+    }
+    return NULL;
+}
+
+int owd_listen(uint16_t port)
+{
+    sock_udp_ep_t local = SOCK_IP_EP_ANY;
+    int res;
+
+    if (_running) {
+        return -EALREADY;
+    }
+    local.port = port;
+    if ((res = sock_udp_create(&_sock, &local, NULL, 0)) < 0) {
+        return res;
+    }
+    _running = true;
+    if (thread_create(_stack, sizeof(_stack), PRIO_OWD,
+                      THREAD_CREATE_STACKTEST, _receiver_thread, NULL,
+                      "owd") <= KERNEL_PID_UNDEF) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+/* sends a request and waits for its reply, which has the next type and
+ * the same session and sequence number; late replies are skipped */
+static ssize_t _request(sock_udp_t *sock, owd_msg_t *req)
+{
+    const owd_msg_t *rsp = (const owd_msg_t *)_reply_buf;
+    uint32_t sent = xtimer_now_usec();
+
+    if (sock_udp_send(sock, req, sizeof(*req), NULL) < 0) {
+        return -EIO;
+    }
+    while ((xtimer_now_usec() - sent) < REPLY_TIMEOUT_US) {
+        ssize_t n = sock_udp_recv(sock, _reply_buf, sizeof(_reply_buf),
+                                  REPLY_TIMEOUT_US, NULL);
+
+        if (n < 0) {
+            return n;
+        }
+        if ((n >= (ssize_t)sizeof(*rsp)) && (rsp->type == req->type + 1) &&
+            (rsp->session.u16 == req->session.u16) &&
+            (rsp->seq.u32 == req->seq.u32)) {
+            return n;
+        }
+    }
+    return -ETIMEDOUT;
+}
+
+/* offset of the receiver's clock from ours, from the exchange with the
+ * shortest round trip */
+static int _sync(sock_udp_t *sock, uint16_t session, _src_t src,
+                 int64_t *offset, uint8_t *flags)
+{
+    uint32_t best = UINT32_MAX;
+
+    for (unsigned i = 0; i < OWD_SYNC_PROBES; i++) {
+        owd_msg_t req = { .type = OWD_TYPE_SYNC };
+        const owd_msg_t *rsp = (const owd_msg_t *)_reply_buf;
+        uint64_t now;
+        int64_t t1, t2, t3, t4, rtt;
+
+        if (_now(src, &now) < 0) {
+            return -EAGAIN;
+        }
+        t1 = now;
+        req.flags = (src != _SRC_LOCAL) ? OWD_FLAG_WALL : 0;
+        req.session = byteorder_htons(session);
+        req.seq = byteorder_htonl(i);
+        req.t1 = byteorder_htonll(t1);
+        if (_request(sock, &req) < 0) {
+            continue;
+        }
+        if (_now(src, &now) < 0) {
+            return -EAGAIN;
+        }
+        t4 = now;
+        t2 = byteorder_ntohll(rsp->t2);
+        t3 = byteorder_ntohll(rsp->t3);
+        rtt = (t4 - t1) - (t3 - t2);
+        if ((rtt >= 0) && (rtt < best)) {
+            best = rtt;
+            *offset = ((t2 - t1) + (t3 - t4)) / 2;
+            *flags = rsp->flags;
+        }
+    }
+    return (best == UINT32_MAX) ? -ETIMEDOUT : (int)best;
+}
+
+static int _parse_ep(sock_udp_ep_t *ep, char *addr_str, char *port_str)
+{
+    *ep = (sock_udp_ep_t)SOCK_IP_EP_ANY;
+#ifdef MODULE_LWIP_IPV6
+    if (ipv6_addr_from_str((ipv6_addr_t *)&ep->addr.ipv6, addr_str) == NULL) {
+#else
+    if (ipv4_addr_from_str((ipv4_addr_t *)&ep->addr.ipv4, addr_str) == NULL) {
+#endif
+        puts("Error: unable to parse destination address");
+        return 1;
+    }
+    ep->port = atoi(port_str);
+    return 0;
+}
+
+static int owd_send(char *addr_str, char *port_str, unsigned num,
+                    uint32_t interval, size_t size, uint8_t dscp)
+{
+    owd_msg_t *msg = (owd_msg_t *)_tx_buf;
+    sock_udp_ep_t remote;
+    sock_udp_t sock;
+    uint16_t session = random_uint32();
+    _src_t src = _source();
+    bool wall = (src != _SRC_LOCAL);
+    xtimer_ticks32_t last;
+    owd_report_t report;
+    int64_t offset = 0;
+    uint8_t flags = 0;
+    int res;
+
+    if (_parse_ep(&remote, addr_str, port_str)) {
+        return 1;
+    }
+    size = MAX(MIN(size, sizeof(_tx_buf)), sizeof(*msg));
+    if ((res = sock_udp_create(&sock, NULL, &remote, 0)) < 0) {
+        printf("Unable to open UDP sock (error code %d)\n", -res);
+        return 1;
+    }
+    qos_udp_set_tos(&sock, QOS_TOS(dscp));
+    if ((res = _sync(&sock, session, src, &offset, &flags)) < 0) {
+        puts((res == -EAGAIN) ? "error: the clock lost its synchronization"
+                              : "error: no answer from the receiver");
+        sock_udp_close(&sock);
+        return 1;
+    }
+    if (wall && (flags & OWD_FLAG_WALL)) {
+        /* both ends follow the wall clock, no estimate needed */
+        puts("clock: wall clock on both ends");
+        offset = 0;
+    }
+    else {
+        uint64_t abs_offset = (offset < 0) ? -offset : offset;
+
+        printf("clock: offset %s%" PRIu32 ".%06" PRIu32 " s estimated, "
+               "rtt %d us\n", (offset < 0) ? "-" : "",
+               (uint32_t)(abs_offset / US_PER_SEC),
+               (uint32_t)(abs_offset % US_PER_SEC), res);
+    }
+
+    memset(_tx_buf, 0, size);
+    msg->type = OWD_TYPE_PROBE;
+    msg->flags = wall ? OWD_FLAG_WALL : 0;
+    msg->session = byteorder_htons(session);
+    last = xtimer_now();
+    for (unsigned i = 0; i < num; i++) {
+        uint64_t now;
+
+        if (_now(src, &now) < 0) {
+            puts("error: the clock lost its synchronization, stopped");
+            num = i;
+            break;
+        }
+        msg->seq = byteorder_htonl(i);
+        /* in the receiver's time base */
+        msg->t1 = byteorder_htonll(now + offset);
+        sock_udp_send(&sock, _tx_buf, size, NULL);
+        xtimer_periodic_wakeup(&last, interval);
+    }
+    xtimer_usleep(DRAIN_US);
+
+    for (unsigned i = 0; i < REPORT_TRIES; i++) {
+        owd_msg_t req = { .type = OWD_TYPE_REPORT };
+
+        req.session = byteorder_htons(session);
+        req.seq = byteorder_htonl(i);
+        if ((res = _request(&sock, &req)) >=
+            (ssize_t)(sizeof(owd_msg_t) + sizeof(report))) {
+            break;
+        }
+    }
+    sock_udp_close(&sock);
+    if (res < (ssize_t)(sizeof(owd_msg_t) + sizeof(report))) {
+        puts("error: no report from the receiver");
+        return 1;
+    }
+    _get_report(&report, _reply_buf);
+    printf("%u probes of %u bytes sent\n", num, (unsigned)size);
+    _print_report(&report);
+    return 0;
+}
+
+int owd_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        owd_report_t report;
+
+        owd_report(&report);
+        _print_report(&report);
+        return 0;
+    }
+    else if (strcmp(argv[1], "listen") == 0) {
+        int res = owd_listen((argc > 2) ? strtoul(argv[2], NULL, 0)
+                                        : OWD_PORT);
+
+        if (res < 0) {
+            printf("error: unable to start receiver (error code %d)\n",
+                   -res);
+            return 1;
+        }
+        return 0;
+    }
+    else if ((strcmp(argv[1], "send") == 0) && (argc > 4)) {
+        return owd_send(argv[2], argv[3], atoi(argv[4]),
+                        (argc > 5) ? strtoul(argv[5], NULL, 0)
+                                   : OWD_INTERVAL_US,
+                        (argc > 6) ? strtoul(argv[6], NULL, 0) : 0,
+                        (argc > 7) ? atoi(argv[7]) : 0);
+    }
+    printf("usage: %s [listen [<port>]|send <addr> <port> <num> "
+           "[<interval us> [<size> [<dscp>]]]]\n", argv[0]);
+    return 1;
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
@@ -0,0 +1,165 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       One-way delay measurement with time stamped UDP probes
+ *
+ * A round trip hides which direction the delay was spent in. Here the
+ * sender stamps every probe with its send time and a sequence number, and
+ * the receiver subtracts the stamp from the arrival time.
+ *
+ * Both ends need a common time base. If sender and receiver both have
+ * wall clock time, from the PTP slave (ptp_slave.h) or else the SNTP
+ * client (wallclock.h), the stamps are in it and nothing else is needed.
+ * Each end picks its source when a session starts and keeps it; if that
+ * source loses its synchronization the sender stops and the receiver
+ * marks the report with @ref OWD_FLAG_INVALID.
+ * Otherwise the sender first runs @ref OWD_SYNC_PROBES
+ * NTP-style exchanges with the receiver, takes the offset of the one with
+ * the shortest round trip and stamps the probes in the receiver's time
+ * base. That estimate assumes the quiet path is symmetric, so it shows
+ * the queueing in either direction but not a fixed asymmetry of the
+ * minimum delay.
+ *
+ * The receiver reports, per session:
+ * - the delay distribution (min, avg, p50, p99, max)
+ * - the IP packet delay variation (RFC 3393), the mean difference between
+ *   the delays of consecutive probes
+ * - the packet delay variation (RFC 5481), p99 above the minimum
+ * - probes lost and reordered
+ *
+ * All messages are one @ref owd_msg_t, probes are padded to the requested
+ * size. The sender asks for the report at the end and prints it, so
+ * `owd send` on the device measures the uplink and tools/owd.py sending
+ * to `owd listen` measures the downlink.
+ * @}
+ */
+#ifndef OWD_H
+#define OWD_H
+
+#include <stdint.h>
+
+#include "byteorder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef OWD_PORT
+#define OWD_PORT                (12390U)    /**< default listen port */
+#endif
+#ifndef OWD_SAMPLES
+#define OWD_SAMPLES             (1000U)     /**< delays kept per session */
+#endif
+#ifndef OWD_SYNC_PROBES
+#define OWD_SYNC_PROBES         (8U)        /**< offset estimation rounds */
+#endif
+#ifndef OWD_INTERVAL_US
+#define OWD_INTERVAL_US         (10000U)    /**< default probe interval */
+#endif
+#ifndef OWD_PROBE_SIZE_MAX
+#define OWD_PROBE_SIZE_MAX      (1024U)     /**< largest probe */
+#endif
+/** @} */
+
+/**
+ * @brief   Message types
+ * @{
+ */
+#define OWD_TYPE_PROBE          (1U)        /**< stamped probe */
+#define OWD_TYPE_SYNC           (2U)        /**< offset estimation request */
+#define OWD_TYPE_SYNC_REPLY     (3U)        /**< with receive/send time */
+#define OWD_TYPE_REPORT         (4U)        /**< report request */
+#define OWD_TYPE_REPORT_REPLY   (5U)        /**< @ref owd_report_t follows */
+/** @} */
+
+/**
+ * @brief   Set in @ref owd_msg_t::flags when the time is wall clock time
+ */
+#define OWD_FLAG_WALL           (0x01U)
+
+/**
+ * @brief   Set in @ref owd_report_t::flags when the receiver's time source
+ *          lost its synchronization during the session
+ *
+ * The probes received since then are not counted, their delays would be
+ * off by the difference between the clocks.
+ */
+#define OWD_FLAG_INVALID        (0x02U)
+
+/**
+ * @brief   Message header, in network byte order
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t type;               /**< OWD_TYPE_* */
+    uint8_t flags;              /**< OWD_FLAG_* of the sender's clock */
+    network_uint16_t session;   /**< changes with every `owd send` */
+    network_uint32_t seq;       /**< probe or exchange number */
+    network_uint64_t t1;        /**< send time, in us */
+    network_uint64_t t2;        /**< sync reply: receive time */
+    network_uint64_t t3;        /**< sync reply: send time */
+} owd_msg_t;
+
+/**
+ * @brief   Report of a session, network_uint32_t fields in the message
+ */
+typedef struct {
+    uint32_t received;          /**< probes received */
+    uint32_t lost;              /**< sequence numbers never seen */
+    uint32_t reordered;         /**< probes behind a later one */
+    int32_t min_us;             /**< smallest delay */
+    int32_t avg_us;             /**< mean delay */
+    int32_t p50_us;             /**< median delay */
+    int32_t p99_us;             /**< 99th percentile delay */
+    int32_t max_us;             /**< largest delay */
+    uint32_t ipdv_us;           /**< mean |delay change| of neighbours */
+    uint32_t pdv_us;            /**< p99 above the minimum */
+    uint32_t flags;             /**< OWD_FLAG_* of the receiver's clock */
+} owd_report_t;
+
+/**
+ * @brief   Start the receiver thread
+ *
+ * @param[in] port      port to listen on
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the receiver is already running
+ * @return  -ENOMEM if the thread could not be created
+ */
+int owd_listen(uint16_t port);
+
+/**
+ * @brief   Get the report of the current receive session
+ *
+ * @param[out] report   report
+ */
+void owd_report(owd_report_t *report);
+
+/**
+ * @brief   One-way delay shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int owd_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OWD_H */
+/** @} */
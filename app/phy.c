@@ -0,0 +1,258 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       LAN8720A link monitoring over MDIO
+ * @}
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/netif.h"
+#include "lwip/tcpip.h"
+#include "netdev_hook.h"
+#include "phy.h"
+#include "prio.h"
+#include "thread.h"
+#include "xtimer.h"
+
+#if !defined(PHY_MOCK) && defined(MODULE_STM32_ETH)
+/* MDIO accessors of the stm32_eth driver */
+extern int32_t eth_phy_read(uint16_t addr, uint8_t reg);
+extern int32_t eth_phy_write(uint16_t addr, uint8_t reg, uint16_t value);
+#endif
+
+static char _stack[THREAD_STACKSIZE_DEFAULT + THREAD_EXTRA_STACKSIZE_PRINTF];
+static phy_status_t _status;
+static uint16_t _last_secr;
+static bool _polled;
+
+int32_t phy_read(uint8_t reg)
+{
+#if defined(PHY_MOCK)
+    return phy_mock_read(reg);
+#elif defined(MODULE_STM32_ETH)
+    return eth_phy_read(PHY_ADDR, reg);
+#else
+    (void)reg;
+    return -ENODEV;
+#endif
+}
+
+int32_t phy_write(uint8_t reg, uint16_t value)
+{
+#if defined(PHY_MOCK)
+    return phy_mock_write(reg, value);
+#elif defined(MODULE_STM32_ETH)
+    return eth_phy_write(PHY_ADDR, reg, value);
+#else
+    (void)reg;
+    (void)value;
+    return -ENODEV;
+#endif
+}
+
+static void _netif_link(bool up)
+{
+    struct netif *netif = netdev_hook_netif();
+
+    if (netif == NULL) {
+        return;
+    }
+    LOCK_TCPIP_CORE();
+    if (up) {
+        netif_set_link_up(netif);
+    }
+    else {
+        netif_set_link_down(netif);
+    }
+    UNLOCK_TCPIP_CORE();
+}
+
+static void _poll(void)
+{
+    /* the first BMSR read returns (and clears) a latched link loss */
+    int32_t latched = phy_read(PHY_BMSR);
+    int32_t bmsr = phy_read(PHY_BMSR);
+    int32_t scsr = phy_read(PHY_PHYSCSR);
+    int32_t secr = phy_read(PHY_SECR);
+    bool link, lost, full_duplex;
+    uint8_t speed;
+
+    if ((latched < 0) || (bmsr < 0) || (scsr < 0) || (secr < 0)) {
+        return;
+    }
+    if (_polled) {
+        _status.rx_errors += (uint16_t)(secr - _last_secr);
+    }
+    _last_secr = secr;
+    link = bmsr & PHY_BMSR_LINK;
+    lost = _polled && _status.link && !(latched & PHY_BMSR_LINK);
+    speed = link ? ((scsr & PHY_PHYSCSR_100) ? 100 : 10) : 0;
+    full_duplex = link && (scsr & PHY_PHYSCSR_FULL);
+    if (_polled && !lost && (link == _status.link) && (speed == _status.speed) &&
+        (full_duplex == _status.full_duplex)) {
+        return;
+    }
+    _polled = true;
+    if (lost) {
+        _status.flaps++;
+        /* let lwIP see short drops, too */
+        _netif_link(false);
+    }
+    _status.link = link;
+    _status.speed = speed;
+    _status.full_duplex = full_duplex;
+    _status.changed = xtimer_now_usec();
+    _netif_link(link);
+    if (link) {
+        printf("phy: link up, %u Mbps %s duplex%s\n", speed,
+               full_duplex ? "full" : "half",
+               ((speed < 100) || !full_duplex) ? " (degraded)" : "");
+    }
+    else {
+        puts("phy: link down");
+    }
+}
+
+static void *_monitor_thread(void *arg)
+{
+    xtimer_ticks32_t last = xtimer_now();
+
+    (void)arg;
+    while (1) {
+        _poll();
+        xtimer_periodic_wakeup(&last, PHY_POLL_INTERVAL_US);
+    }
+    return NULL;
+}
+
+void phy_init(void)
+{
+    /* above main so a busy sender can't delay link detection */
+    thread_create(_stack, sizeof(_stack), PRIO_PHY,
+                  THREAD_CREATE_STACKTEST, _monitor_thread, NULL, "phy");
+}
+
+const phy_status_t *phy_status(void)
+{
+    return &_status;
+}
+
+void phy_print_status(void)
+{
+    if (_status.link) {
+        printf("        link up, %u Mbps %s duplex", _status.speed,
+               _status.full_duplex ? "full" : "half");
+    }
+    else {
+        printf("        link down");
+    }
+    printf(", %" PRIu32 " flaps, %" PRIu32 " rx errors\n", _status.flaps,
+           _status.rx_errors);
+}
+
+static int phy_regs(void)
+{
+    static const uint8_t regs[] = {
+        PHY_BMCR, PHY_BMSR, PHY_ID1, PHY_ID2, PHY_SECR, PHY_PHYSCSR
+    };
+
+    for (unsigned i = 0; i < ARRAY_SIZE(regs); i++) {
+        int32_t value = phy_read(regs[i]);
+
+        if (value < 0) {
+            printf("error: unable to read PHY register %u (error code %d)\n",
+                   regs[i], (int)-value);
+            return 1;
+        }
+        printf("reg %2u: 0x%04x\n", regs[i], (unsigned)value);
+    }
+    return 0;
+}
+
+static int phy_reg(int argc, char **argv)
+{
+    uint8_t reg;
+    int32_t res;
+
+    if (argc < 3) {
+        printf("usage: %s reg <reg> [<value>]\n", argv[0]);
+        return 1;
+    }
+    reg = strtoul(argv[2], NULL, 0);
+    if (argc > 3) {
+        res = phy_write(reg, strtoul(argv[3], NULL, 0));
+    }
+    else if ((res = phy_read(reg)) >= 0) {
+        printf("reg %2u: 0x%04x\n", reg, (unsigned)res);
+    }
+    if (res < 0) {
+        printf("error: MDIO access failed (error code %d)\n", (int)-res);
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef PHY_MOCK
+static int phy_mock(int argc, char **argv)
+{
+    if ((argc > 3) && (strcmp(argv[2], "errors") == 0)) {
+        phy_mock_add_errors(atoi(argv[3]));
+        return 0;
+    }
+    if ((argc > 2) && (strcmp(argv[2], "down") == 0)) {
+        phy_mock_set_link(false, 0, false);
+        return 0;
+    }
+    if ((argc > 2) && (strcmp(argv[2], "up") == 0)) {
+        phy_mock_set_link(true, (argc > 3) ? atoi(argv[3]) : 100,
+                          (argc < 5) || (strcmp(argv[4], "half") != 0));
+        return 0;
+    }
+    printf("usage: %s mock [up [10|100] [half|full]|down|errors <num>]\n",
+           argv[0]);
+    return 1;
+}
+#endif
+
+int phy_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        phy_print_status();
+        return phy_regs();
+    }
+    else if (strcmp(argv[1], "reg") == 0) {
+        return phy_reg(argc, argv);
+    }
+    else if (strcmp(argv[1], "renegotiate") == 0) {
+        int32_t bmcr = phy_read(PHY_BMCR);
+
+        if ((bmcr < 0) || (phy_write(PHY_BMCR, bmcr | PHY_BMCR_ANRESTART) < 0)) {
+            puts("error: MDIO access failed");
+            return 1;
+        }
+        return 0;
+    }
+#ifdef PHY_MOCK
+    else if (strcmp(argv[1], "mock") == 0) {
+        return phy_mock(argc, argv);
+    }
+#endif
+    else {
+        printf("usage: %s [reg|renegotiate]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
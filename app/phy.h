@@ -0,0 +1,162 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       LAN8720A link monitoring over MDIO
+ *
+ * A thread at PRIO_PHY, above the shell, polls BMSR and the PHY special
+ * control/status register. Link changes are forwarded to lwIP, so they
+ * reach users through the netif status callbacks (stream.c reconnects,
+ * boottime.c stamps the link up). Since BMSR latches a link loss until
+ * read, a short drop between two polls still counts as a flap and is
+ * passed on as a down/up pair.
+ *
+ * On BOARD=native the MDIO accessors are served by a register-level mock
+ * (phy_mock.c) that can be driven from the shell.
+ * @}
+ */
+#ifndef PHY_H
+#define PHY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef PHY_ADDR
+#define PHY_ADDR                (0U)        /**< PHYAD strap of the LAN8720A */
+#endif
+#ifndef PHY_POLL_INTERVAL_US
+#define PHY_POLL_INTERVAL_US    (200000UL)  /**< link poll interval */
+#endif
+#if defined(BOARD_NATIVE) && !defined(PHY_MOCK)
+#define PHY_MOCK                (1)         /**< use the mock PHY */
+#endif
+/** @} */
+
+/**
+ * @brief   LAN8720A registers
+ * @{
+ */
+#define PHY_BMCR                (0x00U)     /**< basic control */
+#define PHY_BMSR                (0x01U)     /**< basic status */
+#define PHY_ID1                 (0x02U)     /**< identifier 1 */
+#define PHY_ID2                 (0x03U)     /**< identifier 2 */
+#define PHY_SECR                (0x1aU)     /**< symbol error counter */
+#define PHY_PHYSCSR             (0x1fU)     /**< special control/status */
+/** @} */
+
+/**
+ * @brief   Register bits
+ * @{
+ */
+#define PHY_BMCR_RESET          (0x8000U)   /**< soft reset */
+#define PHY_BMCR_ANRESTART      (0x0200U)   /**< restart auto-negotiation */
+#define PHY_BMSR_ANDONE         (0x0020U)   /**< auto-negotiation complete */
+#define PHY_BMSR_LINK           (0x0004U)   /**< link up, latched low */
+#define PHY_PHYSCSR_AUTODONE    (0x1000U)   /**< auto-negotiation done */
+#define PHY_PHYSCSR_SPEED_MASK  (0x001cU)   /**< speed indication */
+#define PHY_PHYSCSR_10          (0x0004U)   /**< 10BASE-T */
+#define PHY_PHYSCSR_100         (0x0008U)   /**< 100BASE-TX */
+#define PHY_PHYSCSR_FULL        (0x0010U)   /**< full duplex */
+/** @} */
+
+/**
+ * @brief   Link status
+ */
+typedef struct {
+    bool link;                  /**< link is up */
+    bool full_duplex;           /**< negotiated full duplex */
+    uint8_t speed;              /**< negotiated speed in Mbps, 0 if down */
+    uint32_t flaps;             /**< link losses since boot */
+    uint32_t rx_errors;         /**< symbol errors since boot */
+    uint32_t changed;           /**< time of the last change in us */
+} phy_status_t;
+
+/**
+ * @brief   Read a PHY register over MDIO
+ *
+ * @return  register value
+ * @return  < 0 on error
+ */
+int32_t phy_read(uint8_t reg);
+
+/**
+ * @brief   Write a PHY register over MDIO
+ *
+ * @return  0 on success
+ * @return  < 0 on error
+ */
+int32_t phy_write(uint8_t reg, uint16_t value);
+
+/**
+ * @brief   Start the link monitor
+ *
+ * @pre     @ref netdev_hook_init was called
+ */
+void phy_init(void);
+
+/**
+ * @brief   Get the last polled link status
+ */
+const phy_status_t *phy_status(void);
+
+/**
+ * @brief   Print the link status in ifconfig style
+ */
+void phy_print_status(void);
+
+#ifdef PHY_MOCK
+/**
+ * @brief   Mock PHY register accessors
+ * @{
+ */
+int32_t phy_mock_read(uint8_t reg);
+int32_t phy_mock_write(uint8_t reg, uint16_t value);
+/** @} */
+
+/**
+ * @brief   Set the link state reported by the mock PHY
+ *
+ * @param[in] up            link up
+ * @param[in] speed         10 or 100
+ * @param[in] full_duplex   full duplex
+ */
+void phy_mock_set_link(bool up, uint8_t speed, bool full_duplex);
+
+/**
+ * @brief   Add @p num symbol errors to the mock PHY counter
+ */
+void phy_mock_add_errors(uint16_t num);
+#endif
+
+/**
+ * @brief   PHY shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int phy_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PHY_H */
+/** @} */
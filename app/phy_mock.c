@@ -0,0 +1,107 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Register-level LAN8720A mock for BOARD=native
+ * @}
+ */
+
+#include "phy.h"
+
+#ifdef PHY_MOCK
+#include <errno.h>
+
+#include "irq.h"
+#include "kernel_defines.h"
+
+#define MOCK_ID1        (0x0007U)
+#define MOCK_ID2        (0xc0f1U)
+#define MOCK_BMSR       (0x7809U)   /* 10/100 capable, extended registers */
+
+static uint16_t _regs[32] = {
+    [PHY_BMCR] = 0x3100U,
+    [PHY_BMSR] = MOCK_BMSR | PHY_BMSR_ANDONE | PHY_BMSR_LINK,
+    [PHY_ID1] = MOCK_ID1,
+    [PHY_ID2] = MOCK_ID2,
+    [PHY_PHYSCSR] = PHY_PHYSCSR_AUTODONE | PHY_PHYSCSR_100 | PHY_PHYSCSR_FULL,
+};
+/* the link bit in BMSR stays low until read once after a loss */
+static bool _link = true, _latched_low;
+
+int32_t phy_mock_read(uint8_t reg)
+{
+    unsigned state;
+    uint16_t value;
+
+    if (reg >= ARRAY_SIZE(_regs)) {
+        return -EINVAL;
+    }
+    state = irq_disable();
+    value = _regs[reg];
+    if (reg == PHY_BMSR) {
+        if (_latched_low) {
+            value &= ~PHY_BMSR_LINK;
+            _latched_low = false;
+        }
+    }
+    irq_restore(state);
+    return value;
+}
+
+int32_t phy_mock_write(uint8_t reg, uint16_t value)
+{
+    if (reg >= ARRAY_SIZE(_regs)) {
+        return -EINVAL;
+    }
+    switch (reg) {
+        case PHY_BMCR:
+            /* reset and restart complete immediately */
+            _regs[reg] = value & ~(PHY_BMCR_RESET | PHY_BMCR_ANRESTART);
+            break;
+        case PHY_BMSR:
+        case PHY_ID1:
+        case PHY_ID2:
+        case PHY_SECR:
+            /* read-only */
+            break;
+        default:
+            _regs[reg] = value;
+            break;
+    }
+    return 0;
+}
+
+void phy_mock_set_link(bool up, uint8_t speed, bool full_duplex)
+{
+    unsigned state = irq_disable();
+
+    if (_link && !up) {
+        _latched_low = true;
+    }
+    _link = up;
+    _regs[PHY_BMSR] = MOCK_BMSR | (up ? (PHY_BMSR_ANDONE | PHY_BMSR_LINK) : 0);
+    _regs[PHY_PHYSCSR] = (up ? PHY_PHYSCSR_AUTODONE : 0) |
+                         ((speed == 100) ? PHY_PHYSCSR_100 : PHY_PHYSCSR_10) |
+                         (full_duplex ? PHY_PHYSCSR_FULL : 0);
+    irq_restore(state);
+}
+
+void phy_mock_add_errors(uint16_t num)
+{
+    unsigned state = irq_disable();
+
+    _regs[PHY_SECR] += num;
+    irq_restore(state);
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
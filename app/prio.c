@@ -0,0 +1,394 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Thread priority plan and scheduling latency benchmark
+ * @}
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prio.h"
+#include "sched.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include "xtimer.h"
+
+/* names of the threads lwIP creates */
+#define NETDEV_NAME         "lwip_netdev_mux"
+#define TCPIP_NAME          "tcpip_thread"
+
+#define LEVELS              (PRIO_BENCH_LAST - PRIO_BENCH_FIRST + 1)
+#define FLAG_WAKE           (0x0001U)
+#define FLAG_STOP           (0x0002U)
+#define PROBE_STACKSIZE     (THREAD_STACKSIZE_MINIMUM + 256)
+#define BENCH_SECONDS       (10U)
+#define EXIT_WAIT_US        (100U * US_PER_MS)
+
+typedef struct {
+    const char *name;           /* thread name */
+    const char *macro;          /* plan macro */
+    uint8_t prio;               /* plan priority */
+    uint32_t budget_us;         /* p99 wakeup latency it needs, 0: none */
+} _entry_t;
+
+#define ENTRY(name, macro, budget)  { name, #macro, macro, budget }
+
+static const _entry_t _plan[] = {
+    ENTRY(NETDEV_NAME, PRIO_NETDEV, 100),
+    ENTRY(TCPIP_NAME, PRIO_TCPIP, 200),
+    ENTRY("qos_tx", PRIO_QOS_TX, 200),
+    ENTRY("ptp", PRIO_PTP, 500),
+    ENTRY("ctrl", PRIO_CTRL, 1000),
+    ENTRY("fwup", PRIO_FWUP, 2000),
+    ENTRY("fwup_flash", PRIO_FWUP_FLASH, 10000),
+    ENTRY("TCP server", PRIO_TCP, 2000),
+    ENTRY("UDP server", PRIO_UDP, 2000),
+    ENTRY("IP server", PRIO_IP, 2000),
+    ENTRY("http", PRIO_HTTP, 5000),
+    ENTRY("coap", PRIO_COAP, 2000),
+    ENTRY("tls", PRIO_TLS, 5000),
+    ENTRY("dtls", PRIO_TLS, 5000),
+    ENTRY("owd", PRIO_OWD, 1000),
+    ENTRY("stream", PRIO_STREAM, 2000),
+    ENTRY("connector", PRIO_STREAM, 10000),
+    ENTRY("sntp", PRIO_SNTP, 1000),
+    ENTRY("phy", PRIO_PHY, 10000),
+    ENTRY("main", PRIO_SHELL, 20000),
+    ENTRY("rsh", PRIO_RSH, 20000),
+    ENTRY("ctrl_job", PRIO_CTRL_JOB, 20000),
+    ENTRY("metrics", PRIO_METRICS, 0),
+    ENTRY("producer", PRIO_BULK, 0),
+    ENTRY("qos_bulk", PRIO_BULK, 0),
+    ENTRY("storm_bench", PRIO_BULK, 0),
+};
+
+typedef struct {
+    xtimer_t timer;
+    thread_t *thread;
+    volatile bool running;
+    uint32_t woken;             /* set by the timer interrupt */
+    unsigned numof;
+    uint32_t max;
+    uint16_t samples[PRIO_BENCH_SAMPLES];
+} _probe_t;
+
+static _probe_t _probes[LEVELS];
+static char _stacks[LEVELS][PROBE_STACKSIZE];
+static uint32_t _period;
+static volatile bool _bench_run;
+
+/* results of the last run, per level */
+static uint16_t _p50[LEVELS], _p99[LEVELS];
+
+static thread_t *_next(const char *name, kernel_pid_t *pid)
+{
+    for (; *pid <= KERNEL_PID_LAST; (*pid)++) {
+        const char *n = thread_getname(*pid);
+
+        if (n && (strcmp(n, name) == 0)) {
+            return thread_get((*pid)++);
+        }
+    }
+    return NULL;
+}
+
+int prio_set(const char *name, unsigned prio)
+{
+#ifdef DEVELHELP
+    kernel_pid_t pid = KERNEL_PID_FIRST;
+    thread_t *thread;
+    int numof = 0;
+
+    /* the lowest level belongs to the idle thread */
+    if (prio >= THREAD_PRIORITY_IDLE) {
+        return -EINVAL;
+    }
+    while ((thread = _next(name, &pid)) != NULL) {
+        sched_change_priority(thread, prio);
+        numof++;
+    }
+    return numof;
+#else
+    (void)name;
+    (void)prio;
+    return -ENOTSUP;
+#endif
+}
+
+void prio_init(void)
+{
+    /* the lwIP threads are created at their plan priority, see Makefile */
+    sched_change_priority(thread_get_active(), PRIO_SHELL);
+}
+
+/* the lwIP thread priorities are make variables, the others CFLAGS */
+static bool _is_lwip(const _entry_t *e)
+{
+    return (strcmp(e->name, NETDEV_NAME) == 0) ||
+           (strcmp(e->name, TCPIP_NAME) == 0);
+}
+
+/* -1 if no such thread runs */
+static int _current(const char *name)
+{
+    kernel_pid_t pid = KERNEL_PID_FIRST;
+    thread_t *thread = _next(name, &pid);
+
+    return thread ? thread->priority : -1;
+}
+
+static void _wake(void *arg)
+{
+    _probe_t *p = arg;
+
+    p->woken = xtimer_now_usec();
+    thread_flags_set(p->thread, FLAG_WAKE);
+}
+
+static void *_probe_thread(void *arg)
+{
+    _probe_t *p = arg;
+
+    while (!(thread_flags_wait_any(FLAG_WAKE | FLAG_STOP) & FLAG_STOP)) {
+        uint32_t latency = xtimer_now_usec() - p->woken;
+
+        if (p->numof < PRIO_BENCH_SAMPLES) {
+            p->samples[p->numof++] = MIN(latency, UINT16_MAX);
+        }
+        if (latency > p->max) {
+            p->max = latency;
+        }
+        if (_bench_run) {
+            xtimer_set(&p->timer, _period);
+        }
+    }
+    p->running = false;
+    return NULL;
+}
+
+static int _cmp_u16(const void *a, const void *b)
+{
+    return *(const uint16_t *)a - *(const uint16_t *)b;
+}
+
+static bool _busy(void)
+{
+    for (unsigned i = 0; i < LEVELS; i++) {
+        if (_probes[i].running) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* lowest level from the top down whose p99 is within the budget */
+static uint8_t _recommend(uint32_t budget_us, bool *met)
+{
+    unsigned level = 0;
+
+    *met = (_probes[0].numof > 0) && (_p99[0] <= budget_us);
+    if (!budget_us) {
+        *met = true;
+        return PRIO_BENCH_LAST;
+    }
+    while (*met && (level + 1 < LEVELS) && _probes[level + 1].numof &&
+           (_p99[level + 1] <= budget_us)) {
+        level++;
+    }
+    return PRIO_BENCH_FIRST + level;
+}
+
+/* the live priority, or "-" if no such thread runs */
+static const char *_now_str(int now, char *buf, size_t len)
+{
+    if (now < 0) {
+        return "-";
+    }
+    snprintf(buf, len, "%d", now);
+    return buf;
+}
+
+static void _print_recommendation(void)
+{
+    char buf[4];
+    bool met;
+
+    puts("thread           plan  now  budget us  p99 us  advice");
+    for (unsigned i = 0; i < ARRAY_SIZE(_plan); i++) {
+        const _entry_t *e = &_plan[i];
+        int now = _current(e->name);
+        int prio = (now < 0) ? e->prio : now;
+        uint8_t rec = _recommend(e->budget_us, &met);
+
+        printf("%-16s %4u %4s %10" PRIu32 " ", e->name, e->prio,
+               _now_str(now, buf, sizeof(buf)), e->budget_us);
+        if ((prio < PRIO_BENCH_FIRST) || (prio > PRIO_BENCH_LAST)) {
+            printf("%7s  ", "-");
+        }
+        else {
+            printf("%7u  ", _p99[prio - PRIO_BENCH_FIRST]);
+        }
+        if (!met) {
+            puts("over budget on every level");
+        }
+        else if (rec != prio) {
+            printf("move to %u\n", rec);
+        }
+        else {
+            puts("ok");
+        }
+    }
+    puts("recommended plan:");
+    for (unsigned i = 0; i < ARRAY_SIZE(_plan); i++) {
+        uint8_t rec = PRIO_BENCH_LAST;
+        bool first = true;
+
+        /* threads sharing a macro get the level of the tightest budget */
+        for (unsigned j = 0; j < ARRAY_SIZE(_plan); j++) {
+            if (strcmp(_plan[j].macro, _plan[i].macro) == 0) {
+                first = first && (j >= i);
+                rec = MIN(rec, _recommend(_plan[j].budget_us, &met));
+            }
+        }
+        if (first && _is_lwip(&_plan[i])) {
+            printf("%s = %u\n", _plan[i].macro, rec);
+        }
+        else if (first) {
+            printf("CFLAGS += -D%s=%u\n", _plan[i].macro, rec);
+        }
+    }
+}
+
+static void _stop(unsigned numof)
+{
+    _bench_run = false;
+    for (unsigned i = 0; i < numof; i++) {
+        xtimer_remove(&_probes[i].timer);
+        thread_flags_set(_probes[i].thread, FLAG_STOP);
+    }
+    for (uint32_t start = xtimer_now_usec();
+         _busy() && ((xtimer_now_usec() - start) < EXIT_WAIT_US);) {
+        xtimer_usleep(US_PER_MS);
+    }
+}
+
+static int prio_bench(unsigned seconds)
+{
+    if (_busy()) {
+        puts("error: probes of the last run still running");
+        return 1;
+    }
+    memset(_probes, 0, sizeof(_probes));
+    _period = (seconds * US_PER_SEC) / PRIO_BENCH_SAMPLES;
+    _bench_run = true;
+    for (unsigned i = 0; i < LEVELS; i++) {
+        _probe_t *p = &_probes[i];
+        kernel_pid_t pid;
+
+        p->running = true;
+        pid = thread_create(_stacks[i], sizeof(_stacks[i]),
+                            PRIO_BENCH_FIRST + i, THREAD_CREATE_STACKTEST,
+                            _probe_thread, p, "prio_probe");
+        if (pid <= KERNEL_PID_UNDEF) {
+            puts("error: could not create the probes");
+            p->running = false;
+            _stop(i);
+            return 1;
+        }
+        p->thread = thread_get(pid);
+        p->timer.callback = _wake;
+        p->timer.arg = p;
+        /* spread the wakeups, so the probes don't delay each other */
+        xtimer_set(&p->timer, _period + (i * _period) / LEVELS);
+    }
+    xtimer_sleep(seconds);
+    _stop(LEVELS);
+
+    puts("level  wakeups  p50 us  p99 us  max us");
+    for (unsigned i = 0; i < LEVELS; i++) {
+        _probe_t *p = &_probes[i];
+
+        _p50[i] = _p99[i] = 0;
+        if (p->numof) {
+            qsort(p->samples, p->numof, sizeof(p->samples[0]), _cmp_u16);
+            _p50[i] = p->samples[p->numof / 2];
+            _p99[i] = p->samples[(p->numof * 99) / 100];
+        }
+        printf("%5u %8u %7u %7u %7" PRIu32 "\n", PRIO_BENCH_FIRST + i,
+               p->numof, _p50[i], _p99[i], p->max);
+    }
+    _print_recommendation();
+    return 0;
+}
+
+static void prio_print(void)
+{
+    char buf[4];
+
+    puts("thread           plan  now  budget us");
+    for (unsigned i = 0; i < ARRAY_SIZE(_plan); i++) {
+        const _entry_t *e = &_plan[i];
+
+        printf("%-16s %4u %4s %10" PRIu32 "\n", e->name, e->prio,
+               _now_str(_current(e->name), buf, sizeof(buf)), e->budget_us);
+    }
+}
+
+int prio_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        prio_print();
+        return 0;
+    }
+    else if (strcmp(argv[1], "set") == 0) {
+        unsigned long prio;
+        int res;
+
+        if (argc < 4) {
+            printf("usage: %s set <thread> <prio>\n", argv[0]);
+            return 1;
+        }
+        prio = strtoul(argv[3], NULL, 0);
+        res = (prio < THREAD_PRIORITY_IDLE) ? prio_set(argv[2], prio)
+                                            : -EINVAL;
+        if (res == -ENOTSUP) {
+            puts("error: thread names need a build with DEVELHELP");
+            return 1;
+        }
+        if (res < 0) {
+            printf("error: priority must be below %u\n",
+                   THREAD_PRIORITY_IDLE);
+            return 1;
+        }
+        if (res == 0) {
+            printf("error: no thread %s running\n", argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+    else if (strcmp(argv[1], "bench") == 0) {
+        unsigned seconds = (argc > 2) ? strtoul(argv[2], NULL, 0)
+                                      : BENCH_SECONDS;
+
+        if (seconds == 0) {
+            printf("usage: %s bench [<seconds>]\n", argv[0]);
+            return 1;
+        }
+        return prio_bench(seconds);
+    }
+    printf("usage: %s [set <thread> <prio>|bench [<seconds>]]\n", argv[0]);
+    return 1;
+}
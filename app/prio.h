@@ -0,0 +1,175 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Thread priority plan and scheduling latency benchmark
+ *
+ * Every network related thread takes its priority from one of the
+ * PRIO_* macros below, so the whole plan can be set from the Makefile.
+ * RIOT runs the highest priority ready thread and never time slices
+ * threads of equal priority. A thread's wakeup latency therefore depends
+ * on the threads above it and on those next to it. By default the plan
+ * puts, from high to low:
+ * - the lwIP netdev thread, which takes frames out of the driver
+ * - the lwIP tcpip thread and the transmit queue thread (qos.h)
+ * - time stamping and control: PTP, the control channel, firmware update
+ * - the servers
+ * - the shell, remote shell sessions and control channel jobs
+ * - bulk senders, exporters and benchmark workers
+ *
+ * lwIP creates its threads before main(), so the Makefile hands
+ * PRIO_NETDEV and PRIO_TCPIP to lwIP as LWIP_NETDEV_PRIO and
+ * TCPIP_THREAD_PRIO; set them as make variables, not CFLAGS. @ref prio_init
+ * only moves the main thread. `prio set` changes the priority of running
+ * threads until the next reboot. Threads are found by name, which needs
+ * DEVELHELP.
+ *
+ * `prio bench` wakes one probe thread per priority level from a timer
+ * interrupt and measures how long each took to run. Run it under load,
+ * e.g. while `qos bulk` sends to tools/rr_server.py. Each thread is
+ * reported with the latencies of its level and compared to its latency
+ * budget. The recommended plan gives each thread the lowest level whose
+ * measured p99 is within its budget, printed as Makefile lines. Moving
+ * threads changes the load on the levels, so check a recommendation with
+ * `prio set` and another run.
+ * @}
+ */
+#ifndef PRIO_H
+#define PRIO_H
+
+#include <stdint.h>
+
+#include "thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Priority plan
+ * @{
+ */
+#ifndef PRIO_NETDEV
+#define PRIO_NETDEV             (THREAD_PRIORITY_MAIN - 4)  /**< lwIP netdev */
+#endif
+#ifndef PRIO_TCPIP
+#define PRIO_TCPIP              (THREAD_PRIORITY_MAIN - 3)  /**< lwIP tcpip */
+#endif
+#ifndef PRIO_QOS_TX
+#define PRIO_QOS_TX             (THREAD_PRIORITY_MAIN - 3)  /**< qos_tx */
+#endif
+#ifndef PRIO_PTP
+#define PRIO_PTP                (THREAD_PRIORITY_MAIN - 2)  /**< ptp */
+#endif
+#ifndef PRIO_CTRL
+#define PRIO_CTRL               (THREAD_PRIORITY_MAIN - 2)  /**< ctrl */
+#endif
+#ifndef PRIO_FWUP
+#define PRIO_FWUP               (THREAD_PRIORITY_MAIN - 2)  /**< fwup */
+#endif
+#ifndef PRIO_FWUP_FLASH
+#define PRIO_FWUP_FLASH         (THREAD_PRIORITY_MAIN - 1)  /**< fwup_flash */
+#endif
+#ifndef PRIO_TCP
+#define PRIO_TCP                (THREAD_PRIORITY_MAIN - 1)  /**< TCP server */
+#endif
+#ifndef PRIO_UDP
+#define PRIO_UDP                (THREAD_PRIORITY_MAIN - 1)  /**< UDP server */
+#endif
+#ifndef PRIO_IP
+#define PRIO_IP                 (THREAD_PRIORITY_MAIN - 1)  /**< IP server */
+#endif
+#ifndef PRIO_HTTP
+#define PRIO_HTTP               (THREAD_PRIORITY_MAIN - 1)  /**< http */
+#endif
+#ifndef PRIO_COAP
+#define PRIO_COAP               (THREAD_PRIORITY_MAIN - 1)  /**< coap */
+#endif
+#ifndef PRIO_TLS
+#define PRIO_TLS                (THREAD_PRIORITY_MAIN - 1)  /**< tls, dtls */
+#endif
+#ifndef PRIO_OWD
+#define PRIO_OWD                (THREAD_PRIORITY_MAIN - 1)  /**< owd */
+#endif
+#ifndef PRIO_STREAM
+#define PRIO_STREAM             (THREAD_PRIORITY_MAIN - 1)  /**< stream */
+#endif
+#ifndef PRIO_SNTP
+#define PRIO_SNTP               (THREAD_PRIORITY_MAIN - 1)  /**< sntp */
+#endif
+#ifndef PRIO_PHY
+#define PRIO_PHY                (THREAD_PRIORITY_MAIN - 1)  /**< phy */
+#endif
+#ifndef PRIO_SHELL
+#define PRIO_SHELL              (THREAD_PRIORITY_MAIN)      /**< main */
+#endif
+#ifndef PRIO_RSH
+#define PRIO_RSH                (THREAD_PRIORITY_MAIN)      /**< rsh */
+#endif
+#ifndef PRIO_CTRL_JOB
+#define PRIO_CTRL_JOB           (THREAD_PRIORITY_MAIN)      /**< ctrl_job */
+#endif
+#ifndef PRIO_METRICS
+#define PRIO_METRICS            (THREAD_PRIORITY_MAIN + 1)  /**< metrics */
+#endif
+#ifndef PRIO_BULK
+#define PRIO_BULK               (THREAD_PRIORITY_MAIN + 1)  /**< bulk, bench */
+#endif
+/** @} */
+
+/**
+ * @brief   Benchmark configuration
+ * @{
+ */
+#ifndef PRIO_BENCH_FIRST
+#define PRIO_BENCH_FIRST        (THREAD_PRIORITY_MAIN - 5)  /**< top level */
+#endif
+#ifndef PRIO_BENCH_LAST
+#define PRIO_BENCH_LAST         (THREAD_PRIORITY_MAIN + 1)  /**< bottom level */
+#endif
+#ifndef PRIO_BENCH_SAMPLES
+#define PRIO_BENCH_SAMPLES      (500U)      /**< wakeups per level and run */
+#endif
+/** @} */
+
+/**
+ * @brief   Move the main thread to its plan priority
+ */
+void prio_init(void);
+
+/**
+ * @brief   Change the priority of all running threads named @p name
+ *
+ * @param[in] name      thread name
+ * @param[in] prio      new priority
+ *
+ * @return  number of threads changed
+ * @return  -EINVAL if @p prio is not a valid priority
+ * @return  -ENOTSUP without DEVELHELP, threads have no names then
+ */
+int prio_set(const char *name, unsigned prio);
+
+/**
+ * @brief   Priority plan shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int prio_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PRIO_H */
+/** @} */
@@ -0,0 +1,887 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       IEEE 1588 (PTPv2) slave-only ordinary clock
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "byteorder.h"
+#include "lwip/netif.h"
+#include "mutex.h"
+#include "netdev_hook.h"
+#include "prio.h"
+#include "ptp_slave.h"
+#include "rxfilter.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include "xtimer.h"
+
+#if defined(MODULE_STM32_ETH) && defined(MODULE_PERIPH_PTP)
+#define PTP_HW
+#include "cpu.h"
+#include "periph/ptp.h"
+#endif
+
+#define ETH_ADDR_LEN        (6U)
+#define ETH_HDR_LEN         (14U)
+#define ETH_TYPE_OFFSET     (12U)
+#define ETH_TYPE_PTP        (0x88F7U)
+#define ETH_FRAME_MIN       (60U)
+
+#define MSG_SYNC            (0x0U)
+#define MSG_DELAY_REQ       (0x1U)
+#define MSG_PDELAY_REQ      (0x2U)
+#define MSG_PDELAY_RESP     (0x3U)
+#define MSG_FOLLOW_UP       (0x8U)
+#define MSG_DELAY_RESP      (0x9U)
+#define MSG_PDELAY_RESP_FUP (0xAU)
+#define MSG_ANNOUNCE        (0xBU)
+
+#define CTRL_SYNC           (0U)
+#define CTRL_DELAY_REQ      (1U)
+#define CTRL_FOLLOW_UP      (2U)
+#define CTRL_DELAY_RESP     (3U)
+#define CTRL_OTHER          (5U)
+
+#define FLAG0_TWO_STEP      (0x02U)
+#define FLAG1_UTC_VALID     (0x04U)
+#define LOG_UNSPECIFIED     (0x7F)
+
+#define HDR_LEN             (34U)
+#define TS_LEN              (10U)
+#define PORT_ID_LEN         (10U)
+#define SYNC_LEN            (44U)   /* also Delay_Req and Follow_Up */
+#define DELAY_RESP_LEN      (54U)   /* also the Pdelay messages */
+#define ANNOUNCE_LEN        (64U)
+#define MSG_LEN_MAX         (ANNOUNCE_LEN)
+#define UTC_OFFSET          (HDR_LEN + 10U)
+#define DS_OFFSET           (HDR_LEN + 13U)     /* BMCA fields of Announce */
+#define DS_LEN              (14U)
+
+#define SEC_NS              (1000000000LL)
+#define TAI_UTC_DEFAULT     (37)    /* until an Announce tells otherwise */
+#define FLAG_RX             (0x0001U)
+#define TICK_US             (100U * US_PER_MS)
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;                   /* transportSpecific, messageType */
+    uint8_t version;
+    network_uint16_t length;
+    uint8_t domain;
+    uint8_t reserved1;
+    uint8_t flags[2];
+    network_uint64_t correction;    /* ns * 2^16 */
+    uint8_t reserved2[4];
+    uint8_t port_id[PORT_ID_LEN];   /* clock identity and port number */
+    network_uint16_t seq;
+    uint8_t control;
+    int8_t log_interval;
+} _hdr_t;
+
+typedef struct {
+    uint8_t msg[MSG_LEN_MAX];
+    uint8_t len;
+    uint64_t ts;
+} _rx_slot_t;
+
+typedef enum {
+    PD_IDLE,
+    PD_WAIT_RESP,
+    PD_WAIT_FUP,
+} _pd_state_t;
+
+static const uint8_t _e2e_mac[ETH_ADDR_LEN] = {
+    0x01, 0x1b, 0x19, 0x00, 0x00, 0x00
+};
+static const uint8_t _p2p_mac[ETH_ADDR_LEN] = {
+    0x01, 0x80, 0xc2, 0x00, 0x00, 0x0e
+};
+static const char *_state_names[] = {
+    [PTP_STATE_LISTENING] = "listening",
+    [PTP_STATE_UNCALIBRATED] = "uncalibrated",
+    [PTP_STATE_SLAVE] = "slave",
+};
+
+static ptp_slave_stats_t _stats;
+static ptp_delay_mech_t _mech;
+static bool _running;
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+static thread_t *_thread;
+static netdev_hook_t _hook;
+static netdev_t *_dev;
+static uint8_t _mac[ETH_ADDR_LEN];
+static uint8_t _port_id[PORT_ID_LEN];
+static uint8_t _tx_frame[ETH_HDR_LEN + DELAY_RESP_LEN];
+
+/* filled by the RX hook, drained by the thread */
+static mutex_t _lock = MUTEX_INIT;
+static _rx_slot_t _rx_queue[PTP_RX_QUEUE];
+static unsigned _rx_head, _rx_tail;
+
+/* master */
+static uint8_t _master[PORT_ID_LEN];
+static uint8_t _master_ds[DS_LEN];
+static uint32_t _announce_at;
+static int8_t _announce_log;
+static int8_t _sync_log;
+static int16_t _utc_offset = TAI_UTC_DEFAULT;
+
+/* Sync: t2 - t1 - correction of the last one, waiting for its Follow_Up */
+static int64_t _ms;
+static bool _ms_valid;
+static bool _sync_pending;
+static uint16_t _sync_seq;
+static uint64_t _sync_t2;
+static int64_t _sync_corr;
+
+/* end-to-end */
+static bool _req_pending;
+static uint16_t _req_seq;
+static uint64_t _req_t3;
+static int64_t _req_ms;
+
+/* peer-to-peer */
+static _pd_state_t _pd_state;
+static uint16_t _pd_seq;
+static uint32_t _pd_sent;
+static uint8_t _pd_peer[PORT_ID_LEN];
+static uint64_t _pd_t1, _pd_t2, _pd_t4;
+static int64_t _pd_corr;
+
+/* servo */
+static int64_t _delay;
+static bool _have_delay;
+static bool _stepped;
+static int64_t _integral;
+static unsigned _locked;
+
+#ifdef PTP_HW
+#define DESC_OWN            (0x80000000UL)
+#define TDES0_TTSS          (0x00020000UL)
+#define RING_MAX            (32U)
+#define TX_WAIT_US          (1000U)
+
+/* enhanced DMA descriptor, RM0090 33.6.7 and 33.6.8 */
+typedef struct {
+    volatile uint32_t status;
+    volatile uint32_t control;
+    volatile uint32_t buf1;
+    volatile uint32_t next;         /* chained mode */
+    volatile uint32_t ext;
+    volatile uint32_t reserved;
+    volatile uint32_t ts_low;
+    volatile uint32_t ts_high;
+} _desc_t;
+
+static uint64_t _clock_read(void)
+{
+    return ptp_clock_read_u64();
+}
+
+static void _clock_step(int64_t ns)
+{
+    ptp_clock_adjust(ns);
+}
+
+static void _clock_rate(int32_t ppb)
+{
+    /* the speed becomes (1 + correction / 2^32) times the nominal one */
+    ptp_clock_adjust_speed(((int64_t)ppb << 32) / SEC_NS);
+}
+
+static uint64_t _desc_ts(const _desc_t *d)
+{
+    uint64_t sub = d->ts_low & 0x7fffffffUL;
+
+    /* binary roll over counts 2^31 per second */
+    if (!(ETH->PTPTSCR & ETH_PTPTSCR_TSSSR)) {
+        sub = (sub * SEC_NS) >> 31;
+    }
+    return d->ts_high * SEC_NS + sub;
+}
+
+/* The driver released the descriptor already, but the DMA writes it again
+ * only for a later frame. The message, with its sequence number, tells
+ * which descriptor it arrived in. */
+static bool _rx_hw_stamp(const uint8_t *msg, size_t len, uint64_t *ts)
+{
+    const _desc_t *first = (const _desc_t *)(uintptr_t)ETH->DMARDLAR;
+    const _desc_t *d = first;
+
+    for (unsigned i = 0; (i < RING_MAX) && d; i++) {
+        const uint8_t *buf = (const uint8_t *)(uintptr_t)d->buf1;
+
+        if ((d->ts_low | d->ts_high) &&
+            (memcmp(buf + ETH_HDR_LEN, msg, len) == 0)) {
+            *ts = _desc_ts(d);
+            return true;
+        }
+        if ((d = (const _desc_t *)(uintptr_t)d->next) == first) {
+            break;
+        }
+    }
+    return false;
+}
+
+/* Only frames the driver sent with TTSE get a time stamp. Stamps are
+ * cleared once read, so an old one is never taken for the frame just
+ * sent. */
+static bool _tx_hw_stamp(uint64_t *ts)
+{
+    _desc_t *first = (_desc_t *)(uintptr_t)ETH->DMATDLAR;
+    uint32_t start = xtimer_now_usec();
+    bool busy;
+
+    do {
+        _desc_t *d = first;
+
+        busy = false;
+        for (unsigned i = 0; (i < RING_MAX) && d; i++) {
+            uint32_t status = d->status;
+
+            if (status & DESC_OWN) {
+                busy = true;
+            }
+            else if ((status & TDES0_TTSS) && (d->ts_low | d->ts_high)) {
+                *ts = _desc_ts(d);
+                d->ts_low = d->ts_high = 0;
+                return true;
+            }
+            if ((d = (_desc_t *)(uintptr_t)d->next) == first) {
+                break;
+            }
+        }
+    } while (busy && ((xtimer_now_usec() - start) < TX_WAIT_US));
+    return false;
+}
+#else
+/* software clock on the xtimer, in ns */
+static mutex_t _clock_lock = MUTEX_INIT;
+static uint64_t _base_local;
+static uint64_t _base;
+static int32_t _ppb;
+
+static uint64_t _clock_at(uint64_t local)
+{
+    int64_t dt = local - _base_local;
+
+    /* in us steps, so long gaps between updates don't overflow */
+    return _base + dt + ((dt / 1000) * _ppb) / 1000000;
+}
+
+static uint64_t _clock_read(void)
+{
+    uint64_t now;
+
+    mutex_lock(&_clock_lock);
+    now = _clock_at(xtimer_now_usec64() * 1000);
+    mutex_unlock(&_clock_lock);
+    return now;
+}
+
+static void _clock_rebase(void)
+{
+    uint64_t local = xtimer_now_usec64() * 1000;
+
+    _base = _clock_at(local);
+    _base_local = local;
+}
+
+static void _clock_step(int64_t ns)
+{
+    mutex_lock(&_clock_lock);
+    _clock_rebase();
+    _base += ns;
+    mutex_unlock(&_clock_lock);
+}
+
+static void _clock_rate(int32_t ppb)
+{
+    mutex_lock(&_clock_lock);
+    _clock_rebase();
+    _ppb = ppb;
+    mutex_unlock(&_clock_lock);
+}
+#endif
+
+static uint64_t _get_ts(const uint8_t *p)
+{
+    uint64_t sec = 0;
+    uint32_t ns = 0;
+
+    for (unsigned i = 0; i < 6; i++) {
+        sec = (sec << 8) | p[i];
+    }
+    for (unsigned i = 6; i < TS_LEN; i++) {
+        ns = (ns << 8) | p[i];
+    }
+    return sec * SEC_NS + ns;
+}
+
+static void _put_ts(uint8_t *p, uint64_t ts)
+{
+    uint64_t sec = ts / SEC_NS;
+    uint32_t ns = ts % SEC_NS;
+
+    for (int i = 5; i >= 0; i--, sec >>= 8) {
+        p[i] = sec;
+    }
+    for (int i = TS_LEN - 1; i >= 6; i--, ns >>= 8) {
+        p[i] = ns;
+    }
+}
+
+static int64_t _correction(const _hdr_t *hdr)
+{
+    return (int64_t)byteorder_ntohll(hdr->correction) / 65536;
+}
+
+static int32_t _clamp32(int64_t v)
+{
+    return MAX(MIN(v, INT32_MAX), INT32_MIN);
+}
+
+static uint32_t _log_us(int8_t log)
+{
+    if ((log == LOG_UNSPECIFIED) || (log > 7) || (log < -7)) {
+        log = 0;
+    }
+    return (log >= 0) ? (US_PER_SEC << log) : (US_PER_SEC >> -log);
+}
+
+static int _rx(netdev_hook_t *hook, netdev_t *dev, uint8_t *frame, size_t len)
+{
+    /* software stamp first, before anything else delays it */
+    uint64_t ts = _clock_read();
+    bool hw = false;
+    size_t n;
+
+    (void)hook;
+    (void)dev;
+    if ((len < ETH_HDR_LEN + HDR_LEN) ||
+        (((frame[ETH_TYPE_OFFSET] << 8) | frame[ETH_TYPE_OFFSET + 1]) !=
+         ETH_TYPE_PTP)) {
+        return len;
+    }
+    n = MIN(len - ETH_HDR_LEN, MSG_LEN_MAX);
+#ifdef PTP_HW
+    hw = _rx_hw_stamp(frame + ETH_HDR_LEN, n, &ts);
+#endif
+    mutex_lock(&_lock);
+    if ((_rx_tail - _rx_head) >= PTP_RX_QUEUE) {
+        _stats.rx_dropped++;
+    }
+    else {
+        _rx_slot_t *slot = &_rx_queue[_rx_tail++ % PTP_RX_QUEUE];
+
+        memcpy(slot->msg, frame + ETH_HDR_LEN, n);
+        slot->len = n;
+        slot->ts = ts;
+        if (hw) {
+            _stats.rx_hw++;
+        }
+        else {
+            _stats.rx_sw++;
+        }
+    }
+    mutex_unlock(&_lock);
+    thread_flags_set(_thread, FLAG_RX);
+    /* lwIP has no use for PTP frames */
+    return 0;
+}
+
+static bool _dequeue(_rx_slot_t *slot)
+{
+    bool res = false;
+
+    mutex_lock(&_lock);
+    if (_rx_head != _rx_tail) {
+        *slot = _rx_queue[_rx_head++ % PTP_RX_QUEUE];
+        res = true;
+    }
+    mutex_unlock(&_lock);
+    return res;
+}
+
+static _hdr_t *_tx_init(uint8_t type, const uint8_t *dst, uint16_t seq)
+{
+    static const uint8_t controls[] = {
+        [MSG_SYNC] = CTRL_SYNC, [MSG_DELAY_REQ] = CTRL_DELAY_REQ,
+        [MSG_PDELAY_REQ] = CTRL_OTHER, [MSG_PDELAY_RESP] = CTRL_OTHER,
+        [MSG_FOLLOW_UP] = CTRL_FOLLOW_UP, [MSG_DELAY_RESP] = CTRL_DELAY_RESP,
+        [MSG_PDELAY_RESP_FUP] = CTRL_OTHER, [MSG_ANNOUNCE] = CTRL_OTHER,
+    };
+    _hdr_t *hdr = (_hdr_t *)(_tx_frame + ETH_HDR_LEN);
+    size_t len = ((type == MSG_DELAY_REQ) || (type == MSG_SYNC))
+                 ? SYNC_LEN : DELAY_RESP_LEN;
+
+    memset(_tx_frame, 0, sizeof(_tx_frame));
+    memcpy(_tx_frame, dst, ETH_ADDR_LEN);
+    memcpy(_tx_frame + ETH_ADDR_LEN, _mac, ETH_ADDR_LEN);
+    _tx_frame[ETH_TYPE_OFFSET] = ETH_TYPE_PTP >> 8;
+    _tx_frame[ETH_TYPE_OFFSET + 1] = ETH_TYPE_PTP & 0xff;
+    hdr->type = type;
+    hdr->version = 2;
+    hdr->length = byteorder_htons(len);
+    hdr->domain = PTP_DOMAIN;
+    memcpy(hdr->port_id, _port_id, PORT_ID_LEN);
+    hdr->seq = byteorder_htons(seq);
+    hdr->control = controls[type];
+    hdr->log_interval = (type == MSG_PDELAY_REQ) ? PTP_PDELAY_LOG_INTERVAL
+                                                 : LOG_UNSPECIFIED;
+    return hdr;
+}
+
+/* sends the message in _tx_frame, returns its time stamp */
+static uint64_t _tx(void)
+{
+    const _hdr_t *hdr = (const _hdr_t *)(_tx_frame + ETH_HDR_LEN);
+    iolist_t iol = {
+        .iol_next = NULL,
+        .iol_base = _tx_frame,
+        .iol_len = MAX(ETH_HDR_LEN + byteorder_ntohs(hdr->length),
+                       ETH_FRAME_MIN),
+    };
+    uint64_t ts = _clock_read();
+
+    netdev_hook_send(_dev, &iol);
+#ifdef PTP_HW
+    if (_tx_hw_stamp(&ts)) {
+        _stats.tx_hw++;
+        return ts;
+    }
+#endif
+    _stats.tx_sw++;
+    return ts;
+}
+
+static void _lost_master(void)
+{
+    memset(_master, 0, sizeof(_master));
+    _stats.state = PTP_STATE_LISTENING;
+    _sync_pending = false;
+    _ms_valid = false;
+    _req_pending = false;
+    _have_delay = (_mech == PTP_DELAY_P2P) && _have_delay;
+    _locked = 0;
+}
+
+/* measurements spanning a step are wrong by the step */
+static void _invalidate(void)
+{
+    _sync_pending = false;
+    _ms_valid = false;
+    _req_pending = false;
+    _pd_state = PD_IDLE;
+}
+
+static void _servo(int64_t offset)
+{
+    int64_t p, i, freq;
+    uint32_t abs_offset;
+
+    _stats.offset_ns = _clamp32(offset);
+    if (!_stepped || (offset > PTP_STEP_NS) || (offset < -PTP_STEP_NS)) {
+        _clock_step(-offset);
+        _stepped = true;
+        _stats.steps++;
+        _stats.state = PTP_STATE_UNCALIBRATED;
+        _locked = 0;
+        _invalidate();
+        return;
+    }
+    /* PI with kp 0.7 and ki 0.3 per second of Sync interval: an offset
+     * of x ns is taken out in a second with x ppb */
+    p = (offset * 7) / 10;
+    i = (offset * 3) / 10;
+    _integral += (_sync_log >= 0) ? i * (1 << _sync_log)
+                                  : i / (1 << -_sync_log);
+    _integral = MAX(MIN(_integral, PTP_FREQ_MAX_PPB), -PTP_FREQ_MAX_PPB);
+    freq = MAX(MIN(-(p + _integral), PTP_FREQ_MAX_PPB), -PTP_FREQ_MAX_PPB);
+    _clock_rate(freq);
+    _stats.freq_ppb = freq;
+
+    abs_offset = MIN((offset < 0) ? -offset : offset, UINT32_MAX);
+    if (_stats.state == PTP_STATE_UNCALIBRATED) {
+        _locked = (abs_offset < PTP_LOCK_NS) ? _locked + 1 : 0;
+        if (_locked >= PTP_LOCK_SAMPLES) {
+            _stats.state = PTP_STATE_SLAVE;
+        }
+    }
+    if (_stats.state == PTP_STATE_SLAVE) {
+        _stats.samples++;
+        _stats.offset_total_ns += abs_offset;
+        _stats.offset_max_ns = MAX(_stats.offset_max_ns, abs_offset);
+    }
+}
+
+static void _path_delay(int64_t delay)
+{
+    if (_have_delay) {
+        _delay += (delay - _delay) / PTP_DELAY_FILTER;
+    }
+    else {
+        _delay = delay;
+        _have_delay = true;
+    }
+    _stats.path_delay_ns = _clamp32(_delay);
+    _stats.delay_resps++;
+}
+
+static void _delay_req(void)
+{
+    _tx_init(MSG_DELAY_REQ, _e2e_mac, ++_req_seq);
+    _req_t3 = _tx();
+    _req_ms = _ms;
+    _req_pending = true;
+    _stats.delay_reqs++;
+}
+
+static void _pdelay_req(void)
+{
+    _tx_init(MSG_PDELAY_REQ, _p2p_mac, ++_pd_seq);
+    _pd_t1 = _tx();
+    _pd_state = PD_WAIT_RESP;
+    _pd_sent = xtimer_now_usec();
+    _stats.delay_reqs++;
+}
+
+/* t1 is the master's send time, corr the correction fields */
+static void _sample(uint64_t t1, uint64_t t2, int64_t corr)
+{
+    _ms = (int64_t)(t2 - t1) - corr;
+    _ms_valid = true;
+    /* the first sample sets the clock even before the delay is known */
+    if (_have_delay || !_stepped) {
+        _servo(_ms - (_have_delay ? _delay : 0));
+    }
+    if ((_mech == PTP_DELAY_E2E) && _ms_valid && !_req_pending) {
+        _delay_req();
+    }
+}
+
+static void _announce(const _hdr_t *hdr, const uint8_t *msg)
+{
+    const uint8_t *ds = msg + DS_OFFSET;
+    bool current = (_stats.state != PTP_STATE_LISTENING) &&
+                   (memcmp(hdr->port_id, _master, PORT_ID_LEN) == 0);
+
+    _stats.announces++;
+    /* the dataset fields are in the order the BMCA compares them */
+    if (!current && (_stats.state != PTP_STATE_LISTENING) &&
+        (memcmp(ds, _master_ds, DS_LEN) >= 0)) {
+        return;
+    }
+    if (!current) {
+        _lost_master();
+        memcpy(_master, hdr->port_id, PORT_ID_LEN);
+        _stats.state = PTP_STATE_UNCALIBRATED;
+        _stepped = false;
+    }
+    memcpy(_master_ds, ds, DS_LEN);
+    _announce_at = xtimer_now_usec();
+    _announce_log = hdr->log_interval;
+    if (hdr->flags[1] & FLAG1_UTC_VALID) {
+        _utc_offset = (int16_t)((msg[UTC_OFFSET] << 8) | msg[UTC_OFFSET + 1]);
+    }
+}
+
+static void _pdelay_resp(const _hdr_t *req, uint64_t t2)
+{
+    uint8_t requester[PORT_ID_LEN];
+    uint16_t seq = byteorder_ntohs(req->seq);
+    network_uint64_t corr = req->correction;
+    _hdr_t *hdr;
+    uint64_t t3;
+
+    /* _tx_init() reuses the frame buffer, not the received message */
+    memcpy(requester, req->port_id, PORT_ID_LEN);
+    hdr = _tx_init(MSG_PDELAY_RESP, _p2p_mac, seq);
+    hdr->flags[0] = FLAG0_TWO_STEP;
+    _put_ts((uint8_t *)hdr + HDR_LEN, t2);
+    memcpy((uint8_t *)hdr + HDR_LEN + TS_LEN, requester, PORT_ID_LEN);
+    t3 = _tx();
+    hdr = _tx_init(MSG_PDELAY_RESP_FUP, _p2p_mac, seq);
+    hdr->correction = corr;
+    _put_ts((uint8_t *)hdr + HDR_LEN, t3);
+    memcpy((uint8_t *)hdr + HDR_LEN + TS_LEN, requester, PORT_ID_LEN);
+    _tx();
+}
+
+static void _handle(const _rx_slot_t *slot)
+{
+    const _hdr_t *hdr = (const _hdr_t *)slot->msg;
+    const uint8_t *body = slot->msg + HDR_LEN;
+    uint16_t seq = byteorder_ntohs(hdr->seq);
+    bool from_master = (_stats.state != PTP_STATE_LISTENING) &&
+                       (memcmp(hdr->port_id, _master, PORT_ID_LEN) == 0);
+    bool for_us = (slot->len >= DELAY_RESP_LEN) &&
+                  (memcmp(body + TS_LEN, _port_id, PORT_ID_LEN) == 0);
+
+    if (((hdr->version & 0x0f) != 2) || (hdr->domain != PTP_DOMAIN)) {
+        return;
+    }
+    switch (hdr->type & 0x0f) {
+    case MSG_ANNOUNCE:
+        if (slot->len >= ANNOUNCE_LEN) {
+            _announce(hdr, slot->msg);
+        }
+        break;
+    case MSG_SYNC:
+        if (!from_master || (slot->len < SYNC_LEN)) {
+            break;
+        }
+        _stats.syncs++;
+        _sync_log = hdr->log_interval;
+        if ((_sync_log == LOG_UNSPECIFIED) || (_sync_log > 7) ||
+            (_sync_log < -7)) {
+            _sync_log = 0;
+        }
+        if (hdr->flags[0] & FLAG0_TWO_STEP) {
+            _sync_seq = seq;
+            _sync_t2 = slot->ts;
+            _sync_corr = _correction(hdr);
+            _sync_pending = true;
+        }
+        else {
+            _sample(_get_ts(body), slot->ts, _correction(hdr));
+        }
+        break;
+    case MSG_FOLLOW_UP:
+        if (from_master && _sync_pending && (seq == _sync_seq) &&
+            (slot->len >= SYNC_LEN)) {
+            _sync_pending = false;
+            _sample(_get_ts(body), _sync_t2, _sync_corr + _correction(hdr));
+        }
+        break;
+    case MSG_DELAY_RESP:
+        if (from_master && for_us && _req_pending && (seq == _req_seq)) {
+            /* t4 - t3 - correction is the slave-to-master delay */
+            int64_t sm = (int64_t)(_get_ts(body) - _req_t3) -
+                         _correction(hdr);
+
+            _req_pending = false;
+            _path_delay((_req_ms + sm) / 2);
+        }
+        break;
+    case MSG_PDELAY_REQ:
+        if ((_mech == PTP_DELAY_P2P) && (slot->len >= DELAY_RESP_LEN)) {
+            _pdelay_resp(hdr, slot->ts);
+        }
+        break;
+    case MSG_PDELAY_RESP:
+        if (!for_us || (_pd_state != PD_WAIT_RESP) || (seq != _pd_seq)) {
+            break;
+        }
+        _pd_t4 = slot->ts;
+        _pd_t2 = _get_ts(body);
+        _pd_corr = _correction(hdr);
+        if (hdr->flags[0] & FLAG0_TWO_STEP) {
+            memcpy(_pd_peer, hdr->port_id, PORT_ID_LEN);
+            _pd_state = PD_WAIT_FUP;
+        }
+        else {
+            /* the turnaround time is in the correction */
+            _pd_state = PD_IDLE;
+            _path_delay(((int64_t)(_pd_t4 - _pd_t1) - _pd_corr) / 2);
+        }
+        break;
+    case MSG_PDELAY_RESP_FUP:
+        if (for_us && (_pd_state == PD_WAIT_FUP) && (seq == _pd_seq) &&
+            (memcmp(hdr->port_id, _pd_peer, PORT_ID_LEN) == 0)) {
+            int64_t turnaround = _get_ts(body) - _pd_t2;
+
+            _pd_state = PD_IDLE;
+            _path_delay(((int64_t)(_pd_t4 - _pd_t1) - turnaround -
+                         _pd_corr - _correction(hdr)) / 2);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void _periodic(void)
+{
+    uint32_t now = xtimer_now_usec();
+
+    if ((_stats.state != PTP_STATE_LISTENING) &&
+        ((now - _announce_at) >
+         _log_us(_announce_log) * PTP_ANNOUNCE_TIMEOUT)) {
+        _lost_master();
+        _stats.timeouts++;
+    }
+    /* an answer still missing by now is lost */
+    if ((_mech == PTP_DELAY_P2P) &&
+        ((now - _pd_sent) >= _log_us(PTP_PDELAY_LOG_INTERVAL))) {
+        _pdelay_req();
+    }
+}
+
+static thread_flags_t _wait(thread_flags_t mask, uint32_t timeout)
+{
+    xtimer_t timer;
+    thread_flags_t flags;
+
+    xtimer_set_timeout_flag(&timer, timeout);
+    flags = thread_flags_wait_any(mask | THREAD_FLAG_TIMEOUT);
+    xtimer_remove(&timer);
+    thread_flags_clear(THREAD_FLAG_TIMEOUT);
+    return flags;
+}
+
+static void *_ptp_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        _rx_slot_t slot;
+
+        _wait(FLAG_RX, TICK_US);
+        while (_dequeue(&slot)) {
+            _handle(&slot);
+        }
+        _periodic();
+    }
+    return NULL;
+}
+
+int ptp_slave_start(ptp_delay_mech_t mech)
+{
+    struct netif *netif = netdev_hook_netif();
+    kernel_pid_t pid;
+
+    if (_running) {
+        return -EALREADY;
+    }
+    if (netif == NULL) {
+        return -ENODEV;
+    }
+    _dev = netif->state;
+    memcpy(_mac, netif->hwaddr, ETH_ADDR_LEN);
+    /* EUI-64 clock identity from the MAC address, port 1 */
+    memcpy(_port_id, _mac, 3);
+    _port_id[3] = 0xff;
+    _port_id[4] = 0xfe;
+    memcpy(_port_id + 5, _mac + 3, 3);
+    _port_id[9] = 1;
+    _mech = mech;
+#ifdef PTP_HW
+    /* snapshot every received frame, the descriptors carry the stamps */
+    ETH->PTPTSCR |= ETH_PTPTSCR_TSSARFE;
+#endif
+    rxfilter_mac_add(_e2e_mac);
+    rxfilter_mac_add(_p2p_mac);
+    _running = true;
+    pid = thread_create(_stack, sizeof(_stack), PRIO_PTP,
+                        THREAD_CREATE_STACKTEST, _ptp_thread, NULL, "ptp");
+    if (pid <= KERNEL_PID_UNDEF) {
+        return -ENOMEM;
+    }
+    _thread = thread_get(pid);
+    _hook.rx = _rx;
+    netdev_hook_add(&_hook);
+    return 0;
+}
+
+const ptp_slave_stats_t *ptp_slave_stats(void)
+{
+    return &_stats;
+}
+
+int ptp_slave_now(uint64_t *utc_ns)
+{
+    if (_stats.state != PTP_STATE_SLAVE) {
+        return -EAGAIN;
+    }
+    *utc_ns = _clock_read() - _utc_offset * SEC_NS;
+    return 0;
+}
+
+static void _print(void)
+{
+    const ptp_slave_stats_t *s = &_stats;
+
+    printf("%s, %s delay, %s time stamps\n", _state_names[s->state],
+           (_mech == PTP_DELAY_P2P) ? "peer-to-peer" : "end-to-end",
+#ifdef PTP_HW
+           "MAC"
+#else
+           "software"
+#endif
+           );
+    if (s->state != PTP_STATE_LISTENING) {
+        printf("master %02x%02x%02x.%02x%02x.%02x%02x%02x-%u, UTC offset "
+               "%d s\n", _master[0], _master[1], _master[2], _master[3],
+               _master[4], _master[5], _master[6], _master[7],
+               (_master[8] << 8) | _master[9], _utc_offset);
+    }
+    printf("offset %" PRId32 " ns, path delay %" PRId32 " ns, frequency %"
+           PRId32 " ppb\n", s->offset_ns, s->path_delay_ns, s->freq_ppb);
+    if (s->samples) {
+        printf("locked: %" PRIu32 " samples, |offset| avg %" PRIu32
+               " ns, max %" PRIu32 " ns\n", s->samples,
+               (uint32_t)(s->offset_total_ns / s->samples), s->offset_max_ns);
+    }
+    printf("%" PRIu32 " announce, %" PRIu32 " sync, %" PRIu32 " delay req, %"
+           PRIu32 " delay resp, %" PRIu32 " timeouts, %" PRIu32 " steps\n",
+           s->announces, s->syncs, s->delay_reqs, s->delay_resps,
+           s->timeouts, s->steps);
+    printf("stamps rx %" PRIu32 " MAC, %" PRIu32 " sw, tx %" PRIu32 " MAC, %"
+           PRIu32 " sw, %" PRIu32 " dropped\n", s->rx_hw, s->rx_sw, s->tx_hw,
+           s->tx_sw, s->rx_dropped);
+}
+
+int ptp_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        _print();
+        return 0;
+    }
+    else if (strcmp(argv[1], "start") == 0) {
+        ptp_delay_mech_t mech = PTP_DELAY_E2E;
+        int res;
+
+        if ((argc > 2) && (strcmp(argv[2], "p2p") == 0)) {
+            mech = PTP_DELAY_P2P;
+        }
+        else if ((argc > 2) && (strcmp(argv[2], "e2e") != 0)) {
+            printf("usage: %s start [e2e|p2p]\n", argv[0]);
+            return 1;
+        }
+        if ((res = ptp_slave_start(mech)) < 0) {
+            printf("error: unable to start PTP slave (error code %d)\n",
+                   -res);
+            return 1;
+        }
+        return 0;
+    }
+    else if (strcmp(argv[1], "reset") == 0) {
+        ptp_slave_stats_t keep = _stats;
+
+        /* counters only, the servo state stays */
+        memset(&_stats, 0, sizeof(_stats));
+        _stats.state = keep.state;
+        _stats.offset_ns = keep.offset_ns;
+        _stats.path_delay_ns = keep.path_delay_ns;
+        _stats.freq_ppb = keep.freq_ppb;
+        return 0;
+    }
+    printf("usage: %s [start [e2e|p2p]|reset]\n", argv[0]);
+    return 1;
+}
+
+/** @} */
@@ -0,0 +1,171 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       IEEE 1588 (PTPv2) slave-only ordinary clock
+ *
+ * PTP event and general messages are exchanged over IEEE 802.3 (EtherType
+ * 0x88F7, IEEE 1588 annex F) through a netdev hook, so lwIP never sees
+ * them. The master is chosen from the Announce messages by the dataset
+ * comparison of the best master clock algorithm. Sync and Follow_Up
+ * messages are handled both one-step and two-step. The path delay comes
+ * from either:
+ * - the end-to-end mechanism: a Delay_Req to the master after every
+ *   Sync, answered by a Delay_Resp
+ * - the peer-to-peer mechanism: a Pdelay_Req to the link peer every
+ *   2^@ref PTP_PDELAY_LOG_INTERVAL s. Pdelay_Req messages from the peer
+ *   are answered two-step.
+ *
+ * With the STM32 Ethernet MAC (modules stm32_eth and periph_ptp) the
+ * clock is the MAC's IEEE 1588 system time. Receive time stamps are read
+ * from the enhanced DMA descriptors the frame arrived in. A transmit
+ * time stamp is read from the descriptor if the driver requested one.
+ * Otherwise it is the system time right before the frame was handed to
+ * the driver. Elsewhere, e.g. on BOARD=native, the clock runs on
+ * xtimer_now_usec64() and frames are time stamped in the netdev hooks.
+ *
+ * A PI servo steers the clock frequency. The first offset, and any
+ * offset beyond @ref PTP_STEP_NS, steps the clock instead. After
+ * @ref PTP_LOCK_SAMPLES offsets below @ref PTP_LOCK_NS the port is in the
+ * slave state; from then on offsets are added to the statistics and
+ * @ref ptp_slave_now serves the time.
+ * @}
+ */
+#ifndef PTP_SLAVE_H
+#define PTP_SLAVE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef PTP_DOMAIN
+#define PTP_DOMAIN              (0U)        /**< domain number */
+#endif
+#ifndef PTP_RX_QUEUE
+#define PTP_RX_QUEUE            (4U)        /**< messages queued by the hook */
+#endif
+#ifndef PTP_PDELAY_LOG_INTERVAL
+#define PTP_PDELAY_LOG_INTERVAL (0)         /**< Pdelay_Req every 2^x s */
+#endif
+#ifndef PTP_ANNOUNCE_TIMEOUT
+#define PTP_ANNOUNCE_TIMEOUT    (3U)        /**< Announce intervals */
+#endif
+#ifndef PTP_DELAY_FILTER
+#define PTP_DELAY_FILTER        (8)         /**< path delay averaging */
+#endif
+#ifndef PTP_STEP_NS
+#define PTP_STEP_NS             (1000000L)  /**< step instead of slew */
+#endif
+#ifndef PTP_FREQ_MAX_PPB
+#define PTP_FREQ_MAX_PPB        (500000L)   /**< frequency correction limit */
+#endif
+#ifndef PTP_LOCK_NS
+#if defined(MODULE_STM32_ETH) && defined(MODULE_PERIPH_PTP)
+#define PTP_LOCK_NS             (1000L)     /**< offset to count as locked */
+#else
+#define PTP_LOCK_NS             (100000L)
+#endif
+#endif
+#ifndef PTP_LOCK_SAMPLES
+#define PTP_LOCK_SAMPLES        (4U)        /**< locked offsets in a row */
+#endif
+/** @} */
+
+/**
+ * @brief   Path delay mechanisms
+ */
+typedef enum {
+    PTP_DELAY_E2E,              /**< Delay_Req to the master */
+    PTP_DELAY_P2P,              /**< Pdelay_Req to the link peer */
+} ptp_delay_mech_t;
+
+/**
+ * @brief   Port states
+ */
+typedef enum {
+    PTP_STATE_LISTENING,        /**< no master */
+    PTP_STATE_UNCALIBRATED,     /**< following a master, not locked yet */
+    PTP_STATE_SLAVE,            /**< locked to the master */
+} ptp_state_t;
+
+/**
+ * @brief   Slave statistics
+ */
+typedef struct {
+    uint32_t state;             /**< @ref ptp_state_t */
+    uint32_t announces;         /**< Announce messages received */
+    uint32_t syncs;             /**< Sync messages from the master */
+    uint32_t delay_reqs;        /**< Delay_Req or Pdelay_Req sent */
+    uint32_t delay_resps;       /**< path delay measurements */
+    uint32_t timeouts;          /**< masters lost to the announce timeout */
+    uint32_t steps;             /**< steps of the clock */
+    uint32_t rx_hw;             /**< MAC receive time stamps */
+    uint32_t rx_sw;             /**< software receive time stamps */
+    uint32_t tx_hw;             /**< MAC transmit time stamps */
+    uint32_t tx_sw;             /**< software transmit time stamps */
+    uint32_t rx_dropped;        /**< messages the queue had no room for */
+    int32_t offset_ns;          /**< last offset from the master */
+    int32_t path_delay_ns;      /**< mean path or link delay */
+    int32_t freq_ppb;           /**< frequency correction */
+    uint32_t samples;           /**< offsets in the slave state */
+    uint32_t offset_max_ns;     /**< largest of them, absolute */
+    uint64_t offset_total_ns;   /**< sum of them, absolute */
+} ptp_slave_stats_t;
+
+/**
+ * @brief   Start the slave thread and hook the Ethernet interface
+ *
+ * @param[in] mech      path delay mechanism
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the slave is already running
+ * @return  -ENODEV if there is no hooked Ethernet interface
+ * @return  -ENOMEM if the thread could not be created
+ */
+int ptp_slave_start(ptp_delay_mech_t mech);
+
+/**
+ * @brief   Get the slave statistics
+ */
+const ptp_slave_stats_t *ptp_slave_stats(void);
+
+/**
+ * @brief   Get the time of the PTP clock
+ *
+ * @param[out] utc_ns   nanoseconds since the Unix epoch (UTC)
+ *
+ * @return  0 on success
+ * @return  -EAGAIN if the port is not in the slave state
+ */
+int ptp_slave_now(uint64_t *utc_ns);
+
+/**
+ * @brief   PTP shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int ptp_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PTP_SLAVE_H */
+/** @} */
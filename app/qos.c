@@ -0,0 +1,483 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       DSCP marking and strict-priority transmit queues
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/api.h"
+#include "lwip/tcpip.h"
+#include "mutex.h"
+#include "netdev_hook.h"
+#include "prio.h"
+#include "qos.h"
+#include "wallclock.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include "xtimer.h"
+
+#ifdef MODULE_LWIP_IPV6
+#include "net/ipv6.h"
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#include "net/ipv4.h"
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#define ETH_HDR_LEN         (14U)
+#define ETH_TYPE_OFFSET     (12U)
+#define VLAN_TAG_LEN        (4U)
+#define FLAG_TX             (0x0001U)
+#define RR_TIMEOUT_US       (US_PER_SEC)
+#define RR_INTERVAL_US      (10U * US_PER_MS)
+#define BULK_CHUNK          (1024U)
+
+typedef struct frame {
+    struct frame *next;
+    uint32_t queued_at;
+    uint16_t len;
+    uint8_t data[QOS_FRAME_SIZE];
+} _frame_t;
+
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+static thread_t *_thread;
+static netdev_hook_t _hook;
+static netdev_t *_dev;
+static mutex_t _lock = MUTEX_INIT;
+static _frame_t _frames[QOS_FRAMES];
+static _frame_t *_free;
+static _frame_t *_head[QOS_PRIO_NUMOF];
+static _frame_t *_tail[QOS_PRIO_NUMOF];
+static qos_stats_t _stats[QOS_PRIO_NUMOF];
+static unsigned _used;
+static bool _enabled = true;
+
+static qos_prio_t _classify(const uint8_t *frame, size_t len)
+{
+    size_t offset = ETH_TYPE_OFFSET;
+    uint8_t dscp;
+
+    if ((len >= (ETH_HDR_LEN + VLAN_TAG_LEN)) &&
+        (frame[offset] == 0x81) && (frame[offset + 1] == 0x00)) {
+        offset += VLAN_TAG_LEN;
+    }
+    if (len < (offset + 4)) {
+        return QOS_PRIO_NORMAL;
+    }
+    if ((frame[offset] != 0x08) || (frame[offset + 1] != 0x00)) {
+        /* ARP and other link control */
+        return QOS_PRIO_HIGH;
+    }
+    /* TOS is the second byte of the IPv4 header */
+    dscp = frame[offset + 3] >> 2;
+    if (dscp >= 40) {
+        return QOS_PRIO_HIGH;
+    }
+    return (dscp == QOS_DSCP_CS1) ? QOS_PRIO_LOW : QOS_PRIO_NORMAL;
+}
+
+static int _tx(netdev_hook_t *hook, netdev_t *dev, const iolist_t *iolist)
+{
+    size_t size = iolist_size(iolist);
+    qos_prio_t prio;
+    _frame_t *frame;
+    uint8_t *pos;
+
+    (void)hook;
+    mutex_lock(&_lock);
+    if (!_enabled && (_used == 0)) {
+        /* nothing queued or in flight, so the frame can't overtake any */
+        mutex_unlock(&_lock);
+        return 0;
+    }
+    if (size > QOS_FRAME_SIZE) {
+        mutex_unlock(&_lock);
+        return -EMSGSIZE;
+    }
+    /* lwIP puts the Ethernet and IP headers in the first buffer */
+    prio = _classify(iolist->iol_base, iolist->iol_len);
+    if ((_free == NULL) ||
+        ((prio != QOS_PRIO_HIGH) && (_used >= (QOS_FRAMES - QOS_RESERVED)))) {
+        _stats[prio].dropped++;
+        mutex_unlock(&_lock);
+        return -ENOBUFS;
+    }
+    frame = _free;
+    _free = frame->next;
+    _used++;
+    _dev = dev;
+    mutex_unlock(&_lock);
+
+    pos = frame->data;
+    for (const iolist_t *iol = iolist; iol; iol = iol->iol_next) {
+        memcpy(pos, iol->iol_base, iol->iol_len);
+        pos += iol->iol_len;
+    }
+    frame->len = size;
+    frame->next = NULL;
+    frame->queued_at = xtimer_now_usec();
+
+    mutex_lock(&_lock);
+    if (_tail[prio]) {
+        _tail[prio]->next = frame;
+    }
+    else {
+        _head[prio] = frame;
+    }
+    _tail[prio] = frame;
+    if (++_stats[prio].depth > _stats[prio].max_depth) {
+        _stats[prio].max_depth = _stats[prio].depth;
+    }
+    mutex_unlock(&_lock);
+    thread_flags_set(_thread, FLAG_TX);
+    return 1;
+}
+
+static _frame_t *_dequeue(qos_prio_t *prio)
+{
+    _frame_t *frame = NULL;
+
+    mutex_lock(&_lock);
+    for (unsigned i = 0; i < QOS_PRIO_NUMOF; i++) {
+        if ((frame = _head[i]) != NULL) {
+            _head[i] = frame->next;
+            if (_head[i] == NULL) {
+                _tail[i] = NULL;
+            }
+            _stats[i].depth--;
+            *prio = i;
+            break;
+        }
+    }
+    mutex_unlock(&_lock);
+    return frame;
+}
+
+static void *_tx_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        _frame_t *frame;
+        qos_prio_t prio;
+
+        thread_flags_wait_any(FLAG_TX);
+        while ((frame = _dequeue(&prio)) != NULL) {
+            iolist_t iol = {
+                .iol_next = NULL,
+                .iol_base = frame->data,
+                .iol_len = frame->len,
+            };
+            uint32_t delay = xtimer_now_usec() - frame->queued_at;
+
+            netdev_hook_send(_dev, &iol);
+            mutex_lock(&_lock);
+            _stats[prio].frames++;
+            _stats[prio].total_delay_us += delay;
+            if (delay > _stats[prio].max_delay_us) {
+                _stats[prio].max_delay_us = delay;
+            }
+            frame->next = _free;
+            _free = frame;
+            _used--;
+            mutex_unlock(&_lock);
+        }
+    }
+    return NULL;
+}
+
+void qos_init(void)
+{
+    kernel_pid_t pid;
+
+    for (unsigned i = 0; i < QOS_FRAMES; i++) {
+        _frames[i].next = _free;
+        _free = &_frames[i];
+    }
+    /* same priority as the tcpip thread: lwIP finishes a burst of segments
+     * before the queues are drained, which is what lets replies overtake */
+    pid = thread_create(_stack, sizeof(_stack), PRIO_QOS_TX,
+                        THREAD_CREATE_STACKTEST, _tx_thread, NULL, "qos_tx");
+    _thread = thread_get(pid);
+    _hook.tx = _tx;
+    netdev_hook_add(&_hook);
+}
+
+void qos_enable(bool on)
+{
+    mutex_lock(&_lock);
+    _enabled = on;
+    mutex_unlock(&_lock);
+}
+
+static int _set_tos(struct netconn *conn, uint8_t tos)
+{
+    int res = -ENOTCONN;
+
+    LOCK_TCPIP_CORE();
+    if (conn && conn->pcb.ip) {
+        conn->pcb.ip->tos = tos;
+        res = 0;
+    }
+    UNLOCK_TCPIP_CORE();
+    return res;
+}
+
+int qos_tcp_set_tos(sock_tcp_t *sock, uint8_t tos)
+{
+    return _set_tos(sock->base.conn, tos);
+}
+
+int qos_udp_set_tos(sock_udp_t *sock, uint8_t tos)
+{
+    return _set_tos(sock->base.conn, tos);
+}
+
+int qos_ip_set_tos(sock_ip_t *sock, uint8_t tos)
+{
+    return _set_tos(sock->base.conn, tos);
+}
+
+const qos_stats_t *qos_stats(qos_prio_t prio)
+{
+    return (prio < QOS_PRIO_NUMOF) ? &_stats[prio] : NULL;
+}
+
+#if defined(MODULE_SOCK_TCP) || defined(MODULE_SOCK_UDP)
+static int _parse_ep(sock_tcp_ep_t *ep, char *addr_str, char *port_str)
+{
+    *ep = (sock_tcp_ep_t)SOCK_IP_EP_ANY;
+#ifdef MODULE_LWIP_IPV6
+    if (ipv6_addr_from_str((ipv6_addr_t *)&ep->addr.ipv6, addr_str) == NULL) {
+#else
+    if (ipv4_addr_from_str((ipv4_addr_t *)&ep->addr.ipv4, addr_str) == NULL) {
+#endif
+        puts("Error: unable to parse destination address");
+        return 1;
+    }
+    ep->port = atoi(port_str);
+    return 0;
+}
+#endif
+
+#ifdef MODULE_SOCK_TCP
+static char _bulk_stack[THREAD_STACKSIZE_DEFAULT + THREAD_EXTRA_STACKSIZE_PRINTF];
+static uint8_t _bulk_buf[BULK_CHUNK];
+static sock_tcp_ep_t _bulk_remote;
+static uint32_t _bulk_us;
+static uint8_t _bulk_tos;
+static bool _bulk_running;
+
+static void *_bulk_thread(void *arg)
+{
+    sock_tcp_t sock;
+    uint32_t start;
+    uint64_t bytes = 0;
+    int res;
+
+    (void)arg;
+    if ((res = sock_tcp_connect(&sock, &_bulk_remote, 0, 0)) < 0) {
+        printf("qos: bulk connect failed (error code %d)\n", -res);
+        _bulk_running = false;
+        return NULL;
+    }
+    qos_tcp_set_tos(&sock, _bulk_tos);
+    start = xtimer_now_usec();
+    while ((xtimer_now_usec() - start) < _bulk_us) {
+        ssize_t n = sock_tcp_write(&sock, _bulk_buf, sizeof(_bulk_buf));
+
+        if (n < 0) {
+            printf("qos: bulk write failed (error code %d)\n", (int)-n);
+            break;
+        }
+        bytes += n;
+    }
+    sock_tcp_disconnect(&sock);
+    printf("qos: bulk sent %" PRIu32 " byte, %.4f Mbps\n", (uint32_t)bytes,
+           (float)bytes * 8 / (xtimer_now_usec() - start));
+    _bulk_running = false;
+    return NULL;
+}
+
+static int qos_bulk(char *addr_str, char *port_str, unsigned seconds,
+                    uint8_t dscp)
+{
+    if (_bulk_running) {
+        puts("error: bulk transfer already running");
+        return 1;
+    }
+    if (_parse_ep(&_bulk_remote, addr_str, port_str)) {
+        return 1;
+    }
+    _bulk_us = seconds * US_PER_SEC;
+    _bulk_tos = QOS_TOS(dscp);
+    _bulk_running = true;
+    /* below the shell, so the latency benchmark runs next to it */
+    thread_create(_bulk_stack, sizeof(_bulk_stack), PRIO_BULK,
+                  THREAD_CREATE_STACKTEST, _bulk_thread, NULL, "qos_bulk");
+    return 0;
+}
+#endif
+
+#ifdef MODULE_SOCK_UDP
+static uint32_t _rtt[QOS_RR_SAMPLES];
+
+static int _cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* puts the run on the collector's time line */
+static void _print_start(void)
+{
+    uint32_t error;
+    uint64_t now = wallclock_now(&error);
+
+    if (now) {
+        printf("start %" PRIu32 ".%06" PRIu32 " +/- %" PRIu32 " us\n",
+               (uint32_t)(now / US_PER_SEC), (uint32_t)(now % US_PER_SEC),
+               error);
+    }
+}
+
+static int qos_rr(char *addr_str, char *port_str, unsigned num, uint8_t dscp)
+{
+    sock_udp_ep_t remote;
+    sock_udp_t sock;
+    network_uint32_t req, rsp;
+    uint64_t sum = 0;
+    unsigned got = 0;
+    int res;
+
+    if (_parse_ep(&remote, addr_str, port_str)) {
+        return 1;
+    }
+    if (num > QOS_RR_SAMPLES) {
+        num = QOS_RR_SAMPLES;
+    }
+    if ((res = sock_udp_create(&sock, NULL, &remote, 0)) < 0) {
+        printf("Unable to open UDP sock (error code %d)\n", -res);
+        return 1;
+    }
+    qos_udp_set_tos(&sock, QOS_TOS(dscp));
+    _print_start();
+    for (unsigned i = 0; i < num; i++) {
+        uint32_t sent = xtimer_now_usec();
+
+        req = byteorder_htonl(i);
+        if (sock_udp_send(&sock, &req, sizeof(req), NULL) < 0) {
+            continue;
+        }
+        while ((xtimer_now_usec() - sent) < RR_TIMEOUT_US) {
+            ssize_t n = sock_udp_recv(&sock, &rsp, sizeof(rsp),
+                                      RR_TIMEOUT_US, NULL);
+            if (n < 0) {
+                break;
+            }
+            /* late answers to earlier requests are skipped */
+            if ((n == sizeof(rsp)) && (rsp.u32 == req.u32)) {
+                _rtt[got] = xtimer_now_usec() - sent;
+                sum += _rtt[got++];
+                break;
+            }
+        }
+        xtimer_usleep(RR_INTERVAL_US);
+    }
+    sock_udp_close(&sock);
+    printf("%u requests, %u answered\n", num, got);
+    if (got) {
+        qsort(_rtt, got, sizeof(_rtt[0]), _cmp_u32);
+        printf("rtt min %" PRIu32 " us, avg %" PRIu32 " us, p50 %" PRIu32
+               " us, p99 %" PRIu32 " us, max %" PRIu32 " us\n", _rtt[0],
+               (uint32_t)(sum / got), _rtt[got / 2], _rtt[(got * 99) / 100],
+               _rtt[got - 1]);
+    }
+    return 0;
+}
+#endif
+
+static void qos_print(void)
+{
+    static const char *names[QOS_PRIO_NUMOF] = { "high", "normal", "low" };
+
+    printf("queues %s, %u of %u buffers in use\n", _enabled ? "on" : "off",
+           _used, QOS_FRAMES);
+    for (unsigned i = 0; i < QOS_PRIO_NUMOF; i++) {
+        const qos_stats_t *s = &_stats[i];
+
+        printf("%-6s %" PRIu32 " frames, %" PRIu32 " dropped, depth %u "
+               "(max %u), delay avg %" PRIu32 " us, max %" PRIu32 " us\n",
+               names[i], s->frames, s->dropped, s->depth, s->max_depth,
+               s->frames ? (uint32_t)(s->total_delay_us / s->frames) : 0,
+               s->max_delay_us);
+    }
+}
+
+int qos_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        qos_print();
+        return 0;
+    }
+    else if (strcmp(argv[1], "on") == 0) {
+        qos_enable(true);
+        return 0;
+    }
+    else if (strcmp(argv[1], "off") == 0) {
+        qos_enable(false);
+        return 0;
+    }
+    else if (strcmp(argv[1], "reset") == 0) {
+        mutex_lock(&_lock);
+        for (unsigned i = 0; i < QOS_PRIO_NUMOF; i++) {
+            uint8_t depth = _stats[i].depth;
+
+            memset(&_stats[i], 0, sizeof(_stats[i]));
+            _stats[i].depth = _stats[i].max_depth = depth;
+        }
+        mutex_unlock(&_lock);
+        return 0;
+    }
+#ifdef MODULE_SOCK_TCP
+    else if (strcmp(argv[1], "bulk") == 0) {
+        if (argc < 5) {
+            printf("usage: %s bulk <addr> <port> <seconds> [<dscp>]\n",
+                   argv[0]);
+            return 1;
+        }
+        return qos_bulk(argv[2], argv[3], atoi(argv[4]),
+                        (argc > 5) ? strtoul(argv[5], NULL, 0) : QOS_DSCP_CS1);
+    }
+#endif
+#ifdef MODULE_SOCK_UDP
+    else if (strcmp(argv[1], "rr") == 0) {
+        if (argc < 5) {
+            printf("usage: %s rr <addr> <port> <num> [<dscp>]\n", argv[0]);
+            return 1;
+        }
+        return qos_rr(argv[2], argv[3], atoi(argv[4]),
+                      (argc > 5) ? strtoul(argv[5], NULL, 0) : QOS_DSCP_EF);
+    }
+#endif
+    else {
+        printf("usage: %s [on|off|reset|bulk|rr]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
@@ -0,0 +1,163 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       DSCP marking and strict-priority transmit queues
+ *
+ * Sockets are marked with a TOS byte through the `qos_*_set_tos()`
+ * functions. A TX hook copies every frame lwIP sends into one of
+ * @ref QOS_PRIO_NUMOF software queues, chosen by the DSCP of the IPv4
+ * header, and returns at once. A TX thread drains the queues into the
+ * driver, always taking the highest priority frame first, so a control reply
+ * overtakes bulk frames that were queued before it.
+ *
+ * Frames that are not IPv4 (ARP) go to the high priority queue. The last
+ * @ref QOS_RESERVED buffers of the pool are kept for the high priority queue,
+ * so bulk traffic can't starve control traffic of buffers.
+ * @}
+ */
+#ifndef QOS_H
+#define QOS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "net/sock/ip.h"
+#include "net/sock/tcp.h"
+#include "net/sock/udp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef QOS_FRAMES
+#define QOS_FRAMES              (8U)        /**< frame buffers for all queues */
+#endif
+#ifndef QOS_RESERVED
+#define QOS_RESERVED            (2U)        /**< buffers only high priority gets */
+#endif
+#ifndef QOS_FRAME_SIZE
+#define QOS_FRAME_SIZE          (1522U)     /**< largest frame, VLAN tag included */
+#endif
+#ifndef QOS_RR_SAMPLES
+#define QOS_RR_SAMPLES          (500U)      /**< latency samples per benchmark run */
+#endif
+/** @} */
+
+/**
+ * @brief   Differentiated services code points (RFC 2474, RFC 3246)
+ * @{
+ */
+#define QOS_DSCP_BE             (0U)        /**< best effort */
+#define QOS_DSCP_CS1            (8U)        /**< bulk, lower than best effort */
+#define QOS_DSCP_EF             (46U)       /**< expedited forwarding */
+#define QOS_DSCP_CS6            (48U)       /**< network control */
+/** @} */
+
+/**
+ * @brief   TOS byte for a DSCP, ECN bits cleared
+ */
+#define QOS_TOS(dscp)           ((uint8_t)((dscp) << 2))
+
+/**
+ * @brief   Transmit queues, highest priority first
+ */
+typedef enum {
+    QOS_PRIO_HIGH,              /**< DSCP >= CS5 (EF, CS6, CS7) and non-IP */
+    QOS_PRIO_NORMAL,            /**< everything else */
+    QOS_PRIO_LOW,               /**< CS1 */
+    QOS_PRIO_NUMOF,             /**< number of queues */
+} qos_prio_t;
+
+/**
+ * @brief   Per queue statistics
+ */
+typedef struct {
+    uint32_t frames;            /**< frames sent */
+    uint32_t dropped;           /**< frames dropped for lack of buffers */
+    uint32_t max_delay_us;      /**< longest time a frame was queued */
+    uint64_t total_delay_us;    /**< sum of all queueing times */
+    uint8_t depth;              /**< frames queued right now */
+    uint8_t max_depth;          /**< most frames queued at once */
+} qos_stats_t;
+
+/**
+ * @brief   Start the TX thread and register the TX hook
+ *
+ * Call after all other TX hooks were added, frames are queued last.
+ */
+void qos_init(void);
+
+/**
+ * @brief   Enable or disable the queues
+ *
+ * While disabled, frames go straight to the driver.
+ */
+void qos_enable(bool on);
+
+/**
+ * @brief   Set the TOS byte of the IP packets sent with a TCP sock
+ *
+ * @param[in] sock  connected TCP sock
+ * @param[in] tos   TOS byte, see @ref QOS_TOS
+ *
+ * @return  0 on success
+ * @return  -ENOTCONN if @p sock has no connection
+ */
+int qos_tcp_set_tos(sock_tcp_t *sock, uint8_t tos);
+
+/**
+ * @brief   Set the TOS byte of the IP packets sent with a UDP sock
+ *
+ * @param[in] sock  UDP sock
+ * @param[in] tos   TOS byte, see @ref QOS_TOS
+ *
+ * @return  0 on success
+ * @return  -ENOTCONN if @p sock was not created
+ */
+int qos_udp_set_tos(sock_udp_t *sock, uint8_t tos);
+
+/**
+ * @brief   Set the TOS byte of the IP packets sent with a raw IP sock
+ *
+ * @param[in] sock  raw IP sock
+ * @param[in] tos   TOS byte, see @ref QOS_TOS
+ *
+ * @return  0 on success
+ * @return  -ENOTCONN if @p sock was not created
+ */
+int qos_ip_set_tos(sock_ip_t *sock, uint8_t tos);
+
+/**
+ * @brief   Get the statistics of queue @p prio
+ */
+const qos_stats_t *qos_stats(qos_prio_t prio);
+
+/**
+ * @brief   QoS shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int qos_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QOS_H */
+/** @} */
@@ -0,0 +1,282 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Remote shell over TCP
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "lwip/api.h"
+#include "mutex.h"
+#include "net/sock/tcp.h"
+#include "prio.h"
+#include "rsh.h"
+#include "stdio_base.h"
+#include "thread.h"
+
+#ifdef MODULE_LWIP_IPV6
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#define TELNET_IAC          (0xffU)
+#define RX_SIZE             (64U)
+
+typedef struct {
+    sock_tcp_t *sock;
+    kernel_pid_t pid;
+    bool capture;               /* a command of this session is running */
+    int res;
+    size_t fill;
+    char out[TCP_MSS];
+    char line[SHELL_DEFAULT_BUFSIZE];
+} _session_t;
+
+static rsh_stats_t _stats;
+
+#ifdef MODULE_SOCK_TCP
+static _session_t _sessions[RSH_SESSIONS];
+static char _stacks[RSH_SESSIONS][THREAD_STACKSIZE_MAIN];
+static sock_tcp_t _socks[RSH_SESSIONS];
+static sock_tcp_queue_t _queue;
+static mutex_t _accept_lock = MUTEX_INIT;
+static const shell_command_t *_commands;
+static bool _running;
+
+/* empties the buffer, output of a broken session is dropped */
+static void _flush(_session_t *s, uint8_t flags)
+{
+    if ((s->fill == 0) || (s->res < 0)) {
+        s->fill = 0;
+        return;
+    }
+    if ((s->sock->base.conn == NULL) ||
+        (netconn_write(s->sock->base.conn, s->out, s->fill,
+                       NETCONN_COPY | flags) != ERR_OK)) {
+        s->res = -EIO;
+    }
+    else {
+        _stats.bytes += s->fill;
+        _stats.writes++;
+    }
+    s->fill = 0;
+}
+
+/* buffers output, sending full segments only; terminals want CR LF */
+static void _write(_session_t *s, const char *data, size_t len)
+{
+    for (size_t i = 0; (i < len) && (s->res >= 0); i++) {
+        /* room for a CR LF pair */
+        if ((s->fill + 2) > sizeof(s->out)) {
+            _flush(s, NETCONN_MORE);
+        }
+        if (data[i] == '\n') {
+            s->out[s->fill++] = '\r';
+        }
+        s->out[s->fill++] = data[i];
+    }
+}
+
+static void _puts(_session_t *s, const char *str)
+{
+    _write(s, str, strlen(str));
+}
+
+extern ssize_t __real_stdio_write(const void *buffer, size_t len);
+
+/* the application links with --wrap=stdio_write */
+ssize_t __wrap_stdio_write(const void *buffer, size_t len)
+{
+    kernel_pid_t pid = thread_getpid();
+
+    for (unsigned i = 0; i < RSH_SESSIONS; i++) {
+        if (_sessions[i].capture && (_sessions[i].pid == pid)) {
+            _write(&_sessions[i], buffer, len);
+            return len;
+        }
+    }
+    return __real_stdio_write(buffer, len);
+}
+
+/* returns true if the session should end */
+static bool _run(_session_t *s, char *line)
+{
+    char *argv[RSH_ARGS_MAX];
+    int argc = tokenize(line, argv, RSH_ARGS_MAX);
+
+    if (argc == 0) {
+        return false;
+    }
+    if ((strcmp(argv[0], "exit") == 0) || (strcmp(argv[0], "quit") == 0)) {
+        return true;
+    }
+    if (strcmp(argv[0], "help") == 0) {
+        _puts(s, "Command              Description\n"
+                 "---------------------------------------\n");
+        for (const shell_command_t *cmd = _commands; cmd->name; cmd++) {
+            char buf[96];
+
+            snprintf(buf, sizeof(buf), "%-20s %s\n", cmd->name, cmd->desc);
+            _puts(s, buf);
+        }
+        return false;
+    }
+    for (const shell_command_t *cmd = _commands; cmd->name; cmd++) {
+        if (strcmp(argv[0], cmd->name) == 0) {
+            /* don't take along what other threads left in stdout */
+            fflush(stdout);
+            s->capture = true;
+            cmd->handler(argc, argv);
+            fflush(stdout);
+            s->capture = false;
+            _stats.commands++;
+            return false;
+        }
+    }
+    _puts(s, "shell: command not found: ");
+    _puts(s, argv[0]);
+    _puts(s, "\n");
+    return false;
+}
+
+static void _serve(_session_t *s)
+{
+    char rx[RX_SIZE];
+    unsigned iac_skip = 0;
+    size_t len = 0;
+
+    s->fill = 0;
+    s->res = 0;
+    _puts(s, "RIOT remote shell, type help or exit\n> ");
+    _flush(s, 0);
+    while (s->res == 0) {
+        ssize_t res = sock_tcp_read(s->sock, rx, sizeof(rx),
+                                    RSH_IDLE_TIMEOUT_US);
+
+        if (res <= 0) {
+            return;
+        }
+        for (ssize_t i = 0; i < res; i++) {
+            char c = rx[i];
+
+            /* skip telnet option negotiation */
+            if (iac_skip) {
+                iac_skip--;
+                continue;
+            }
+            if ((uint8_t)c == TELNET_IAC) {
+                iac_skip = 2;
+                continue;
+            }
+            if ((c == '\r') || (c == '\0')) {
+                continue;
+            }
+            if ((c == '\b') || (c == 0x7f)) {
+                len -= (len > 0);
+                continue;
+            }
+            if (c != '\n') {
+                if (len < (sizeof(s->line) - 1)) {
+                    s->line[len++] = c;
+                }
+                continue;
+            }
+            s->line[len] = '\0';
+            len = 0;
+            if (_run(s, s->line)) {
+                _flush(s, 0);
+                return;
+            }
+            _puts(s, "> ");
+            _flush(s, 0);
+        }
+    }
+}
+
+static void *_session_thread(void *arg)
+{
+    _session_t *s = arg;
+
+    while (1) {
+        int res;
+
+        /* one thread at a time waits for the next client */
+        mutex_lock(&_accept_lock);
+        res = sock_tcp_accept(&_queue, &s->sock, SOCK_NO_TIMEOUT);
+        mutex_unlock(&_accept_lock);
+        if (res < 0) {
+            continue;
+        }
+        _stats.sessions++;
+        _serve(s);
+        sock_tcp_disconnect(s->sock);
+    }
+    return NULL;
+}
+
+int rsh_start(uint16_t port, const shell_command_t *commands)
+{
+    sock_tcp_ep_t local = SOCK_IP_EP_ANY;
+    int res;
+
+    if (_running) {
+        return -EALREADY;
+    }
+    local.port = port;
+    if ((res = sock_tcp_listen(&_queue, &local, _socks, RSH_SESSIONS,
+                               0)) < 0) {
+        return res;
+    }
+    _commands = commands;
+    _running = true;
+    for (unsigned i = 0; i < RSH_SESSIONS; i++) {
+        _sessions[i].pid = thread_create(_stacks[i], sizeof(_stacks[i]),
+                                         PRIO_RSH,
+                                         THREAD_CREATE_STACKTEST,
+                                         _session_thread, &_sessions[i],
+                                         "rsh");
+        if (_sessions[i].pid <= KERNEL_PID_UNDEF) {
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+#else
+int rsh_start(uint16_t port, const shell_command_t *commands)
+{
+    (void)port;
+    (void)commands;
+    return -ENOTSUP;
+}
+#endif
+
+const rsh_stats_t *rsh_stats(void)
+{
+    return &_stats;
+}
+
+int rsh_cmd(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    printf("sessions %" PRIu32 ", commands %" PRIu32 ", %" PRIu32
+           " bytes in %" PRIu32 " writes\n", _stats.sessions,
+           _stats.commands, _stats.bytes, _stats.writes);
+    return 0;
+}
+
+/** @} */
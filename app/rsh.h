@@ -0,0 +1,105 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Remote shell over TCP
+ *
+ * Serves the application's shell command table to telnet or netcat
+ * clients, up to @ref RSH_SESSIONS at a time, each in its own thread.
+ *
+ * While a session runs a command, everything its thread writes to stdout
+ * is captured (the application links with `--wrap=stdio_write`) into a
+ * buffer of one TCP segment, which is handed to lwIP when it is full and
+ * pushed out when the command returns. Output of other threads, e.g. of
+ * the servers started from a session, still goes to the console. On
+ * BOARD=native printf() does not go through stdio_write(), so command
+ * output stays on the console there.
+ *
+ * Sessions are not authenticated, so the remote shell is only started at
+ * boot in builds with `make RSH=1` (@ref RSH_AUTOSTART), meant for isolated
+ * test networks.
+ * @}
+ */
+#ifndef RSH_H
+#define RSH_H
+
+#include <stdint.h>
+
+#include "shell.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef RSH_PORT
+#define RSH_PORT                (2323U)     /**< listen port */
+#endif
+#ifndef RSH_SESSIONS
+#define RSH_SESSIONS            (2U)        /**< concurrent sessions */
+#endif
+#ifndef RSH_IDLE_TIMEOUT_US
+#define RSH_IDLE_TIMEOUT_US     (300000000UL) /**< idle session timeout */
+#endif
+#ifndef RSH_ARGS_MAX
+#define RSH_ARGS_MAX            (16U)       /**< arguments per command */
+#endif
+#ifndef RSH_AUTOSTART
+#define RSH_AUTOSTART           (0)         /**< start from main() */
+#endif
+/** @} */
+
+/**
+ * @brief   Remote shell statistics
+ */
+typedef struct {
+    uint32_t sessions;          /**< accepted sessions */
+    uint32_t commands;          /**< commands run */
+    uint32_t bytes;             /**< output bytes sent */
+    uint32_t writes;            /**< writes handed to lwIP */
+} rsh_stats_t;
+
+/**
+ * @brief   Start the session threads
+ *
+ * @param[in] port      port to listen on
+ * @param[in] commands  command table, terminated by an all NULL entry
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the remote shell is already running
+ * @return  -ENOMEM if a thread could not be created
+ */
+int rsh_start(uint16_t port, const shell_command_t *commands);
+
+/**
+ * @brief   Get the remote shell statistics
+ */
+const rsh_stats_t *rsh_stats(void);
+
+/**
+ * @brief   Remote shell statistics shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int rsh_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RSH_H */
+/** @} */
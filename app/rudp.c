@@ -0,0 +1,571 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Reliable UDP bulk transfer with selective repeat
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "net/af.h"
+#include "net/sock/tcp.h"
+#include "net/sock/udp.h"
+#include "rudp.h"
+#include "xtimer.h"
+
+#ifdef MODULE_LWIP_IPV6
+#include "net/ipv6.h"
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#include "net/ipv4.h"
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#ifdef MODULE_SOCK_UDP
+#define START_TIMEOUT_US    (200000UL)
+#define WAIT_MIN_US         (US_PER_MS) /* lwIP sock timeouts are in ms */
+#define FIN_REPEAT          (3U)
+
+#define BIT_GET(map, i)     ((map)[(i) / 8] & (1U << ((i) % 8)))
+#define BIT_SET(map, i)     ((map)[(i) / 8] |= (1U << ((i) % 8)))
+#define BIT_CLR(map, i)     ((map)[(i) / 8] &= ~(1U << ((i) % 8)))
+
+typedef struct {
+    sock_udp_t sock;
+    const rudp_params_t *params;
+    rudp_read_cb_t read_cb;
+    void *arg;
+    rudp_stats_t *stats;
+    uint32_t size;
+    uint32_t chunks;
+    uint32_t base;          /* first chunk not yet acknowledged */
+    uint32_t next;          /* first chunk never sent */
+    uint32_t lost_from;     /* no chunk below is marked lost */
+    unsigned lost_cnt;
+    uint32_t srtt;
+    uint32_t rttvar;
+    uint32_t rto;
+    uint32_t rate;
+    uint32_t next_tx;
+    uint32_t last_rx;
+    uint32_t last_decrease;
+    uint16_t session;
+} _rudp_t;
+
+static uint8_t _pkt[sizeof(rudp_data_t) + RUDP_CHUNK_MAX];
+static uint32_t _sent_at[RUDP_WINDOW];
+static uint8_t _acked[RUDP_WINDOW / 8];
+static uint8_t _lost[RUDP_WINDOW / 8];
+
+static inline bool _after_eq(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) >= 0;
+}
+
+static void _hdr_init(rudp_hdr_t *hdr, uint8_t type, uint16_t session)
+{
+    hdr->type = type;
+    hdr->flags = 0;
+    hdr->session = byteorder_htons(session);
+}
+
+static int _send_chunk(_rudp_t *r, uint32_t seq, uint32_t now)
+{
+    rudp_data_t *data = (rudp_data_t *)_pkt;
+    uint32_t offset = seq * r->params->chunk;
+    size_t len = r->params->chunk;
+    unsigned slot = seq % RUDP_WINDOW;
+    int res;
+
+    if (len > (r->size - offset)) {
+        len = r->size - offset;
+    }
+    _hdr_init(&data->hdr, RUDP_TYPE_DATA, r->session);
+    data->seq = byteorder_htonl(seq);
+    data->ts = byteorder_htonl(now);
+    r->read_cb(r->arg, offset, _pkt + sizeof(*data), len);
+    if ((res = sock_udp_send(&r->sock, _pkt, sizeof(*data) + len, NULL)) < 0) {
+        return res;
+    }
+    if (_sent_at[slot] != 0) {
+        r->stats->retrans++;
+    }
+    /* 0 is reserved for "never sent" */
+    _sent_at[slot] = now | 1;
+    r->stats->sent++;
+    if (r->rate) {
+        if (_after_eq(now, r->next_tx + (r->rto / 2))) {
+            /* don't burst to catch up after an idle period */
+            r->next_tx = now;
+        }
+        r->next_tx += ((uint64_t)len * US_PER_SEC) / r->rate;
+    }
+    return 0;
+}
+
+static void _mark_lost(_rudp_t *r, uint32_t seq)
+{
+    unsigned slot = seq % RUDP_WINDOW;
+
+    if (!BIT_GET(_lost, slot)) {
+        BIT_SET(_lost, slot);
+        r->lost_cnt++;
+        if (seq < r->lost_from) {
+            r->lost_from = seq;
+        }
+    }
+}
+
+static void _update_rtt(_rudp_t *r, uint32_t sample)
+{
+    if (r->srtt == 0) {
+        r->srtt = sample;
+        r->rttvar = sample / 2;
+    }
+    else {
+        uint32_t err = (sample > r->srtt) ? sample - r->srtt : r->srtt - sample;
+
+        r->rttvar = (3 * r->rttvar + err) / 4;
+        r->srtt = (7 * r->srtt + sample) / 8;
+    }
+    r->rto = r->srtt + 4 * r->rttvar;
+    if (r->rto < RUDP_RTO_MIN_US) {
+        r->rto = RUDP_RTO_MIN_US;
+    }
+}
+
+static void _handle_ack(_rudp_t *r, const rudp_ack_t *ack, uint32_t now)
+{
+    uint32_t ack_base = byteorder_ntohl(ack->base);
+    uint32_t echo_ts = byteorder_ntohl(ack->echo_ts);
+    unsigned new_losses = 0;
+    int highest = -1;
+
+    r->stats->acks++;
+    r->last_rx = now;
+    if (echo_ts != 0) {
+        _update_rtt(r, now - echo_ts);
+    }
+    if (ack_base > r->next) {
+        /* bogus ACK, acknowledges chunks never sent */
+        return;
+    }
+    while (r->base < ack_base) {
+        unsigned slot = r->base % RUDP_WINDOW;
+
+        if (BIT_GET(_lost, slot)) {
+            BIT_CLR(_lost, slot);
+            r->lost_cnt--;
+        }
+        BIT_SET(_acked, slot);
+        r->base++;
+    }
+    if (r->lost_from < r->base) {
+        r->lost_from = r->base;
+    }
+    for (unsigned i = 0; i < RUDP_BITMAP_BITS; i++) {
+        if (BIT_GET(ack->bitmap, i)) {
+            highest = i;
+        }
+    }
+    for (int i = 0; i <= highest; i++) {
+        uint32_t seq = ack_base + i;
+        unsigned slot = seq % RUDP_WINDOW;
+
+        if (seq < r->base || seq >= r->next) {
+            continue;
+        }
+        if (BIT_GET(ack->bitmap, i)) {
+            if (BIT_GET(_lost, slot)) {
+                BIT_CLR(_lost, slot);
+                r->lost_cnt--;
+            }
+            BIT_SET(_acked, slot);
+        }
+        else if (!BIT_GET(_acked, slot) &&
+                 ((now - _sent_at[slot]) > r->srtt)) {
+            /* a later chunk overtook this one and the last transmission is
+             * older than one round trip, so it is gone */
+            if (!BIT_GET(_lost, slot)) {
+                new_losses++;
+            }
+            _mark_lost(r, seq);
+        }
+    }
+    if (r->params->rate == 0) {
+        return;
+    }
+    /* AIMD below the configured ceiling, decrease at most once per RTT */
+    if (new_losses && ((now - r->last_decrease) > r->srtt)) {
+        r->rate -= r->rate / 4;
+        if (r->rate < (r->params->rate / 16)) {
+            r->rate = r->params->rate / 16;
+        }
+        r->last_decrease = now;
+    }
+    else if (!new_losses) {
+        r->rate += r->params->rate / 64;
+        if (r->rate > r->params->rate) {
+            r->rate = r->params->rate;
+        }
+    }
+}
+
+static void _mark_expired(_rudp_t *r, uint32_t now)
+{
+    for (uint32_t seq = r->base; seq < r->next; seq++) {
+        unsigned slot = seq % RUDP_WINDOW;
+
+        if (!BIT_GET(_acked, slot) && ((now - _sent_at[slot]) >= r->rto)) {
+            _mark_lost(r, seq);
+        }
+    }
+}
+
+static int32_t _pick_lost(_rudp_t *r)
+{
+    if (r->lost_cnt == 0) {
+        return -1;
+    }
+    for (uint32_t seq = r->lost_from; seq < r->next; seq++) {
+        unsigned slot = seq % RUDP_WINDOW;
+
+        if (BIT_GET(_lost, slot)) {
+            BIT_CLR(_lost, slot);
+            r->lost_cnt--;
+            r->lost_from = seq + 1;
+            return seq;
+        }
+    }
+    /* counter got out of sync with the map, start over */
+    r->lost_cnt = 0;
+    return -1;
+}
+
+static int _recv_ack(_rudp_t *r, uint32_t timeout)
+{
+    rudp_ack_t ack;
+    ssize_t res;
+
+    res = sock_udp_recv(&r->sock, &ack, sizeof(ack), timeout, NULL);
+    if (res < 0) {
+        return res;
+    }
+    if (((size_t)res < sizeof(ack)) || (ack.hdr.type != RUDP_TYPE_ACK) ||
+        (byteorder_ntohs(ack.hdr.session) != r->session)) {
+        return 0;
+    }
+    _handle_ack(r, &ack, xtimer_now_usec());
+    return 1;
+}
+
+static int _start(_rudp_t *r)
+{
+    rudp_start_t start;
+
+    _hdr_init(&start.hdr, RUDP_TYPE_START, r->session);
+    start.total = byteorder_htonl(r->size);
+    start.chunk = byteorder_htons(r->params->chunk);
+    start.reserved = byteorder_htons(0);
+    for (unsigned i = 0; i < RUDP_START_RETRIES; i++) {
+        uint32_t sent = xtimer_now_usec();
+        int res;
+
+        if ((res = sock_udp_send(&r->sock, &start, sizeof(start), NULL)) < 0) {
+            return res;
+        }
+        while ((xtimer_now_usec() - sent) < START_TIMEOUT_US) {
+            res = _recv_ack(r, START_TIMEOUT_US);
+            if (res > 0) {
+                _update_rtt(r, xtimer_now_usec() - sent);
+                return 0;
+            }
+            if ((res < 0) && (res != -ETIMEDOUT) && (res != -EAGAIN)) {
+                return res;
+            }
+        }
+    }
+    return -ETIMEDOUT;
+}
+
+static void _fin(_rudp_t *r)
+{
+    rudp_hdr_t fin;
+
+    _hdr_init(&fin, RUDP_TYPE_FIN, r->session);
+    for (unsigned i = 0; i < FIN_REPEAT; i++) {
+        sock_udp_send(&r->sock, &fin, sizeof(fin), NULL);
+    }
+}
+
+static int _run(_rudp_t *r)
+{
+    uint32_t rto_check = xtimer_now_usec() + r->rto;
+
+    r->last_rx = xtimer_now_usec();
+    r->next_tx = r->last_rx;
+    while (r->base < r->chunks) {
+        uint32_t now = xtimer_now_usec();
+        int32_t seq = -1;
+        uint32_t timeout;
+        int res;
+
+        if ((now - r->last_rx) > RUDP_IDLE_TIMEOUT_US) {
+            return -ETIMEDOUT;
+        }
+        if (_after_eq(now, rto_check)) {
+            _mark_expired(r, now);
+            rto_check = now + (r->rto / 2);
+        }
+        if (!r->rate || _after_eq(now, r->next_tx)) {
+            seq = _pick_lost(r);
+            if ((seq < 0) && (r->next < r->chunks) &&
+                ((r->next - r->base) < r->params->window)) {
+                unsigned slot = r->next % RUDP_WINDOW;
+
+                BIT_CLR(_acked, slot);
+                _sent_at[slot] = 0;
+                seq = r->next++;
+            }
+        }
+        if (seq >= 0) {
+            if ((res = _send_chunk(r, seq, now)) < 0) {
+                if (res != -ENOMEM) {
+                    return res;
+                }
+                /* out of pbufs: retry once the stack drained its queue */
+                _mark_lost(r, seq);
+            }
+            /* collect whatever ACKs queued up meanwhile */
+            while (_recv_ack(r, 0) >= 0) {}
+            continue;
+        }
+        /* nothing to send: sleep until pacing or the RTO check allow more */
+        if (r->rate && !_after_eq(now, r->next_tx)) {
+            timeout = r->next_tx - now;
+        }
+        else {
+            timeout = rto_check - now;
+        }
+        if ((int32_t)timeout < (int32_t)WAIT_MIN_US) {
+            timeout = WAIT_MIN_US;
+        }
+        res = _recv_ack(r, timeout);
+        if ((res < 0) && (res != -ETIMEDOUT) && (res != -EAGAIN)) {
+            return res;
+        }
+    }
+    return 0;
+}
+
+int rudp_send(const sock_udp_ep_t *remote, uint32_t size,
+              rudp_read_cb_t read_cb, void *arg,
+              const rudp_params_t *params, rudp_stats_t *stats)
+{
+    sock_udp_ep_t local = SOCK_IP_EP_ANY;
+    rudp_stats_t dummy;
+    _rudp_t r;
+    uint32_t start;
+    int res;
+
+    if ((params->chunk == 0) || (params->chunk > RUDP_CHUNK_MAX) ||
+        (params->window == 0) || (params->window > RUDP_WINDOW) ||
+        (size == 0)) {
+        return -EINVAL;
+    }
+    memset(&r, 0, sizeof(r));
+    if (stats == NULL) {
+        stats = &dummy;
+    }
+    memset(stats, 0, sizeof(*stats));
+    memset(_sent_at, 0, sizeof(_sent_at));
+    memset(_acked, 0, sizeof(_acked));
+    memset(_lost, 0, sizeof(_lost));
+    r.params = params;
+    r.read_cb = read_cb;
+    r.arg = arg;
+    r.stats = stats;
+    r.size = size;
+    r.chunks = (size + params->chunk - 1) / params->chunk;
+    r.rto = RUDP_RTO_MIN_US;
+    r.rate = params->rate;
+    r.session = (uint16_t)xtimer_now_usec();
+    if ((res = sock_udp_create(&r.sock, &local, remote, 0)) < 0) {
+        return res;
+    }
+    start = xtimer_now_usec();
+    if ((res = _start(&r)) == 0) {
+        res = _run(&r);
+    }
+    if (res == 0) {
+        _fin(&r);
+    }
+    stats->duration_us = xtimer_now_usec() - start;
+    stats->srtt_us = r.srtt;
+    stats->rate = r.rate;
+    sock_udp_close(&r.sock);
+    return res;
+}
+
+static void _pattern_cb(void *arg, uint32_t offset, uint8_t *buf, size_t len)
+{
+    (void)arg;
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(offset + i);
+    }
+}
+
+static int _parse_ep(sock_udp_ep_t *ep, char *addr_str, char *port_str)
+{
+    *ep = (sock_udp_ep_t)SOCK_IP_EP_ANY;
+#ifdef MODULE_LWIP_IPV6
+    if (ipv6_addr_from_str((ipv6_addr_t *)&ep->addr.ipv6, addr_str) == NULL) {
+#else
+    if (ipv4_addr_from_str((ipv4_addr_t *)&ep->addr.ipv4, addr_str) == NULL) {
+#endif
+        puts("Error: unable to parse destination address");
+        return 1;
+    }
+    ep->port = atoi(port_str);
+    return 0;
+}
+
+static void _print_result(const char *proto, uint32_t size, uint32_t duration)
+{
+    float mbps = (float)size * 8 / (duration ? duration : 1);
+
+    printf("%s: %" PRIu32 " byte in %" PRIu32 " ms, %.4f Mbps\n", proto,
+           size, duration / US_PER_MS, mbps);
+}
+
+static int rudp_send_cmd(char *addr_str, char *port_str, uint32_t size,
+                         rudp_params_t *params)
+{
+    sock_udp_ep_t dst;
+    rudp_stats_t stats;
+    int res;
+
+    if (_parse_ep(&dst, addr_str, port_str)) {
+        return 1;
+    }
+    if ((res = rudp_send(&dst, size, _pattern_cb, NULL, params, &stats)) < 0) {
+        printf("Error: transfer failed (error code %d)\n", -res);
+        return 1;
+    }
+    _print_result("rudp", size, stats.duration_us);
+    printf("sent %" PRIu32 " chunks, %" PRIu32 " retransmissions, "
+           "%" PRIu32 " acks, srtt %" PRIu32 " us, rate %" PRIu32 " B/s\n",
+           stats.sent, stats.retrans, stats.acks, stats.srtt_us, stats.rate);
+    return 0;
+}
+
+#ifdef MODULE_SOCK_TCP
+static int rudp_tcp_cmd(char *addr_str, char *port_str, uint32_t size)
+{
+    sock_udp_ep_t dst;
+    sock_tcp_t sock;
+    network_uint32_t hdr = byteorder_htonl(size);
+    uint32_t offset = 0, start;
+    char ack;
+
+    if (_parse_ep(&dst, addr_str, port_str)) {
+        return 1;
+    }
+    if (sock_tcp_connect(&sock, &dst, 0, 0) < 0) {
+        puts("Error: unable to connect");
+        return 1;
+    }
+    start = xtimer_now_usec();
+    /* announce the size like START does, the data follows as raw stream */
+    if (sock_tcp_write(&sock, &hdr, sizeof(hdr)) < 0) {
+        puts("Error: write failed");
+        sock_tcp_disconnect(&sock);
+        return 1;
+    }
+    while (offset < size) {
+        size_t len = sizeof(_pkt);
+        ssize_t res;
+
+        if (len > (size - offset)) {
+            len = size - offset;
+        }
+        _pattern_cb(NULL, offset, _pkt, len);
+        if ((res = sock_tcp_write(&sock, _pkt, len)) < 0) {
+            printf("Error: write failed (error code %d)\n", (int)-res);
+            sock_tcp_disconnect(&sock);
+            return 1;
+        }
+        offset += res;
+    }
+    /* the receiver answers with a single byte once it has everything so both
+     * variants are timed up to the final acknowledgement */
+    sock_tcp_read(&sock, &ack, sizeof(ack), RUDP_IDLE_TIMEOUT_US);
+    _print_result("tcp", size, xtimer_now_usec() - start);
+    sock_tcp_disconnect(&sock);
+    return 0;
+}
+#endif
+
+int rudp_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("usage: %s [send|tcp]\n", argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "send") == 0) {
+        rudp_params_t params = {
+            .chunk = RUDP_CHUNK_SIZE,
+            .window = RUDP_WINDOW,
+            .rate = 0,
+        };
+        if (argc < 5) {
+            printf("usage: %s send <addr> <port> <size> [<chunk> [<window> "
+                   "[<rate in kbit/s>]]]\n", argv[0]);
+            return 1;
+        }
+        if (argc > 5) {
+            params.chunk = atoi(argv[5]);
+        }
+        if (argc > 6) {
+            params.window = atoi(argv[6]);
+        }
+        if (argc > 7) {
+            params.rate = (uint32_t)atoi(argv[7]) * 1000 / 8;
+        }
+        return rudp_send_cmd(argv[2], argv[3], strtoul(argv[4], NULL, 0),
+                             &params);
+    }
+#ifdef MODULE_SOCK_TCP
+    else if (strcmp(argv[1], "tcp") == 0) {
+        if (argc < 5) {
+            printf("usage: %s tcp <addr> <port> <size>\n", argv[0]);
+            return 1;
+        }
+        return rudp_tcp_cmd(argv[2], argv[3], strtoul(argv[4], NULL, 0));
+    }
+#endif
+    else {
+        puts("error: invalid command");
+        return 1;
+    }
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
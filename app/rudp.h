@@ -0,0 +1,175 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Reliable UDP bulk transfer with selective repeat
+ *
+ * The transfer is split into fixed-size chunks that are sent over a UDP
+ * sock. The receiver (see `tools/rudp_recv.py`) periodically reports the
+ * first missing chunk plus a bitmap of the chunks received after it, so the
+ * sender only repeats what was actually lost.
+ *
+ *     START  | type | flags | session | total size (32) | chunk size (16) | 0 |
+ *     DATA   | type | flags | session | seq (32)        | timestamp (32)      | payload
+ *     ACK    | type | flags | session | base (32)       | echo timestamp (32) | bitmap
+ *     FIN    | type | flags | session |
+ * @}
+ */
+#ifndef RUDP_H
+#define RUDP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "byteorder.h"
+#include "net/sock/udp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef RUDP_CHUNK_SIZE
+#define RUDP_CHUNK_SIZE         (1024U)     /**< default payload per datagram */
+#endif
+#ifndef RUDP_CHUNK_MAX
+#define RUDP_CHUNK_MAX          (1440U)     /**< largest unfragmented payload */
+#endif
+#ifndef RUDP_WINDOW
+#define RUDP_WINDOW             (256U)      /**< sending window in chunks */
+#endif
+#ifndef RUDP_RTO_MIN_US
+#define RUDP_RTO_MIN_US         (20000UL)   /**< lower bound for retransmission timeout */
+#endif
+#ifndef RUDP_START_RETRIES
+#define RUDP_START_RETRIES      (10U)       /**< START attempts before giving up */
+#endif
+#ifndef RUDP_IDLE_TIMEOUT_US
+#define RUDP_IDLE_TIMEOUT_US    (5000000UL) /**< abort when peer is silent this long */
+#endif
+/** @} */
+
+/**
+ * @brief   Number of chunks covered by the bitmap in an ACK
+ */
+#define RUDP_BITMAP_BITS        (256U)
+
+/**
+ * @brief   Packet types
+ */
+enum {
+    RUDP_TYPE_START = 1,
+    RUDP_TYPE_DATA  = 2,
+    RUDP_TYPE_ACK   = 3,
+    RUDP_TYPE_FIN   = 4,
+};
+
+/**
+ * @brief   Common packet header
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t type;                   /**< packet type */
+    uint8_t flags;                  /**< reserved, 0 */
+    network_uint16_t session;       /**< transfer session */
+} rudp_hdr_t;
+
+/**
+ * @brief   START packet, repeated until the receiver ACKs it
+ */
+typedef struct __attribute__((packed)) {
+    rudp_hdr_t hdr;                 /**< common header */
+    network_uint32_t total;         /**< transfer size in bytes */
+    network_uint16_t chunk;         /**< payload size of every but the last chunk */
+    network_uint16_t reserved;      /**< 0 */
+} rudp_start_t;
+
+/**
+ * @brief   DATA packet header, followed by the chunk payload
+ */
+typedef struct __attribute__((packed)) {
+    rudp_hdr_t hdr;                 /**< common header */
+    network_uint32_t seq;           /**< chunk index */
+    network_uint32_t ts;            /**< sender timestamp, echoed in ACK */
+} rudp_data_t;
+
+/**
+ * @brief   ACK packet with selective acknowledgement bitmap
+ *
+ * All chunks below @p base were received. Bit `i` of @p bitmap (LSB first
+ * in byte `i / 8`) is set if chunk `base + i` was received; a cleared bit
+ * below the highest set one is a negative acknowledgement.
+ */
+typedef struct __attribute__((packed)) {
+    rudp_hdr_t hdr;                 /**< common header */
+    network_uint32_t base;          /**< first missing chunk */
+    network_uint32_t echo_ts;       /**< timestamp of latest DATA received */
+    uint8_t bitmap[RUDP_BITMAP_BITS / 8]; /**< chunks received after base */
+} rudp_ack_t;
+
+/**
+ * @brief   Transfer parameters
+ */
+typedef struct {
+    uint16_t chunk;                 /**< payload per datagram */
+    uint16_t window;                /**< sending window in chunks */
+    uint32_t rate;                  /**< rate ceiling in bytes/s, 0 for unpaced */
+} rudp_params_t;
+
+/**
+ * @brief   Transfer statistics
+ */
+typedef struct {
+    uint32_t duration_us;           /**< START to final ACK */
+    uint32_t sent;                  /**< DATA packets sent */
+    uint32_t retrans;               /**< DATA packets sent more than once */
+    uint32_t acks;                  /**< ACKs received */
+    uint32_t srtt_us;               /**< smoothed round trip time */
+    uint32_t rate;                  /**< final pacing rate in bytes/s */
+} rudp_stats_t;
+
+/**
+ * @brief   Callback to fetch transfer data
+ *
+ * @param[in] arg       user argument
+ * @param[in] offset    byte offset into the transfer
+ * @param[out] buf      buffer to fill
+ * @param[in] len       number of bytes to fill
+ */
+typedef void (*rudp_read_cb_t)(void *arg, uint32_t offset, uint8_t *buf,
+                               size_t len);
+
+/**
+ * @brief   Reliably send @p size bytes to @p remote
+ *
+ * @param[in] remote    receiver end point
+ * @param[in] size      transfer size in bytes
+ * @param[in] read_cb   provides the data of each chunk on (re)transmission
+ * @param[in] arg       argument for @p read_cb
+ * @param[in] params    transfer parameters
+ * @param[out] stats    transfer statistics, may be NULL
+ *
+ * @return  0 on success
+ * @return  -EINVAL on invalid parameters
+ * @return  -ETIMEDOUT if the receiver stopped answering
+ * @return  other negative errno from the UDP sock
+ */
+int rudp_send(const sock_udp_ep_t *remote, uint32_t size,
+              rudp_read_cb_t read_cb, void *arg,
+              const rudp_params_t *params, rudp_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RUDP_H */
+/** @} */
@@ -0,0 +1,586 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       MAC address filtering and RX early-drop rules
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "lwip/netif.h"
+#include "lwip/tcpip.h"
+#include "mutex.h"
+#include "netdev_hook.h"
+#include "rxfilter.h"
+
+#if defined(MODULE_STM32_ETH) && !defined(RXFILTER_MODEL)
+#include "cpu.h"
+#endif
+
+#define ETH_HDR_LEN         (14U)
+#define ETH_TYPE_OFFSET     (12U)
+#define VLAN_TAG_LEN        (4U)
+#define ETH_TYPE_VLAN       (0x8100U)
+#define ETH_TYPE_IPV4       (0x0800U)
+#define IP_PROTO_TCP        (6U)
+#define IP_PROTO_UDP        (17U)
+
+/* MACFFR bits of the STM32 Ethernet MAC */
+#define MACFFR_PM           (1UL << 0)      /* promiscuous */
+#define MACFFR_HM           (1UL << 2)      /* hash multicast */
+#define MACFFR_PAM          (1UL << 4)      /* pass all multicast */
+#define MACFFR_BFD          (1UL << 5)      /* broadcast frames disable */
+#define MACFFR_HPF          (1UL << 10)     /* hash or perfect filter */
+#define MACFFR_RA           (1UL << 31)     /* receive all */
+#define MACAHR_AE           (1UL << 31)     /* address enable */
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t refs;           /* 0 marks a free entry */
+} _group_t;
+
+typedef struct {
+    uint16_t ethertype;
+    uint16_t port;
+    uint8_t proto;
+    bool used;
+    uint32_t hits;
+} _rule_t;
+
+/* shadow of the filter registers, the model on BOARD=native */
+static struct {
+    uint32_t ffr;
+    uint32_t hash[2];       /* low, high */
+    uint32_t addr_hi[RXFILTER_PERFECT_NUMOF];
+    uint32_t addr_lo[RXFILTER_PERFECT_NUMOF];
+} _regs;
+
+static netdev_hook_t _hook;
+static mutex_t _lock = MUTEX_INIT;
+static _group_t _groups[RXFILTER_GROUPS];
+static _rule_t _rules[RXFILTER_RULES];
+static rxfilter_stats_t _stats;
+static bool _pass_all;
+
+/* bit number in the hash table: the upper 6 bits of the bit-reversed
+ * Ethernet CRC of the address */
+static unsigned _hash(const uint8_t *mac)
+{
+    uint32_t crc = 0xffffffff;
+    unsigned idx = 0;
+
+    for (unsigned i = 0; i < 6; i++) {
+        crc ^= mac[i];
+        for (unsigned bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+        }
+    }
+    crc = ~crc;
+    for (unsigned i = 0; i < 6; i++) {
+        idx = (idx << 1) | ((crc >> i) & 1);
+    }
+    return idx;
+}
+
+static void _write_regs(void)
+{
+#if defined(MODULE_STM32_ETH) && !defined(RXFILTER_MODEL)
+    volatile uint32_t *hi[RXFILTER_PERFECT_NUMOF] = {
+        &ETH->MACA1HR, &ETH->MACA2HR, &ETH->MACA3HR
+    };
+    volatile uint32_t *lo[RXFILTER_PERFECT_NUMOF] = {
+        &ETH->MACA1LR, &ETH->MACA2LR, &ETH->MACA3LR
+    };
+
+    for (unsigned i = 0; i < RXFILTER_PERFECT_NUMOF; i++) {
+        /* the address is latched on the write of the low register */
+        *hi[i] = _regs.addr_hi[i];
+        *lo[i] = _regs.addr_lo[i];
+    }
+    ETH->MACHTHR = _regs.hash[1];
+    ETH->MACHTLR = _regs.hash[0];
+    ETH->MACFFR = _regs.ffr;
+#endif
+}
+
+/* called with _lock held */
+static void _program(void)
+{
+    unsigned perfect = 0;
+
+    memset(&_regs, 0, sizeof(_regs));
+    for (unsigned i = 0; i < RXFILTER_GROUPS; i++) {
+        const uint8_t *mac = _groups[i].mac;
+
+        if (_groups[i].refs == 0) {
+            continue;
+        }
+        if (perfect < RXFILTER_PERFECT_NUMOF) {
+            _regs.addr_hi[perfect] = MACAHR_AE | (mac[5] << 8) | mac[4];
+            _regs.addr_lo[perfect] = ((uint32_t)mac[3] << 24) |
+                                     ((uint32_t)mac[2] << 16) |
+                                     (mac[1] << 8) | mac[0];
+            perfect++;
+        }
+        else {
+            unsigned idx = _hash(mac);
+
+            _regs.hash[idx >> 5] |= 1UL << (idx & 0x1f);
+        }
+    }
+    _regs.ffr = MACFFR_HPF | MACFFR_HM | (_pass_all ? MACFFR_PAM : 0);
+    _write_regs();
+}
+
+static bool _perfect_match(const uint8_t *dst)
+{
+    for (unsigned i = 0; i < RXFILTER_PERFECT_NUMOF; i++) {
+        if ((_regs.addr_hi[i] & MACAHR_AE) &&
+            (_regs.addr_lo[i] == (((uint32_t)dst[3] << 24) |
+                                  ((uint32_t)dst[2] << 16) |
+                                  (dst[1] << 8) | dst[0])) &&
+            ((_regs.addr_hi[i] & 0xffff) == (uint32_t)((dst[5] << 8) | dst[4]))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+rxfilter_result_t rxfilter_mac_match(const uint8_t *dst)
+{
+    static const uint8_t bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    struct netif *netif = netdev_hook_netif();
+    uint32_t ffr = _regs.ffr;
+
+    if (ffr & (MACFFR_RA | MACFFR_PM)) {
+        return RXFILTER_PASS_ALL;
+    }
+    if (memcmp(dst, bcast, sizeof(bcast)) == 0) {
+        return (ffr & MACFFR_BFD) ? RXFILTER_DROP : RXFILTER_PASS_OWN;
+    }
+    if (dst[0] & 0x01) {
+        unsigned idx = _hash(dst);
+
+        if (ffr & MACFFR_PAM) {
+            return RXFILTER_PASS_ALL;
+        }
+        /* with HM set, the perfect filter only counts together with HPF */
+        if ((!(ffr & MACFFR_HM) || (ffr & MACFFR_HPF)) && _perfect_match(dst)) {
+            return RXFILTER_PASS_PERFECT;
+        }
+        if ((ffr & MACFFR_HM) && (_regs.hash[idx >> 5] & (1UL << (idx & 0x1f)))) {
+            return RXFILTER_PASS_HASH;
+        }
+        return RXFILTER_DROP;
+    }
+    if (netif && (memcmp(dst, netif->hwaddr, sizeof(bcast)) == 0)) {
+        return RXFILTER_PASS_OWN;
+    }
+    return _perfect_match(dst) ? RXFILTER_PASS_PERFECT : RXFILTER_DROP;
+}
+
+static bool _rule_drop(const uint8_t *frame, size_t len)
+{
+    size_t offset = ETH_TYPE_OFFSET;
+    uint16_t type = (frame[offset] << 8) | frame[offset + 1];
+    uint8_t proto = 0;
+    uint16_t port = 0;
+
+    if ((type == ETH_TYPE_VLAN) && (len >= (ETH_HDR_LEN + VLAN_TAG_LEN))) {
+        offset += VLAN_TAG_LEN;
+        type = (frame[offset] << 8) | frame[offset + 1];
+    }
+    offset += 2;
+    if ((type == ETH_TYPE_IPV4) && (len >= (offset + 20))) {
+        const uint8_t *ip = frame + offset;
+        size_t ihl = (ip[0] & 0x0f) * 4;
+
+        proto = ip[9];
+        /* only the first fragment carries the ports */
+        if (((proto == IP_PROTO_UDP) || (proto == IP_PROTO_TCP)) &&
+            !(((ip[6] & 0x1f) << 8) | ip[7]) && (len >= (offset + ihl + 4))) {
+            port = (ip[ihl + 2] << 8) | ip[ihl + 3];
+        }
+    }
+    for (unsigned i = 0; i < RXFILTER_RULES; i++) {
+        _rule_t *rule = &_rules[i];
+
+        if (rule->used && (rule->ethertype == type) &&
+            (!rule->proto || (rule->proto == proto)) &&
+            (!rule->port || (rule->port == port))) {
+            rule->hits++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* runs in the lwIP netdev thread, before any pbuf is allocated */
+static int _rx(netdev_hook_t *hook, netdev_t *dev, uint8_t *frame, size_t len)
+{
+    (void)hook;
+    (void)dev;
+    if (len < ETH_HDR_LEN) {
+        return len;
+    }
+#ifdef RXFILTER_MODEL
+    if (rxfilter_mac_match(frame) == RXFILTER_DROP) {
+        _stats.mac_dropped++;
+        return 0;
+    }
+#endif
+    if (_rule_drop(frame, len)) {
+        _stats.rule_dropped++;
+        return 0;
+    }
+    if (frame[0] & 0x01) {
+        if ((frame[0] & frame[1] & frame[2] & frame[3] & frame[4] &
+             frame[5]) == 0xff) {
+            _stats.broadcast++;
+        }
+        else {
+            _stats.multicast++;
+        }
+    }
+    return len;
+}
+
+int rxfilter_mac_add(const uint8_t *mac)
+{
+    _group_t *free = NULL;
+
+    if (!(mac[0] & 0x01)) {
+        return -EINVAL;
+    }
+    mutex_lock(&_lock);
+    for (unsigned i = 0; i < RXFILTER_GROUPS; i++) {
+        if (_groups[i].refs && (memcmp(_groups[i].mac, mac, 6) == 0)) {
+            _groups[i].refs++;
+            mutex_unlock(&_lock);
+            return 0;
+        }
+        if ((_groups[i].refs == 0) && (free == NULL)) {
+            free = &_groups[i];
+        }
+    }
+    if (free == NULL) {
+        /* better too many frames than missing a group */
+        _pass_all = true;
+        _program();
+        mutex_unlock(&_lock);
+        return -ENOMEM;
+    }
+    memcpy(free->mac, mac, 6);
+    free->refs = 1;
+    _program();
+    mutex_unlock(&_lock);
+    return 0;
+}
+
+int rxfilter_mac_del(const uint8_t *mac)
+{
+    mutex_lock(&_lock);
+    for (unsigned i = 0; i < RXFILTER_GROUPS; i++) {
+        if (_groups[i].refs && (memcmp(_groups[i].mac, mac, 6) == 0)) {
+            if (--_groups[i].refs == 0) {
+                _program();
+            }
+            mutex_unlock(&_lock);
+            return 0;
+        }
+    }
+    mutex_unlock(&_lock);
+    return -ENOENT;
+}
+
+void rxfilter_pass_all_multicast(bool on)
+{
+    mutex_lock(&_lock);
+    _pass_all = on;
+    _program();
+    mutex_unlock(&_lock);
+}
+
+#if LWIP_IGMP
+static const uint8_t _all_systems[6] = { 0x01, 0x00, 0x5e, 0x00, 0x00, 0x01 };
+
+/* runs in the tcpip thread */
+static err_t _igmp_mac_filter(struct netif *netif, const ip4_addr_t *group,
+                              enum netif_mac_filter_action action)
+{
+    const uint8_t *addr = (const uint8_t *)&group->addr;
+    uint8_t mac[6] = { 0x01, 0x00, 0x5e, addr[1] & 0x7f, addr[2], addr[3] };
+    int res;
+
+    (void)netif;
+    if (action == NETIF_ADD_MAC_FILTER) {
+        res = rxfilter_mac_add(mac);
+    }
+    else {
+        res = rxfilter_mac_del(mac);
+    }
+    return (res < 0) ? ERR_IF : ERR_OK;
+}
+#endif
+
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+static const uint8_t _all_nodes[6] = { 0x33, 0x33, 0x00, 0x00, 0x00, 0x01 };
+
+/* runs in the tcpip thread */
+static err_t _mld_mac_filter(struct netif *netif, const ip6_addr_t *group,
+                             enum netif_mac_filter_action action)
+{
+    const uint8_t *addr = (const uint8_t *)&group->addr[3];
+    uint8_t mac[6] = { 0x33, 0x33, addr[0], addr[1], addr[2], addr[3] };
+    int res;
+
+    (void)netif;
+    if (action == NETIF_ADD_MAC_FILTER) {
+        res = rxfilter_mac_add(mac);
+    }
+    else {
+        res = rxfilter_mac_del(mac);
+    }
+    return (res < 0) ? ERR_IF : ERR_OK;
+}
+#endif
+
+void rxfilter_init(void)
+{
+    struct netif *netif = netdev_hook_netif();
+
+    _hook.rx = _rx;
+    netdev_hook_add(&_hook);
+    mutex_lock(&_lock);
+    _program();
+    mutex_unlock(&_lock);
+    if (netif == NULL) {
+        return;
+    }
+    LOCK_TCPIP_CORE();
+#if LWIP_IGMP
+    /* mcast_init() starts IGMP later, its join of 224.0.0.1 then goes
+     * through the filter. Only a netif that already runs IGMP joined it
+     * before the filter function was set. */
+    if (netif->flags & NETIF_FLAG_IGMP) {
+        rxfilter_mac_add(_all_systems);
+    }
+    netif_set_igmp_mac_filter(netif, _igmp_mac_filter);
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+    /* same for all-nodes and the solicited-node groups of the addresses */
+    rxfilter_mac_add(_all_nodes);
+    for (int i = 0; i < LWIP_IPV6_NUM_ADDRESSES; i++) {
+        if (!ip6_addr_isinvalid(netif_ip6_addr_state(netif, i))) {
+            const uint8_t *addr = (const uint8_t *)&netif_ip6_addr(netif, i)->addr[3];
+            uint8_t mac[6] = { 0x33, 0x33, 0xff, addr[1], addr[2], addr[3] };
+
+            rxfilter_mac_add(mac);
+        }
+    }
+    netif_set_mld_mac_filter(netif, _mld_mac_filter);
+#endif
+    UNLOCK_TCPIP_CORE();
+}
+
+int rxfilter_rule_add(uint16_t ethertype, uint8_t proto, uint16_t port)
+{
+    for (unsigned i = 0; i < RXFILTER_RULES; i++) {
+        _rule_t *rule = &_rules[i];
+
+        if (!rule->used) {
+            rule->ethertype = ethertype;
+            rule->proto = proto;
+            rule->port = port;
+            rule->hits = 0;
+            /* set last, the netdev thread uses the rule from here on */
+            rule->used = true;
+            return i;
+        }
+    }
+    return -ENOMEM;
+}
+
+int rxfilter_rule_del(unsigned idx)
+{
+    if ((idx >= RXFILTER_RULES) || !_rules[idx].used) {
+        return -ENOENT;
+    }
+    _rules[idx].used = false;
+    return 0;
+}
+
+const rxfilter_stats_t *rxfilter_stats(void)
+{
+    return &_stats;
+}
+
+static const char *_result_str(rxfilter_result_t res)
+{
+    switch (res) {
+        case RXFILTER_PASS_OWN:
+            return "pass (own or broadcast)";
+        case RXFILTER_PASS_PERFECT:
+            return "pass (perfect filter)";
+        case RXFILTER_PASS_HASH:
+            return "pass (hash)";
+        case RXFILTER_PASS_ALL:
+            return "pass (all)";
+        default:
+            return "drop";
+    }
+}
+
+static void _print_mac(const uint8_t *mac)
+{
+    printf("%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3],
+           mac[4], mac[5]);
+}
+
+static int filter_print(void)
+{
+    printf("MAC filter%s: MACFFR 0x%08" PRIx32 ", hash 0x%08" PRIx32
+           "%08" PRIx32 "\n",
+#ifdef RXFILTER_MODEL
+           " (model)",
+#else
+           "",
+#endif
+           _regs.ffr, _regs.hash[1], _regs.hash[0]);
+    for (unsigned i = 0; i < RXFILTER_GROUPS; i++) {
+        if (_groups[i].refs) {
+            printf("  ");
+            _print_mac(_groups[i].mac);
+            printf(" refs %u, %s\n", _groups[i].refs,
+                   _result_str(rxfilter_mac_match(_groups[i].mac)));
+        }
+    }
+    for (unsigned i = 0; i < RXFILTER_RULES; i++) {
+        const _rule_t *rule = &_rules[i];
+
+        if (rule->used) {
+            printf("rule %u: ethertype 0x%04x, proto %u, port %u: %" PRIu32
+                   " hits\n", i, rule->ethertype, rule->proto, rule->port,
+                   rule->hits);
+        }
+    }
+    printf("passed %" PRIu32 " multicast, %" PRIu32 " broadcast, dropped %"
+           PRIu32 " by MAC filter, %" PRIu32 " by rules\n", _stats.multicast,
+           _stats.broadcast, _stats.mac_dropped, _stats.rule_dropped);
+    return 0;
+}
+
+static int _parse_mac(uint8_t *mac, const char *str)
+{
+    if (hex2ints(mac, str) != 6) {
+        printf("error: unable to parse MAC address %s\n", str);
+        return 1;
+    }
+    return 0;
+}
+
+static int filter_mac(int argc, char **argv)
+{
+    uint8_t mac[6];
+    int res;
+
+    if ((argc < 4) || _parse_mac(mac, argv[3])) {
+        printf("usage: %s mac [add|del] <mac>\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[2], "add") == 0) {
+        res = rxfilter_mac_add(mac);
+    }
+    else if (strcmp(argv[2], "del") == 0) {
+        res = rxfilter_mac_del(mac);
+    }
+    else {
+        printf("usage: %s mac [add|del] <mac>\n", argv[0]);
+        return 1;
+    }
+    if (res < 0) {
+        printf("error: unable to update the filter (error code %d)\n", -res);
+        return 1;
+    }
+    return 0;
+}
+
+int filter_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        return filter_print();
+    }
+    else if (strcmp(argv[1], "mac") == 0) {
+        return filter_mac(argc, argv);
+    }
+    else if (strcmp(argv[1], "test") == 0) {
+        uint8_t mac[6];
+
+        if ((argc < 3) || _parse_mac(mac, argv[2])) {
+            printf("usage: %s test <mac>\n", argv[0]);
+            return 1;
+        }
+        printf("%s (hash bit %u)\n", _result_str(rxfilter_mac_match(mac)),
+               _hash(mac));
+        return 0;
+    }
+    else if (strcmp(argv[1], "all") == 0) {
+        if (argc < 3) {
+            printf("usage: %s all [on|off]\n", argv[0]);
+            return 1;
+        }
+        rxfilter_pass_all_multicast(strcmp(argv[2], "on") == 0);
+        return 0;
+    }
+    else if (strcmp(argv[1], "drop") == 0) {
+        int res;
+
+        if (argc < 3) {
+            printf("usage: %s drop <ethertype> [<ip proto> [<dst port>]]\n",
+                   argv[0]);
+            return 1;
+        }
+        res = rxfilter_rule_add(strtoul(argv[2], NULL, 0),
+                                (argc > 3) ? atoi(argv[3]) : 0,
+                                (argc > 4) ? atoi(argv[4]) : 0);
+        if (res < 0) {
+            puts("error: no free rule");
+            return 1;
+        }
+        printf("rule %d added\n", res);
+        return 0;
+    }
+    else if (strcmp(argv[1], "undrop") == 0) {
+        if ((argc < 3) || (rxfilter_rule_del(atoi(argv[2])) < 0)) {
+            printf("usage: %s undrop <rule>\n", argv[0]);
+            return 1;
+        }
+        return 0;
+    }
+    else if (strcmp(argv[1], "reset") == 0) {
+        memset(&_stats, 0, sizeof(_stats));
+        for (unsigned i = 0; i < RXFILTER_RULES; i++) {
+            _rules[i].hits = 0;
+        }
+        return 0;
+    }
+    else {
+        printf("usage: %s [mac|test|all|drop|undrop|reset]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
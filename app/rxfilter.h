@@ -0,0 +1,162 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       MAC address filtering and RX early-drop rules
+ *
+ * The multicast groups lwIP joins (IGMP and MLD) are programmed into the
+ * address filter of the STM32 Ethernet MAC: the first
+ * @ref RXFILTER_PERFECT_NUMOF groups into the spare perfect filter address
+ * registers, all others into the 64 bit hash table. Multicast frames of
+ * other groups are then dropped by the MAC without CPU involvement.
+ *
+ * The early-drop rules match the EtherType and, for IPv4, the protocol and
+ * destination port. They run as the first RX hook, right after the driver
+ * copied the frame out of the DMA ring and before lwIP allocates a pbuf.
+ *
+ * On BOARD=native the register writes go to a model of the MAC filter that
+ * is applied in the RX hook, so the filter logic can be tried against the
+ * tap interface (`filter test` shows the decision for any address).
+ * @}
+ */
+#ifndef RXFILTER_H
+#define RXFILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef RXFILTER_GROUPS
+#define RXFILTER_GROUPS         (16U)       /**< multicast addresses tracked */
+#endif
+#ifndef RXFILTER_RULES
+#define RXFILTER_RULES          (8U)        /**< early-drop rules */
+#endif
+#if defined(BOARD_NATIVE) && !defined(RXFILTER_MODEL)
+#define RXFILTER_MODEL          (1)         /**< use the filter model */
+#endif
+/** @} */
+
+/**
+ * @brief   Number of perfect filter registers used for multicast
+ *
+ * The MAC has four address registers, the first one holds the own address.
+ */
+#define RXFILTER_PERFECT_NUMOF  (3U)
+
+/**
+ * @brief   Filter decisions of @ref rxfilter_mac_match
+ */
+typedef enum {
+    RXFILTER_DROP,              /**< dropped by the MAC */
+    RXFILTER_PASS_OWN,          /**< own unicast or broadcast address */
+    RXFILTER_PASS_PERFECT,      /**< matched a perfect filter register */
+    RXFILTER_PASS_HASH,         /**< matched the hash table */
+    RXFILTER_PASS_ALL,          /**< filter disabled */
+} rxfilter_result_t;
+
+/**
+ * @brief   Filter statistics
+ */
+typedef struct {
+    uint32_t multicast;         /**< multicast frames passed to lwIP */
+    uint32_t broadcast;         /**< broadcast frames passed to lwIP */
+    uint32_t mac_dropped;       /**< frames dropped by the filter model */
+    uint32_t rule_dropped;      /**< frames dropped by early-drop rules */
+} rxfilter_stats_t;
+
+/**
+ * @brief   Register the RX hook and program the MAC filter
+ *
+ * Call right after netdev_hook_init(), before other RX hooks are added.
+ */
+void rxfilter_init(void);
+
+/**
+ * @brief   Pass frames to the multicast MAC address @p mac
+ *
+ * Calls are counted, each needs a matching @ref rxfilter_mac_del.
+ *
+ * @return  0 on success
+ * @return  -EINVAL if @p mac is no multicast address
+ * @return  -ENOMEM if the table is full
+ */
+int rxfilter_mac_add(const uint8_t *mac);
+
+/**
+ * @brief   Stop passing frames to the multicast MAC address @p mac
+ *
+ * @return  0 on success
+ * @return  -ENOENT if @p mac was not added
+ */
+int rxfilter_mac_del(const uint8_t *mac);
+
+/**
+ * @brief   Evaluate the MAC filter for destination address @p dst
+ *
+ * Follows the programmed registers, so it tells what the MAC does with a
+ * frame to @p dst.
+ */
+rxfilter_result_t rxfilter_mac_match(const uint8_t *dst);
+
+/**
+ * @brief   Let every multicast frame pass (or not)
+ */
+void rxfilter_pass_all_multicast(bool on);
+
+/**
+ * @brief   Add an early-drop rule
+ *
+ * @param[in] ethertype EtherType to match
+ * @param[in] proto     IPv4 protocol to match, 0 for any
+ * @param[in] port      UDP/TCP destination port to match, 0 for any
+ *
+ * @return  index of the rule on success
+ * @return  -ENOMEM if all rules are in use
+ */
+int rxfilter_rule_add(uint16_t ethertype, uint8_t proto, uint16_t port);
+
+/**
+ * @brief   Remove early-drop rule @p idx
+ *
+ * @return  0 on success
+ * @return  -ENOENT if there is no such rule
+ */
+int rxfilter_rule_del(unsigned idx);
+
+/**
+ * @brief   Get the filter statistics
+ */
+const rxfilter_stats_t *rxfilter_stats(void);
+
+/**
+ * @brief   Filter shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int filter_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RXFILTER_H */
+/** @} */
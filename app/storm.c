@@ -0,0 +1,290 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Broadcast and multicast storm protection
+ * @}
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdev_hook.h"
+#include "prio.h"
+#include "storm.h"
+#include "thread.h"
+#include "xtimer.h"
+
+#define ETH_HDR_LEN         (14U)
+#define ETH_TYPE_OFFSET     (12U)
+#define VLAN_TAG_LEN        (4U)
+#define IP_PROTO_ICMP       (1U)
+#define EXIT_WAIT_US        (100U * US_PER_MS)
+
+typedef struct {
+    uint32_t rate;
+    uint32_t burst;
+    uint64_t credit;        /* in 1/US_PER_SEC frames */
+    uint32_t last;
+} _bucket_t;
+
+static const char *_names[STORM_NUMOF] = {
+    [STORM_ARP] = "arp",
+    [STORM_ICMP] = "icmp",
+    [STORM_BCAST] = "bcast",
+    [STORM_MCAST] = "mcast",
+    [STORM_UNICAST] = "unicast",
+};
+
+static _bucket_t _buckets[STORM_NUMOF] = {
+    [STORM_ARP] = { .rate = STORM_ARP_RATE, .burst = STORM_ARP_BURST },
+    [STORM_ICMP] = { .rate = STORM_ICMP_RATE, .burst = STORM_ICMP_BURST },
+    [STORM_BCAST] = { .rate = STORM_BCAST_RATE, .burst = STORM_BCAST_BURST },
+    [STORM_MCAST] = { .rate = STORM_MCAST_RATE, .burst = STORM_MCAST_BURST },
+    [STORM_UNICAST] = { .rate = STORM_UNICAST_RATE,
+                        .burst = STORM_UNICAST_BURST },
+};
+static storm_stats_t _stats[STORM_NUMOF];
+static netdev_hook_t _hook;
+static bool _enabled = true;
+
+static storm_class_t _classify(const uint8_t *frame, size_t len)
+{
+    size_t offset = ETH_TYPE_OFFSET;
+
+    if ((frame[offset] == 0x81) && (frame[offset + 1] == 0x00) &&
+        (len >= (ETH_HDR_LEN + VLAN_TAG_LEN))) {
+        offset += VLAN_TAG_LEN;
+    }
+    if ((frame[offset] == 0x08) && (frame[offset + 1] == 0x06)) {
+        return STORM_ARP;
+    }
+    /* protocol field of the IPv4 header */
+    if ((frame[offset] == 0x08) && (frame[offset + 1] == 0x00) &&
+        (len > (offset + 2 + 9)) && (frame[offset + 2 + 9] == IP_PROTO_ICMP)) {
+        return STORM_ICMP;
+    }
+    if (frame[0] & 0x01) {
+        return ((frame[0] & frame[1] & frame[2] & frame[3] & frame[4] &
+                 frame[5]) == 0xff) ? STORM_BCAST : STORM_MCAST;
+    }
+    return STORM_UNICAST;
+}
+
+static bool _conform(_bucket_t *b, uint32_t now)
+{
+    uint64_t max = (uint64_t)b->burst * US_PER_SEC;
+
+    b->credit += (uint64_t)(now - b->last) * b->rate;
+    b->last = now;
+    if (b->credit > max) {
+        b->credit = max;
+    }
+    if (b->credit < US_PER_SEC) {
+        return false;
+    }
+    b->credit -= US_PER_SEC;
+    return true;
+}
+
+/* runs in the lwIP netdev thread, before any pbuf is allocated */
+static int _rx(netdev_hook_t *hook, netdev_t *dev, uint8_t *frame, size_t len)
+{
+    storm_class_t cls;
+    _bucket_t *b;
+
+    (void)hook;
+    (void)dev;
+    if (!_enabled || (len < ETH_HDR_LEN)) {
+        return len;
+    }
+    cls = _classify(frame, len);
+    b = &_buckets[cls];
+    if (b->rate && !_conform(b, xtimer_now_usec())) {
+        _stats[cls].dropped++;
+        return 0;
+    }
+    _stats[cls].passed++;
+    return len;
+}
+
+void storm_init(void)
+{
+    uint32_t now = xtimer_now_usec();
+
+    for (unsigned i = 0; i < STORM_NUMOF; i++) {
+        _buckets[i].last = now;
+        _buckets[i].credit = (uint64_t)_buckets[i].burst * US_PER_SEC;
+    }
+    _hook.rx = _rx;
+    netdev_hook_add(&_hook);
+}
+
+void storm_enable(bool on)
+{
+    _enabled = on;
+}
+
+void storm_set(storm_class_t cls, uint32_t rate, uint32_t burst)
+{
+    if (cls < STORM_NUMOF) {
+        _bucket_t *b = &_buckets[cls];
+
+        /* a bucket needs room for at least one frame */
+        b->burst = MAX(burst, 1);
+        b->credit = (uint64_t)b->burst * US_PER_SEC;
+        b->last = xtimer_now_usec();
+        b->rate = rate;
+    }
+}
+
+const storm_stats_t *storm_stats(storm_class_t cls)
+{
+    return (cls < STORM_NUMOF) ? &_stats[cls] : NULL;
+}
+
+static char _bench_stack[THREAD_STACKSIZE_DEFAULT];
+static volatile bool _bench_run, _bench_running;
+static uint32_t _bench_loops, _bench_max_gap;
+
+/* stands in for the application, below all network threads */
+static void *_bench_thread(void *arg)
+{
+    uint32_t last = xtimer_now_usec();
+
+    (void)arg;
+    _bench_loops = 0;
+    _bench_max_gap = 0;
+    while (_bench_run) {
+        uint32_t now = xtimer_now_usec();
+
+        if ((now - last) > _bench_max_gap) {
+            _bench_max_gap = now - last;
+        }
+        last = now;
+        _bench_loops++;
+    }
+    _bench_running = false;
+    return NULL;
+}
+
+static int storm_bench(unsigned seconds)
+{
+    storm_stats_t before[STORM_NUMOF];
+    uint32_t start, duration;
+    kernel_pid_t pid;
+
+    /* the stack is shared, a worker held off by other PRIO_BULK threads
+     * may not have seen the end of the last run yet */
+    if (_bench_running) {
+        puts("error: worker of the last run still running");
+        return 1;
+    }
+    puts("note: the worker spins at PRIO_BULK, other bulk senders starve");
+    memcpy(before, _stats, sizeof(before));
+    _bench_run = true;
+    _bench_running = true;
+    start = xtimer_now_usec();
+    pid = thread_create(_bench_stack, sizeof(_bench_stack), PRIO_BULK,
+                        THREAD_CREATE_STACKTEST, _bench_thread, NULL,
+                        "storm_bench");
+    if (pid <= KERNEL_PID_UNDEF) {
+        puts("error: could not create the worker");
+        _bench_running = false;
+        return 1;
+    }
+    xtimer_sleep(seconds);
+    _bench_run = false;
+    duration = xtimer_now_usec() - start;
+    /* let the worker see the flag and exit */
+    for (uint32_t stop = xtimer_now_usec();
+         _bench_running && ((xtimer_now_usec() - stop) < EXIT_WAIT_US);) {
+        xtimer_usleep(US_PER_MS);
+    }
+    printf("policing %s: %" PRIu32 " loops/ms, longest starvation %" PRIu32
+           " us\n", _enabled ? "on" : "off",
+           (uint32_t)(((uint64_t)_bench_loops * US_PER_MS) / duration),
+           _bench_max_gap);
+    for (unsigned i = 0; i < STORM_NUMOF; i++) {
+        printf("%-8s %" PRIu32 " frames/s passed, %" PRIu32 " frames/s dropped\n",
+               _names[i],
+               (uint32_t)(((uint64_t)(_stats[i].passed - before[i].passed) *
+                           US_PER_SEC) / duration),
+               (uint32_t)(((uint64_t)(_stats[i].dropped - before[i].dropped) *
+                           US_PER_SEC) / duration));
+    }
+    return 0;
+}
+
+static int storm_print(void)
+{
+    printf("policing %s\n", _enabled ? "on" : "off");
+    for (unsigned i = 0; i < STORM_NUMOF; i++) {
+        if (_buckets[i].rate) {
+            printf("%-8s %5" PRIu32 " frames/s, burst %3" PRIu32, _names[i],
+                   _buckets[i].rate, _buckets[i].burst);
+        }
+        else {
+            printf("%-8s   unpoliced           ", _names[i]);
+        }
+        printf(": %" PRIu32 " passed, %" PRIu32 " dropped\n",
+               _stats[i].passed, _stats[i].dropped);
+    }
+    return 0;
+}
+
+int storm_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        return storm_print();
+    }
+    else if (strcmp(argv[1], "on") == 0) {
+        storm_enable(true);
+        return 0;
+    }
+    else if (strcmp(argv[1], "off") == 0) {
+        storm_enable(false);
+        return 0;
+    }
+    else if (strcmp(argv[1], "reset") == 0) {
+        memset(_stats, 0, sizeof(_stats));
+        return 0;
+    }
+    else if (strcmp(argv[1], "set") == 0) {
+        if (argc < 5) {
+            printf("usage: %s set <class> <frames/s> <burst>\n", argv[0]);
+            return 1;
+        }
+        for (unsigned i = 0; i < STORM_NUMOF; i++) {
+            if (strcmp(argv[2], _names[i]) == 0) {
+                storm_set(i, strtoul(argv[3], NULL, 0),
+                          strtoul(argv[4], NULL, 0));
+                return 0;
+            }
+        }
+        printf("error: unknown class %s\n", argv[2]);
+        return 1;
+    }
+    else if (strcmp(argv[1], "bench") == 0) {
+        if (argc < 3) {
+            printf("usage: %s bench <seconds>\n", argv[0]);
+            return 1;
+        }
+        return storm_bench(atoi(argv[2]));
+    }
+    else {
+        printf("usage: %s [on|off|reset|set|bench]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
@@ -0,0 +1,133 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Broadcast and multicast storm protection
+ *
+ * Every received frame is put in one of the @ref storm_class_t classes and
+ * charged against the token bucket of its class in an RX hook, before lwIP
+ * allocates a pbuf. Frames beyond the budget are dropped right there, so a
+ * storm costs the driver copy and a few compares per frame instead of a trip
+ * through the stack. A rate of 0 leaves a class unpoliced.
+ *
+ * `storm bench` runs a worker below the network threads and reports how
+ * much CPU it got and the longest time it was starved, e.g. while
+ * `tools/storm.py` floods the interface. The worker spins at PRIO_BULK
+ * and, without time slicing, starves the other bulk threads (`qos bulk`,
+ * the ipref producer) for the whole run.
+ * @}
+ */
+#ifndef STORM_H
+#define STORM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default budgets in frames per second and burst frames
+ * @{
+ */
+#ifndef STORM_BCAST_RATE
+#define STORM_BCAST_RATE        (200U)
+#endif
+#ifndef STORM_BCAST_BURST
+#define STORM_BCAST_BURST       (50U)
+#endif
+#ifndef STORM_MCAST_RATE
+#define STORM_MCAST_RATE        (500U)
+#endif
+#ifndef STORM_MCAST_BURST
+#define STORM_MCAST_BURST       (100U)
+#endif
+#ifndef STORM_ARP_RATE
+#define STORM_ARP_RATE          (100U)
+#endif
+#ifndef STORM_ARP_BURST
+#define STORM_ARP_BURST         (20U)
+#endif
+#ifndef STORM_ICMP_RATE
+#define STORM_ICMP_RATE         (50U)
+#endif
+#ifndef STORM_ICMP_BURST
+#define STORM_ICMP_BURST        (10U)
+#endif
+#ifndef STORM_UNICAST_RATE
+#define STORM_UNICAST_RATE      (0U)        /**< unpoliced by default */
+#endif
+#ifndef STORM_UNICAST_BURST
+#define STORM_UNICAST_BURST     (0U)
+#endif
+/** @} */
+
+/**
+ * @brief   Traffic classes, checked in this order
+ */
+typedef enum {
+    STORM_ARP,                  /**< ARP, any destination */
+    STORM_ICMP,                 /**< ICMP, any destination */
+    STORM_BCAST,                /**< other broadcast frames */
+    STORM_MCAST,                /**< other multicast frames */
+    STORM_UNICAST,              /**< other frames to us */
+    STORM_NUMOF,                /**< number of classes */
+} storm_class_t;
+
+/**
+ * @brief   Per class counters
+ */
+typedef struct {
+    uint32_t passed;            /**< frames within the budget */
+    uint32_t dropped;           /**< frames dropped */
+} storm_stats_t;
+
+/**
+ * @brief   Register the RX hook
+ */
+void storm_init(void);
+
+/**
+ * @brief   Enable or disable policing
+ */
+void storm_enable(bool on);
+
+/**
+ * @brief   Set the budget of class @p cls
+ *
+ * @param[in] cls       traffic class
+ * @param[in] rate      frames per second, 0 to disable policing
+ * @param[in] burst     frames accepted at once
+ */
+void storm_set(storm_class_t cls, uint32_t rate, uint32_t burst);
+
+/**
+ * @brief   Get the counters of class @p cls
+ */
+const storm_stats_t *storm_stats(storm_class_t cls);
+
+/**
+ * @brief   Storm protection shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int storm_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STORM_H */
+/** @} */
@@ -0,0 +1,600 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Resilient record stream to a collector over TCP
+ * @}
+ */
+
+#ifdef MODULE_SOCK_TCP
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "boottime.h"
+#include "lwip/api.h"
+#include "lwip/netif.h"
+#include "lwip/tcp.h"
+#include "lwip/tcpip.h"
+#include "mutex.h"
+#include "net/ipv4/addr.h"
+#include "netdev_hook.h"
+#include "prio.h"
+#include "random.h"
+#include "stream.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include "xtimer.h"
+
+#define FLAG_DATA       (0x0001U)   /* record queued */
+#define FLAG_LINK       (0x0002U)   /* link state changed */
+#define FLAG_STANDBY    (0x0004U)   /* a connection became ready */
+#define FLAG_CONNECT    (0x0008U)   /* to the connector: slot went idle */
+#define FLAG_SPACE      (0x0100U)   /* to the writer: ring has room */
+
+#define SLOTS           (2U)
+
+typedef struct {
+    stream_hdr_t hdr;
+    uint8_t data[STREAM_RECORD_MAX];
+} _record_t;
+
+/* the connector owns IDLE and CONNECTING slots, the stream thread the rest */
+typedef enum {
+    SLOT_IDLE,
+    SLOT_CONNECTING,
+    SLOT_STANDBY,
+    SLOT_ACTIVE,
+} _slot_state_t;
+
+typedef struct {
+    sock_tcp_t sock;
+    sock_tcp_ep_t remote;
+    _slot_state_t state;
+    uint32_t backoff;
+    uint32_t next_try;
+} _slot_t;
+
+static const char *_state_names[] = {
+    [SLOT_IDLE] = "idle",
+    [SLOT_CONNECTING] = "connecting",
+    [SLOT_STANDBY] = "standby",
+    [SLOT_ACTIVE] = "active",
+};
+
+static char _stack[THREAD_STACKSIZE_DEFAULT + THREAD_EXTRA_STACKSIZE_PRINTF];
+static char _connector_stack[THREAD_STACKSIZE_DEFAULT];
+static _record_t _ring[STREAM_RECORDS];
+static _record_t _tx;               /* copy of the record being sent */
+/* sequence numbers: oldest unacknowledged, next to send, next to queue */
+static uint32_t _first, _send, _next;
+static mutex_t _lock = MUTEX_INIT;
+static thread_t *_thread, *_connector, *_waiter;
+static _slot_t _slots[SLOTS];
+static unsigned _slots_numof;
+static _slot_t *_active;
+static volatile bool _link_up;
+static uint32_t _lost_at;           /* when the last active connection died */
+static uint32_t _progress_at;       /* last ack progress or first record out */
+static bool _gap_pending;
+static uint32_t _gap_from;
+static network_uint32_t _ack;
+static unsigned _ack_fill;
+static stream_stats_t _stats;
+
+NETIF_DECLARE_EXT_CALLBACK(_netif_cb)
+
+/* called by lwIP with the core locked */
+static void _netif_changed(struct netif *netif, netif_nsc_reason_t reason,
+                           const netif_ext_callback_args_t *args)
+{
+    if ((netif == netdev_hook_netif()) && (reason & LWIP_NSC_LINK_CHANGED)) {
+        _link_up = args->link_changed.state;
+        thread_flags_set(_thread, FLAG_LINK);
+        thread_flags_set(_connector, FLAG_LINK);
+    }
+}
+
+static thread_flags_t _wait(thread_flags_t mask, uint32_t timeout)
+{
+    xtimer_t timer;
+    thread_flags_t flags;
+
+    xtimer_set_timeout_flag(&timer, timeout);
+    flags = thread_flags_wait_any(mask | THREAD_FLAG_TIMEOUT);
+    xtimer_remove(&timer);
+    thread_flags_clear(THREAD_FLAG_TIMEOUT);
+    return flags;
+}
+
+static void _wake_writer(void)
+{
+    if (_waiter) {
+        thread_flags_set(_waiter, FLAG_SPACE);
+        _waiter = NULL;
+    }
+}
+
+static void _acked(uint32_t seq)
+{
+    mutex_lock(&_lock);
+    /* ignore anything outside of what was sent */
+    if ((seq != _first) && ((seq - _first) <= (_send - _first))) {
+        uint32_t now = xtimer_now_usec();
+
+        _stats.acked += seq - _first;
+        _first = seq;
+        _progress_at = now;
+        if (_gap_pending) {
+            _gap_pending = false;
+            _stats.last_gap_us = now - _gap_from;
+            if (_stats.last_gap_us > _stats.max_gap_us) {
+                _stats.max_gap_us = _stats.last_gap_us;
+            }
+        }
+        _wake_writer();
+    }
+    mutex_unlock(&_lock);
+}
+
+static int _read_acks(uint32_t timeout)
+{
+    uint8_t buf[16];
+    ssize_t res = sock_tcp_read(&_active->sock, buf, sizeof(buf), timeout);
+
+    if (res == 0) {
+        return -ECONNRESET;
+    }
+    if (res < 0) {
+        return ((res == -EAGAIN) || (res == -ETIMEDOUT)) ? 0 : res;
+    }
+    for (ssize_t i = 0; i < res; i++) {
+        _ack.u8[_ack_fill++] = buf[i];
+        if (_ack_fill == sizeof(_ack)) {
+            _ack_fill = 0;
+            _acked(byteorder_ntohl(_ack));
+        }
+    }
+    return 0;
+}
+
+/* sock_tcp_write() blocks on a full send buffer, possibly for as long as it
+ * takes TCP to give up, and would keep us from seeing a link loss */
+static bool _can_send(size_t size)
+{
+    struct netconn *conn = _active->sock.base.conn;
+    bool res;
+
+    LOCK_TCPIP_CORE();
+    res = conn && conn->pcb.tcp && (tcp_sndbuf(conn->pcb.tcp) >= size);
+    UNLOCK_TCPIP_CORE();
+    return res;
+}
+
+static bool _zero_window(void)
+{
+    struct netconn *conn = _active->sock.base.conn;
+    bool res;
+
+    LOCK_TCPIP_CORE();
+    res = conn && conn->pcb.tcp && (conn->pcb.tcp->snd_wnd == 0);
+    UNLOCK_TCPIP_CORE();
+    return res;
+}
+
+/* a reset or a failed keepalive detaches the pcb, a FIN moves it on */
+static bool _alive(_slot_t *slot)
+{
+    struct netconn *conn = slot->sock.base.conn;
+    bool res;
+
+    LOCK_TCPIP_CORE();
+    res = conn && conn->pcb.tcp && (conn->pcb.tcp->state == ESTABLISHED);
+    UNLOCK_TCPIP_CORE();
+    return res;
+}
+
+static void _keepalive(_slot_t *slot)
+{
+    struct netconn *conn = slot->sock.base.conn;
+
+    LOCK_TCPIP_CORE();
+    if (conn && conn->pcb.tcp) {
+        struct tcp_pcb *pcb = conn->pcb.tcp;
+
+        ip_set_option(pcb, SOF_KEEPALIVE);
+        pcb->keep_idle = STREAM_KEEPALIVE_MS;
+        pcb->keep_intvl = STREAM_KEEPALIVE_MS;
+        pcb->keep_cnt = STREAM_KEEPALIVE_CNT;
+    }
+    UNLOCK_TCPIP_CORE();
+}
+
+/* called by the stream thread for STANDBY and ACTIVE slots */
+static void _slot_close(_slot_t *slot)
+{
+    sock_tcp_disconnect(&slot->sock);
+    mutex_lock(&_lock);
+    if (slot == _active) {
+        _active = NULL;
+        _lost_at = xtimer_now_usec();
+        /* a blocked writer overwrites old records from now on */
+        _wake_writer();
+    }
+    slot->state = SLOT_IDLE;
+    slot->next_try = xtimer_now_usec();
+    mutex_unlock(&_lock);
+    thread_flags_set(_connector, FLAG_CONNECT);
+}
+
+static void _slot_connect(_slot_t *slot)
+{
+    int res;
+
+    mutex_lock(&_lock);
+    slot->state = SLOT_CONNECTING;
+    mutex_unlock(&_lock);
+    res = sock_tcp_connect(&slot->sock, &slot->remote, 0, 0);
+    if ((res == 0) && _link_up) {
+        _keepalive(slot);
+        qos_tcp_set_tos(&slot->sock, QOS_TOS(STREAM_DSCP));
+        mutex_lock(&_lock);
+        slot->state = SLOT_STANDBY;
+        slot->backoff = STREAM_BACKOFF_MIN_US;
+        mutex_unlock(&_lock);
+        thread_flags_set(_thread, FLAG_STANDBY);
+        return;
+    }
+    _stats.failures++;
+    sock_tcp_disconnect(&slot->sock);
+    mutex_lock(&_lock);
+    slot->next_try = xtimer_now_usec() +
+                     random_uint32_range(slot->backoff / 2, slot->backoff + 1);
+    slot->backoff = MIN(2 * slot->backoff, STREAM_BACKOFF_MAX_US);
+    slot->state = SLOT_IDLE;
+    mutex_unlock(&_lock);
+}
+
+static void *_connector_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        uint32_t wait = STREAM_BACKOFF_MAX_US;
+
+        for (unsigned i = 0; _link_up && (i < _slots_numof); i++) {
+            _slot_t *slot = &_slots[i];
+            int32_t due = slot->next_try - xtimer_now_usec();
+
+            if (slot->state != SLOT_IDLE) {
+                continue;
+            }
+            if (due <= 0) {
+                _slot_connect(slot);
+                due = slot->next_try - xtimer_now_usec();
+            }
+            if (slot->state == SLOT_IDLE) {
+                wait = MIN(wait, (uint32_t)MAX(due, 0));
+            }
+        }
+        if (wait == 0) {
+            continue;
+        }
+        if ((_wait(FLAG_CONNECT | FLAG_LINK, wait) & FLAG_LINK) && _link_up) {
+            /* a link that just came up deserves an immediate retry */
+            for (unsigned i = 0; i < _slots_numof; i++) {
+                _slots[i].backoff = STREAM_BACKOFF_MIN_US;
+                _slots[i].next_try = xtimer_now_usec();
+            }
+        }
+    }
+    return NULL;
+}
+
+static int _promote(_slot_t *slot)
+{
+    stream_hdr_t hello;
+    uint32_t now = xtimer_now_usec();
+
+    boottime_mark(BOOTTIME_TCP_CONNECT);
+    if (_stats.connects++) {
+        _stats.last_latency_us = now - _lost_at;
+        if (_stats.last_latency_us > _stats.max_latency_us) {
+            _stats.max_latency_us = _stats.last_latency_us;
+        }
+    }
+    mutex_lock(&_lock);
+    /* everything unacknowledged is sent again */
+    for (uint32_t seq = _first; seq != _send; seq++) {
+        _stats.replayed_records++;
+        _stats.replayed_bytes += byteorder_ntohs(_ring[seq % STREAM_RECORDS].hdr.len);
+    }
+    _send = _first;
+    _progress_at = now;
+    _active = slot;
+    slot->state = SLOT_ACTIVE;
+    hello.type = byteorder_htons(STREAM_TYPE_HELLO);
+    hello.len = byteorder_htons(0);
+    hello.seq = byteorder_htonl(_first);
+    mutex_unlock(&_lock);
+    _ack_fill = 0;
+    return sock_tcp_write(&slot->sock, &hello, sizeof(hello));
+}
+
+/* stalls only count as failure if there is somewhere to go */
+static bool _stalled(bool standby)
+{
+    uint32_t idle = xtimer_now_usec() - _progress_at;
+
+    if (!standby || (_send == _first)) {
+        return false;
+    }
+    return (idle > STREAM_ACK_TIMEOUT_US) ||
+           ((idle > STREAM_STALL_US) && _zero_window());
+}
+
+static int _step(bool standby)
+{
+    size_t size = 0;
+    int res;
+
+    mutex_lock(&_lock);
+    if (_send != _next) {
+        _record_t *rec = &_ring[_send % STREAM_RECORDS];
+
+        size = sizeof(rec->hdr) + byteorder_ntohs(rec->hdr.len);
+        memcpy(&_tx, rec, size);
+    }
+    mutex_unlock(&_lock);
+    if (size && _can_send(size)) {
+        if ((res = sock_tcp_write(&_active->sock, &_tx, size)) < 0) {
+            return res;
+        }
+        mutex_lock(&_lock);
+        if (_send == _first) {
+            /* nothing was outstanding, the ack clock starts now */
+            _progress_at = xtimer_now_usec();
+        }
+        _send++;
+        mutex_unlock(&_lock);
+        res = _read_acks(0);
+    }
+    else {
+        res = _read_acks(STREAM_ACK_POLL_US);
+    }
+    if (res < 0) {
+        return res;
+    }
+    return _stalled(standby) ? -ETIMEDOUT : 0;
+}
+
+static void *_stream_thread(void *arg)
+{
+    (void)arg;
+    _lost_at = xtimer_now_usec();
+    while (1) {
+        _slot_t *standby = NULL;
+
+        thread_flags_clear(FLAG_DATA | FLAG_LINK | FLAG_STANDBY);
+        if (!_link_up) {
+            for (unsigned i = 0; i < _slots_numof; i++) {
+                if (_slots[i].state >= SLOT_STANDBY) {
+                    _slot_close(&_slots[i]);
+                }
+            }
+            thread_flags_wait_any(FLAG_LINK);
+            continue;
+        }
+        for (unsigned i = 0; i < _slots_numof; i++) {
+            if (_slots[i].state != SLOT_STANDBY) {
+                continue;
+            }
+            if (!_alive(&_slots[i])) {
+                _slot_close(&_slots[i]);
+            }
+            else if (standby == NULL) {
+                standby = &_slots[i];
+            }
+        }
+        if (_active == NULL) {
+            if (standby == NULL) {
+                thread_flags_wait_any(FLAG_STANDBY | FLAG_LINK);
+            }
+            else if (_promote(standby) < 0) {
+                _slot_close(standby);
+            }
+            continue;
+        }
+        if (_step(standby != NULL) < 0) {
+            if (standby) {
+                _stats.failovers++;
+            }
+            mutex_lock(&_lock);
+            if (!_gap_pending) {
+                _gap_pending = true;
+                _gap_from = _progress_at;
+            }
+            mutex_unlock(&_lock);
+            _slot_close(_active);
+        }
+    }
+    return NULL;
+}
+
+int stream_start(const sock_tcp_ep_t *remote, const sock_tcp_ep_t *standby)
+{
+    struct netif *netif = netdev_hook_netif();
+    kernel_pid_t pid, connector;
+
+    if (_thread) {
+        return -EALREADY;
+    }
+    _slots[0].remote = *remote;
+    _slots_numof = 1;
+    if (standby) {
+        _slots[1].remote = *standby;
+        _slots_numof = 2;
+    }
+    for (unsigned i = 0; i < _slots_numof; i++) {
+        _slots[i].backoff = STREAM_BACKOFF_MIN_US;
+        _slots[i].next_try = xtimer_now_usec();
+    }
+    pid = thread_create(_stack, sizeof(_stack), PRIO_STREAM,
+                        THREAD_CREATE_STACKTEST | THREAD_CREATE_SLEEPING,
+                        _stream_thread, NULL, "stream");
+    connector = thread_create(_connector_stack, sizeof(_connector_stack),
+                              PRIO_STREAM,
+                              THREAD_CREATE_STACKTEST | THREAD_CREATE_SLEEPING,
+                              _connector_thread, NULL, "connector");
+    _thread = thread_get(pid);
+    _connector = thread_get(connector);
+    LOCK_TCPIP_CORE();
+    _link_up = (netif == NULL) || netif_is_link_up(netif);
+    netif_add_ext_callback(&_netif_cb, _netif_changed);
+    UNLOCK_TCPIP_CORE();
+    thread_wakeup(pid);
+    thread_wakeup(connector);
+    return 0;
+}
+
+int stream_write(const void *data, size_t len)
+{
+    _record_t *rec;
+
+    if (len > STREAM_RECORD_MAX) {
+        return -EMSGSIZE;
+    }
+    if (_thread == NULL) {
+        return -ENOTCONN;
+    }
+    mutex_lock(&_lock);
+    while ((_next - _first) >= STREAM_RECORDS) {
+        if (_active == NULL) {
+            /* nobody can acknowledge now, sacrifice the oldest record */
+            _stats.lost_records++;
+            _stats.lost_bytes += byteorder_ntohs(_ring[_first % STREAM_RECORDS].hdr.len);
+            _first++;
+            if ((int32_t)(_send - _first) < 0) {
+                _send = _first;
+            }
+            break;
+        }
+        _waiter = thread_get_active();
+        mutex_unlock(&_lock);
+        thread_flags_wait_any(FLAG_SPACE);
+        mutex_lock(&_lock);
+    }
+    rec = &_ring[_next % STREAM_RECORDS];
+    rec->hdr.type = byteorder_htons(STREAM_TYPE_DATA);
+    rec->hdr.len = byteorder_htons(len);
+    rec->hdr.seq = byteorder_htonl(_next);
+    memcpy(rec->data, data, len);
+    _next++;
+    _stats.records++;
+    mutex_unlock(&_lock);
+    thread_flags_set(_thread, FLAG_DATA);
+    return len;
+}
+
+bool stream_connected(void)
+{
+    return _active != NULL;
+}
+
+const stream_stats_t *stream_stats(void)
+{
+    return &_stats;
+}
+
+static int stream_print(void)
+{
+    if (_thread == NULL) {
+        puts("stream: not started");
+        return 0;
+    }
+    printf("stream: link %s\n", _link_up ? "up" : "down");
+    for (unsigned i = 0; i < _slots_numof; i++) {
+        char addr_str[IPV4_ADDR_MAX_STR_LEN];
+
+        printf("collector %u: %s:%u %s\n", i,
+               ipv4_addr_to_str(addr_str, (ipv4_addr_t *)&_slots[i].remote.addr.ipv4,
+                                sizeof(addr_str)),
+               _slots[i].remote.port, _state_names[_slots[i].state]);
+    }
+    printf("records: %" PRIu32 " queued, %" PRIu32 " acked, %" PRIu32
+           " unacked\n", _stats.records, _stats.acked, _next - _first);
+    printf("connects: %" PRIu32 ", failed: %" PRIu32 ", failovers: %" PRIu32
+           "\n", _stats.connects, _stats.failures, _stats.failovers);
+    printf("resume latency: last %" PRIu32 " us, max %" PRIu32 " us; "
+           "ack gap: last %" PRIu32 " us, max %" PRIu32 " us\n",
+           _stats.last_latency_us, _stats.max_latency_us,
+           _stats.last_gap_us, _stats.max_gap_us);
+    printf("replayed: %" PRIu32 " records (%" PRIu32 " byte), lost: %" PRIu32
+           " records (%" PRIu32 " byte)\n", _stats.replayed_records,
+           (uint32_t)_stats.replayed_bytes, _stats.lost_records,
+           (uint32_t)_stats.lost_bytes);
+    return 0;
+}
+
+static int _parse_ep(sock_tcp_ep_t *ep, const char *addr_str,
+                     const char *port_str)
+{
+    *ep = (sock_tcp_ep_t)SOCK_IPV4_EP_ANY;
+    if (ipv4_addr_from_str((ipv4_addr_t *)&ep->addr.ipv4, addr_str) == NULL) {
+        puts("Error: unable to parse destination address");
+        return 1;
+    }
+    ep->port = atoi(port_str);
+    return 0;
+}
+
+int stream_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        return stream_print();
+    }
+    else if (strcmp(argv[1], "start") == 0) {
+        sock_tcp_ep_t remote, standby;
+        int res;
+
+        if ((argc != 4) && (argc != 6)) {
+            printf("usage: %s start <addr> <port> [<standby addr> <standby port>]\n",
+                   argv[0]);
+            return 1;
+        }
+        if (_parse_ep(&remote, argv[2], argv[3]) ||
+            ((argc == 6) && _parse_ep(&standby, argv[4], argv[5]))) {
+            return 1;
+        }
+        if ((res = stream_start(&remote, (argc == 6) ? &standby : NULL)) < 0) {
+            printf("Error: unable to start stream (error code %d)\n", -res);
+            return 1;
+        }
+        return 0;
+    }
+    else if (strcmp(argv[1], "reset") == 0) {
+        uint32_t connects = _stats.connects;
+
+        memset(&_stats, 0, sizeof(_stats));
+        /* keep the first connect from counting as reconnect */
+        _stats.connects = connects;
+        return 0;
+    }
+    else {
+        printf("usage: %s [start|reset]\n", argv[0]);
+        return 1;
+    }
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
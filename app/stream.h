@@ -0,0 +1,183 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       Resilient record stream to a collector over TCP
+ *
+ * The application queues records with @ref stream_write. A stream thread
+ * sends them and keeps them until the collector acknowledges them, so after
+ * a lost connection the stream resumes at the first unacknowledged record.
+ *
+ * Wire format (all fields in network byte order): the device sends a
+ * @ref stream_hdr_t followed by `len` payload bytes for every record. Each
+ * connection starts with a record of type @ref STREAM_TYPE_HELLO without
+ * payload, carrying the sequence number of the first record that follows.
+ * The collector answers with 4 byte cumulative acknowledgements holding the
+ * next sequence number it expects; it drops duplicates, so replayed records
+ * are delivered once.
+ *
+ * Reconnection is driven by the netif link state: a link loss aborts the
+ * connection at once, a link-up reconnects immediately. Other failures are
+ * retried with jittered exponential backoff.
+ *
+ * With a second collector configured, a connector thread keeps a warm
+ * standby connection to it (established, keepalive on, no data). When the
+ * active connection fails, or stalls with records outstanding (zero window
+ * for @ref STREAM_STALL_US or no acknowledgement for
+ * @ref STREAM_ACK_TIMEOUT_US), the stream switches to the standby without a
+ * connection setup and replays what was not acknowledged. The failed
+ * collector is reconnected and becomes the new standby. Both collectors are
+ * expected to share their sequence state (see tools/collector.py).
+ * @}
+ */
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "byteorder.h"
+#include "net/sock/tcp.h"
+#include "qos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef STREAM_RECORDS
+#define STREAM_RECORDS          (32U)       /**< records kept for replay */
+#endif
+#ifndef STREAM_RECORD_MAX
+#define STREAM_RECORD_MAX       (256U)      /**< maximum record payload */
+#endif
+#ifndef STREAM_BACKOFF_MIN_US
+#define STREAM_BACKOFF_MIN_US   (100000UL)  /**< first reconnect delay */
+#endif
+#ifndef STREAM_BACKOFF_MAX_US
+#define STREAM_BACKOFF_MAX_US   (10000000UL) /**< reconnect delay limit */
+#endif
+#ifndef STREAM_ACK_POLL_US
+#define STREAM_ACK_POLL_US      (10000UL)   /**< ack poll interval when idle */
+#endif
+#ifndef STREAM_STALL_US
+#define STREAM_STALL_US         (50000UL)   /**< zero window before failover */
+#endif
+#ifndef STREAM_ACK_TIMEOUT_US
+#define STREAM_ACK_TIMEOUT_US   (500000UL)  /**< no ack before failover */
+#endif
+#ifndef STREAM_KEEPALIVE_MS
+#define STREAM_KEEPALIVE_MS     (1000U)     /**< standby keepalive interval */
+#endif
+#ifndef STREAM_KEEPALIVE_CNT
+#define STREAM_KEEPALIVE_CNT    (3U)        /**< missed keepalives to give up */
+#endif
+#ifndef STREAM_DSCP
+#define STREAM_DSCP             (QOS_DSCP_CS1) /**< marking of the stream */
+#endif
+/** @} */
+
+/**
+ * @brief   Record types
+ * @{
+ */
+#define STREAM_TYPE_DATA        (0x0001U)   /**< application record */
+#define STREAM_TYPE_HELLO       (0x0002U)   /**< start of a connection */
+/** @} */
+
+/**
+ * @brief   Record header
+ */
+typedef struct __attribute__((packed)) {
+    network_uint16_t type;      /**< STREAM_TYPE_* */
+    network_uint16_t len;       /**< payload length */
+    network_uint32_t seq;       /**< record sequence number */
+} stream_hdr_t;
+
+/**
+ * @brief   Stream statistics
+ */
+typedef struct {
+    uint32_t connects;          /**< connections established */
+    uint32_t failures;          /**< failed connection attempts */
+    uint32_t failovers;         /**< switches to the standby connection */
+    uint32_t last_latency_us;   /**< last loss-to-resume time */
+    uint32_t max_latency_us;    /**< longest loss-to-resume time */
+    uint32_t last_gap_us;       /**< last ack-to-ack gap across a loss */
+    uint32_t max_gap_us;        /**< longest ack-to-ack gap across a loss */
+    uint32_t records;           /**< records queued */
+    uint32_t acked;             /**< records acknowledged */
+    uint32_t lost_records;      /**< records overwritten before their ack */
+    uint64_t lost_bytes;        /**< payload bytes of the lost records */
+    uint32_t replayed_records;  /**< records sent again after a reconnect */
+    uint64_t replayed_bytes;    /**< payload bytes sent again */
+} stream_stats_t;
+
+/**
+ * @brief   Start the stream and connector threads
+ *
+ * @param[in] remote    collector endpoint
+ * @param[in] standby   second collector for hot standby, may be NULL
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the stream was already started
+ */
+int stream_start(const sock_tcp_ep_t *remote, const sock_tcp_ep_t *standby);
+
+/**
+ * @brief   Queue a record
+ *
+ * While connected this blocks until the collector acknowledged enough
+ * records to make room. While disconnected the oldest unacknowledged record
+ * is overwritten instead and counted as lost.
+ *
+ * @param[in] data      record payload
+ * @param[in] len       payload length
+ *
+ * @return  @p len on success
+ * @return  -EMSGSIZE if @p len exceeds @ref STREAM_RECORD_MAX
+ * @return  -ENOTCONN if the stream was not started
+ */
+int stream_write(const void *data, size_t len);
+
+/**
+ * @brief   Check whether records currently go to a collector
+ *
+ * Producers that can hold back their data, rather than have it overwritten
+ * while disconnected, wait for this before @ref stream_write.
+ */
+bool stream_connected(void);
+
+/**
+ * @brief   Get the stream statistics
+ */
+const stream_stats_t *stream_stats(void);
+
+/**
+ * @brief   Stream shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int stream_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_H */
+/** @} */
@@ -21,10 +21,13 @@
 #include <stdio.h>
 
 #include "common.h"
+#include "evq.h"
+#include "metrics.h"
 #include "od.h"
 #include "net/af.h"
 #include "net/sock/async/event.h"
 #include "net/sock/tcp.h"
+#include "prio.h"
 #include "shell.h"
 #include "test_utils/expect.h"
 #include "thread.h"
@@ -46,7 +49,11 @@ static sock_tcp_queue_t server_queue;
 static char server_stack[THREAD_STACKSIZE_DEFAULT];
 static msg_t server_msg_queue[SERVER_MSG_QUEUE_SIZE];
 static char _addr_str[IPV6_ADDR_MAX_STR_LEN];
-static event_queue_t _ev_queue;
+static evq_t _evq;
+static metrics_metric_t accepted = METRICS_COUNTER(
+    "tcp_server_connections_total", "Connections accepted by the TCP server");
+static metrics_metric_t rx_bytes = METRICS_COUNTER(
+    "tcp_server_rx_bytes_total", "Bytes received by the TCP server");
 
 static void _tcp_recv(sock_tcp_t *sock, sock_async_flags_t flags, void *arg)
 {
@@ -74,6 +81,7 @@ static void _tcp_recv(sock_tcp_t *sock, sock_async_flags_t flags, void *arg)
             printf("Received TCP data from client [%s]:%u:\n", _addr_str,
                    client.port);
             if (res > 0) {
+                metrics_add(&rx_bytes, res);
                 od_hex_dump(sock_inbuf, res, 0);
             }
             else {
@@ -101,7 +109,8 @@ static void _tcp_accept(sock_tcp_queue_t *queue, sock_async_flags_t flags,
         else {
             sock_tcp_ep_t client;
 
-            sock_tcp_event_init(sock, &_ev_queue, _tcp_recv, "test");
+            metrics_inc(&accepted);
+            evq_tcp_event_init(&_evq, sock, _tcp_recv, "test", "recv");
             sock_tcp_get_remote(sock, &client);
 #ifdef MODULE_LWIP_IPV6
             ipv6_addr_to_str(_addr_str, (ipv6_addr_t *)&client.addr.ipv6,
@@ -130,11 +139,14 @@ static void *_server_thread(void *args)
         return NULL;
     }
     server_running = true;
+    metrics_register(&accepted);
+    metrics_register(&rx_bytes);
     printf("Success: started TCP server on port %" PRIu16 "\n",
            server_addr.port);
-    event_queue_init(&_ev_queue);
-    sock_tcp_queue_event_init(&server_queue, &_ev_queue, _tcp_accept, "test");
-    event_loop(&_ev_queue);
+    evq_init(&_evq, "tcp_server");
+    evq_tcp_queue_event_init(&_evq, &server_queue, _tcp_accept, "test",
+                             "accept");
+    evq_loop(&_evq);
     return NULL;
 }
 
@@ -196,7 +208,7 @@ static int tcp_send(char *data, unsigned int num, unsigned int delay)
 
 static int tcp_start_server(char *port_str)
 {
-    if (thread_create(server_stack, sizeof(server_stack), THREAD_PRIORITY_MAIN - 1,
+    if (thread_create(server_stack, sizeof(server_stack), PRIO_TCP,
                       THREAD_CREATE_STACKTEST, _server_thread, port_str,
                       "TCP server") <= KERNEL_PID_UNDEF) {
         return 1;
@@ -0,0 +1,403 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       TLS and DTLS benchmark servers on wolfSSL
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tls.h"
+
+#if defined(MODULE_WOLFSSL) && defined(MODULE_SOCK_TCP) && \
+    defined(MODULE_SOCK_UDP)
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/ssl.h>
+
+#include "hashes/sha256.h"
+#include "net/sock/tcp.h"
+#include "net/sock/udp.h"
+#include "prio.h"
+#include "random.h"
+#include "thread.h"
+#include "xtimer.h"
+
+#ifdef MODULE_LWIP_IPV6
+#define SOCK_IP_EP_ANY  SOCK_IPV6_EP_ANY
+#else
+#define SOCK_IP_EP_ANY  SOCK_IPV4_EP_ANY
+#endif
+
+#define REQUEST_SIZE        (16U)
+
+typedef struct {
+    tls_proto_t proto;
+    bool running;
+    bool has_peer;              /* DTLS: a client is being served */
+    WOLFSSL_CTX *ctx;
+    sock_tcp_queue_t queue;
+    sock_tcp_t tcp;
+    sock_tcp_t *conn;
+    sock_udp_t udp;
+    sock_udp_ep_t peer;
+    uint32_t hs_start;          /* arrival of the first client flight */
+    tls_stats_t stats;
+} _server_t;
+
+static const char *_names[] = { "tls", "dtls" };
+static const uint8_t _psk[] = TLS_PSK_KEY;
+static _server_t _servers[TLS_PROTO_NUMOF];
+static uint8_t _pools[TLS_PROTO_NUMOF][TLS_POOL_SIZE];
+static char _stacks[TLS_PROTO_NUMOF][TLS_STACKSIZE];
+static uint8_t _cookie_secret[16];
+static char _data[TLS_RECORD_SIZE];
+static bool _initialized;
+
+static bool _ep_equal(const sock_udp_ep_t *a, const sock_udp_ep_t *b)
+{
+    return (a->family == b->family) && (a->port == b->port) &&
+           (memcmp(&a->addr, &b->addr, (a->family == AF_INET6)
+                   ? sizeof(a->addr.ipv6) : sizeof(a->addr.ipv4)) == 0);
+}
+
+static int _tcp_recv(WOLFSSL *ssl, char *buf, int sz, void *arg)
+{
+    _server_t *s = arg;
+    ssize_t res = sock_tcp_read(s->conn, buf, sz, TLS_TIMEOUT_US);
+
+    (void)ssl;
+    if (res > 0) {
+        return res;
+    }
+    if (res == 0) {
+        return WOLFSSL_CBIO_ERR_CONN_CLOSE;
+    }
+    return (res == -ETIMEDOUT) ? WOLFSSL_CBIO_ERR_TIMEOUT
+                               : WOLFSSL_CBIO_ERR_GENERAL;
+}
+
+static int _tcp_send(WOLFSSL *ssl, char *buf, int sz, void *arg)
+{
+    _server_t *s = arg;
+    ssize_t res = sock_tcp_write(s->conn, buf, sz);
+
+    (void)ssl;
+    return (res < 0) ? WOLFSSL_CBIO_ERR_GENERAL : res;
+}
+
+static int _udp_recv(WOLFSSL *ssl, char *buf, int sz, void *arg)
+{
+    _server_t *s = arg;
+
+    while (1) {
+        sock_udp_ep_t remote;
+        uint32_t timeout = SOCK_NO_TIMEOUT;
+        ssize_t res;
+
+        /* during the handshake wolfSSL retransmits its last flight when
+         * the receive times out */
+        if (s->has_peer) {
+            timeout = wolfSSL_is_init_finished(ssl)
+                    ? TLS_TIMEOUT_US
+                    : wolfSSL_dtls_get_current_timeout(ssl) * US_PER_SEC;
+        }
+        res = sock_udp_recv(&s->udp, buf, sz, timeout, &remote);
+        if (res == -ETIMEDOUT) {
+            return WOLFSSL_CBIO_ERR_TIMEOUT;
+        }
+        if (res < 0) {
+            return WOLFSSL_CBIO_ERR_GENERAL;
+        }
+        if (!s->has_peer) {
+            s->peer = remote;
+            s->has_peer = true;
+            s->hs_start = xtimer_now_usec();
+        }
+        /* one client at a time, others have to retransmit later */
+        else if (!_ep_equal(&remote, &s->peer)) {
+            continue;
+        }
+        return res;
+    }
+}
+
+static int _udp_send(WOLFSSL *ssl, char *buf, int sz, void *arg)
+{
+    _server_t *s = arg;
+    ssize_t res = sock_udp_send(&s->udp, buf, sz, &s->peer);
+
+    (void)ssl;
+    return (res < 0) ? WOLFSSL_CBIO_ERR_GENERAL : res;
+}
+
+/* the default cookie needs getpeername(), derive it from the sock_udp
+ * endpoint instead */
+static int _cookie(WOLFSSL *ssl, unsigned char *buf, int sz, void *arg)
+{
+    _server_t *s = arg;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    sha256_context_t sha;
+
+    (void)ssl;
+    sha256_init(&sha);
+    sha256_update(&sha, _cookie_secret, sizeof(_cookie_secret));
+    sha256_update(&sha, &s->peer.addr, sizeof(s->peer.addr));
+    sha256_update(&sha, &s->peer.port, sizeof(s->peer.port));
+    sha256_final(&sha, digest);
+    sz = MIN(sz, (int)sizeof(digest));
+    memcpy(buf, digest, sz);
+    return sz;
+}
+
+static unsigned _psk_cb(WOLFSSL *ssl, const char *identity,
+                        unsigned char *key, unsigned max_len)
+{
+    (void)ssl;
+    if ((strcmp(identity, TLS_PSK_IDENTITY) != 0) || (sizeof(_psk) > max_len)) {
+        return 0;
+    }
+    memcpy(key, _psk, sizeof(_psk));
+    return sizeof(_psk);
+}
+
+static void _record(tls_stats_t *stats, bool resumed, uint32_t us)
+{
+    if (resumed) {
+        stats->resumed++;
+        stats->resumed_us = us;
+        stats->resumed_max_us = MAX(stats->resumed_max_us, us);
+        stats->resumed_total_us += us;
+    }
+    else {
+        stats->full++;
+        stats->full_us = us;
+        stats->full_max_us = MAX(stats->full_max_us, us);
+        stats->full_total_us += us;
+    }
+}
+
+static void _serve(_server_t *s, WOLFSSL *ssl)
+{
+    char req[REQUEST_SIZE];
+    uint64_t start;
+    size_t left;
+    int len = 0;
+
+    if (wolfSSL_accept(ssl) != WOLFSSL_SUCCESS) {
+        s->stats.failures++;
+        return;
+    }
+    _record(&s->stats, wolfSSL_session_reused(ssl),
+            xtimer_now_usec() - s->hs_start);
+
+    /* decimal KiB and newline */
+    while (len < (int)(sizeof(req) - 1)) {
+        int res = wolfSSL_read(ssl, req + len, sizeof(req) - 1 - len);
+
+        if (res <= 0) {
+            return;
+        }
+        len += res;
+        if (memchr(req, '\n', len)) {
+            break;
+        }
+    }
+    req[len] = '\0';
+    left = MIN(strtoul(req, NULL, 10), TLS_DATA_MAX_KIB) * 1024;
+
+    start = xtimer_now_usec64();
+    while (left) {
+        size_t n = MIN(left, sizeof(_data));
+
+        if (wolfSSL_write(ssl, _data, n) != (int)n) {
+            break;
+        }
+        left -= n;
+        s->stats.bytes += n;
+    }
+    s->stats.bulk_us += xtimer_now_usec64() - start;
+    wolfSSL_shutdown(ssl);
+}
+
+static void *_server_thread(void *arg)
+{
+    _server_t *s = arg;
+
+    while (1) {
+        WOLFSSL *ssl = wolfSSL_new(s->ctx);
+
+        if (ssl == NULL) {
+            s->stats.failures++;
+            xtimer_sleep(1);
+            continue;
+        }
+        wolfSSL_SetIOReadCtx(ssl, s);
+        wolfSSL_SetIOWriteCtx(ssl, s);
+        if (s->proto == TLS_PROTO_DTLS) {
+            wolfSSL_SetCookieCtx(ssl, s);
+            s->has_peer = false;
+            _serve(s, ssl);
+        }
+        else if (sock_tcp_accept(&s->queue, &s->conn, SOCK_NO_TIMEOUT) == 0) {
+            s->hs_start = xtimer_now_usec();
+            _serve(s, ssl);
+            sock_tcp_disconnect(s->conn);
+        }
+        wolfSSL_free(ssl);
+    }
+    return NULL;
+}
+
+static int _setup(_server_t *s, uint8_t *pool)
+{
+    wolfSSL_method_func method = (s->proto == TLS_PROTO_DTLS)
+                               ? wolfDTLSv1_2_server_method_ex
+                               : wolfTLSv1_2_server_method_ex;
+
+    /* one session at a time, everything from the pool */
+    if (wolfSSL_CTX_load_static_memory(&s->ctx, method, pool, TLS_POOL_SIZE,
+                                       0, 1) != WOLFSSL_SUCCESS) {
+        return -EINVAL;
+    }
+    if (wolfSSL_CTX_set_cipher_list(s->ctx, TLS_CIPHERS) != WOLFSSL_SUCCESS) {
+        wolfSSL_CTX_free(s->ctx);
+        return -EINVAL;
+    }
+    wolfSSL_CTX_set_psk_server_callback(s->ctx, _psk_cb);
+    if (s->proto == TLS_PROTO_DTLS) {
+        wolfSSL_CTX_SetIORecv(s->ctx, _udp_recv);
+        wolfSSL_CTX_SetIOSend(s->ctx, _udp_send);
+        wolfSSL_CTX_SetGenCookie(s->ctx, _cookie);
+    }
+    else {
+        wolfSSL_CTX_SetIORecv(s->ctx, _tcp_recv);
+        wolfSSL_CTX_SetIOSend(s->ctx, _tcp_send);
+    }
+    return 0;
+}
+
+int tls_start(tls_proto_t proto, uint16_t port)
+{
+    _server_t *s = &_servers[proto];
+    sock_udp_ep_t local = SOCK_IP_EP_ANY;
+    int res;
+
+    if (s->running) {
+        return -EALREADY;
+    }
+    if (!_initialized) {
+        wolfSSL_Init();
+        random_bytes(_cookie_secret, sizeof(_cookie_secret));
+        for (unsigned i = 0; i < sizeof(_data); i++) {
+            _data[i] = 'a' + (i % 26);
+        }
+        _initialized = true;
+    }
+    s->proto = proto;
+    if ((res = _setup(s, _pools[proto])) < 0) {
+        return res;
+    }
+    local.port = port;
+    res = (proto == TLS_PROTO_DTLS)
+        ? sock_udp_create(&s->udp, &local, NULL, 0)
+        : sock_tcp_listen(&s->queue, &local, &s->tcp, 1, 0);
+    if (res < 0) {
+        wolfSSL_CTX_free(s->ctx);
+        return res;
+    }
+    s->running = true;
+    if (thread_create(_stacks[proto], sizeof(_stacks[proto]),
+                      PRIO_TLS, THREAD_CREATE_STACKTEST,
+                      _server_thread, s, _names[proto]) <= KERNEL_PID_UNDEF) {
+        if (proto == TLS_PROTO_DTLS) {
+            sock_udp_close(&s->udp);
+        }
+        else {
+            sock_tcp_stop_listen(&s->queue);
+        }
+        wolfSSL_CTX_free(s->ctx);
+        s->ctx = NULL;
+        s->running = false;
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+const tls_stats_t *tls_stats(tls_proto_t proto)
+{
+    return &_servers[proto].stats;
+}
+
+static uint32_t _avg(uint64_t total, uint32_t count)
+{
+    return count ? (uint32_t)(total / count) : 0;
+}
+
+static void _print(tls_proto_t proto)
+{
+    const tls_stats_t *st = &_servers[proto].stats;
+    uint32_t kbit = st->bulk_us ? (uint32_t)(st->bytes * 8000 / st->bulk_us)
+                                : 0;
+
+    printf("%s: %s, %" PRIu32 " failed handshakes\n", _names[proto],
+           _servers[proto].running ? "running" : "stopped", st->failures);
+    printf("  full    %5" PRIu32 ", avg %8" PRIu32 " us, max %8" PRIu32
+           " us\n", st->full, _avg(st->full_total_us, st->full),
+           st->full_max_us);
+    printf("  resumed %5" PRIu32 ", avg %8" PRIu32 " us, max %8" PRIu32
+           " us\n", st->resumed, _avg(st->resumed_total_us, st->resumed),
+           st->resumed_max_us);
+    printf("  %" PRIu32 " KiB in %" PRIu32 " ms, %" PRIu32 " kbit/s\n",
+           (uint32_t)(st->bytes / 1024), (uint32_t)(st->bulk_us / US_PER_MS),
+           kbit);
+}
+
+int tls_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        for (unsigned i = 0; i < TLS_PROTO_NUMOF; i++) {
+            _print(i);
+        }
+        return 0;
+    }
+    else if ((strcmp(argv[1], "start") == 0) && (argc > 2)) {
+        for (unsigned i = 0; i < TLS_PROTO_NUMOF; i++) {
+            if (strcmp(argv[2], _names[i]) == 0) {
+                int res = tls_start(i, (argc > 3) ? strtoul(argv[3], NULL, 0)
+                                                  : TLS_PORT);
+
+                if (res < 0) {
+                    printf("error: unable to start %s server (error code "
+                           "%d)\n", _names[i], -res);
+                    return 1;
+                }
+                return 0;
+            }
+        }
+    }
+    else if (strcmp(argv[1], "reset") == 0) {
+        for (unsigned i = 0; i < TLS_PROTO_NUMOF; i++) {
+            memset(&_servers[i].stats, 0, sizeof(_servers[i].stats));
+        }
+        return 0;
+    }
+    printf("usage: %s [start tls|dtls [<port>]|reset]\n", argv[0]);
+    return 1;
+}
+#else
+typedef int dont_be_pedantic;
+#endif
+
+/** @} */
@@ -0,0 +1,150 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       TLS and DTLS benchmark servers on wolfSSL
+ *
+ * `tls start tls` serves TLS 1.2 on a sock_tcp listener, `tls start dtls`
+ * DTLS 1.2 on a sock_udp socket, one session at a time each. wolfSSL talks
+ * to the socks through its custom I/O callbacks, so neither needs the
+ * POSIX socket layer.
+ *
+ * Keys are pre-shared: the default suites are ECDHE-PSK, for forward
+ * secrecy at the cost of one ECDH exchange, and plain PSK with AES-CCM-8,
+ * the cheapest suite a Cortex-M4 can offer. A resumed session skips the
+ * key exchange, either through the server session cache or through a
+ * session ticket the client presents.
+ *
+ * All wolfSSL allocations, including the record buffers, come from a static
+ * pool of @ref TLS_POOL_SIZE per server, so a handshake can fail but never
+ * fragment or exhaust the heap. Records are written @ref TLS_RECORD_SIZE
+ * at a time; clients should negotiate a maximum fragment length so the
+ * receive buffer stays small, too.
+ *
+ * After the handshake the client sends a decimal number of KiB and a
+ * newline, the server answers with that much test data and closes the
+ * session. Handshake times are measured from the first client flight to
+ * the end of the handshake, separately for full and resumed handshakes;
+ * bulk throughput is measured over the writes of the data.
+ * tools/tls_bench.py drives the benchmark with the OpenSSL command line
+ * client.
+ *
+ * wolfSSL, the pools and the stacks cost about 52 KiB of RAM, so the
+ * servers and the `tls` command are only built with `make TLS=1`.
+ * @}
+ */
+#ifndef TLS_H
+#define TLS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef TLS_PORT
+#define TLS_PORT                (4433U)     /**< default listen port */
+#endif
+#ifndef TLS_POOL_SIZE
+#define TLS_POOL_SIZE           (20U * 1024U) /**< wolfSSL memory per server */
+#endif
+#ifndef TLS_RECORD_SIZE
+#define TLS_RECORD_SIZE         (1024U)     /**< plaintext bytes per record */
+#endif
+#ifndef TLS_STACKSIZE
+#define TLS_STACKSIZE           (6U * 1024U) /**< server thread stack */
+#endif
+#ifndef TLS_TIMEOUT_US
+#define TLS_TIMEOUT_US          (10000000UL) /**< idle session timeout */
+#endif
+#ifndef TLS_DATA_MAX_KIB
+#define TLS_DATA_MAX_KIB        (16384U)    /**< largest request */
+#endif
+#ifndef TLS_PSK_IDENTITY
+#define TLS_PSK_IDENTITY        "Client_identity" /**< OpenSSL's default */
+#endif
+#ifndef TLS_PSK_KEY
+/** pre-shared key, `-psk 0102030405060708090a0b0c0d0e0f10` for OpenSSL */
+#define TLS_PSK_KEY             { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, \
+                                  0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, \
+                                  0x0d, 0x0e, 0x0f, 0x10 }
+#endif
+#ifndef TLS_CIPHERS
+/** offered suites, the client picks one */
+#define TLS_CIPHERS             "ECDHE-PSK-AES128-CBC-SHA256:" \
+                                "PSK-AES128-CCM-8:PSK-AES128-CBC-SHA256"
+#endif
+/** @} */
+
+/**
+ * @brief   Transport of a server
+ */
+typedef enum {
+    TLS_PROTO_TLS,              /**< TLS over TCP */
+    TLS_PROTO_DTLS,             /**< DTLS over UDP */
+    TLS_PROTO_NUMOF,            /**< number of transports */
+} tls_proto_t;
+
+/**
+ * @brief   Server statistics
+ */
+typedef struct {
+    uint32_t full;              /**< full handshakes */
+    uint32_t resumed;           /**< resumed handshakes */
+    uint32_t failures;          /**< failed handshakes */
+    uint32_t full_us;           /**< last full handshake time */
+    uint32_t full_max_us;       /**< longest full handshake */
+    uint32_t resumed_us;        /**< last resumed handshake time */
+    uint32_t resumed_max_us;    /**< longest resumed handshake */
+    uint64_t full_total_us;     /**< sum of the full handshake times */
+    uint64_t resumed_total_us;  /**< sum of the resumed handshake times */
+    uint64_t bytes;             /**< test data bytes sent */
+    uint64_t bulk_us;           /**< time spent sending test data */
+} tls_stats_t;
+
+/**
+ * @brief   Start a server thread
+ *
+ * @param[in] proto     transport
+ * @param[in] port      port to listen on
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the server is already running
+ * @return  -EINVAL if wolfSSL could not be set up
+ * @return  -ENOMEM if the thread could not be created
+ */
+int tls_start(tls_proto_t proto, uint16_t port);
+
+/**
+ * @brief   Get the statistics of a server
+ */
+const tls_stats_t *tls_stats(tls_proto_t proto);
+
+/**
+ * @brief   TLS shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int tls_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TLS_H */
+/** @} */
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Observe and block-wise transfer benchmark for the `coap start` server.
+
+Usage:
+    coap_bench.py --host 192.168.1.100
+    coap_bench.py --host 192.168.1.100 --rate 1000 --interval 10
+    coap_bench.py --host 192.168.1.100 --block 256 --count 20
+
+Uses the libcoap client (coap-client, or the binary given with --client)
+and the control channel (ctrl.h) to configure the device and read its
+statistics.
+
+Observe: sets the producer to --rate changes/s and the notification
+interval to --interval ms, observes /value for --duration seconds and
+reports the notifications/s the device sent and how many changes it
+coalesced.
+
+Block-wise: downloads /waveform --count times with blocks of --block bytes
+and reports the client side transfer time next to the device's.
+"""
+
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+import ctrl
+
+
+def delta(before, after):
+    return {k: (after[k] - before[k]) & 0xffffffff for k in after}
+
+
+def observe(args, dev):
+    dev.exec("coap rate %d" % args.rate, wait=True)
+    dev.exec("coap interval %d" % args.interval, wait=True)
+    before = dev.stats("coap")
+    start = time.monotonic()
+    proc = subprocess.run([args.client, "-m", "get", "-s",
+                           str(args.duration), "coap://%s/value" % args.host],
+                          capture_output=True, timeout=args.duration + 30)
+    elapsed = time.monotonic() - start
+    d = delta(before, dev.stats("coap"))
+    dev.exec("coap rate 0", wait=True)
+    if proc.returncode != 0:
+        raise RuntimeError(proc.stderr.decode(errors="replace").strip())
+    print("observe: %d changes/s, interval %d ms" % (args.rate, args.interval))
+    print("  %.1f notifications/s, %.1f changes/s, %d%% coalesced" %
+          (d["notifications"] / elapsed, d["changes"] / elapsed,
+           100 * d["coalesced"] // max(d["changes"], 1)))
+
+
+def blockwise(args, dev):
+    times = []
+    before = dev.stats("coap")
+    fd, path = tempfile.mkstemp()
+    os.close(fd)
+    try:
+        for _ in range(args.count):
+            start = time.monotonic()
+            proc = subprocess.run([args.client, "-m", "get", "-b",
+                                   str(args.block), "-o", path,
+                                   "coap://%s/waveform" % args.host],
+                                  capture_output=True, timeout=60)
+            elapsed = time.monotonic() - start
+            if proc.returncode != 0:
+                raise RuntimeError(proc.stderr.decode(errors="replace")
+                                   .strip())
+            times.append(elapsed)
+        size = os.path.getsize(path)
+    finally:
+        os.unlink(path)
+    d = delta(before, dev.stats("coap"))
+    print("block-wise: %d x %d bytes in %d byte blocks" %
+          (args.count, size, args.block))
+    print("  client avg %.1f ms, max %.1f ms, %.1f kbit/s" %
+          (statistics.mean(times) * 1000, max(times) * 1000,
+           size * 8 / statistics.mean(times) / 1000))
+    if d["transfers"] and d["block_us"]:
+        print("  device %d transfers, %d blocks, avg %.1f ms, %.1f kbit/s" %
+              (d["transfers"], d["blocks"],
+               d["block_us"] / d["transfers"] / 1000,
+               d["transfers"] * size * 8 / d["block_us"] * 1000))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--ctrl-port", type=int, default=12380)
+    parser.add_argument("--client", default="coap-client")
+    parser.add_argument("--rate", type=int, default=100,
+                        help="changes of /value per second")
+    parser.add_argument("--interval", type=int, default=100,
+                        help="minimum notification interval in ms")
+    parser.add_argument("--duration", type=int, default=10,
+                        help="observe duration in seconds, 0 to skip")
+    parser.add_argument("--block", type=int, default=1024,
+                        choices=(16, 32, 64, 128, 256, 512, 1024))
+    parser.add_argument("--count", type=int, default=10,
+                        help="waveform downloads, 0 to skip")
+    args = parser.parse_args()
+
+    dev = ctrl.Device(args.host, args.ctrl_port, 0.5, 5)
+    try:
+        if args.duration:
+            observe(args, dev)
+        if args.count:
+            blockwise(args, dev)
+    except (ctrl.CtrlError, RuntimeError, OSError,
+            subprocess.TimeoutExpired) as e:
+        print("error: %s" % e, file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Linux-side collector for the record stream of stream.h.
+
+Usage:
+    collector.py [--port 12344 [--port 12345]] [--ack-every 1]
+                 [--failover-every SECONDS [--mode close|stall]]
+
+Records are acknowledged cumulatively with the next expected sequence number.
+Replayed records (sequence number below the expected one) are counted as
+duplicates and dropped, skipped sequence numbers are counted as lost. A new
+connection from the device takes over from older ones, which are closed.
+
+Giving --port twice runs a primary and a secondary collector in one process.
+They share the sequence state like a replicated backend would, so they can be
+used as the two peers for the hot standby mode:
+
+    stream start <host addr> 12344 <host addr> 12345
+
+--failover-every makes the collector fail the connection carrying the stream
+periodically, either by closing it or by no longer reading from it (the
+device then sees a zero window). Every time the stream moves to another
+connection, the gap between the last new record on the old connection and
+the first new record on the new one is printed, with a summary on Ctrl-C.
+
+Records of a device running the SNTP client (`wallclock start <server>`)
+start with its wall clock time in microseconds, big endian. Run the
+collector host on the same NTP server and the one-way delay of each stamped
+record, from the stamp to its arrival here, is summarized on Ctrl-C. It
+includes the time records spent in the device's replay buffer.
+
+To force plain reconnects, flap the link (`phy mock down` / `phy mock up` on
+BOARD=native, or unplug the cable) or restart this script.
+"""
+
+import argparse
+import selectors
+import socket
+import struct
+import time
+
+TYPE_DATA = 1
+TYPE_HELLO = 2
+
+HDR = struct.Struct("!HHI")
+ACK = struct.Struct("!I")
+STAMP = struct.Struct("!Q")
+STAMP_MAX_AGE = 3600.0
+REPORT_INTERVAL = 2.0
+
+
+class Collector:
+    def __init__(self, ack_every):
+        self.ack_every = ack_every
+        self.expected = None
+        self.records = 0
+        self.bytes = 0
+        self.dups = 0
+        self.lost = 0
+        self.connections = 0
+        self.current = None
+        self.last_conn = None
+        self.last_new = 0.0
+        self.gaps = []
+        self.delays = []
+
+    def hello(self, conn, seq):
+        self.connections += 1
+        if self.current is not None and self.current is not conn:
+            self.current.close()
+        self.current = conn
+        if self.expected is None:
+            self.expected = seq
+        elif seq > self.expected:
+            # the device overwrote records it could not deliver
+            self.lost += seq - self.expected
+            self.expected = seq
+        print("connection %d via port %d resumes at %d (expected %d)" %
+              (self.connections, conn.port, seq, self.expected))
+
+    def stamp(self, payload):
+        if len(payload) < STAMP.size:
+            return
+        stamp, = STAMP.unpack_from(payload)
+        delay = time.time() - stamp / 1e6
+        # 0 until the device is synchronized, other payloads are far off
+        if stamp and abs(delay) < STAMP_MAX_AGE:
+            self.delays.append(delay)
+
+    def record(self, conn, seq, payload):
+        now = time.monotonic()
+        if self.expected is None:
+            self.expected = seq
+        if seq < self.expected:
+            self.dups += 1
+            return
+        if seq > self.expected:
+            self.lost += seq - self.expected
+        if self.last_conn is not None and self.last_conn is not conn:
+            gap = now - self.last_new
+            self.gaps.append(gap)
+            print("stream moved to port %d, gap %.3f ms" %
+                  (conn.port, gap * 1000))
+        self.last_conn = conn
+        self.last_new = now
+        self.expected = seq + 1
+        self.records += 1
+        self.bytes += len(payload)
+        self.stamp(payload)
+
+    def summary(self):
+        print("%d records, %d duplicates, %d lost, %d connections" %
+              (self.records, self.dups, self.lost, self.connections))
+        if self.gaps:
+            gaps = sorted(g * 1000 for g in self.gaps)
+            print("%d switches, gap min %.3f ms, avg %.3f ms, max %.3f ms" %
+                  (len(gaps), gaps[0], sum(gaps) / len(gaps), gaps[-1]))
+        if self.delays:
+            delays = sorted(d * 1000 for d in self.delays)
+            print("%d stamped, one-way delay min %.3f ms, avg %.3f ms, "
+                  "p99 %.3f ms, max %.3f ms" %
+                  (len(delays), delays[0], sum(delays) / len(delays),
+                   delays[len(delays) * 99 // 100], delays[-1]))
+
+
+class Connection:
+    def __init__(self, sel, sock, port, collector):
+        self.sel = sel
+        self.sock = sock
+        self.port = port
+        self.collector = collector
+        self.buf = b""
+        self.unacked = 0
+        self.closed = False
+        self.stalled = False
+
+    def close(self):
+        if not self.closed:
+            self.closed = True
+            if not self.stalled:
+                self.sel.unregister(self.sock)
+            self.sock.close()
+
+    def stall(self):
+        # stop reading, the receive window closes once our buffer is full
+        if not self.closed and not self.stalled:
+            self.stalled = True
+            self.sel.unregister(self.sock)
+
+    def input(self, data):
+        self.buf += data
+        while len(self.buf) >= HDR.size:
+            rtype, length, seq = HDR.unpack_from(self.buf)
+            if len(self.buf) < HDR.size + length:
+                break
+            payload = self.buf[HDR.size:HDR.size + length]
+            self.buf = self.buf[HDR.size + length:]
+            if rtype == TYPE_HELLO:
+                self.collector.hello(self, seq)
+            elif rtype == TYPE_DATA:
+                self.collector.record(self, seq, payload)
+                self.unacked += 1
+        if self.unacked >= self.collector.ack_every and not self.closed:
+            self.unacked = 0
+            self.sock.sendall(ACK.pack(self.collector.expected & 0xffffffff))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, action="append",
+                        help="TCP port to listen on, may be given twice")
+    parser.add_argument("--ack-every", type=int, default=1,
+                        help="acknowledge after this many records")
+    parser.add_argument("--failover-every", type=float, default=0,
+                        help="fail the active connection every N seconds")
+    parser.add_argument("--mode", choices=("close", "stall"), default="close",
+                        help="how to fail the active connection")
+    args = parser.parse_args()
+
+    collector = Collector(args.ack_every)
+    sel = selectors.DefaultSelector()
+    for port in args.port or [12344]:
+        srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        srv.bind(("", port))
+        srv.listen(4)
+        sel.register(srv, selectors.EVENT_READ, port)
+        print("collecting on TCP port %d" % port)
+
+    last = time.monotonic()
+    last_fail = last
+    last_bytes = 0
+    try:
+        while True:
+            for key, _ in sel.select(timeout=0.1):
+                if isinstance(key.data, int):
+                    sock, _ = key.fileobj.accept()
+                    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                    sel.register(sock, selectors.EVENT_READ,
+                                 Connection(sel, sock, key.data, collector))
+                    continue
+                conn = key.data
+                try:
+                    data = b"" if conn.closed else conn.sock.recv(65536)
+                except OSError:
+                    data = b""
+                if not data:
+                    conn.close()
+                    continue
+                conn.input(data)
+            now = time.monotonic()
+            if (args.failover_every and collector.current is not None and
+                    now - last_fail >= args.failover_every):
+                last_fail = now
+                print("failing the connection on port %d (%s)" %
+                      (collector.current.port, args.mode))
+                if args.mode == "close":
+                    collector.current.close()
+                    collector.current = None
+                else:
+                    collector.current.stall()
+            if now - last >= REPORT_INTERVAL:
+                rate = (collector.bytes - last_bytes) * 8 / (now - last) / 1e6
+                print("%.3f Mbps, %d records, %d duplicates, %d lost, "
+                      "%d connections" % (rate, collector.records,
+                                          collector.dups, collector.lost,
+                                          collector.connections))
+                last = now
+                last_bytes = collector.bytes
+    except KeyboardInterrupt:
+        collector.summary()
+
+
+if __name__ == "__main__":
+    main()
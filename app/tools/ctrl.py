@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Client for the binary UDP control channel, see ctrl.h.
+
+Usage:
+    ctrl.py --host 192.168.1.100 ping
+    ctrl.py --host 192.168.1.100 --host 192.168.1.101 exec "http start" --wait
+    ctrl.py --host 192.168.1.100 status
+    ctrl.py --host 192.168.1.100 metrics
+    ctrl.py --host 192.168.1.100 stats http
+    ctrl.py --host 192.168.1.100 --host 192.168.1.101 run matrix.txt
+
+Commands are sent to all hosts at once. Every request is retried with the
+same sequence number until it is answered, so a lost reply never starts a
+command twice.
+
+A run script has one shell command line per line, `#` starts a comment.
+Each line is executed on all hosts and waited for; then the metrics of
+every host are printed as one JSON object per line, so a matrix of
+parameter settings and benchmark runs can be scripted and collected
+without scraping console output.
+"""
+
+import argparse
+import errno
+import json
+import os
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+MAGIC = 0x5243
+VERSION = 1
+OP_PING = 0x01
+OP_EXEC = 0x02
+OP_STATUS = 0x03
+OP_METRICS = 0x04
+OP_STATS = 0x05
+OP_REPLY = 0x80
+HDR = struct.Struct("!HBBHH")
+
+JOB_STATES = ("idle", "running", "done")
+METRIC_TYPES = ("counter", "gauge", "histogram")
+TLS_FIELDS = ("full", "resumed", "failures", "full_us", "full_max_us",
+              "resumed_us", "resumed_max_us", "full_total_us",
+              "resumed_total_us", "bytes", "bulk_us")
+STATS = {
+    "stream": (1, ("connects", "failures", "failovers", "last_latency_us",
+                   "max_latency_us", "last_gap_us", "max_gap_us", "records",
+                   "acked", "lost_records", "lost_bytes", "replayed_records",
+                   "replayed_bytes")),
+    "http": (2, ("connections", "requests", "pipelined", "errors",
+                 "rom_bytes", "copied_bytes")),
+    "fwup": (3, ("status", "size", "duration_us", "wait_us", "flash_us")),
+    "rsh": (4, ("sessions", "commands", "bytes", "writes")),
+    "tls": (5, TLS_FIELDS),
+    "dtls": (6, TLS_FIELDS),
+    "coap": (7, ("requests", "errors", "changes", "notifications",
+                 "coalesced", "blocks", "transfers", "block_bytes",
+                 "block_us")),
+    "ptp": (8, ("state", "announces", "syncs", "delay_reqs", "delay_resps",
+                "timeouts", "steps", "rx_hw", "rx_sw", "tx_hw", "tx_sw",
+                "rx_dropped", "offset_ns", "path_delay_ns", "freq_ppb",
+                "samples", "offset_max_ns", "offset_total_ns")),
+}
+SIGNED_STATS = ("offset_ns", "path_delay_ns", "freq_ppb")
+
+
+class CtrlError(Exception):
+    def __init__(self, msg, status=0):
+        super().__init__(msg)
+        self.status = status
+
+
+class Device:
+    def __init__(self, host, port, timeout, retries):
+        self.host = host
+        self.addr = socket.getaddrinfo(host, port, 0, socket.SOCK_DGRAM)[0]
+        self.sock = socket.socket(self.addr[0], socket.SOCK_DGRAM)
+        self.sock.settimeout(timeout)
+        self.retries = retries
+        self.seq = random.randrange(0x10000)
+
+    def request(self, op, payload=b""):
+        self.seq = (self.seq + 1) & 0xffff
+        data = HDR.pack(MAGIC, VERSION, op, self.seq, 0) + payload
+        for _ in range(self.retries + 1):
+            self.sock.sendto(data, self.addr[4])
+            deadline = time.monotonic() + self.sock.gettimeout()
+            while time.monotonic() < deadline:
+                try:
+                    reply = self.sock.recv(2048)
+                except socket.timeout:
+                    break
+                if len(reply) < HDR.size:
+                    continue
+                magic, _, rop, seq, status = HDR.unpack_from(reply)
+                # drop late replies to earlier requests
+                if (magic != MAGIC or rop != (op | OP_REPLY)
+                        or seq != self.seq):
+                    continue
+                if status:
+                    raise CtrlError("%s: %s" % (self.host,
+                                                os.strerror(status)), status)
+                return reply[HDR.size:]
+        raise CtrlError("%s: no reply" % self.host)
+
+    def ping(self):
+        uptime_ms, commands = struct.unpack("!IH", self.request(OP_PING))
+        return {"uptime_ms": uptime_ms, "commands": commands}
+
+    def status(self):
+        state, _, seq, ret, elapsed_ms = struct.unpack(
+            "!BBHiI", self.request(OP_STATUS))
+        return {"state": JOB_STATES[state], "seq": seq, "ret": ret,
+                "elapsed_ms": elapsed_ms}
+
+    def exec(self, line, wait=False, poll=0.2):
+        try:
+            self.request(OP_EXEC, line.encode())
+        except CtrlError as e:
+            if e.status == errno.ENOENT:
+                raise CtrlError("%s: unknown command: %s" % (self.host, line))
+            raise
+        seq = self.seq
+        while True:
+            status = self.status()
+            if status["seq"] != seq:
+                raise CtrlError("%s: job was replaced" % self.host)
+            if not wait or status["state"] == "done":
+                return status
+            time.sleep(poll)
+
+    def metrics(self):
+        result = {}
+        index = 0
+        while True:
+            reply = self.request(OP_METRICS, struct.pack("!H", index))
+            index, = struct.unpack_from("!H", reply)
+            pos = 2
+            while pos < len(reply):
+                mtype, name_len = reply[pos], reply[pos + 1]
+                pos += 2
+                name = reply[pos:pos + name_len].decode()
+                pos += name_len
+                if METRIC_TYPES[mtype] == "histogram":
+                    count, total = struct.unpack_from("!II", reply, pos)
+                    result[name] = {"count": count, "sum": total}
+                    pos += 8
+                else:
+                    result[name], = struct.unpack_from("!I", reply, pos)
+                    pos += 4
+            if index == 0:
+                return result
+
+    def stats(self, name):
+        sid, fields = STATS[name]
+        reply = self.request(OP_STATS, bytes([sid]))
+        values = struct.unpack("!%dI" % (len(reply) // 4), reply)
+        result = dict(zip(fields, values))
+        for name in SIGNED_STATS:
+            if result.get(name, 0) >= 0x80000000:
+                result[name] -= 0x100000000
+        return result
+
+
+def on_all(devices, func):
+    """Run func(device) for every device concurrently, return the results
+    in order of the devices. Errors are returned as the exception."""
+    results = [None] * len(devices)
+
+    def worker(i, dev):
+        try:
+            results[i] = func(dev)
+        except (CtrlError, OSError) as e:
+            results[i] = e
+
+    threads = [threading.Thread(target=worker, args=(i, dev))
+               for i, dev in enumerate(devices)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return results
+
+
+def report(devices, results):
+    failed = False
+    for dev, res in zip(devices, results):
+        if isinstance(res, Exception):
+            print("error: %s" % res, file=sys.stderr)
+            failed = True
+        else:
+            print(json.dumps({"host": dev.host, **res}))
+    return failed
+
+
+def run_script(devices, path, poll):
+    failed = False
+    with open(path) as f:
+        lines = [line.split("#", 1)[0].strip() for line in f]
+    for line in filter(None, lines):
+        results = on_all(devices, lambda d: d.exec(line, True, poll))
+        for dev, res in zip(devices, results):
+            if not isinstance(res, Exception):
+                res = {"exec": line, **res}
+            failed |= report([dev], [res])
+        results = on_all(devices, Device.metrics)
+        results = [r if isinstance(r, Exception)
+                   else {"after": line, "metrics": r} for r in results]
+        failed |= report(devices, results)
+    return failed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", action="append", required=True,
+                        help="device address, may be repeated")
+    parser.add_argument("--port", type=int, default=12380)
+    parser.add_argument("--timeout", type=float, default=0.5,
+                        help="seconds to wait for a reply")
+    parser.add_argument("--retries", type=int, default=5)
+    parser.add_argument("--poll", type=float, default=0.2,
+                        help="status poll interval while waiting")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    sub.add_parser("ping")
+    p = sub.add_parser("exec")
+    p.add_argument("line", help="shell command line")
+    p.add_argument("--wait", action="store_true",
+                   help="wait for the command to return")
+    sub.add_parser("status")
+    sub.add_parser("metrics")
+    p = sub.add_parser("stats")
+    p.add_argument("name", choices=sorted(STATS))
+    p = sub.add_parser("run")
+    p.add_argument("script")
+    args = parser.parse_args()
+
+    devices = [Device(h, args.port, args.timeout, args.retries)
+               for h in args.host]
+    if args.cmd == "run":
+        failed = run_script(devices, args.script, args.poll)
+    else:
+        funcs = {
+            "ping": Device.ping,
+            "exec": lambda d: d.exec(args.line, args.wait, args.poll),
+            "status": Device.status,
+            "metrics": lambda d: {"metrics": d.metrics()},
+            "stats": lambda d: d.stats(args.name),
+        }
+        failed = report(devices, on_all(devices, funcs[args.cmd]))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
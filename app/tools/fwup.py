@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Firmware update client for the `fwup start` receiver.
+
+Usage:
+    fwup.py --host 192.168.1.100 bin/kl-ftu/kl-ftu.bin
+    fwup.py --host 192.168.1.100 --size 262144 [--corrupt]
+
+Sends the image, or --size bytes of random data, with the header described
+in fwup.h and prints the device's verdict and timing. --corrupt sends a
+wrong SHA-256 to check that the device rejects the image. For BOARD=native
+the flash pages are emulated in RAM; run the same image once after
+`fwup pipeline off` to see what the overlap of receiving and programming
+saves.
+"""
+
+import argparse
+import errno
+import hashlib
+import os
+import socket
+import struct
+import time
+
+MAGIC = 0x46575550
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--port", type=int, default=12370)
+    parser.add_argument("--size", type=int,
+                        help="send random data of this size")
+    parser.add_argument("--corrupt", action="store_true",
+                        help="send a wrong SHA-256")
+    parser.add_argument("image", nargs="?")
+    args = parser.parse_args()
+
+    if args.image:
+        with open(args.image, "rb") as f:
+            image = f.read()
+    elif args.size:
+        image = os.urandom(args.size)
+    else:
+        parser.error("need an image or --size")
+    digest = hashlib.sha256(image).digest()
+    if args.corrupt:
+        digest = bytes([digest[0] ^ 0xff]) + digest[1:]
+
+    start = time.monotonic()
+    with socket.create_connection((args.host, args.port)) as sock:
+        sock.sendall(struct.pack("!II", MAGIC, len(image)) + digest)
+        sock.sendall(image)
+        reply = b""
+        while len(reply) < 8:
+            data = sock.recv(8 - len(reply))
+            if not data:
+                raise SystemExit("device closed the connection without reply")
+            reply += data
+    duration = time.monotonic() - start
+    status, device_ms = struct.unpack("!II", reply)
+    if status:
+        print("update failed: %s" % errno.errorcode.get(status, status))
+    else:
+        print("update verified")
+    print("%d bytes in %.3f s (device: %d ms), %.1f KiB/s"
+          % (len(image), duration, device_ms, len(image) / duration / 1024))
+    raise SystemExit(1 if status else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""HTTP load generator for the device HTTP server (`http start`).
+
+Usage:
+    http_bench.py --host 192.168.1.100 [--port 80] [--path /] \
+        [--connections 4] [--pipeline 1] [--seconds 10]
+
+Keeps --connections keep-alive connections busy with --pipeline requests in
+flight each and reports requests/s and MB/s of response bodies. Use
+`--path /` for small responses (requests/s) and `--path /data/1024` for
+bulk transfer (MB/s). The same numbers can be cross-checked with the usual
+tools, e.g.:
+
+    wrk -t1 -c4 -d10s http://192.168.1.100/
+    curl -o /dev/null -w '%{speed_download}\\n' http://192.168.1.100/data/4096
+
+Compare `http` on the device shell before and after a run for the bytes
+that were sent from flash and the bytes that were copied.
+"""
+
+import argparse
+import selectors
+import socket
+import time
+
+
+class Conn:
+    def __init__(self, args, request):
+        self.sock = socket.create_connection((args.host, args.port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.sock.setblocking(False)
+        self.request = request
+        self.buf = b""
+        self.pending = 0
+        self.body_left = None
+
+    def send(self, count):
+        self.sock.sendall(self.request * count)
+        self.pending += count
+
+    def receive(self):
+        """Returns the number of completed responses and body bytes."""
+        data = self.sock.recv(65536)
+        if not data:
+            raise ConnectionError("server closed the connection")
+        self.buf += data
+        done = 0
+        body = 0
+        while True:
+            if self.body_left is None:
+                end = self.buf.find(b"\r\n\r\n")
+                if end < 0:
+                    break
+                header = self.buf[:end].decode("latin-1")
+                self.buf = self.buf[end + 4:]
+                if not header.startswith("HTTP/1.1 200"):
+                    raise ConnectionError(header.splitlines()[0])
+                self.body_left = 0
+                for line in header.split("\r\n")[1:]:
+                    name, _, value = line.partition(":")
+                    if name.lower() == "content-length":
+                        self.body_left = int(value)
+            take = min(self.body_left, len(self.buf))
+            self.buf = self.buf[take:]
+            self.body_left -= take
+            body += take
+            if self.body_left:
+                break
+            self.body_left = None
+            self.pending -= 1
+            done += 1
+        return done, body
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/")
+    parser.add_argument("--connections", type=int, default=4)
+    parser.add_argument("--pipeline", type=int, default=1,
+                        help="requests in flight per connection")
+    parser.add_argument("--seconds", type=float, default=10)
+    args = parser.parse_args()
+
+    request = ("GET %s HTTP/1.1\r\nHost: %s\r\n\r\n"
+               % (args.path, args.host)).encode()
+    sel = selectors.DefaultSelector()
+    conns = [Conn(args, request) for _ in range(args.connections)]
+    for conn in conns:
+        sel.register(conn.sock, selectors.EVENT_READ, conn)
+        conn.send(args.pipeline)
+
+    requests = 0
+    body = 0
+    start = time.monotonic()
+    while time.monotonic() - start < args.seconds:
+        for key, _ in sel.select(timeout=1):
+            conn = key.data
+            done, nbytes = conn.receive()
+            requests += done
+            body += nbytes
+            if done:
+                conn.send(done)
+    duration = time.monotonic() - start
+    for conn in conns:
+        conn.sock.close()
+    print("%d requests in %.1f s: %.0f requests/s, %.3f MB/s"
+          % (requests, duration, requests / duration,
+             body / duration / 1e6))
+
+
+if __name__ == "__main__":
+    main()
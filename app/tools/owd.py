@@ -0,0 +1,297 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""One-way delay probes against `owd listen` / `owd send`, see owd.h.
+
+Usage:
+    owd.py serve [--port 12390]
+    owd.py send --host 192.168.1.100 [--count 1000] [--interval 10]
+    owd.py both --host 192.168.1.100 [--count 1000] [--size 512]
+
+serve is the receiver for `owd send <this host> 12390 <num>` on the
+device, i.e. the uplink. It answers the offset estimation and prints the
+report of every session the device asks for.
+
+send sends probes to the device's receiver (started with `owd listen`),
+i.e. the downlink, and prints the device's report.
+
+both measures the uplink and then the downlink, starting the device side
+through the control channel (ctrl.h), and prints them next to each other.
+
+Pass --ntp when this host follows the same NTP server as the device's
+SNTP client (`wallclock start`). If the device is synchronized too, the
+probes are then stamped in wall clock time; otherwise the offset is
+estimated from the fastest of a few exchanges, which hides a fixed
+asymmetry of the minimum delays but not the queueing on top of them.
+"""
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+import ctrl
+
+TYPE_PROBE = 1
+TYPE_SYNC = 2
+TYPE_SYNC_REPLY = 3
+TYPE_REPORT = 4
+TYPE_REPORT_REPLY = 5
+FLAG_WALL = 0x01
+
+MSG = struct.Struct("!BBHIQQQ")
+REPORT = struct.Struct("!IIIiiiiiIII")
+REPORT_FIELDS = ("received", "lost", "reordered", "min_us", "avg_us",
+                 "p50_us", "p99_us", "max_us", "ipdv_us", "pdv_us", "flags")
+SYNC_PROBES = 8
+SAMPLES = 1000
+TIMEOUT = 0.2
+
+
+def now_us():
+    return int(time.time() * 1e6)
+
+
+class Session:
+    def __init__(self, session):
+        self.session = session
+        self.delays = []
+        self.received = 0
+        self.reordered = 0
+        self.highest = 0
+        self.last = None
+        self.ipdv = []
+        self.total = 0
+        self.min = None
+        self.max = None
+
+    def record(self, seq, delay):
+        if self.received == 0 or seq > self.highest:
+            self.highest = seq
+        else:
+            self.reordered += 1
+        # RFC 3393 pairs consecutive probes only
+        if self.last is not None and seq == self.last[0] + 1:
+            self.ipdv.append(abs(delay - self.last[1]))
+        self.last = (seq, delay)
+        self.received += 1
+        self.total += delay
+        self.min = delay if self.min is None else min(self.min, delay)
+        self.max = delay if self.max is None else max(self.max, delay)
+        if len(self.delays) < SAMPLES:
+            self.delays.append(delay)
+
+    def report(self, flags):
+        r = dict.fromkeys(REPORT_FIELDS, 0)
+        r["flags"] = flags
+        if self.received:
+            d = sorted(self.delays)
+            r.update(received=self.received,
+                     lost=max(self.highest + 1 - self.received, 0),
+                     reordered=self.reordered, min_us=self.min,
+                     avg_us=int(self.total / self.received),
+                     p50_us=d[len(d) // 2], p99_us=d[len(d) * 99 // 100],
+                     max_us=self.max,
+                     ipdv_us=(sum(self.ipdv) // len(self.ipdv)
+                              if self.ipdv else 0))
+            r["pdv_us"] = r["p99_us"] - r["min_us"]
+        return r
+
+
+def serve(port, flags, stop=None, reports=None):
+    """Receiver loop, returns when stop is set. Every report sent is
+    printed, and appended to reports if given."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", port))
+    sock.settimeout(0.1)
+    session = None
+    reported = set()
+    while stop is None or not stop.is_set():
+        try:
+            data, addr = sock.recvfrom(2048)
+        except socket.timeout:
+            continue
+        arrival = now_us()
+        if len(data) < MSG.size:
+            continue
+        mtype, _, sid, seq, t1, _, _ = MSG.unpack_from(data)
+        if session is None or sid != session.session:
+            session = Session(sid)
+        if mtype == TYPE_PROBE:
+            session.record(seq, arrival - t1)
+        elif mtype == TYPE_SYNC:
+            sock.sendto(MSG.pack(TYPE_SYNC_REPLY, flags, sid, seq, t1,
+                                 arrival, now_us()), addr)
+        elif mtype == TYPE_REPORT:
+            r = session.report(flags)
+            sock.sendto(MSG.pack(TYPE_REPORT_REPLY, flags, sid, seq, 0, 0, 0)
+                        + REPORT.pack(*(r[k] for k in REPORT_FIELDS)), addr)
+            # retried requests get the report again but print it once
+            if sid not in reported:
+                reported.add(sid)
+                print_report("uplink from %s" % addr[0], r)
+                if reports is not None:
+                    reports.append(r)
+    sock.close()
+
+
+def request(sock, mtype, sid, seq, t1=0):
+    sock.send(MSG.pack(mtype, 0, sid, seq, t1, 0, 0))
+    deadline = time.monotonic() + TIMEOUT
+    while time.monotonic() < deadline:
+        try:
+            reply = sock.recv(2048)
+        except socket.timeout:
+            break
+        if len(reply) < MSG.size:
+            continue
+        rtype, rflags, rsid, rseq, _, t2, t3 = MSG.unpack_from(reply)
+        # drop late replies to earlier requests
+        if rtype == mtype + 1 and rsid == sid and rseq == seq:
+            return rflags, t2, t3, reply[MSG.size:]
+    return None
+
+
+def send(host, port, count, interval, size, dscp, flags):
+    """Probe the receiver at host:port, return its report."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_TOS, dscp << 2)
+    sock.settimeout(TIMEOUT)
+    sock.connect((host, port))
+    sid = random.randrange(0x10000)
+
+    best = None
+    for i in range(SYNC_PROBES):
+        t1 = now_us()
+        reply = request(sock, TYPE_SYNC, sid, i, t1)
+        t4 = now_us()
+        if reply is None:
+            continue
+        rflags, t2, t3, _ = reply
+        rtt = (t4 - t1) - (t3 - t2)
+        if rtt >= 0 and (best is None or rtt < best[0]):
+            best = (rtt, ((t2 - t1) + (t3 - t4)) // 2, rflags)
+    if best is None:
+        raise RuntimeError("no answer from %s:%d" % (host, port))
+    rtt, offset, rflags = best
+    if flags & rflags & FLAG_WALL:
+        print("clock: wall clock on both ends")
+        offset = 0
+    else:
+        print("clock: offset %.6f s estimated, rtt %d us" %
+              (offset / 1e6, rtt))
+
+    pad = bytes(max(size - MSG.size, 0))
+    start = time.monotonic()
+    for i in range(count):
+        sock.send(MSG.pack(TYPE_PROBE, flags, sid, i, now_us() + offset,
+                           0, 0) + pad)
+        delay = start + (i + 1) * interval / 1000 - time.monotonic()
+        if delay > 0:
+            time.sleep(delay)
+    time.sleep(0.1)
+
+    for i in range(3):
+        reply = request(sock, TYPE_REPORT, sid, i)
+        if reply is not None and len(reply[3]) >= REPORT.size:
+            return dict(zip(REPORT_FIELDS, REPORT.unpack_from(reply[3])))
+    raise RuntimeError("no report from %s:%d" % (host, port))
+
+
+def print_report(title, r):
+    print("%s: %d received, %d lost, %d reordered, %s time" %
+          (title, r["received"], r["lost"], r["reordered"],
+           "wall clock" if r["flags"] & FLAG_WALL else "estimated"))
+    if r["received"]:
+        print("  delay min %d us, avg %d us, p50 %d us, p99 %d us, "
+              "max %d us" % (r["min_us"], r["avg_us"], r["p50_us"],
+                             r["p99_us"], r["max_us"]))
+        print("  ipdv %d us, pdv %d us" % (r["ipdv_us"], r["pdv_us"]))
+
+
+def local_addr(host):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.connect((host, 1))
+    addr = sock.getsockname()[0]
+    sock.close()
+    return addr
+
+
+def both(args, flags):
+    dev = ctrl.Device(args.host, args.ctrl_port, 0.5, 5)
+    stop = threading.Event()
+    reports = []
+    server = threading.Thread(target=serve, args=(args.listen, flags, stop,
+                                                  reports))
+    server.start()
+    try:
+        status = dev.exec("owd send %s %d %d %d %d %d" %
+                          (local_addr(args.host), args.listen, args.count,
+                           args.interval * 1000, args.size, args.dscp),
+                          wait=True)
+        if status["ret"] != 0:
+            raise RuntimeError("owd send failed on the device")
+    finally:
+        stop.set()
+        server.join()
+    # fails with the receiver already running, which is fine
+    dev.exec("owd listen %d" % args.port, wait=True)
+    down = send(args.host, args.port, args.count, args.interval, args.size,
+                args.dscp, flags)
+    print_report("downlink to %s" % args.host, down)
+    if reports and reports[-1]["received"] and down["received"]:
+        up = reports[-1]
+        print("uplink - downlink: min %+d us, p50 %+d us, p99 %+d us" %
+              (up["min_us"] - down["min_us"], up["p50_us"] - down["p50_us"],
+               up["p99_us"] - down["p99_us"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--ntp", action="store_true",
+                        help="this host follows the device's NTP server")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    p = sub.add_parser("serve")
+    p.add_argument("--port", type=int, default=12390)
+    for name in ("send", "both"):
+        p = sub.add_parser(name)
+        p.add_argument("--host", required=True)
+        p.add_argument("--port", type=int, default=12390,
+                       help="port of the device's receiver")
+        p.add_argument("--count", type=int, default=1000)
+        p.add_argument("--interval", type=int, default=10,
+                       help="probe interval in ms")
+        p.add_argument("--size", type=int, default=MSG.size,
+                       help="probe size in bytes")
+        p.add_argument("--dscp", type=int, default=0)
+    p.add_argument("--listen", type=int, default=12390,
+                   help="port of this host's receiver")
+    p.add_argument("--ctrl-port", type=int, default=12380)
+    args = parser.parse_args()
+    flags = FLAG_WALL if args.ntp else 0
+
+    try:
+        if args.cmd == "serve":
+            serve(args.port, flags)
+        elif args.cmd == "send":
+            print_report("downlink to %s" % args.host,
+                         send(args.host, args.port, args.count,
+                              args.interval, args.size, args.dscp, flags))
+        else:
+            both(args, flags)
+    except KeyboardInterrupt:
+        pass
+    except (ctrl.CtrlError, RuntimeError, OSError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
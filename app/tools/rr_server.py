@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Linux-side peer for the latency under load benchmark of the `qos` command.
+
+Usage:
+    rr_server.py [--port 12350]
+
+UDP datagrams are echoed back unchanged (the requests of `qos rr`), TCP
+connections on the same port are drained and their rate is reported (the
+bulk load of `qos bulk`). A run on the device looks like:
+
+    qos off
+    qos bulk <host addr> 12350 30
+    qos rr <host addr> 12350 500
+    qos on
+    qos bulk <host addr> 12350 30
+    qos rr <host addr> 12350 500
+
+The first `qos rr` shows the request/response latency with the replies
+queued behind bulk frames, the second one with the priority queues.
+"""
+
+import argparse
+import selectors
+import socket
+import time
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=12350,
+                        help="UDP and TCP port to listen on")
+    args = parser.parse_args()
+
+    sel = selectors.DefaultSelector()
+    udp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    udp.bind(("", args.port))
+    sel.register(udp, selectors.EVENT_READ, "udp")
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(("", args.port))
+    srv.listen(1)
+    sel.register(srv, selectors.EVENT_READ, "listen")
+    print("echoing UDP and draining TCP on port %d" % args.port)
+
+    echoed = 0
+    bulk = {}
+    while True:
+        for key, _ in sel.select():
+            if key.data == "udp":
+                data, addr = udp.recvfrom(2048)
+                udp.sendto(data, addr)
+                echoed += 1
+            elif key.data == "listen":
+                conn, addr = srv.accept()
+                sel.register(conn, selectors.EVENT_READ, "tcp")
+                bulk[conn] = [time.monotonic(), 0]
+                print("bulk connection from %s:%d" % addr)
+            else:
+                conn = key.fileobj
+                data = conn.recv(65536)
+                if data:
+                    bulk[conn][1] += len(data)
+                    continue
+                start, size = bulk.pop(conn)
+                duration = max(time.monotonic() - start, 1e-6)
+                print("bulk: %d byte in %.1f s, %.3f Mbps, %d requests echoed"
+                      % (size, duration, size * 8 / duration / 1e6, echoed))
+                sel.unregister(conn)
+                conn.close()
+
+
+if __name__ == "__main__":
+    main()
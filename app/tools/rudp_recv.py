@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Linux-side receiver for the `rudp` shell command.
+
+Usage:
+    rudp_recv.py [--port 5001] [--out FILE] [--ack-every 16]
+    rudp_recv.py --tcp [--port 5002]
+
+The UDP mode implements the receiver side of the protocol described in
+rudp.h. The TCP mode accepts the stream of `rudp tcp` so both transports can
+be compared on the same link. To emulate loss on the host interface facing
+the device (or the tap interface for BOARD=native), use netem, e.g.:
+
+    sudo tc qdisc add dev tap0 root netem loss 2% delay 5ms
+    sudo tc qdisc del dev tap0 root
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+TYPE_START = 1
+TYPE_DATA = 2
+TYPE_ACK = 3
+TYPE_FIN = 4
+
+HDR = struct.Struct("!BBH")
+START = struct.Struct("!BBHIHH")
+DATA = struct.Struct("!BBHII")
+ACK = struct.Struct("!BBHII32s")
+BITMAP_BITS = 256
+ACK_INTERVAL = 0.01
+
+
+class Transfer:
+    def __init__(self, session, total, chunk, out):
+        self.session = session
+        self.total = total
+        self.chunk = chunk
+        self.chunks = (total + chunk - 1) // chunk
+        self.received = bytearray(self.chunks)
+        self.base = 0
+        self.highest = -1
+        self.echo_ts = 0
+        self.unacked = 0
+        self.last_ack = 0.0
+        self.dups = 0
+        self.out = out
+        self.start = time.monotonic()
+        self.done_at = None
+        if out is not None:
+            out.truncate(total)
+
+    def data(self, seq, ts, payload):
+        if seq >= self.chunks:
+            return False
+        self.echo_ts = ts
+        self.unacked += 1
+        if self.received[seq]:
+            self.dups += 1
+            return False
+        self.received[seq] = 1
+        if self.out is not None:
+            self.out.seek(seq * self.chunk)
+            self.out.write(payload)
+        gap = seq > self.highest + 1
+        self.highest = max(self.highest, seq)
+        while self.base < self.chunks and self.received[self.base]:
+            self.base += 1
+        if self.base == self.chunks and self.done_at is None:
+            self.done_at = time.monotonic()
+        return gap
+
+    def ack(self):
+        bitmap = bytearray(BITMAP_BITS // 8)
+        for i in range(BITMAP_BITS):
+            seq = self.base + i
+            if seq >= self.chunks:
+                break
+            if self.received[seq]:
+                bitmap[i // 8] |= 1 << (i % 8)
+        self.unacked = 0
+        self.last_ack = time.monotonic()
+        return ACK.pack(TYPE_ACK, 0, self.session, self.base, self.echo_ts,
+                        bytes(bitmap))
+
+
+def serve_udp(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+    sock.bind(("", args.port))
+    sock.settimeout(ACK_INTERVAL)
+    out = open(args.out, "w+b") if args.out else None
+    xfer = None
+    peer = None
+    print("rudp receiver listening on UDP port %d" % args.port)
+    while True:
+        try:
+            pkt, addr = sock.recvfrom(2048)
+        except socket.timeout:
+            if xfer is not None and xfer.unacked:
+                sock.sendto(xfer.ack(), peer)
+            continue
+        if len(pkt) < HDR.size:
+            continue
+        ptype, _, session = HDR.unpack_from(pkt)
+        if ptype == TYPE_START and len(pkt) >= START.size:
+            _, _, _, total, chunk, _ = START.unpack_from(pkt)
+            if xfer is None or xfer.session != session:
+                xfer = Transfer(session, total, chunk, out)
+                peer = addr
+                print("session %04x from %s:%d: %d byte in %d chunks of %d"
+                      % (session, addr[0], addr[1], total, xfer.chunks, chunk))
+            sock.sendto(xfer.ack(), peer)
+        elif xfer is None or session != xfer.session:
+            continue
+        elif ptype == TYPE_DATA and len(pkt) >= DATA.size:
+            _, _, _, seq, ts = DATA.unpack_from(pkt)
+            gap = xfer.data(seq, ts, pkt[DATA.size:])
+            now = time.monotonic()
+            if (gap or xfer.unacked >= args.ack_every or
+                    xfer.base == xfer.chunks or
+                    now - xfer.last_ack >= ACK_INTERVAL):
+                sock.sendto(xfer.ack(), peer)
+        elif ptype == TYPE_FIN:
+            done = xfer.done_at or time.monotonic()
+            secs = done - xfer.start
+            print("session %04x complete: %d byte in %.3f s, %.4f Mbps, "
+                  "%d duplicates" % (session, xfer.total, secs,
+                                     xfer.total * 8 / secs / 1e6, xfer.dups))
+            if out is not None:
+                out.flush()
+            xfer = None
+
+
+def recv_exact(conn, size):
+    buf = b""
+    while len(buf) < size:
+        chunk = conn.recv(size - len(buf))
+        if not chunk:
+            raise ConnectionError("connection closed")
+        buf += chunk
+    return buf
+
+
+def serve_tcp(args):
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(("", args.port))
+    srv.listen(1)
+    print("tcp receiver listening on TCP port %d" % args.port)
+    while True:
+        conn, addr = srv.accept()
+        with conn:
+            try:
+                (total,) = struct.unpack("!I", recv_exact(conn, 4))
+                start = time.monotonic()
+                remaining = total
+                while remaining:
+                    chunk = conn.recv(min(remaining, 65536))
+                    if not chunk:
+                        raise ConnectionError("connection closed")
+                    remaining -= len(chunk)
+                secs = time.monotonic() - start
+                conn.sendall(b"\x01")
+                print("%s:%d: %d byte in %.3f s, %.4f Mbps"
+                      % (addr[0], addr[1], total, secs,
+                         total * 8 / secs / 1e6))
+            except ConnectionError as e:
+                print("%s:%d: %s" % (addr[0], addr[1], e))
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__,
+                                formatter_class=argparse.RawTextHelpFormatter)
+    p.add_argument("--port", type=int, default=None)
+    p.add_argument("--tcp", action="store_true",
+                   help="receive the TCP reference stream instead")
+    p.add_argument("--out", help="write received data to this file")
+    p.add_argument("--ack-every", type=int, default=16,
+                   help="ACK after this many DATA packets")
+    args = p.parse_args()
+    if args.port is None:
+        args.port = 5002 if args.tcp else 5001
+    try:
+        serve_tcp(args) if args.tcp else serve_udp(args)
+    except KeyboardInterrupt:
+        sys.exit(0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Broadcast/multicast storm generator for the `storm bench` shell command.
+
+Usage:
+    storm.py --dest 192.168.1.255 [--rate 20000] [--seconds 10] [--size 64]
+    storm.py --dest 239.1.2.3 --iface-addr 192.168.1.1 [...]
+
+Floods UDP datagrams to a broadcast or multicast address (rate 0 sends as
+fast as possible). For BOARD=native, use the broadcast address of the tap
+interface. Run `storm bench <seconds>` on the device during the storm, once
+with `storm on` and once with `storm off`, and compare the CPU left to the
+worker and its longest starvation.
+"""
+
+import argparse
+import socket
+import time
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--dest", required=True,
+                        help="broadcast or multicast address")
+    parser.add_argument("--port", type=int, default=9,
+                        help="UDP destination port")
+    parser.add_argument("--rate", type=int, default=0,
+                        help="datagrams per second, 0 for no limit")
+    parser.add_argument("--seconds", type=float, default=10)
+    parser.add_argument("--size", type=int, default=64,
+                        help="UDP payload size")
+    parser.add_argument("--iface-addr",
+                        help="local address to send multicast from")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    if args.iface_addr:
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF,
+                        socket.inet_aton(args.iface_addr))
+    payload = bytes(args.size)
+    start = time.monotonic()
+    sent = 0
+    while True:
+        now = time.monotonic()
+        if now - start >= args.seconds:
+            break
+        if args.rate and sent >= (now - start) * args.rate:
+            time.sleep(0.0005)
+            continue
+        try:
+            sock.sendto(payload, (args.dest, args.port))
+            sent += 1
+        except OSError:
+            # the host queue is full, give it a moment
+            time.sleep(0.0005)
+    duration = time.monotonic() - start
+    print("%d datagrams in %.1f s, %.0f datagrams/s"
+          % (sent, duration, sent / duration))
+
+
+if __name__ == "__main__":
+    main()
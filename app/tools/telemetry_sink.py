@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Telemetry collectors for the `mcast bench` shell command.
+
+Usage:
+    telemetry_sink.py --group 239.1.2.3 --iface-addr 192.168.1.1 \
+        [--port 12360] [--collectors 4]
+
+Starts N collectors. Each one subscribes to the group on --port and listens
+for unicast on its own port --port + 1 + i, the layout `mcast bench` sends
+to. Run `mcast bench <group> <host addr> <port> <collectors> <num>` on the
+device; the sink prints the datagrams every collector got by unicast and by
+multicast once a second while traffic comes in.
+"""
+
+import argparse
+import selectors
+import socket
+import struct
+import time
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--group", required=True, help="multicast group")
+    parser.add_argument("--iface-addr", default="0.0.0.0",
+                        help="local address of the interface to the device")
+    parser.add_argument("--port", type=int, default=12360,
+                        help="group port, unicast uses the following ports")
+    parser.add_argument("--collectors", type=int, default=4)
+    args = parser.parse_args()
+
+    sel = selectors.DefaultSelector()
+    mreq = struct.pack("4s4s", socket.inet_aton(args.group),
+                       socket.inet_aton(args.iface_addr))
+    counts = []
+    for i in range(args.collectors):
+        # every collector gets its own copy of each group datagram
+        msock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        msock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        msock.bind(("", args.port))
+        msock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+        usock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        usock.bind(("", args.port + 1 + i))
+        counts.append({"unicast": 0, "multicast": 0})
+        sel.register(msock, selectors.EVENT_READ, (i, "multicast"))
+        sel.register(usock, selectors.EVENT_READ, (i, "unicast"))
+
+    last = time.monotonic()
+    dirty = False
+    try:
+        while True:
+            for key, _ in sel.select(timeout=0.5):
+                key.fileobj.recv(2048)
+                idx, kind = key.data
+                counts[idx][kind] += 1
+                dirty = True
+            now = time.monotonic()
+            if dirty and now - last >= 1:
+                for i, count in enumerate(counts):
+                    print("collector %d: %d unicast, %d multicast"
+                          % (i, count["unicast"], count["multicast"]))
+                last = now
+                dirty = False
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+
+# This file is subject to the terms and conditions of the GNU Lesser
+# General Public License v2.1. See the file LICENSE in the top level
+# directory for more details.
+
+"""Handshake and bulk benchmark for the `tls start` servers.
+
+Usage:
+    tls_bench.py --host 192.168.1.100
+    tls_bench.py --host 192.168.1.100 --dtls --cipher PSK-AES128-CCM-8
+    tls_bench.py --host 192.168.1.100 --no-ticket --count 20 --kib 4096
+
+Runs the OpenSSL command line client against the device: --count full
+handshakes, --count handshakes resuming the session of the last one (from
+a session ticket, or from the server session cache with --no-ticket), and
+one download of --kib KiB. All connections ask for a maximum fragment
+length of 1024 bytes, matching TLS_RECORD_SIZE.
+
+Client side times include starting openssl, so the handshake latency that
+matters is the one the device measures: the statistics of the server are
+read over the control channel (ctrl.h) before and after the run and the
+difference is reported, unless --ctrl-port is 0.
+"""
+
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+import ctrl
+
+PSK = "0102030405060708090a0b0c0d0e0f10"
+CIPHERS = "ECDHE-PSK-AES128-CBC-SHA256"
+
+
+class Client:
+    def __init__(self, args):
+        self.args = args
+        fd, self.session = tempfile.mkstemp(suffix=".pem")
+        os.close(fd)
+
+    def run(self, kib, resume=False):
+        """Connect, request kib KiB, return (seconds, reused, bytes)"""
+        args = self.args
+        cmd = ["openssl", "s_client",
+               "-connect", "%s:%d" % (args.host, args.port),
+               "-dtls1_2" if args.dtls else "-tls1_2",
+               "-psk", args.psk, "-cipher", args.cipher,
+               "-maxfraglen", "1024", "-ign_eof"]
+        cmd += ["-sess_in", self.session] if resume \
+            else ["-sess_out", self.session]
+        if args.no_ticket:
+            cmd.append("-no_ticket")
+        # the session summary goes to stdout as well, only read it when no
+        # data is expected
+        if kib:
+            cmd.append("-quiet")
+        start = time.monotonic()
+        try:
+            proc = subprocess.run(cmd, input=b"%d\n" % kib,
+                                  capture_output=True, timeout=args.timeout)
+        except subprocess.TimeoutExpired:
+            raise RuntimeError("timeout")
+        elapsed = time.monotonic() - start
+        if proc.returncode != 0:
+            msg = proc.stderr.decode(errors="replace").strip().splitlines()
+            raise RuntimeError(msg[-1] if msg else "openssl failed")
+        return elapsed, b"\nReused," in proc.stdout, len(proc.stdout)
+
+    def close(self):
+        os.unlink(self.session)
+
+
+def device_stats(args):
+    if not args.ctrl_port:
+        return None
+    dev = ctrl.Device(args.host, args.ctrl_port, 0.5, 5)
+    return dev.stats("dtls" if args.dtls else "tls")
+
+
+def ms(values):
+    if not values:
+        return "-"
+    return "avg %7.1f ms, min %7.1f ms, max %7.1f ms" % (
+        statistics.mean(values) * 1000, min(values) * 1000,
+        max(values) * 1000)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--port", type=int, default=4433)
+    parser.add_argument("--dtls", action="store_true")
+    parser.add_argument("--cipher", default=CIPHERS)
+    parser.add_argument("--psk", default=PSK, help="key in hex")
+    parser.add_argument("--no-ticket", action="store_true",
+                        help="resume from the server session cache")
+    parser.add_argument("--count", type=int, default=10,
+                        help="handshakes of each kind")
+    parser.add_argument("--kib", type=int, default=1024,
+                        help="download size, 0 to skip")
+    parser.add_argument("--timeout", type=float, default=60)
+    parser.add_argument("--ctrl-port", type=int, default=12380)
+    args = parser.parse_args()
+
+    before = device_stats(args)
+    client = Client(args)
+    full, resumed, failed = [], [], 0
+    try:
+        for resume, times in ((False, full), (True, resumed)):
+            for _ in range(args.count):
+                try:
+                    elapsed, reused, _ = client.run(0, resume)
+                except RuntimeError as e:
+                    print("handshake failed: %s" % e, file=sys.stderr)
+                    failed += 1
+                    continue
+                if reused != resume:
+                    print("%s handshake where %s was expected" %
+                          (("full", "resumed")[reused],
+                           ("full", "resumed")[resume]), file=sys.stderr)
+                    failed += 1
+                    continue
+                times.append(elapsed)
+        bulk = client.run(args.kib) if args.kib else None
+    finally:
+        client.close()
+    after = device_stats(args)
+
+    print("%s %s, %d handshakes failed" %
+          ("DTLS" if args.dtls else "TLS", args.cipher, failed))
+    print("client full    %3d: %s" % (len(full), ms(full)))
+    print("client resumed %3d: %s" % (len(resumed), ms(resumed)))
+    if bulk:
+        elapsed, _, size = bulk
+        print("client download %d KiB in %.2f s, %.1f kbit/s" %
+              (size // 1024, elapsed, size * 8 / elapsed / 1000))
+    if before and after:
+        d = {k: (after[k] - before[k]) & 0xffffffff for k in after}
+        for kind in ("full", "resumed"):
+            if d[kind]:
+                print("device %-7s %3d: avg %7.1f ms, max %7.1f ms" %
+                      (kind, d[kind],
+                       d[kind + "_total_us"] / d[kind] / 1000,
+                       after[kind + "_max_us"] / 1000))
+        if d["bulk_us"]:
+            print("device sent %d KiB in %.2f s, %.1f kbit/s" %
+                  (d["bytes"] // 1024, d["bulk_us"] / 1e6,
+                   d["bytes"] * 8 / d["bulk_us"] * 1000))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
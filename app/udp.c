@@ -21,10 +21,15 @@
 #include <stdio.h>
 
 #include "common.h"
+#include "evq.h"
+#include "fec.h"
+#include "mcast.h"
+#include "metrics.h"
 #include "od.h"
 #include "net/af.h"
 #include "net/sock/async/event.h"
 #include "net/sock/udp.h"
+#include "prio.h"
 #include "shell.h"
 #include "test_utils/expect.h"
 #include "thread.h"
@@ -44,6 +49,36 @@ static bool server_running;
 static sock_udp_t server_sock;
 static char server_stack[THREAD_STACKSIZE_DEFAULT];
 static msg_t server_msg_queue[SERVER_MSG_QUEUE_SIZE];
+static char *server_group;
+static evq_t _evq;
+static metrics_metric_t rx_datagrams = METRICS_COUNTER(
+    "udp_server_rx_datagrams_total", "Datagrams received by the UDP server");
+static metrics_metric_t rx_bytes = METRICS_COUNTER(
+    "udp_server_rx_bytes_total", "Payload bytes received by the UDP server");
+static bool fec_enabled;
+static fec_enc_t fec_enc;
+static fec_dec_t fec_dec;
+static fec_stats_t fec_stats;
+
+static void _print_data(void *arg, const void *data, size_t len,
+                        bool recovered)
+{
+    sock_udp_ep_t *src = arg;
+    char addrstr[IPV6_ADDR_MAX_STR_LEN];
+
+#ifdef MODULE_LWIP_IPV6
+    printf("%s UDP data from [%s]:%" PRIu16 ":\n",
+           recovered ? "Recovered" : "Received",
+           ipv6_addr_to_str(addrstr, (ipv6_addr_t *)&src->addr.ipv6,
+                            sizeof(addrstr)), src->port);
+#else
+    printf("%s UDP data from [%s]:%" PRIu16 ":\n",
+           recovered ? "Recovered" : "Received",
+           ipv4_addr_to_str(addrstr, (ipv4_addr_t *)&src->addr.ipv4,
+                            sizeof(addrstr)), src->port);
+#endif
+    od_hex_dump(data, len, 0);
+}
 
 static void _udp_recv(sock_udp_t *sock, sock_async_flags_t flags, void *arg)
 {
@@ -60,25 +95,21 @@ static void _udp_recv(sock_udp_t *sock, sock_async_flags_t flags, void *arg)
             puts("No data received");
         }
         else {
-            char addrstr[IPV6_ADDR_MAX_STR_LEN];
-
-#ifdef MODULE_LWIP_IPV6
-            printf("Received UDP data from [%s]:%" PRIu16 ":\n",
-                   ipv6_addr_to_str(addrstr, (ipv6_addr_t *)&src.addr.ipv6,
-                                    sizeof(addrstr)), src.port);
-#else
-            printf("Received UDP data from [%s]:%" PRIu16 ":\n",
-                   ipv4_addr_to_str(addrstr, (ipv4_addr_t *)&src.addr.ipv4,
-                                    sizeof(addrstr)), src.port);
-#endif
-            od_hex_dump(sock_inbuf, res, 0);
+            metrics_inc(&rx_datagrams);
+            metrics_add(&rx_bytes, res);
+            if (!fec_enabled) {
+                _print_data(&src, sock_inbuf, res, false);
+            }
+            else if (fec_dec_recv(&fec_dec, sock_inbuf, res, _print_data,
+                                  &src, &fec_stats) < 0) {
+                puts("Error: malformed FEC datagram");
+            }
         }
     }
 }
 
 static void *_server_thread(void *args)
 {
-    event_queue_t queue;
     sock_udp_ep_t server_addr = SOCK_IP_EP_ANY;
     int res;
 
@@ -90,15 +121,37 @@ static void *_server_thread(void *args)
                server_addr.port, -res);
         return NULL;
     }
+    if (server_group) {
+        ipv4_addr_t group;
+
+        if ((ipv4_addr_from_str(&group, server_group) == NULL) ||
+            ((res = mcast_join(&server_sock, &group)) < 0)) {
+            printf("Unable to join group %s\n", server_group);
+        }
+    }
     server_running = true;
+    metrics_register(&rx_datagrams);
+    metrics_register(&rx_bytes);
     printf("Success: started UDP server on port %" PRIu16 "\n",
            server_addr.port);
-    event_queue_init(&queue);
-    sock_udp_event_init(&server_sock, &queue, _udp_recv, "test");
-    event_loop(&queue);
+    evq_init(&_evq, "udp_server");
+    evq_udp_event_init(&_evq, &server_sock, _udp_recv, "test", "recv");
+    evq_loop(&_evq);
     return NULL;
 }
 
+typedef struct {
+    sock_udp_t *sock;
+    const sock_udp_ep_t *dst;
+} _fec_send_ctx_t;
+
+static int _fec_send(void *arg, const void *pkt, size_t len)
+{
+    _fec_send_ctx_t *ctx = arg;
+
+    return sock_udp_send(ctx->sock, pkt, len, ctx->dst);
+}
+
 static int udp_send(char *addr_str, char *port_str, char *data, unsigned int num,
                     unsigned int delay)
 {
@@ -120,11 +173,25 @@ static int udp_send(char *addr_str, char *port_str, char *data, unsigned int num
     data_len = hex2ints(byte_data, data);
     for (unsigned int i = 0; i < num; i++) {
         sock_udp_t *sock = NULL;
+        int res;
 
         if (server_running) {
             sock = &server_sock;
         }
-        if (sock_udp_send(sock, byte_data, data_len, &dst) < 0) {
+        if (fec_enabled) {
+            _fec_send_ctx_t ctx = { .sock = sock, .dst = &dst };
+
+            res = fec_enc_send(&fec_enc, byte_data, data_len, _fec_send, &ctx,
+                               &fec_stats);
+            if ((res == 0) && (i == (num - 1))) {
+                /* don't leave the tail of the burst unprotected */
+                res = fec_enc_flush(&fec_enc, _fec_send, &ctx, &fec_stats);
+            }
+        }
+        else {
+            res = sock_udp_send(sock, byte_data, data_len, &dst);
+        }
+        if (res < 0) {
             puts("could not send");
         }
         else {
@@ -136,9 +203,59 @@ static int udp_send(char *addr_str, char *port_str, char *data, unsigned int num
     return 0;
 }
 
-static int udp_start_server(char *port_str)
+static void udp_fec_print_stats(void)
+{
+    uint32_t tx = fec_stats.data_tx + fec_stats.repair_tx;
+    uint32_t rx = fec_stats.data_rx + fec_stats.repair_rx;
+    uint32_t lost = fec_stats.recovered + fec_stats.residual;
+
+    printf("FEC k=%u m=%u (%s)\n", fec_enc.k, fec_enc.m,
+           fec_enabled ? "enabled" : "disabled");
+    printf("tx: %" PRIu32 " data, %" PRIu32 " repair, %" PRIu32 " ns/packet\n",
+           fec_stats.data_tx, fec_stats.repair_tx,
+           tx ? (uint32_t)(((uint64_t)fec_stats.enc_us * 1000) / tx) : 0);
+    printf("rx: %" PRIu32 " data, %" PRIu32 " repair, %" PRIu32 " ns/packet\n",
+           fec_stats.data_rx, fec_stats.repair_rx,
+           rx ? (uint32_t)(((uint64_t)fec_stats.dec_us * 1000) / rx) : 0);
+    printf("lost: %" PRIu32 " recovered, %" PRIu32 " residual (%" PRIu32
+           "/1000 of data)\n", fec_stats.recovered, fec_stats.residual,
+           (fec_stats.data_rx + lost) ?
+           (fec_stats.residual * 1000) / (fec_stats.data_rx + lost) : 0);
+}
+
+static int udp_fec(int argc, char **argv)
+{
+    if (argc < 3) {
+        printf("usage: %s fec [<k> <m>|off|stats]\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[2], "off") == 0) {
+        fec_enabled = false;
+        return 0;
+    }
+    if (strcmp(argv[2], "stats") == 0) {
+        udp_fec_print_stats();
+        return 0;
+    }
+    if (argc < 4) {
+        printf("usage: %s fec <k> <m>\n", argv[0]);
+        return 1;
+    }
+    if (fec_enc_init(&fec_enc, atoi(argv[2]), atoi(argv[3])) < 0) {
+        printf("error: need 1 <= k <= %u and 1 <= m <= %u\n", FEC_K_MAX,
+               FEC_M_MAX);
+        return 1;
+    }
+    fec_dec_init(&fec_dec);
+    memset(&fec_stats, 0, sizeof(fec_stats));
+    fec_enabled = true;
+    return 0;
+}
+
+static int udp_start_server(char *port_str, char *group_str)
 {
-    if (thread_create(server_stack, sizeof(server_stack), THREAD_PRIORITY_MAIN - 1,
+    server_group = group_str;
+    if (thread_create(server_stack, sizeof(server_stack), PRIO_UDP,
                       THREAD_CREATE_STACKTEST, _server_thread, port_str,
                       "UDP server") <= KERNEL_PID_UNDEF) {
         return 1;
@@ -149,7 +266,7 @@ static int udp_start_server(char *port_str)
 int udp_cmd(int argc, char **argv)
 {
     if (argc < 2) {
-        printf("usage: %s [send|server]\n", argv[0]);
+        printf("usage: %s [send|server|fec]\n", argv[0]);
         return 1;
     }
 
@@ -176,16 +293,19 @@ int udp_cmd(int argc, char **argv)
         }
         if (strcmp(argv[2], "start") == 0) {
             if (argc < 4) {
-                printf("usage %s server start <port>\n", argv[0]);
+                printf("usage %s server start <port> [<group>]\n", argv[0]);
                 return 1;
             }
-            return udp_start_server(argv[3]);
+            return udp_start_server(argv[3], (argc > 4) ? argv[4] : NULL);
         }
         else {
             puts("error: invalid command");
             return 1;
         }
     }
+    else if (strcmp(argv[1], "fec") == 0) {
+        return udp_fec(argc, argv);
+    }
     else {
         puts("error: invalid command");
         return 1;
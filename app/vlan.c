@@ -0,0 +1,420 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       802.1Q VLAN sub-interfaces on the Ethernet interface
+ * @}
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/etharp.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "net/ipv4/addr.h"
+#include "netdev_hook.h"
+#include "vlan.h"
+#include "xtimer.h"
+
+#ifdef MODULE_SOCK_TCP
+#include "net/ipv4.h"
+#include "net/sock/tcp.h"
+#endif
+
+#define MAC_LEN             (12U)   /* destination and source address */
+#define TAG_LEN             (4U)
+#define TYPE_OFFSET         (12U)
+#define IP_TOS_OFFSET       (TYPE_OFFSET + TAG_LEN + 2 + 1)
+#define VID_MASK            (0x0fffU)
+#define PCP_SHIFT           (13U)
+#define BENCH_CHUNK         (1024U)
+
+typedef struct {
+    struct netif netif;
+    uint16_t vid;           /* 0 marks a free slot */
+    vlan_stats_t stats;
+} _vlan_t;
+
+static _vlan_t _vlans[VLAN_NUMOF];
+static struct netif *_eth;
+static netif_input_fn _eth_input;
+static uint32_t _unknown, _prio_tagged;
+/* DSCP class to PCP, the identity matches the class selector code points */
+static uint8_t _pcp_map[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+NETIF_DECLARE_EXT_CALLBACK(_netif_cb)
+
+static _vlan_t *_find(uint16_t vid)
+{
+    for (unsigned i = 0; i < VLAN_NUMOF; i++) {
+        if (_vlans[i].vid == vid) {
+            return &_vlans[i];
+        }
+    }
+    return NULL;
+}
+
+static inline void _strip(struct pbuf *p)
+{
+    uint8_t *frame = p->payload;
+
+    memmove(frame + TAG_LEN, frame, MAC_LEN);
+    pbuf_remove_header(p, TAG_LEN);
+}
+
+/* runs in the lwIP netdev thread */
+static err_t _input(struct pbuf *p, struct netif *netif)
+{
+    const uint8_t *frame = p->payload;
+    uint16_t vid;
+    _vlan_t *vlan;
+
+    if ((p->len < (TYPE_OFFSET + TAG_LEN + 2)) ||
+        (frame[TYPE_OFFSET] != 0x81) || (frame[TYPE_OFFSET + 1] != 0x00)) {
+        return _eth_input(p, netif);
+    }
+    vid = ((frame[TYPE_OFFSET + 2] << 8) | frame[TYPE_OFFSET + 3]) & VID_MASK;
+    if (vid == 0) {
+        _prio_tagged++;
+        _strip(p);
+        return _eth_input(p, netif);
+    }
+    if ((vlan = _find(vid)) == NULL) {
+        _unknown++;
+        pbuf_free(p);
+        return ERR_OK;
+    }
+    vlan->stats.rx++;
+    _strip(p);
+    return vlan->netif.input(p, &vlan->netif);
+}
+
+static uint16_t _tci(_vlan_t *vlan, const struct pbuf *p)
+{
+    const uint8_t *frame = p->payload;
+    uint8_t pcp = 0;
+
+    /* the tag is already in place, so the IPv4 header starts behind it */
+    if ((p->len > IP_TOS_OFFSET) &&
+        (frame[TYPE_OFFSET + TAG_LEN] == 0x08) &&
+        (frame[TYPE_OFFSET + TAG_LEN + 1] == 0x00)) {
+        pcp = _pcp_map[frame[IP_TOS_OFFSET] >> 5];
+    }
+    return (pcp << PCP_SHIFT) | vlan->vid;
+}
+
+static void _tag(_vlan_t *vlan, struct pbuf *p)
+{
+    uint8_t *frame = p->payload;
+    uint16_t tci;
+
+    memmove(frame, frame + TAG_LEN, MAC_LEN);
+    frame[TYPE_OFFSET] = 0x81;
+    frame[TYPE_OFFSET + 1] = 0x00;
+    tci = _tci(vlan, p);
+    frame[TYPE_OFFSET + 2] = tci >> 8;
+    frame[TYPE_OFFSET + 3] = tci & 0xff;
+}
+
+/* runs with the lwIP core locked */
+static err_t _linkoutput(struct netif *netif, struct pbuf *p)
+{
+    _vlan_t *vlan = netif->state;
+    struct pbuf *q;
+    err_t res;
+
+    if (p->len < MAC_LEN) {
+        return ERR_BUF;
+    }
+    if (pbuf_add_header(p, TAG_LEN) == 0) {
+        _tag(vlan, p);
+        res = _eth->linkoutput(_eth, p);
+        /* TCP keeps the pbuf for retransmissions, so undo the tag */
+        _strip(p);
+        vlan->stats.tx++;
+        return res;
+    }
+    /* a pbuf without link header space, e.g. one allocated by hand */
+    if ((q = pbuf_alloc(PBUF_RAW, p->tot_len + TAG_LEN, PBUF_RAM)) == NULL) {
+        return ERR_MEM;
+    }
+    pbuf_copy_partial(p, (uint8_t *)q->payload + TAG_LEN, p->tot_len, 0);
+    _tag(vlan, q);
+    res = _eth->linkoutput(_eth, q);
+    pbuf_free(q);
+    vlan->stats.tx++;
+    vlan->stats.tx_copied++;
+    return res;
+}
+
+static err_t _netif_init(struct netif *netif)
+{
+    netif->name[0] = 'v';
+    netif->name[1] = 'l';
+    netif->mtu = _eth->mtu;
+    netif->hwaddr_len = _eth->hwaddr_len;
+    memcpy(netif->hwaddr, _eth->hwaddr, sizeof(netif->hwaddr));
+    netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP |
+                   NETIF_FLAG_ETHERNET;
+    netif->output = etharp_output;
+    netif->linkoutput = _linkoutput;
+    return ERR_OK;
+}
+
+/* the sub-interfaces follow the link of the Ethernet interface */
+static void _netif_changed(struct netif *netif, netif_nsc_reason_t reason,
+                           const netif_ext_callback_args_t *args)
+{
+    if ((netif != _eth) || !(reason & LWIP_NSC_LINK_CHANGED)) {
+        return;
+    }
+    for (unsigned i = 0; i < VLAN_NUMOF; i++) {
+        if (_vlans[i].vid == 0) {
+            continue;
+        }
+        if (args->link_changed.state) {
+            netif_set_link_up(&_vlans[i].netif);
+        }
+        else {
+            netif_set_link_down(&_vlans[i].netif);
+        }
+    }
+}
+
+void vlan_init(void)
+{
+    if ((_eth = netdev_hook_netif()) == NULL) {
+        return;
+    }
+    LOCK_TCPIP_CORE();
+    _eth_input = _eth->input;
+    _eth->input = _input;
+    netif_add_ext_callback(&_netif_cb, _netif_changed);
+    UNLOCK_TCPIP_CORE();
+}
+
+struct netif *vlan_add(uint16_t vid, const ip4_addr_t *addr,
+                       const ip4_addr_t *netmask, const ip4_addr_t *gw)
+{
+    _vlan_t *vlan;
+
+    if ((_eth == NULL) || (vid == 0) || (vid > VLAN_VID_MAX) || _find(vid) ||
+        ((vlan = _find(0)) == NULL)) {
+        return NULL;
+    }
+    memset(&vlan->stats, 0, sizeof(vlan->stats));
+    LOCK_TCPIP_CORE();
+    if (netif_add(&vlan->netif, addr, netmask, gw ? gw : IP4_ADDR_ANY, vlan,
+                  _netif_init, tcpip_input) == NULL) {
+        UNLOCK_TCPIP_CORE();
+        return NULL;
+    }
+    netif_set_up(&vlan->netif);
+    if (netif_is_link_up(_eth)) {
+        netif_set_link_up(&vlan->netif);
+    }
+    /* set last, the netdev thread picks the slot up from here on */
+    vlan->vid = vid;
+    UNLOCK_TCPIP_CORE();
+    return &vlan->netif;
+}
+
+int vlan_del(uint16_t vid)
+{
+    _vlan_t *vlan;
+
+    if ((vid == 0) || ((vlan = _find(vid)) == NULL)) {
+        return -ENOENT;
+    }
+    LOCK_TCPIP_CORE();
+    vlan->vid = 0;
+    netif_remove(&vlan->netif);
+    UNLOCK_TCPIP_CORE();
+    return 0;
+}
+
+void vlan_set_pcp(uint8_t cls, uint8_t pcp)
+{
+    if (cls < ARRAY_SIZE(_pcp_map)) {
+        _pcp_map[cls] = pcp & 0x7;
+    }
+}
+
+static void _print_addr(const char *name, const ip4_addr_t *addr)
+{
+    char addr_str[IPV4_ADDR_MAX_STR_LEN];
+
+    printf("%s %s", name, ipv4_addr_to_str(addr_str, (const ipv4_addr_t *)addr,
+                                           sizeof(addr_str)));
+}
+
+static int vlan_print(void)
+{
+    for (unsigned i = 0; i < VLAN_NUMOF; i++) {
+        _vlan_t *vlan = &_vlans[i];
+
+        if (vlan->vid == 0) {
+            continue;
+        }
+        printf("%c%c_%02u: vid %u", vlan->netif.name[0], vlan->netif.name[1],
+               vlan->netif.num, vlan->vid);
+        _print_addr(",", netif_ip4_addr(&vlan->netif));
+        _print_addr("/", netif_ip4_netmask(&vlan->netif));
+        printf(", rx %" PRIu32 ", tx %" PRIu32 " (%" PRIu32 " copied)\n",
+               vlan->stats.rx, vlan->stats.tx, vlan->stats.tx_copied);
+    }
+    printf("%" PRIu32 " frames of unknown VLANs dropped, %" PRIu32
+           " priority tagged\n", _unknown, _prio_tagged);
+    printf("PCP by DSCP class:");
+    for (unsigned i = 0; i < ARRAY_SIZE(_pcp_map); i++) {
+        printf(" %u", _pcp_map[i]);
+    }
+    puts("");
+    return 0;
+}
+
+static int _parse_addr(ip4_addr_t *addr, const char *str)
+{
+    if (ipv4_addr_from_str((ipv4_addr_t *)addr, str) == NULL) {
+        printf("error: unable to parse IPv4 address %s\n", str);
+        return 1;
+    }
+    return 0;
+}
+
+static int vlan_add_cmd(int argc, char **argv)
+{
+    ip4_addr_t addr, netmask, gw;
+
+    if (argc < 5) {
+        printf("usage: %s add <vid> <addr> <netmask> [<gw>]\n", argv[0]);
+        return 1;
+    }
+    if (_parse_addr(&addr, argv[3]) || _parse_addr(&netmask, argv[4]) ||
+        ((argc > 5) && _parse_addr(&gw, argv[5]))) {
+        return 1;
+    }
+    if (vlan_add(atoi(argv[2]), &addr, &netmask,
+                 (argc > 5) ? &gw : NULL) == NULL) {
+        puts("error: invalid or duplicate VLAN ID, or no free slot");
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef MODULE_SOCK_TCP
+static uint8_t _bench_buf[BENCH_CHUNK];
+
+/* same stream as `rudp tcp`, received by tools/rudp_recv.py --tcp */
+static int _bench_one(const char *addr_str, uint16_t port, uint32_t size)
+{
+    sock_tcp_ep_t dst = SOCK_IPV4_EP_ANY;
+    network_uint32_t hdr = byteorder_htonl(size);
+    sock_tcp_t sock;
+    uint32_t offset = 0, start, duration;
+    char ack;
+    int res;
+
+    if (_parse_addr((ip4_addr_t *)&dst.addr.ipv4, addr_str)) {
+        return 1;
+    }
+    dst.port = port;
+    if ((res = sock_tcp_connect(&sock, &dst, 0, 0)) < 0) {
+        printf("error: unable to connect to %s (error code %d)\n", addr_str,
+               -res);
+        return 1;
+    }
+    start = xtimer_now_usec();
+    res = sock_tcp_write(&sock, &hdr, sizeof(hdr));
+    while ((res >= 0) && (offset < size)) {
+        size_t len = MIN(sizeof(_bench_buf), size - offset);
+
+        if ((res = sock_tcp_write(&sock, _bench_buf, len)) > 0) {
+            offset += res;
+        }
+    }
+    if (res >= 0) {
+        sock_tcp_read(&sock, &ack, sizeof(ack), 5 * US_PER_SEC);
+    }
+    duration = MAX(xtimer_now_usec() - start, 1);
+    sock_tcp_disconnect(&sock);
+    if (res < 0) {
+        printf("error: write failed (error code %d)\n", -res);
+        return 1;
+    }
+    printf("%s: %" PRIu32 " byte in %" PRIu32 " ms, %.4f Mbps\n", addr_str,
+           size, duration / US_PER_MS, (float)size * 8 / duration);
+    return 0;
+}
+
+static int vlan_bench(int argc, char **argv)
+{
+    uint16_t port;
+    uint32_t size;
+
+    if (argc < 6) {
+        printf("usage: %s bench <untagged addr> <tagged addr> <port> <size>\n",
+               argv[0]);
+        return 1;
+    }
+    port = atoi(argv[4]);
+    size = strtoul(argv[5], NULL, 0);
+    for (size_t i = 0; i < sizeof(_bench_buf); i++) {
+        _bench_buf[i] = i;
+    }
+    if (_bench_one(argv[2], port, size) || _bench_one(argv[3], port, size)) {
+        return 1;
+    }
+    return vlan_print();
+}
+#endif
+
+int vlan_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        return vlan_print();
+    }
+    else if (strcmp(argv[1], "add") == 0) {
+        return vlan_add_cmd(argc, argv);
+    }
+    else if (strcmp(argv[1], "del") == 0) {
+        if (argc < 3) {
+            printf("usage: %s del <vid>\n", argv[0]);
+            return 1;
+        }
+        if (vlan_del(atoi(argv[2])) < 0) {
+            puts("error: no such VLAN");
+            return 1;
+        }
+        return 0;
+    }
+    else if (strcmp(argv[1], "pcp") == 0) {
+        if (argc < 4) {
+            printf("usage: %s pcp <dscp class 0-7> <pcp 0-7>\n", argv[0]);
+            return 1;
+        }
+        vlan_set_pcp(atoi(argv[2]), atoi(argv[3]));
+        return 0;
+    }
+#ifdef MODULE_SOCK_TCP
+    else if (strcmp(argv[1], "bench") == 0) {
+        return vlan_bench(argc, argv);
+    }
+#endif
+    else {
+        printf("usage: %s [add|del|pcp|bench]\n", argv[0]);
+        return 1;
+    }
+}
+
+/** @} */
@@ -0,0 +1,115 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       802.1Q VLAN sub-interfaces on the Ethernet interface
+ *
+ * Every VLAN is a separate lwIP interface with its own addresses, sharing
+ * the MAC address and the driver of the Ethernet interface. The input
+ * function of the Ethernet interface is wrapped: tagged frames are handed to
+ * the sub-interface of their VLAN ID, priority tagged frames (VID 0) to the
+ * Ethernet interface itself, frames of unknown VLANs are dropped.
+ *
+ * Neither direction copies the frame. The tag is stripped by moving the two
+ * MAC addresses over it, and inserted in the link header space lwIP reserves
+ * in front of every frame (`PBUF_LINK_ENCAPSULATION_HLEN`). The PCP of the
+ * tag follows the DSCP class of the IPv4 header (see qos.h), so the
+ * priority of a socket is set with `qos_*_set_tos()`.
+ *
+ * `vlan bench` sends the same TCP stream to an address on the untagged
+ * network and one on a VLAN, received by `tools/rudp_recv.py --tcp` on a host
+ * with a matching VLAN interface, e.g. for BOARD=native:
+ *
+ *     sudo ip link add link tap0 name tap0.10 type vlan id 10
+ * @}
+ */
+#ifndef VLAN_H
+#define VLAN_H
+
+#include <stdint.h>
+
+#include "lwip/netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef VLAN_NUMOF
+#define VLAN_NUMOF              (2U)        /**< number of sub-interfaces */
+#endif
+/** @} */
+
+/**
+ * @brief   Largest VLAN ID
+ */
+#define VLAN_VID_MAX            (4094U)
+
+/**
+ * @brief   VLAN statistics
+ */
+typedef struct {
+    uint32_t rx;                /**< tagged frames received */
+    uint32_t tx;                /**< tagged frames sent */
+    uint32_t tx_copied;         /**< frames copied for lack of header space */
+} vlan_stats_t;
+
+/**
+ * @brief   Hook the input of the Ethernet interface
+ */
+void vlan_init(void);
+
+/**
+ * @brief   Add a VLAN sub-interface
+ *
+ * @param[in] vid       VLAN ID, 1 to @ref VLAN_VID_MAX
+ * @param[in] addr      IPv4 address of the sub-interface
+ * @param[in] netmask   network mask
+ * @param[in] gw        gateway, may be NULL
+ *
+ * @return  the new interface on success
+ * @return  NULL if @p vid is invalid or in use or no slot is free
+ */
+struct netif *vlan_add(uint16_t vid, const ip4_addr_t *addr,
+                       const ip4_addr_t *netmask, const ip4_addr_t *gw);
+
+/**
+ * @brief   Remove the sub-interface of VLAN @p vid
+ *
+ * @return  0 on success
+ * @return  -ENOENT if there is no such VLAN
+ */
+int vlan_del(uint16_t vid);
+
+/**
+ * @brief   Map the DSCP class (DSCP >> 3) @p cls to the PCP @p pcp
+ */
+void vlan_set_pcp(uint8_t cls, uint8_t pcp);
+
+/**
+ * @brief   VLAN shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int vlan_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VLAN_H */
+/** @} */
@@ -0,0 +1,356 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       SNTP client and disciplined wall clock
+ * @}
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "byteorder.h"
+#include "mutex.h"
+#include "net/ipv4/addr.h"
+#include "prio.h"
+#include "thread.h"
+#include "wallclock.h"
+#include "xtimer.h"
+
+#define NTP_UNIX_OFFSET     (2208988800UL)  /* 1900 to 1970 in s */
+#define NTP_MODE_CLIENT     (3U)
+#define NTP_MODE_SERVER     (4U)
+#define NTP_VERSION         (4U)
+#define NTP_LI_ALARM        (3U)
+#define FREQ_GAIN           (4)             /* of the frequency loop */
+
+typedef struct __attribute__((packed)) {
+    uint8_t li_vn_mode;
+    uint8_t stratum;
+    int8_t poll;
+    int8_t precision;
+    network_uint32_t root_delay;            /* 16.16 s */
+    network_uint32_t root_dispersion;       /* 16.16 s */
+    network_uint32_t ref_id;
+    network_uint64_t ref;
+    network_uint64_t origin;
+    network_uint64_t receive;
+    network_uint64_t transmit;
+} _ntp_pkt_t;
+
+typedef struct {
+    int64_t offset;
+    uint32_t delay;
+    uint32_t root;              /* server error, root delay / 2 + disp. */
+    uint64_t local;             /* xtimer_now_usec64() of the answer */
+} _sample_t;
+
+static mutex_t _lock = MUTEX_INIT;
+static wallclock_state_t _state;
+static uint64_t _base_local;
+static uint64_t _base_wall;
+static int64_t _slew;           /* offset still to slew out at the base */
+static uint64_t _sync_local;
+static uint32_t _sync_error;
+
+/* callers hold _lock */
+static uint64_t _wall(uint64_t local, int64_t *applied)
+{
+    int64_t dt = local - _base_local;
+    int64_t slew = 0;
+
+    if (dt > 0) {
+        int64_t max = (dt * WALLCLOCK_SLEW_PPM) / 1000000;
+
+        slew = (_slew > max) ? max : ((_slew < -max) ? -max : _slew);
+    }
+    if (applied) {
+        *applied = slew;
+    }
+    return _base_wall + dt + (dt * _state.freq_ppb) / 1000000000 + slew;
+}
+
+static uint32_t _error(uint64_t local, int64_t applied)
+{
+    int64_t pending = _slew - applied;
+    int64_t since = local - _sync_local;
+
+    return _sync_error + ((pending < 0) ? -pending : pending) +
+           (((since < 0) ? -since : since) * WALLCLOCK_DRIFT_PPM) / 1000000;
+}
+
+uint64_t wallclock_from_local(uint32_t local_us, uint32_t *error_us)
+{
+    uint64_t now = xtimer_now_usec64();
+    /* the stamp was taken at most one 32 bit wrap ago */
+    uint64_t local = now - (uint32_t)((uint32_t)now - local_us);
+    uint64_t wall = 0;
+    int64_t applied;
+
+    mutex_lock(&_lock);
+    if (_state.synced) {
+        wall = _wall(local, &applied);
+        if (error_us) {
+            *error_us = _error(local, applied);
+        }
+    }
+    mutex_unlock(&_lock);
+    return wall;
+}
+
+uint64_t wallclock_now(uint32_t *error_us)
+{
+    return wallclock_from_local(xtimer_now_usec(), error_us);
+}
+
+const wallclock_state_t *wallclock_state(void)
+{
+    return &_state;
+}
+
+static void _update(const _sample_t *s)
+{
+    int64_t applied, pending;
+
+    mutex_lock(&_lock);
+    /* restart the clock at the answer, keeping what was slewed so far */
+    _base_wall = _wall(s->local, &applied);
+    pending = _slew - applied;
+    if (!_state.synced || (s->offset > WALLCLOCK_STEP_US) ||
+        (s->offset < -WALLCLOCK_STEP_US)) {
+        _base_wall += s->offset;
+        _slew = 0;
+        _state.steps++;
+    }
+    else {
+        /* what is left after the pending slew is frequency error */
+        int64_t interval = s->local - _sync_local;
+        int64_t freq = _state.freq_ppb;
+
+        if (interval > 0) {
+            freq += ((s->offset - pending) * 1000000000) /
+                    (interval * FREQ_GAIN);
+        }
+        if (freq > WALLCLOCK_FREQ_MAX_PPM * 1000) {
+            freq = WALLCLOCK_FREQ_MAX_PPM * 1000;
+        }
+        else if (freq < -WALLCLOCK_FREQ_MAX_PPM * 1000) {
+            freq = -WALLCLOCK_FREQ_MAX_PPM * 1000;
+        }
+        _state.freq_ppb = freq;
+        _slew = s->offset;
+    }
+    _base_local = s->local;
+    _sync_local = s->local;
+    _sync_error = s->delay / 2 + s->root;
+    _state.synced = true;
+    /* the first step covers the time since 1970 */
+    _state.offset_us = MAX(MIN(s->offset, INT32_MAX), INT32_MIN);
+    _state.delay_us = s->delay;
+    _state.last_sync_s = s->local / US_PER_SEC;
+    _state.polls++;
+    mutex_unlock(&_lock);
+}
+
+#ifdef MODULE_SOCK_UDP
+static uint64_t _to_ntp(uint64_t wall)
+{
+    uint64_t sec = wall / US_PER_SEC + NTP_UNIX_OFFSET;
+    uint64_t frac = ((wall % US_PER_SEC) << 32) / US_PER_SEC;
+
+    return (sec << 32) | frac;
+}
+
+static int64_t _from_ntp(network_uint64_t ts)
+{
+    uint64_t ntp = byteorder_ntohll(ts);
+    uint64_t sec = ntp >> 32;
+
+    /* era 1 starts in 2036 */
+    if (sec < NTP_UNIX_OFFSET) {
+        sec += 1ULL << 32;
+    }
+    return (sec - NTP_UNIX_OFFSET) * US_PER_SEC +
+           (((ntp & 0xffffffff) * US_PER_SEC) >> 32);
+}
+
+static uint32_t _from_short(network_uint32_t v)
+{
+    return ((uint64_t)byteorder_ntohl(v) * US_PER_SEC) >> 16;
+}
+
+static int _query(sock_udp_t *sock, _sample_t *s)
+{
+    _ntp_pkt_t pkt = { .li_vn_mode = (NTP_VERSION << 3) | NTP_MODE_CLIENT };
+    network_uint64_t origin;
+    uint64_t t1_local, t4_local;
+    int64_t t1, t2, t3, t4;
+
+    mutex_lock(&_lock);
+    t1_local = xtimer_now_usec64();
+    t1 = _wall(t1_local, NULL);
+    mutex_unlock(&_lock);
+    origin = byteorder_htonll(_to_ntp(t1));
+    pkt.transmit = origin;
+    if (sock_udp_send(sock, &pkt, sizeof(pkt), NULL) < 0) {
+        return -EIO;
+    }
+    while (1) {
+        ssize_t res = sock_udp_recv(sock, &pkt, sizeof(pkt),
+                                    WALLCLOCK_TIMEOUT_US, NULL);
+
+        if (res < 0) {
+            return res;
+        }
+        t4_local = xtimer_now_usec64();
+        /* late answers to earlier requests don't echo this one */
+        if ((res == sizeof(pkt)) && (pkt.origin.u64 == origin.u64)) {
+            break;
+        }
+    }
+    if (((pkt.li_vn_mode & 0x7) != NTP_MODE_SERVER) || (pkt.stratum == 0) ||
+        ((pkt.li_vn_mode >> 6) == NTP_LI_ALARM)) {
+        return -EPROTO;
+    }
+    mutex_lock(&_lock);
+    t4 = _wall(t4_local, NULL);
+    mutex_unlock(&_lock);
+    /* t1 went out through the NTP format, round it the same way */
+    t1 = _from_ntp(origin);
+    t2 = _from_ntp(pkt.receive);
+    t3 = _from_ntp(pkt.transmit);
+    s->offset = ((t2 - t1) + (t3 - t4)) / 2;
+    s->delay = MAX((t4 - t1) - (t3 - t2), 0);
+    s->root = _from_short(pkt.root_delay) / 2 +
+              _from_short(pkt.root_dispersion);
+    s->local = t4_local;
+    return 0;
+}
+
+static sock_udp_ep_t _server;
+static volatile uint32_t _poll_s = WALLCLOCK_POLL_S;
+static bool _running;
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+
+static void _poll(void)
+{
+    _sample_t best = { .delay = UINT32_MAX };
+    sock_udp_t sock;
+
+    if (sock_udp_create(&sock, NULL, &_server, 0) < 0) {
+        _state.timeouts++;
+        return;
+    }
+    /* the answer with the shortest round trip was delayed least */
+    for (unsigned i = 0; i < WALLCLOCK_BURST; i++) {
+        _sample_t s;
+
+        if ((_query(&sock, &s) == 0) && (s.delay < best.delay)) {
+            best = s;
+        }
+    }
+    sock_udp_close(&sock);
+    if (best.delay == UINT32_MAX) {
+        _state.timeouts++;
+        return;
+    }
+    _update(&best);
+}
+
+static void *_sntp_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        _poll();
+        xtimer_sleep(_poll_s);
+    }
+    return NULL;
+}
+
+int wallclock_start(const sock_udp_ep_t *server)
+{
+    if (_running) {
+        return -EALREADY;
+    }
+    _server = *server;
+    _running = true;
+    if (thread_create(_stack, sizeof(_stack), PRIO_SNTP,
+                      THREAD_CREATE_STACKTEST, _sntp_thread, NULL,
+                      "sntp") <= KERNEL_PID_UNDEF) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+#else
+int wallclock_start(const sock_udp_ep_t *server)
+{
+    (void)server;
+    return -ENOTSUP;
+}
+#endif
+
+static void _print(void)
+{
+    uint32_t error;
+    uint64_t now = wallclock_now(&error);
+
+    if (!_state.synced) {
+        printf("not synchronized, %" PRIu32 " polls without answer\n",
+               _state.timeouts);
+        return;
+    }
+    printf("time %" PRIu32 ".%06" PRIu32 " +/- %" PRIu32 " us\n",
+           (uint32_t)(now / US_PER_SEC), (uint32_t)(now % US_PER_SEC),
+           error);
+    printf("offset %" PRId32 " us, delay %" PRIu32 " us, frequency %"
+           PRId32 " ppb, last answer %" PRIu32 " s ago\n", _state.offset_us,
+           _state.delay_us, _state.freq_ppb,
+           (uint32_t)(xtimer_now_usec64() / US_PER_SEC) - _state.last_sync_s);
+    printf("%" PRIu32 " polls, %" PRIu32 " timeouts, %" PRIu32 " steps\n",
+           _state.polls, _state.timeouts, _state.steps);
+}
+
+int wallclock_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        _print();
+        return 0;
+    }
+#ifdef MODULE_SOCK_UDP
+    else if ((strcmp(argv[1], "start") == 0) && (argc > 2)) {
+        sock_udp_ep_t server = SOCK_IPV4_EP_ANY;
+        int res;
+
+        if (ipv4_addr_from_str((ipv4_addr_t *)&server.addr.ipv4,
+                               argv[2]) == NULL) {
+            puts("Error: unable to parse server address");
+            return 1;
+        }
+        server.port = (argc > 3) ? strtoul(argv[3], NULL, 0)
+                                 : WALLCLOCK_PORT;
+        if ((res = wallclock_start(&server)) < 0) {
+            printf("error: unable to start SNTP client (error code %d)\n",
+                   -res);
+            return 1;
+        }
+        return 0;
+    }
+    else if ((strcmp(argv[1], "poll") == 0) && (argc > 2)) {
+        _poll_s = MAX(strtoul(argv[2], NULL, 0), 1);
+        return 0;
+    }
+#endif
+    printf("usage: %s [start <server> [<port>]|poll <s>]\n", argv[0]);
+    return 1;
+}
+
+/** @} */
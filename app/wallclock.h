@@ -0,0 +1,143 @@
+/*
+ * This file is subject to the terms and conditions of the GNU Lesser
+ * General Public License v2.1. See the file LICENSE in the top level
+ * directory for more details.
+ */
+
+/**
+ * @ingroup     tests
+ * @{
+ *
+ * @file
+ * @brief       SNTP client and disciplined wall clock
+ *
+ * The wall clock runs on xtimer_now_usec64() and is set by an SNTP client
+ * (RFC 4330) on sock_udp. Every @ref WALLCLOCK_POLL_S the client sends a
+ * burst of @ref WALLCLOCK_BURST requests and uses the answer with the
+ * shortest round trip, whose offset estimate is least disturbed by
+ * queueing.
+ *
+ * The first answer, and any offset beyond @ref WALLCLOCK_STEP_US, steps
+ * the clock. Smaller offsets are slewed out at @ref WALLCLOCK_SLEW_PPM, so
+ * time stamps never go backwards and intervals are stretched by at most
+ * that rate. The offsets left after each poll also correct the frequency
+ * of the local oscillator.
+ *
+ * Each reading comes with an error bound: half the round trip of the last
+ * answer, the server's root delay and dispersion, the part of the offset
+ * not slewed out yet, and @ref WALLCLOCK_DRIFT_PPM of the time since the
+ * last answer.
+ *
+ * Local time stamps taken with xtimer_now_usec() up to 71 minutes ago can
+ * be converted with @ref wallclock_from_local, so existing samples can be
+ * put on the collector's time line.
+ * @}
+ */
+#ifndef WALLCLOCK_H
+#define WALLCLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "net/sock/udp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Default configuration
+ * @{
+ */
+#ifndef WALLCLOCK_PORT
+#define WALLCLOCK_PORT          (123U)      /**< SNTP server port */
+#endif
+#ifndef WALLCLOCK_POLL_S
+#define WALLCLOCK_POLL_S        (16U)       /**< poll interval */
+#endif
+#ifndef WALLCLOCK_BURST
+#define WALLCLOCK_BURST         (4U)        /**< requests per poll */
+#endif
+#ifndef WALLCLOCK_TIMEOUT_US
+#define WALLCLOCK_TIMEOUT_US    (500000UL)  /**< answer timeout */
+#endif
+#ifndef WALLCLOCK_STEP_US
+#define WALLCLOCK_STEP_US       (128000L)   /**< step instead of slew */
+#endif
+#ifndef WALLCLOCK_SLEW_PPM
+#define WALLCLOCK_SLEW_PPM      (500)       /**< slew rate */
+#endif
+#ifndef WALLCLOCK_FREQ_MAX_PPM
+#define WALLCLOCK_FREQ_MAX_PPM  (500)       /**< frequency correction limit */
+#endif
+#ifndef WALLCLOCK_DRIFT_PPM
+#define WALLCLOCK_DRIFT_PPM     (15)        /**< assumed residual drift */
+#endif
+/** @} */
+
+/**
+ * @brief   Clock state
+ */
+typedef struct {
+    bool synced;                /**< set after the first answer */
+    uint32_t polls;             /**< polls with an answer */
+    uint32_t timeouts;          /**< polls without an answer */
+    uint32_t steps;             /**< steps of the clock */
+    int32_t offset_us;          /**< offset measured at the last poll */
+    uint32_t delay_us;          /**< round trip of the last answer */
+    int32_t freq_ppb;           /**< frequency correction */
+    uint32_t last_sync_s;       /**< uptime of the last answer */
+} wallclock_state_t;
+
+/**
+ * @brief   Start the SNTP client thread
+ *
+ * @param[in] server    SNTP server
+ *
+ * @return  0 on success
+ * @return  -EALREADY if the client is already running
+ * @return  -ENOMEM if the thread could not be created
+ */
+int wallclock_start(const sock_udp_ep_t *server);
+
+/**
+ * @brief   Get the wall clock time
+ *
+ * @param[out] error_us     error bound, may be NULL
+ *
+ * @return  microseconds since the Unix epoch, 0 before the first sync
+ */
+uint64_t wallclock_now(uint32_t *error_us);
+
+/**
+ * @brief   Convert a time stamp of xtimer_now_usec() to wall clock time
+ *
+ * @param[in] local_us      time stamp taken less than 71 minutes ago
+ * @param[out] error_us     error bound, may be NULL
+ *
+ * @return  microseconds since the Unix epoch, 0 before the first sync
+ */
+uint64_t wallclock_from_local(uint32_t local_us, uint32_t *error_us);
+
+/**
+ * @brief   Get the clock state
+ */
+const wallclock_state_t *wallclock_state(void);
+
+/**
+ * @brief   Wall clock shell command
+ *
+ * @param[in] argc  number of arguments
+ * @param[in] argv  array of arguments
+ *
+ * @return  0 on success
+ * @return  other on error
+ */
+int wallclock_cmd(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WALLCLOCK_H */
+/** @} */